@@ -0,0 +1,81 @@
+// Include the arena interface.
+#include "arena.h"
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+// Include max_align_t.
+#include <stddef.h>
+
+void arena_init(Arena *arena) {
+    arena->blocks = NULL;
+    arena->allocations = 0;
+}
+
+void arena_destroy(Arena *arena) {
+    ArenaBlock *block = arena->blocks;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    const size_t align = _Alignof(max_align_t);
+    size = (size + align - 1) & ~(align - 1);
+    ArenaBlock *block = arena->blocks;
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(ArenaBlock) + block_size);
+        if (block == NULL) {
+            return NULL;
+        }
+        arena->allocations++;
+        block->next = arena->blocks;
+        block->used = 0;
+        block->size = block_size;
+        arena->blocks = block;
+    }
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+char *arena_strndup(Arena *arena, const char *str, size_t len) {
+    char *copy = arena_alloc(arena, len + 1);
+    if (copy != NULL) {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+void arena_reset(Arena *arena) {
+    ArenaBlock *block = arena->blocks;
+    if (block == NULL || block->next == NULL) {
+        if (block != NULL) {
+            block->used = 0;
+        }
+        return;
+    }
+    // The round needed several blocks: replace them with one block that holds all of them, so the
+    // next round of the same size needs no malloc at all
+    size_t total = 0;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        total += block->size;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+    block = malloc(sizeof(ArenaBlock) + total);
+    if (block != NULL) {
+        arena->allocations++;
+        block->next = NULL;
+        block->used = 0;
+        block->size = total;
+        arena->blocks = block;
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+// Include size types.
+#include <stddef.h>
+
+// Define the size of an arena block. Larger requests get a block of their own.
+#define ARENA_BLOCK_SIZE (16 * 1024)
+
+// A block of an arena. Allocations are carved from data back to back.
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used;
+    size_t size;
+    char data[];
+} ArenaBlock;
+
+/**
+ * @brief A bump allocator for short-lived strings.
+ *
+ * Allocating is a pointer bump in the current block; nothing is freed individually. arena_reset()
+ * discards everything at once and keeps a single block as large as all the blocks it replaces, so an
+ * arena that is reset after every page stops calling malloc once it has grown to fit the largest page.
+ * Not thread-safe; each worker owns one.
+ */
+typedef struct {
+    ArenaBlock *blocks;              // Block being filled, linked to the older ones
+    unsigned long allocations;       // Blocks allocated, for statistics
+} Arena;
+
+// Initialize an empty arena.
+void arena_init(Arena *arena);
+// Free every block.
+void arena_destroy(Arena *arena);
+// Allocate size bytes, aligned for any type. Returns NULL if memory runs out.
+void *arena_alloc(Arena *arena, size_t size);
+// Copy len bytes of str into the arena and terminate them. Returns NULL if memory runs out.
+char *arena_strndup(Arena *arena, const char *str, size_t len);
+// Discard every allocation, keeping one block big enough for as much again.
+void arena_reset(Arena *arena);
+
+#endif
@@ -0,0 +1,460 @@
+// End-to-end benchmark: the whole crawler against a synthetic site served from this process.
+//
+// The site is a tree of generated pages: page 0 links to pages 1..F, page 1 to F+1..2F, and so on down
+// to the given depth, and every page also links to a few pseudo-random pages of the site so that the
+// visited set turns links away. Each response can be held back by a fixed latency to stand in for the
+// network. The crawler runs as a child process with its stdout discarded; the harness reports pages
+// and links per second from the server's side, fetch latency quantiles from the crawler's metrics
+// dump, and the child's peak RSS and CPU time. Nothing leaves the loopback interface, so runs are
+// repeatable.
+//
+// Usage: bench/crawl_bench [--fanout F] [--depth D] [--cross N] [--page-size BYTES] [--latency MS]
+//                          [--crawler PATH] [-- crawler options...]
+
+// Define the required feature test macro to enable memmem() and wait4().
+#define _GNU_SOURCE
+
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+// Include atomic types for the server's counters.
+#include <stdatomic.h>
+// Include fixed-width integer types.
+#include <stdint.h>
+// Include the pthread library for the server threads.
+#include <pthread.h>
+// Include the clock used for timing and the latency sleeps.
+#include <time.h>
+// Include fork() and execv().
+#include <unistd.h>
+// Include long command-line option parsing.
+#include <getopt.h>
+// Include the socket API for the server.
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+// Include wait4() and the child's resource usage.
+#include <sys/wait.h>
+#include <sys/resource.h>
+// Include open() for redirecting the child's output.
+#include <fcntl.h>
+
+// Define the most pages the site may have.
+#define MAX_PAGES 10000000L
+// Define the size of a connection's request buffer.
+#define REQUEST_BUFFER 8192
+// Define the stack size of a connection thread; the crawler may open hundreds of connections.
+#define CONNECTION_STACK (128 * 1024)
+
+// Shape of the synthetic site.
+typedef struct {
+    long fanout;                     // Child pages per page
+    int depth;                       // Levels of the tree; also the depth the crawler is given
+    long cross;                      // Extra links per page to pseudo-random pages of the site
+    long page_size;                  // Approximate size of a page in bytes
+    long latency_ms;                 // Delay before every response
+    long pages;                      // Pages in the site
+} Site;
+
+Site site;
+atomic_ulong pages_served;
+atomic_ulong links_served;
+atomic_ulong bytes_served;
+atomic_ulong not_found;
+
+// Words the filler text is made of.
+static const char *WORDS[] = {
+    "crawler", "frontier", "thread", "socket", "latency", "queue", "parser", "anchor", "visited", "depth",
+    "host", "buffer", "chunk", "worker", "steal", "deque", "signal", "cache", "header", "body"
+};
+#define WORD_COUNT (sizeof(WORDS) / sizeof(WORDS[0]))
+
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Mix a page number and a link index into a pseudo-random number (SplitMix64).
+uint64_t mix(uint64_t page, uint64_t index) {
+    uint64_t z = page * 0x9E3779B97F4A7C15ULL + index + 1;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Number of pages in a tree of the given fan-out and depth, or -1 if it exceeds MAX_PAGES.
+long site_pages(long fanout, int depth) {
+    long pages = 0, level = 1;
+    for (int d = 0; d < depth; d++) {
+        pages += level;
+        if (pages > MAX_PAGES) {
+            return -1;
+        }
+        if (d + 1 < depth) {
+            if (level > MAX_PAGES / fanout) {
+                return -1;
+            }
+            level *= fanout;
+        }
+    }
+    return pages;
+}
+
+// Write page number page into out, which holds at least page_capacity() bytes. Returns the body
+// length and sets *links to the number of links on the page.
+size_t page_render(long page, char *out, long *links) {
+    char *p = out;
+    p += sprintf(p, "<!DOCTYPE html>\n<html><head><title>Page %ld</title></head><body>\n<h1>Page %ld</h1>\n",
+                 page, page);
+    *links = 0;
+    for (long i = 1; i <= site.fanout; i++) {
+        long child = page * site.fanout + i;
+        if (child >= site.pages) {
+            break;
+        }
+        p += sprintf(p, "<a href=\"/p%ld.html\">Page %ld</a>\n", child, child);
+        (*links)++;
+    }
+    for (long i = 0; i < site.cross; i++) {
+        long target = (long)(mix((uint64_t)page, (uint64_t)i) % (uint64_t)site.pages);
+        p += sprintf(p, "<a href=\"p%ld.html\">See also %ld</a>\n", target, target);
+        (*links)++;
+    }
+    // Fill up to the page size with paragraphs of words picked by the page number
+    size_t target_size = (size_t)site.page_size;
+    uint64_t word = 0;
+    while ((size_t)(p - out) + 32 < target_size) {
+        p += sprintf(p, "<p>");
+        for (int w = 0; w < 12 && (size_t)(p - out) + 32 < target_size; w++) {
+            p += sprintf(p, "%s ", WORDS[mix((uint64_t)page, word++) % WORD_COUNT]);
+        }
+        p += sprintf(p, "</p>\n");
+    }
+    p += sprintf(p, "</body></html>\n");
+    return (size_t)(p - out);
+}
+
+// Bytes a rendered page may take.
+size_t page_capacity() {
+    return (size_t)site.page_size + (size_t)(site.fanout + site.cross) * 64 + 512;
+}
+
+// Parse the page number out of a request path /pN.html. Returns -1 for any other path.
+long page_number(const char *path, size_t len) {
+    char *end;
+    if (len < 8 || strncmp(path, "/p", 2) != 0) {
+        return -1;
+    }
+    long page = strtol(path + 2, &end, 10);
+    if (end == path + 2 || (size_t)(end - path) + 5 != len || strncmp(end, ".html", 5) != 0) {
+        return -1;
+    }
+    return page >= 0 && page < site.pages ? page : -1;
+}
+
+// Write all of a buffer to a socket.
+bool send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        len -= (size_t)sent;
+    }
+    return true;
+}
+
+// Serve the requests of one keep-alive connection until the client closes it.
+void *connection_thread(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    char request[REQUEST_BUFFER];
+    size_t used = 0;
+    size_t capacity = page_capacity() + 256;
+    char *response = malloc(capacity);
+    if (response == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    while (true) {
+        // Read until the end of the request headers; requests have no body
+        char *end;
+        while ((end = memmem(request, used, "\r\n\r\n", 4)) == NULL) {
+            if (used == sizeof(request)) {
+                goto done; // Headers too long for a benchmark client
+            }
+            ssize_t got = recv(fd, request + used, sizeof(request) - used, 0);
+            if (got <= 0) {
+                goto done;
+            }
+            used += (size_t)got;
+        }
+        size_t request_len = (size_t)(end - request) + 4;
+
+        // Only the path of the request line matters
+        char *path = memchr(request, ' ', request_len);
+        char *path_end = path != NULL ? memchr(path + 1, ' ', request_len - (size_t)(path + 1 - request)) : NULL;
+        long page = path_end != NULL ? page_number(path + 1, (size_t)(path_end - path - 1)) : -1;
+        bool close_after = memmem(request, request_len, "Connection: close", 17) != NULL;
+
+        if (site.latency_ms > 0) {
+            struct timespec pause = { site.latency_ms / 1000, (site.latency_ms % 1000) * 1000000L };
+            nanosleep(&pause, NULL);
+        }
+
+        size_t header_len, body_len = 0;
+        long links = 0;
+        if (page >= 0) {
+            // Render the body after room for the header, then put the header right in front of it
+            char *body = response + 256;
+            body_len = page_render(page, body, &links);
+            char header[256];
+            header_len = (size_t)snprintf(header, sizeof(header),
+                                          "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: %zu\r\n%s\r\n",
+                                          body_len, close_after ? "Connection: close\r\n" : "");
+            memcpy(body - header_len, header, header_len);
+            if (!send_all(fd, body - header_len, header_len + body_len)) {
+                goto done;
+            }
+            atomic_fetch_add(&pages_served, 1);
+            atomic_fetch_add(&links_served, (unsigned long)links);
+        } else {
+            header_len = (size_t)snprintf(response, capacity,
+                                          "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n%s\r\n",
+                                          close_after ? "Connection: close\r\n" : "");
+            if (!send_all(fd, response, header_len)) {
+                goto done;
+            }
+            atomic_fetch_add(&not_found, 1);
+        }
+        atomic_fetch_add(&bytes_served, header_len + body_len);
+
+        if (close_after) {
+            break;
+        }
+        // Keep whatever the client pipelined after this request
+        memmove(request, request + request_len, used - request_len);
+        used -= request_len;
+    }
+
+done:
+    free(response);
+    close(fd);
+    return NULL;
+}
+
+// Accept connections and give each one a detached thread, until the listening socket is shut down.
+void *accept_thread(void *arg) {
+    int listener = (int)(intptr_t)arg;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, CONNECTION_STACK);
+    while (true) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            break;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, connection_thread, (void *)(intptr_t)fd) != 0) {
+            close(fd);
+        }
+    }
+    pthread_attr_destroy(&attr);
+    return NULL;
+}
+
+// Read one stage quantile of the fetch stage from a Prometheus dump written by the crawler.
+double fetch_quantile(const char *metrics_path, const char *quantile) {
+    FILE *in = fopen(metrics_path, "r");
+    if (in == NULL) {
+        return -1;
+    }
+    char prefix[128], line[512];
+    snprintf(prefix, sizeof(prefix), "crawler_stage_quantile_seconds{stage=\"fetch\",quantile=\"%s\"} ", quantile);
+    double value = -1;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if (strncmp(line, prefix, strlen(prefix)) == 0) {
+            value = atof(line + strlen(prefix));
+            break;
+        }
+    }
+    fclose(in);
+    return value;
+}
+
+void print_usage(const char *program) {
+    printf("Usage: %s [options] [-- crawler options...]\n", program);
+    printf("  --fanout F         Child pages per page (default: 10)\n");
+    printf("  --depth D          Levels of the site, and the crawl depth (default: 4)\n");
+    printf("  --cross N          Extra links per page to random pages of the site (default: 5)\n");
+    printf("  --page-size BYTES  Approximate page size (default: 16384)\n");
+    printf("  --latency MS       Delay before every response (default: 0)\n");
+    printf("  --crawler PATH     Crawler binary to run (default: ./crawler)\n");
+}
+
+int main(int argc, char *argv[]) {
+    site.fanout = 10;
+    site.depth = 4;
+    site.cross = 5;
+    site.page_size = 16384;
+    site.latency_ms = 0;
+    const char *crawler = "./crawler";
+
+    static struct option long_options[] = {
+        {"fanout", required_argument, NULL, 'f'},
+        {"depth", required_argument, NULL, 'd'},
+        {"cross", required_argument, NULL, 'x'},
+        {"page-size", required_argument, NULL, 's'},
+        {"latency", required_argument, NULL, 'l'},
+        {"crawler", required_argument, NULL, 'c'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "f:d:x:s:l:c:", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'f':
+                site.fanout = atol(optarg);
+                break;
+            case 'd':
+                site.depth = atoi(optarg);
+                break;
+            case 'x':
+                site.cross = atol(optarg);
+                break;
+            case 's':
+                site.page_size = atol(optarg);
+                break;
+            case 'l':
+                site.latency_ms = atol(optarg);
+                break;
+            case 'c':
+                crawler = optarg;
+                break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (site.fanout < 1 || site.depth < 1 || site.cross < 0 || site.page_size < 0 || site.latency_ms < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    site.pages = site_pages(site.fanout, site.depth);
+    if (site.pages < 0) {
+        printf("The site would have more than %ld pages.\n", MAX_PAGES);
+        return 1;
+    }
+
+    // Serve the site on an ephemeral loopback port
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = { .sin_family = AF_INET, .sin_port = 0 };
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t address_len = sizeof(address);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0 || getsockname(listener, (struct sockaddr *)&address, &address_len) != 0) {
+        perror("listen");
+        return 1;
+    }
+    pthread_t acceptor;
+    pthread_create(&acceptor, NULL, accept_thread, (void *)(intptr_t)listener);
+
+    char start_url[64], depth_arg[16], metrics_path[] = "/tmp/crawl_bench_metrics_XXXXXX";
+    snprintf(start_url, sizeof(start_url), "http://127.0.0.1:%d/p0.html", ntohs(address.sin_port));
+    snprintf(depth_arg, sizeof(depth_arg), "%d", site.depth);
+    int metrics_fd = mkstemp(metrics_path);
+    if (metrics_fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(metrics_fd);
+
+    // The crawler's command line: quiet logging and a metrics dump for the latency quantiles, then the
+    // caller's options, which may override them
+    int extra = argc - optind;
+    char **args = calloc((size_t)extra + 8, sizeof(char *));
+    int n = 0;
+    args[n++] = (char *)crawler;
+    args[n++] = "--log-level";
+    args[n++] = "error";
+    args[n++] = "--metrics";
+    args[n++] = metrics_path;
+    for (int i = optind; i < argc; i++) {
+        args[n++] = argv[i];
+    }
+    args[n++] = start_url;
+    args[n++] = depth_arg;
+    args[n] = NULL;
+
+    printf("Site: %ld pages (fan-out %ld, depth %d, %ld cross links/page), %ld bytes/page, %ld ms latency\n",
+           site.pages, site.fanout, site.depth, site.cross, site.page_size, site.latency_ms);
+    printf("Crawler:");
+    for (int i = 0; i < n; i++) {
+        printf(" %s", args[i]);
+    }
+    printf("\n");
+    fflush(stdout);
+
+    double begin = now_seconds();
+    pid_t child = fork();
+    if (child == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDOUT_FILENO); // The per-page log and the summary; errors still reach stderr
+            close(null_fd);
+        }
+        execv(crawler, args);
+        perror(crawler);
+        _exit(127);
+    }
+    if (child < 0) {
+        perror("fork");
+        return 1;
+    }
+    int status;
+    struct rusage usage;
+    if (wait4(child, &status, 0, &usage) < 0) {
+        perror("wait4");
+        return 1;
+    }
+    double elapsed = now_seconds() - begin;
+    shutdown(listener, SHUT_RDWR);
+    pthread_join(acceptor, NULL);
+    close(listener);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("The crawler failed (status %d).\n", WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        unlink(metrics_path);
+        return 1;
+    }
+
+    unsigned long pages = atomic_load(&pages_served), links = atomic_load(&links_served);
+    double cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec +
+                 usage.ru_stime.tv_usec / 1e6;
+    printf("Pages: %lu of %ld in %.3f s: %.0f pages/s, %.0f links/s (%lu links)%s\n", pages, site.pages, elapsed,
+           pages / elapsed, links / elapsed, links, atomic_load(&not_found) > 0 ? "; some requests got 404" : "");
+    printf("Transfer: %.1f MiB served\n", atomic_load(&bytes_served) / 1048576.0);
+    double p50 = fetch_quantile(metrics_path, "0.5"), p99 = fetch_quantile(metrics_path, "0.99");
+    if (p50 >= 0 && p99 >= 0) {
+        printf("Fetch latency: p50 %.3f ms, p99 %.3f ms\n", p50 * 1e3, p99 * 1e3);
+    } else {
+        printf("Fetch latency: not reported (crawler without --metrics?)\n");
+    }
+    printf("Crawler: peak RSS %.1f MiB, CPU %.3f s user + %.3f s system, %.1f us/page\n", usage.ru_maxrss / 1024.0,
+           usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6, usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6,
+           pages > 0 ? cpu * 1e6 / pages : 0.0);
+
+    unlink(metrics_path);
+    free(args);
+    return 0;
+}
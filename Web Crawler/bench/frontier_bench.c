@@ -0,0 +1,153 @@
+// Microbenchmark: the lock-free frontier against the original mutex-protected linked-list queue.
+//
+// Every thread runs the crawler's access pattern: push a discovered URL, then pop the next one to
+// fetch. Both queues are pre-filled so pops never find them empty, and nodes are allocated up front
+// so only the queue operations themselves are timed.
+
+// Define the required feature test macro to enable clock_gettime().
+#define _POSIX_C_SOURCE 200809L
+
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include the pthread library for the benchmark threads.
+#include <pthread.h>
+// Include the clock used for timing.
+#include <time.h>
+// Include the frontier under test.
+#include "frontier.h"
+
+// Define the total number of push/pop pairs per run, split evenly across the threads.
+#define TOTAL_OPS 4000000
+// Define how many nodes each queue holds before the timed run starts.
+#define PREFILL 4096
+
+// The original URLQueue and the part of ThreadPool that enqueue() used to signal.
+typedef struct {
+    URLQueueNode *head, *tail;
+    pthread_mutex_t lock;
+} LegacyQueue;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t task_available;
+} LegacyPool;
+
+LegacyQueue legacy_queue;
+LegacyPool legacy_pool;
+URLQueue frontier;
+
+// The original enqueue(), minus the node allocation.
+void legacy_enqueue(LegacyQueue *queue, URLQueueNode *newNode, LegacyPool *pool) {
+    newNode->next = NULL;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail) {
+        queue->tail->next = newNode;
+    } else {
+        queue->head = newNode;
+    }
+    queue->tail = newNode;
+    pthread_mutex_unlock(&queue->lock);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->task_available);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// The original dequeue().
+URLQueueNode *legacy_dequeue(LegacyQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    if (queue->head == NULL) {
+        pthread_mutex_unlock(&queue->lock);
+        return NULL;
+    }
+    URLQueueNode *temp = queue->head;
+    queue->head = queue->head->next;
+    if (queue->head == NULL) {
+        queue->tail = NULL;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return temp;
+}
+
+typedef struct {
+    bool use_frontier;
+    long ops;
+    pthread_barrier_t *start;
+} WorkerArgs;
+
+void *worker(void *arg) {
+    WorkerArgs *args = arg;
+    URLQueueNode *node = calloc(1, sizeof(URLQueueNode));
+    pthread_barrier_wait(args->start);
+    for (long i = 0; i < args->ops; i++) {
+        if (args->use_frontier) {
+            frontier_push(&frontier, node);
+            while ((node = frontier_pop(&frontier)) == NULL) {
+            }
+        } else {
+            legacy_enqueue(&legacy_queue, node, &legacy_pool);
+            while ((node = legacy_dequeue(&legacy_queue)) == NULL) {
+            }
+        }
+    }
+    free(node);
+    return NULL;
+}
+
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Run one configuration and return millions of push/pop pairs per second.
+double run(bool use_frontier, int threads) {
+    pthread_t tids[64];
+    WorkerArgs args;
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, threads + 1);
+    args.use_frontier = use_frontier;
+    args.ops = TOTAL_OPS / threads;
+    args.start = &start;
+
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&tids[i], NULL, worker, &args);
+    }
+    double begin = now_seconds();
+    pthread_barrier_wait(&start);
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double elapsed = now_seconds() - begin;
+    pthread_barrier_destroy(&start);
+    return (double)args.ops * threads / elapsed / 1e6;
+}
+
+int main() {
+    legacy_queue.head = legacy_queue.tail = NULL;
+    pthread_mutex_init(&legacy_queue.lock, NULL);
+    pthread_mutex_init(&legacy_pool.lock, NULL);
+    pthread_cond_init(&legacy_pool.task_available, NULL);
+    initQueue(&frontier);
+
+    for (int i = 0; i < PREFILL; i++) {
+        legacy_enqueue(&legacy_queue, calloc(1, sizeof(URLQueueNode)), &legacy_pool);
+        frontier_push(&frontier, calloc(1, sizeof(URLQueueNode)));
+    }
+
+    printf("%8s %18s %18s %9s\n", "threads", "mutex list Mops/s", "lock-free Mops/s", "speedup");
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        double legacy = run(false, threads);
+        double lockfree = run(true, threads);
+        printf("%8d %18.2f %18.2f %8.2fx\n", threads, legacy, lockfree, lockfree / legacy);
+    }
+
+    URLQueueNode *node;
+    while ((node = legacy_dequeue(&legacy_queue)) != NULL) {
+        free(node);
+    }
+    queue_destroy(&frontier);
+    return 0;
+}
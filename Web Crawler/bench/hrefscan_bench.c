@@ -0,0 +1,313 @@
+// Benchmark: the vectorized href scanner, with each byte search it can use, against the libxml2 DOM walk
+// the crawler uses otherwise.
+//
+// The corpus is a set of generated pages shaped like real ones (head with scripts and styles, nested
+// markup, comments, quoted and unquoted attributes, query strings with &amp;), or the .html files of a
+// directory given on the command line. Every method must find the same hrefs in the same order; pages the
+// scanner hands back to libxml2 are counted and left out of the comparison.
+
+// Define the required feature test macro to enable clock_gettime() and the directory functions.
+#define _POSIX_C_SOURCE 200809L
+
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+// Include variable arguments for building pages.
+#include <stdarg.h>
+// Include the clock used for timing.
+#include <time.h>
+// Include directory listing for a corpus on disk.
+#include <dirent.h>
+// Include libxml2 for the DOM baseline.
+#include <libxml2/libxml/HTMLparser.h>
+// Include the scanner under test.
+#include "hrefscan.h"
+
+// Define the number of generated pages and the links on each.
+#define PAGES 200
+#define LINKS_PER_PAGE 400
+// Define how many times each method goes over the corpus.
+#define ROUNDS 5
+
+typedef struct {
+    char *data;
+    size_t size;
+} Page;
+
+Page *pages;
+int page_count;
+
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Append formatted text to a growing page.
+void page_append(Page *page, size_t *capacity, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (page->size + (size_t)n + 1 > *capacity) {
+        while (page->size + (size_t)n + 1 > *capacity) {
+            *capacity *= 2;
+        }
+        page->data = realloc(page->data, *capacity);
+    }
+    va_start(args, format);
+    vsnprintf(page->data + page->size, (size_t)n + 1, format, args);
+    va_end(args);
+    page->size += (size_t)n;
+}
+
+void generate_corpus() {
+    page_count = PAGES;
+    pages = calloc(PAGES, sizeof(Page));
+    unsigned int rng = 42;
+    for (int p = 0; p < PAGES; p++) {
+        Page *page = &pages[p];
+        size_t capacity = 4096;
+        page->data = malloc(capacity);
+        page_append(page, &capacity, "<!DOCTYPE html>\n<html lang=\"en\"><head><meta charset=\"utf-8\">"
+                    "<title>Page %d</title>\n<link rel=\"stylesheet\" href=\"/static/site.css\">\n"
+                    "<style>a > b { color: red; } /* <a href=\"/not-a-link\"> */</style>\n"
+                    "<script>var s = '<a href=\"/also-not-a-link\">'; if (a < b) { go(); }</script>\n"
+                    "</head>\n<body class=\"page\">\n<!-- navigation <a href=\"/commented\"> -->\n", p);
+        for (int l = 0; l < LINKS_PER_PAGE; l++) {
+            rng = rng * 1103515245u + 12345u;
+            unsigned int r = rng >> 16;
+            page_append(page, &capacity, "<div class=\"item item-%u\" data-id=\"%d\"><p>Some text about item %d, "
+                        "with <b>bold</b> and <i>italic</i> words, 3 &lt; 4 &amp; so on.</p>\n", r % 7, l, l);
+            switch (r % 4) {
+                case 0:
+                    page_append(page, &capacity, "<a href=\"/section/%u/page-%d.html\" title=\"Item %d\">Item</a>\n",
+                                r % 31, l, l);
+                    break;
+                case 1:
+                    page_append(page, &capacity, "<a class='ext' href='https://host%u.example.com/path/%d'>Out</a>\n",
+                                r % 97, l);
+                    break;
+                case 2:
+                    page_append(page, &capacity, "<A HREF=/list?page=%d&amp;sort=name&amp;q=x%u>Next</A>\n", l, r);
+                    break;
+                default:
+                    page_append(page, &capacity, "<a id=\"a%d\" target=\"_blank\" rel=\"noopener\"\n"
+                                "   href=\"//cdn.example.com/asset/%u?v=%d&lang=en\">Asset</a>\n", l, r, l);
+                    break;
+            }
+            page_append(page, &capacity, "</div>\n");
+        }
+        page_append(page, &capacity, "</body></html>\n");
+    }
+}
+
+// Load every .html file of a directory as the corpus.
+int load_corpus(const char *dir) {
+    DIR *d = opendir(dir);
+    if (d == NULL) {
+        perror(dir);
+        return 0;
+    }
+    int capacity = 64;
+    pages = calloc(capacity, sizeof(Page));
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len < 5 || strcmp(entry->d_name + len - 5, ".html") != 0) {
+            continue;
+        }
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        FILE *file = fopen(path, "rb");
+        if (file == NULL) {
+            continue;
+        }
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (page_count == capacity) {
+            capacity *= 2;
+            pages = realloc(pages, capacity * sizeof(Page));
+        }
+        Page *page = &pages[page_count];
+        page->data = malloc((size_t)size + 1);
+        page->size = fread(page->data, 1, (size_t)size, file);
+        page->data[page->size] = '\0';
+        fclose(file);
+        page_count++;
+    }
+    closedir(d);
+    return page_count;
+}
+
+// The crawler's DOM path: hrefs of <a> elements, depth first. Adds each href to a hash of the page's links.
+void dom_walk(htmlNodePtr node, size_t *links, unsigned long *hash) {
+    for (htmlNodePtr cur = node; cur; cur = cur->next) {
+        if (cur->type == XML_ELEMENT_NODE && !xmlStrcmp(cur->name, (const xmlChar *)"a")) {
+            xmlChar *href = xmlGetProp(cur, (const xmlChar *)"href");
+            if (href != NULL) {
+                (*links)++;
+                for (const xmlChar *c = href; *c; c++) {
+                    *hash = *hash * 31 + *c;
+                }
+                *hash = *hash * 31 + 1;
+                xmlFree(href);
+            }
+        }
+        dom_walk(cur->children, links, hash);
+    }
+}
+
+// Extract a page's links with libxml2. Returns the number of links and the hash of their values.
+size_t dom_extract(const Page *page, unsigned long *hash) {
+    htmlDocPtr document = htmlReadMemory(page->data, (int)page->size, NULL, NULL,
+                                         HTML_PARSE_NOWARNING | HTML_PARSE_NOERROR);
+    size_t links = 0;
+    *hash = 0;
+    if (document != NULL) {
+        dom_walk(xmlDocGetRootElement(document), &links, hash);
+        xmlFreeDoc(document);
+    }
+    return links;
+}
+
+// Count and hash the <a> links found by the scanner's last scan.
+size_t scan_links_found(const HrefScanner *scanner, unsigned long *hash) {
+    size_t links = 0;
+    *hash = 0;
+    for (size_t i = 0; i < scanner->count; i++) {
+        if (scanner->links[i].base) {
+            continue;
+        }
+        links++;
+        for (const char *c = href_scan_value(scanner, i); *c; c++) {
+            *hash = *hash * 31 + (unsigned char)*c;
+        }
+        *hash = *hash * 31 + 1;
+    }
+    return links;
+}
+
+// Extract a page's <a> links with the scanner, or return (size_t)-1 if it falls back.
+size_t scan_extract(HrefScanner *scanner, const Page *page, unsigned long *hash) {
+    if (!href_scan(scanner, page->data, page->size)) {
+        return (size_t)-1;
+    }
+    return scan_links_found(scanner, hash);
+}
+
+// Like scan_extract(), but feed the page to the scanner in pieces of the given size.
+size_t scan_extract_pieces(HrefScanner *scanner, const Page *page, size_t piece, unsigned long *hash) {
+    href_scan_begin(scanner);
+    for (size_t offset = 0; offset < page->size || offset == 0; offset += piece) {
+        size_t len = page->size - offset < piece ? page->size - offset : piece;
+        if (!href_scan_feed(scanner, page->data + offset, len, offset + len == page->size)) {
+            return (size_t)-1;
+        }
+    }
+    return scan_links_found(scanner, hash);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 ? load_corpus(argv[1]) == 0 : (generate_corpus(), 0)) {
+        fprintf(stderr, "No .html files in %s\n", argv[1]);
+        return 1;
+    }
+    size_t total_bytes = 0;
+    for (int p = 0; p < page_count; p++) {
+        total_bytes += pages[p].size;
+    }
+
+    // Reference results from libxml2, and which pages the scanner accepts
+    size_t *expected_links = malloc(page_count * sizeof(size_t));
+    unsigned long *expected_hash = malloc(page_count * sizeof(unsigned long));
+    char *scannable = malloc(page_count);
+    HrefScanner scanner;
+    href_scanner_init(&scanner);
+    href_scan_init(HREF_SCAN_SCALAR);
+    size_t scan_bytes = 0, scan_links = 0, all_links = 0;
+    int fallbacks = 0;
+    for (int p = 0; p < page_count; p++) {
+        unsigned long hash;
+        expected_links[p] = dom_extract(&pages[p], &expected_hash[p]);
+        all_links += expected_links[p];
+        scannable[p] = scan_extract(&scanner, &pages[p], &hash) != (size_t)-1;
+        if (scannable[p]) {
+            scan_bytes += pages[p].size;
+            scan_links += expected_links[p];
+        } else {
+            fallbacks++;
+        }
+    }
+    printf("Corpus: %d pages, %.1f MiB, %zu links; %d pages fall back to libxml2.\n\n", page_count,
+           total_bytes / 1048576.0, all_links, fallbacks);
+
+    printf("%10s %14s %12s %10s\n", "method", "Mlinks/s", "MiB/s", "speedup");
+    double start = now_seconds();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int p = 0; p < page_count; p++) {
+            unsigned long hash;
+            if (scannable[p]) {
+                dom_extract(&pages[p], &hash);
+            }
+        }
+    }
+    double dom_time = (now_seconds() - start) / ROUNDS;
+    printf("%10s %14.2f %12.1f %10s\n", "libxml2", scan_links / dom_time / 1e6, scan_bytes / dom_time / 1048576.0, "1.0x");
+
+    HrefScanImpl impls[] = { HREF_SCAN_SCALAR, HREF_SCAN_SSE2, HREF_SCAN_AVX2 };
+    for (size_t m = 0; m < sizeof(impls) / sizeof(impls[0]); m++) {
+        if (href_scan_init(impls[m]) != impls[m]) {
+            printf("%10s %14s\n", href_scan_impl_name(impls[m]), "unsupported");
+            continue;
+        }
+        // Check the results before timing
+        for (int p = 0; p < page_count; p++) {
+            unsigned long hash;
+            if (scannable[p] && (scan_extract(&scanner, &pages[p], &hash) != expected_links[p] ||
+                                 hash != expected_hash[p])) {
+                fprintf(stderr, "%s: page %d differs from libxml2\n", href_scan_impl_name(impls[m]), p);
+                return 1;
+            }
+        }
+        // Pages fed in pieces, as with --zero-copy, must give the same links and fall back alike
+        size_t pieces[] = { 1, 7, 61, 4096 };
+        for (int p = 0; p < page_count; p++) {
+            for (size_t i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++) {
+                unsigned long hash = 0;
+                size_t links = scan_extract_pieces(&scanner, &pages[p], pieces[i], &hash);
+                if (scannable[p] ? links != expected_links[p] || hash != expected_hash[p] : links != (size_t)-1) {
+                    fprintf(stderr, "%s: page %d in %zu-byte pieces differs from the whole page\n",
+                            href_scan_impl_name(impls[m]), p, pieces[i]);
+                    return 1;
+                }
+            }
+        }
+        start = now_seconds();
+        for (int round = 0; round < ROUNDS; round++) {
+            for (int p = 0; p < page_count; p++) {
+                unsigned long hash;
+                if (scannable[p]) {
+                    scan_extract(&scanner, &pages[p], &hash);
+                }
+            }
+        }
+        double time = (now_seconds() - start) / ROUNDS;
+        printf("%10s %14.2f %12.1f %9.1fx\n", href_scan_impl_name(impls[m]), scan_links / time / 1e6,
+               scan_bytes / time / 1048576.0, dom_time / time);
+    }
+
+    href_scanner_destroy(&scanner);
+    for (int p = 0; p < page_count; p++) {
+        free(pages[p].data);
+    }
+    free(pages);
+    free(expected_links);
+    free(expected_hash);
+    free(scannable);
+    return 0;
+}
@@ -0,0 +1,179 @@
+// Benchmark: the sharded visited set, in exact and fingerprint mode, against the original GMutex-guarded
+// GHashTable.
+//
+// Every thread checks and inserts its share of a fixed list of URLs in which each URL appears twice,
+// so half of the operations find the URL already present, as in a crawl where most links repeat.
+
+// Define the required feature test macro to enable clock_gettime().
+#define _POSIX_C_SOURCE 200809L
+
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions, such as strdup().
+#include <string.h>
+// Include the pthread library for the benchmark threads.
+#include <pthread.h>
+// Include the clock used for timing.
+#include <time.h>
+// Include GLib for the original hash table path.
+#include <glib.h>
+// Include the visited set under test.
+#include "visited.h"
+
+// Define the number of distinct URLs; each is inserted twice.
+#define UNIQUE_URLS (1 << 20)
+#define TOTAL_OPS (2 * UNIQUE_URLS)
+
+char **unique;
+char **urls;
+
+// The original hashmap_* functions.
+GHashTable *hashmap;
+GMutex mutex;
+
+void hashmap_insert(const char* key) {
+    g_mutex_lock(&mutex);
+    g_hash_table_insert(hashmap, g_strdup(key), NULL);
+    g_mutex_unlock(&mutex);
+}
+
+bool hashmap_contains(const char* key) {
+    g_mutex_lock(&mutex);
+    bool found = g_hash_table_contains(hashmap, key);
+    g_mutex_unlock(&mutex);
+    return found;
+}
+
+// Define the pseudo-mode that selects the original GHashTable path.
+#define LEGACY -1
+
+VisitedSet visited;
+VisitedStats last_stats;
+
+typedef struct {
+    int mode;
+    long begin, end;
+    long inserted;
+    pthread_barrier_t *start;
+} WorkerArgs;
+
+void *worker(void *arg) {
+    WorkerArgs *args = arg;
+    pthread_barrier_wait(args->start);
+    for (long i = args->begin; i < args->end; i++) {
+        if (args->mode != LEGACY) {
+            if (visited_insert(&visited, urls[i])) {
+                args->inserted++;
+            }
+        } else if (!hashmap_contains(urls[i])) {
+            // The original check-then-insert: two lock acquisitions, and racing threads can both insert
+            hashmap_insert(urls[i]);
+            args->inserted++;
+        }
+    }
+    return NULL;
+}
+
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Run one configuration on a fresh set and return millions of operations per second.
+double run(int mode, int threads, long *inserted) {
+    pthread_t tids[64];
+    WorkerArgs args[64];
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, threads + 1);
+
+    if (mode != LEGACY) {
+        visited_init(&visited, (VisitedMode)mode, 0.001, UNIQUE_URLS);
+    } else {
+        hashmap = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+        g_mutex_init(&mutex);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        args[i].mode = mode;
+        args[i].begin = (long)TOTAL_OPS * i / threads;
+        args[i].end = (long)TOTAL_OPS * (i + 1) / threads;
+        args[i].inserted = 0;
+        args[i].start = &start;
+        pthread_create(&tids[i], NULL, worker, &args[i]);
+    }
+    double begin = now_seconds();
+    pthread_barrier_wait(&start);
+    *inserted = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        *inserted += args[i].inserted;
+    }
+    double elapsed = now_seconds() - begin;
+
+    if (mode != LEGACY) {
+        visited_stats(&visited, &last_stats);
+        visited_destroy(&visited);
+    } else {
+        g_hash_table_destroy(hashmap);
+        g_mutex_clear(&mutex);
+    }
+    pthread_barrier_destroy(&start);
+    return TOTAL_OPS / elapsed / 1e6;
+}
+
+int main() {
+    // Build the URL list: every URL twice, in a shuffled order
+    unique = malloc(UNIQUE_URLS * sizeof(char *));
+    urls = malloc(TOTAL_OPS * sizeof(char *));
+    for (long i = 0; i < UNIQUE_URLS; i++) {
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), "https://host%ld.example.com/section/%ld/page-%ld.html", i % 997, i % 31, i);
+        unique[i] = strdup(buffer);
+        urls[2 * i] = urls[2 * i + 1] = unique[i];
+    }
+    srand(42);
+    for (long i = TOTAL_OPS - 1; i > 0; i--) {
+        long j = ((long)rand() * RAND_MAX + rand()) % (i + 1);
+        char *tmp = urls[i];
+        urls[i] = urls[j];
+        urls[j] = tmp;
+    }
+
+    printf("%8s %18s %18s %22s %16s\n", "threads", "GHashTable Mops/s", "exact Mops/s", "fingerprint Mops/s",
+           "GHashTable dups");
+    VisitedStats exact_stats, fingerprint_stats;
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        long legacy_inserted, exact_inserted, fingerprint_inserted;
+        double legacy = run(LEGACY, threads, &legacy_inserted);
+        double exact = run(VISITED_EXACT, threads, &exact_inserted);
+        exact_stats = last_stats;
+        double fingerprint = run(VISITED_FINGERPRINT, threads, &fingerprint_inserted);
+        fingerprint_stats = last_stats;
+        if (exact_inserted != UNIQUE_URLS) {
+            fprintf(stderr, "exact set inserted %ld URLs, expected %d\n", exact_inserted, UNIQUE_URLS);
+            return 1;
+        }
+        // Check-then-insert lets racing threads both claim a URL; the count shows how often that happened
+        printf("%8d %18.2f %18.2f %22.2f %16ld\n", threads, legacy, exact, fingerprint,
+               legacy_inserted - UNIQUE_URLS);
+    }
+
+    printf("\nexact:       %.1f MiB, %.1f bytes/URL, %.2f probes/lookup\n", exact_stats.bytes / 1048576.0,
+           (double)exact_stats.bytes / exact_stats.urls, (double)exact_stats.probes / exact_stats.lookups);
+    // URLs the fingerprint set wrongly reported as already visited
+    printf("fingerprint: %.1f MiB, %.1f bytes/URL, %.2f buckets/lookup, %lu evictions, %d filters, "
+           "%zu false positives (estimated rate %.2g)\n", fingerprint_stats.bytes / 1048576.0,
+           (double)fingerprint_stats.bytes / fingerprint_stats.urls,
+           (double)fingerprint_stats.probes / fingerprint_stats.lookups, fingerprint_stats.kicks,
+           fingerprint_stats.filters, UNIQUE_URLS - fingerprint_stats.urls, fingerprint_stats.false_positive_rate);
+
+    for (long i = 0; i < UNIQUE_URLS; i++) {
+        free(unique[i]);
+    }
+    free(unique);
+    free(urls);
+    return 0;
+}
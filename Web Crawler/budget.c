@@ -0,0 +1,138 @@
+// Include the frontier budget interface.
+#include "budget.h"
+// Include standard library functionality, such as strtoull().
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+
+void budget_init(FrontierBudget *budget, BudgetPolicy policy, size_t max_urls, size_t max_bytes, bool spill) {
+    budget->policy = policy;
+    budget->max_urls = max_urls;
+    budget->max_bytes = max_bytes;
+    budget->spill = spill;
+    atomic_init(&budget->urls, 0);
+    atomic_init(&budget->bytes, 0);
+    atomic_init(&budget->admitted, 0);
+    atomic_init(&budget->blocks, 0);
+    atomic_init(&budget->blocked_ns, 0);
+    atomic_init(&budget->overshoots, 0);
+    atomic_init(&budget->dropped, 0);
+    atomic_init(&budget->spilled, 0);
+    atomic_init(&budget->peak_urls, 0);
+    atomic_init(&budget->peak_bytes, 0);
+}
+
+// Whether one more node of the given size would take the frontier over either limit. Producers check
+// and charge separately, so together they may go over by up to one node each.
+static bool budget_over(FrontierBudget *budget, size_t bytes, size_t max_urls, size_t max_bytes) {
+    return (max_urls != 0 && (size_t)atomic_load_explicit(&budget->urls, memory_order_relaxed) + 1 > max_urls) ||
+           (max_bytes != 0 && (size_t)atomic_load_explicit(&budget->bytes, memory_order_relaxed) + bytes > max_bytes);
+}
+
+static void raise_peak(atomic_long *peak, long value) {
+    long seen = atomic_load_explicit(peak, memory_order_relaxed);
+    while (value > seen && !atomic_compare_exchange_weak_explicit(peak, &seen, value, memory_order_relaxed,
+                                                                   memory_order_relaxed)) {
+    }
+}
+
+static void budget_charge(FrontierBudget *budget, size_t bytes) {
+    long urls = atomic_fetch_add_explicit(&budget->urls, 1, memory_order_relaxed) + 1;
+    long total = atomic_fetch_add_explicit(&budget->bytes, (long)bytes, memory_order_relaxed) + (long)bytes;
+    raise_peak(&budget->peak_urls, urls);
+    raise_peak(&budget->peak_bytes, total);
+    atomic_fetch_add_explicit(&budget->admitted, 1, memory_order_relaxed);
+}
+
+double budget_fill(FrontierBudget *budget) {
+    double fill = 0;
+    if (budget->max_urls != 0) {
+        fill = (double)atomic_load_explicit(&budget->urls, memory_order_relaxed) / (double)budget->max_urls;
+    }
+    if (budget->max_bytes != 0) {
+        double bytes = (double)atomic_load_explicit(&budget->bytes, memory_order_relaxed) / (double)budget->max_bytes;
+        if (bytes > fill) {
+            fill = bytes;
+        }
+    }
+    return fill;
+}
+
+bool budget_full(FrontierBudget *budget) {
+    return budget_over(budget, 0, budget->max_urls, budget->max_bytes);
+}
+
+BudgetDecision budget_admit(FrontierBudget *budget, size_t bytes, double rank) {
+    switch (budget->policy) {
+        case BUDGET_DROP: {
+            // Past BUDGET_DROP_START, drop the links ranked below a bar that rises with the fill, so the
+            // most promising links are the last to go
+            double fill = budget_fill(budget);
+            double bar = (fill - BUDGET_DROP_START) / (1.0 - BUDGET_DROP_START);
+            if (budget_over(budget, bytes, budget->max_urls, budget->max_bytes) || (bar > 0 && rank < bar)) {
+                atomic_fetch_add_explicit(&budget->dropped, 1, memory_order_relaxed);
+                return BUDGET_DROPPED;
+            }
+            break;
+        }
+        case BUDGET_SPILL:
+            if (budget_over(budget, bytes, budget->max_urls, budget->max_bytes)) {
+                atomic_fetch_add_explicit(&budget->spilled, 1, memory_order_relaxed);
+                return BUDGET_SPILLED;
+            }
+            break;
+        case BUDGET_BLOCK:
+            // The workers have stopped starting transfers; what the ones in flight find is kept, on disk
+            // once it would take the frontier past the overshoot allowance
+            if (budget_over(budget, bytes, budget->max_urls, budget->max_bytes)) {
+                if (budget->spill &&
+                    budget_over(budget, bytes, budget->max_urls + budget->max_urls * BUDGET_OVERSHOOT_PERCENT / 100,
+                                budget->max_bytes + budget->max_bytes * BUDGET_OVERSHOOT_PERCENT / 100)) {
+                    atomic_fetch_add_explicit(&budget->spilled, 1, memory_order_relaxed);
+                    return BUDGET_SPILLED;
+                }
+                atomic_fetch_add_explicit(&budget->overshoots, 1, memory_order_relaxed);
+            }
+            break;
+    }
+    budget_charge(budget, bytes);
+    return BUDGET_ADMITTED;
+}
+
+void budget_release(FrontierBudget *budget, size_t bytes) {
+    atomic_fetch_sub_explicit(&budget->urls, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&budget->bytes, (long)bytes, memory_order_relaxed);
+}
+
+void budget_blocked(FrontierBudget *budget, uint64_t ns) {
+    atomic_fetch_add_explicit(&budget->blocks, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&budget->blocked_ns, ns, memory_order_relaxed);
+}
+
+bool budget_policy_parse(const char *name, BudgetPolicy *policy) {
+    if (strcmp(name, "block") == 0) {
+        *policy = BUDGET_BLOCK;
+    } else if (strcmp(name, "drop") == 0) {
+        *policy = BUDGET_DROP;
+    } else if (strcmp(name, "spill") == 0) {
+        *policy = BUDGET_SPILL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+size_t budget_parse_size(const char *text) {
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text) {
+        return 0;
+    }
+    switch (*end) {
+        case 'K': case 'k': value <<= 10; end++; break;
+        case 'M': case 'm': value <<= 20; end++; break;
+        case 'G': case 'g': value <<= 30; end++; break;
+        default: break;
+    }
+    return *end == '\0' ? (size_t)value : 0;
+}
@@ -0,0 +1,90 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+// Include size types.
+#include <stddef.h>
+// Include fixed-width integer types.
+#include <stdint.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+// Include atomic types for the usage and the counters.
+#include <stdatomic.h>
+
+// Define how far (as a percentage of the budget) the block policy lets the transfers already in flight
+// take the frontier over it before their links are sent to disk, when there is a spill directory.
+#define BUDGET_OVERSHOOT_PERCENT 10
+// Define the fill (as a fraction of the budget) from which the drop policy starts dropping links; the
+// share of links dropped grows from none there to all of them at the budget.
+#define BUDGET_DROP_START 0.5
+
+// What happens while the frontier is over its budget.
+typedef enum {
+    BUDGET_BLOCK,                    // Hold back new fetches, which are what find new links
+    BUDGET_DROP,                     // Drop the link, starting with the least promising ones
+    BUDGET_SPILL                     // Queue the link on disk instead of in memory
+} BudgetPolicy;
+
+// The outcome of budget_admit().
+typedef enum {
+    BUDGET_ADMITTED,                 // Queue the link in memory; it has been charged
+    BUDGET_DROPPED,                  // Do not queue the link
+    BUDGET_SPILLED                   // Queue the link on disk; it has not been charged
+} BudgetDecision;
+
+/**
+ * @brief Memory and length budgets of the in-memory frontier, and the backpressure that keeps to them.
+ *
+ * Every queue node admitted in memory is charged its size (node and URL; base URLs are shared and not
+ * counted) until it is freed, so the budget covers the nodes in the deques, the frontier, the host
+ * queues and those being fetched. When a new link would take the frontier over max_urls nodes or
+ * max_bytes bytes, the policy decides what happens to it. Dropping and spilling act on the link.
+ * Blocking never loses one: it holds back the fetches that find links instead, each worker starting
+ * no new transfer while the budget is full (budget_full()) and it has one in flight, and the links the
+ * transfers in flight still find are admitted over the budget and counted as overshoots. With a spill
+ * directory those past BUDGET_OVERSHOOT_PERCENT over the budget go to disk, which makes that a hard
+ * cap; without one a frontier that keeps growing as pages are fetched can only be slowed down.
+ */
+typedef struct {
+    BudgetPolicy policy;
+    size_t max_urls;                 // Most nodes in memory, or 0 for no limit
+    size_t max_bytes;                // Most bytes of nodes in memory, or 0 for no limit
+    bool spill;                      // Whether blocking may send links past the overshoot to disk
+    _Alignas(64) atomic_long urls;   // Nodes charged and not yet freed
+    atomic_long bytes;               // Their bytes
+    _Alignas(64) atomic_ulong admitted; // Links charged
+    atomic_ulong blocks;             // Times a worker held back new transfers
+    atomic_ulong blocked_ns;         // Total time workers held them back
+    atomic_ulong overshoots;         // Links admitted over the budget by the block policy
+    atomic_ulong dropped;            // Links dropped
+    atomic_ulong spilled;            // Links sent to disk
+    atomic_long peak_urls;           // Most nodes charged at once
+    atomic_long peak_bytes;          // Most bytes charged at once
+} FrontierBudget;
+
+// Initialize a budget. spill is only used under BUDGET_BLOCK.
+void budget_init(FrontierBudget *budget, BudgetPolicy policy, size_t max_urls, size_t max_bytes, bool spill);
+/**
+ * @brief Decide what happens to a new link of the given size, charging it if it is admitted.
+ *
+ * Never blocks: under BUDGET_BLOCK the fetches are held back instead (see budget_full()).
+ *
+ * @param budget The budget.
+ * @param bytes The size of the link's queue node.
+ * @param rank How promising the link is, from 0 (least) to 1; only used by BUDGET_DROP.
+ * @return What to do with the link.
+ */
+BudgetDecision budget_admit(FrontierBudget *budget, size_t bytes, double rank);
+// Give back the charge of a freed node.
+void budget_release(FrontierBudget *budget, size_t bytes);
+// Whether the frontier is at or over either budget. Under BUDGET_BLOCK workers then hold back new transfers.
+bool budget_full(FrontierBudget *budget);
+// Count one stretch of ns nanoseconds in which a worker held back new transfers.
+void budget_blocked(FrontierBudget *budget, uint64_t ns);
+// The larger of the node and byte fill, as a fraction of the budget.
+double budget_fill(FrontierBudget *budget);
+// Parse a policy name (block, drop or spill). Returns false if it is not one.
+bool budget_policy_parse(const char *name, BudgetPolicy *policy);
+// Parse a size such as 512M or 2G (suffixes K, M and G are powers of 1024). Returns 0 if it is malformed.
+size_t budget_parse_size(const char *text);
+
+#endif
@@ -0,0 +1,159 @@
+// Include the buffer pool interface.
+#include "bufpool.h"
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+
+void bufpool_init(BufferPool *pool) {
+    memset(pool, 0, sizeof(BufferPool));
+}
+
+static void free_chain(BufferChunk *chunk) {
+    while (chunk != NULL) {
+        BufferChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+void bufpool_destroy(BufferPool *pool) {
+    free_chain(pool->free);
+    free_chain(pool->free_large);
+    free(pool->slab);
+    pool->free = pool->free_large = NULL;
+    pool->free_count = pool->free_large_count = 0;
+    pool->slab = NULL;
+    pool->slab_size = 0;
+}
+
+// Take a chunk with at least size usable bytes from the pool, or allocate one.
+static BufferChunk *chunk_get(BufferPool *pool, size_t size) {
+    if (size <= BUFFER_CHUNK_SIZE) {
+        size = BUFFER_CHUNK_SIZE;
+        if (pool->free != NULL) {
+            BufferChunk *chunk = pool->free;
+            pool->free = chunk->next;
+            pool->free_count--;
+            pool->reuses++;
+            chunk->next = NULL;
+            chunk->used = 0;
+            return chunk;
+        }
+    } else {
+        // First fit among the idle oversized chunks
+        for (BufferChunk **link = &pool->free_large; *link != NULL; link = &(*link)->next) {
+            BufferChunk *chunk = *link;
+            if (chunk->size >= size) {
+                *link = chunk->next;
+                pool->free_large_count--;
+                pool->reuses++;
+                chunk->next = NULL;
+                chunk->used = 0;
+                return chunk;
+            }
+        }
+    }
+    BufferChunk *chunk = malloc(sizeof(BufferChunk) + size + 1);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    pool->allocations++;
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+// Give a chunk back to the pool, or free it if the pool already holds enough idle chunks.
+static void chunk_put(BufferPool *pool, BufferChunk *chunk) {
+    if (chunk->size == BUFFER_CHUNK_SIZE && pool->free_count < BUFFER_POOL_CHUNKS) {
+        chunk->next = pool->free;
+        pool->free = chunk;
+        pool->free_count++;
+    } else if (chunk->size != BUFFER_CHUNK_SIZE && pool->free_large_count < BUFFER_POOL_LARGE) {
+        chunk->next = pool->free_large;
+        pool->free_large = chunk;
+        pool->free_large_count++;
+    } else {
+        free(chunk);
+    }
+}
+
+void response_init(ResponseBuffer *response, BufferPool *pool, size_t expected_size) {
+    response->head = response->tail = NULL;
+    response->size = 0;
+    if (expected_size > 0 && expected_size <= BUFFER_PRESIZE_MAX) {
+        response->head = response->tail = chunk_get(pool, expected_size);
+    }
+}
+
+bool response_append(ResponseBuffer *response, BufferPool *pool, const char *data, size_t len) {
+    while (len > 0) {
+        BufferChunk *tail = response->tail;
+        if (tail == NULL || tail->used == tail->size) {
+            BufferChunk *chunk = chunk_get(pool, BUFFER_CHUNK_SIZE);
+            if (chunk == NULL) {
+                return false;
+            }
+            if (tail == NULL) {
+                response->head = chunk;
+            } else {
+                tail->next = chunk;
+            }
+            response->tail = tail = chunk;
+        }
+        size_t n = tail->size - tail->used < len ? tail->size - tail->used : len;
+        memcpy(tail->data + tail->used, data, n);
+        tail->used += n;
+        response->size += n;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+const char *response_contiguous(ResponseBuffer *response, BufferPool *pool) {
+    if (response->head == NULL) {
+        return "";
+    }
+    if (response->head->next == NULL) {
+        // Already in one piece; the chunk has room for the terminator
+        response->head->data[response->head->used] = '\0';
+        return response->head->data;
+    }
+    if (pool->slab_size < response->size + 1) {
+        size_t size = pool->slab_size ? pool->slab_size : BUFFER_CHUNK_SIZE;
+        while (size < response->size + 1) {
+            size *= 2;
+        }
+        // The old contents do not need to survive, so free instead of realloc to avoid copying them
+        free(pool->slab);
+        pool->slab = malloc(size);
+        pool->slab_size = pool->slab != NULL ? size : 0;
+        if (pool->slab == NULL) {
+            return NULL;
+        }
+        pool->allocations++;
+    }
+    size_t offset = 0;
+    for (BufferChunk *chunk = response->head; chunk != NULL; chunk = chunk->next) {
+        memcpy(pool->slab + offset, chunk->data, chunk->used);
+        offset += chunk->used;
+    }
+    pool->slab[offset] = '\0';
+    pool->bytes_copied += offset;
+    return pool->slab;
+}
+
+void response_release(ResponseBuffer *response, BufferPool *pool) {
+    BufferChunk *chunk = response->head;
+    while (chunk != NULL) {
+        BufferChunk *next = chunk->next;
+        chunk_put(pool, chunk);
+        chunk = next;
+    }
+    response->head = response->tail = NULL;
+    response->size = 0;
+    pool->pages++;
+}
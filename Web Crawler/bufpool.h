@@ -0,0 +1,69 @@
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+
+// Include size types.
+#include <stddef.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+
+// Define the size of a standard chunk. Bodies without a Content-Length grow one chunk at a time.
+#define BUFFER_CHUNK_SIZE (64 * 1024)
+// Define the number of idle standard chunks a pool keeps; the rest are freed.
+#define BUFFER_POOL_CHUNKS 256
+// Define the number of idle oversized chunks (presized from Content-Length) a pool keeps.
+#define BUFFER_POOL_LARGE 16
+// Define the largest Content-Length a body is presized for.
+#define BUFFER_PRESIZE_MAX (16 * 1024 * 1024)
+
+// A chunk of response body. One byte past size is always reserved for a terminating '\0'.
+typedef struct BufferChunk {
+    struct BufferChunk *next;
+    size_t size;                     // Usable bytes
+    size_t used;
+    char data[];
+} BufferChunk;
+
+// A response body: a chain of chunks filled in order.
+typedef struct {
+    BufferChunk *head;
+    BufferChunk *tail;
+    size_t size;                     // Total bytes received
+} ResponseBuffer;
+
+/**
+ * @brief Per-worker pool of response chunks.
+ *
+ * A body is stored as a chain of chunks taken from the pool, so receiving more data never moves what
+ * has already been received, and the chunks go back to the pool when the page has been parsed instead
+ * of to the allocator. A body whose Content-Length is known is given a single chunk of that size up
+ * front and therefore ends up contiguous. A body that spans several chunks is copied once into the
+ * pool's reusable slab when the parser needs it in one piece. Not thread-safe; each worker owns one.
+ */
+typedef struct {
+    BufferChunk *free;               // Idle standard chunks
+    BufferChunk *free_large;         // Idle oversized chunks
+    int free_count;
+    int free_large_count;
+    char *slab;                      // Reusable buffer for bodies that span several chunks
+    size_t slab_size;
+    unsigned long allocations;       // malloc/realloc calls for chunks and the slab
+    unsigned long reuses;            // Chunks taken from the pool instead of allocated
+    unsigned long bytes_copied;      // Bytes copied to make bodies contiguous
+    unsigned long pages;             // Bodies released back to the pool
+} BufferPool;
+
+// Initialize an empty pool.
+void bufpool_init(BufferPool *pool);
+// Free every idle chunk and the slab.
+void bufpool_destroy(BufferPool *pool);
+// Prepare an empty body. If expected_size is known (> 0), the first chunk is sized to hold all of it.
+void response_init(ResponseBuffer *response, BufferPool *pool, size_t expected_size);
+// Append received bytes to a body. Returns false if memory runs out.
+bool response_append(ResponseBuffer *response, BufferPool *pool, const char *data, size_t len);
+// The body as one '\0'-terminated string. Points into the body's only chunk, or into the pool's slab
+// (valid until the next call) if the body spans several chunks. NULL if memory runs out.
+const char *response_contiguous(ResponseBuffer *response, BufferPool *pool);
+// Return a body's chunks to the pool and reset it.
+void response_release(ResponseBuffer *response, BufferPool *pool);
+
+#endif
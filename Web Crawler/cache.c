@@ -0,0 +1,255 @@
+// Define the required feature test macro to enable fileno(), fsync() and mkdir().
+#define _POSIX_C_SOURCE 200809L
+
+// Include the response cache interface.
+#include "cache.h"
+// Include the URL hash shared with the visited set.
+#include "visited.h"
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+// Include errno to tell an existing directory from a failed mkdir().
+#include <errno.h>
+// Include time() for the entry timestamp.
+#include <time.h>
+// Include mkdir().
+#include <sys/stat.h>
+// Include getpid() for temporary file names.
+#include <unistd.h>
+// Include the zlib compression library.
+#include <zlib.h>
+
+// Define the longest entry path: the directory, "/xx/", 16 hex digits and a temporary suffix.
+#define CACHE_PATH_MAX 4096
+
+bool cache_init(ResponseCache *cache, const char *dir) {
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        perror("Failed to create cache directory");
+        return false;
+    }
+    cache->dir = strdup(dir);
+    if (cache->dir == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the response cache\n");
+        return false;
+    }
+    atomic_init(&cache->lookups, 0);
+    atomic_init(&cache->hits, 0);
+    atomic_init(&cache->loads, 0);
+    atomic_init(&cache->stores, 0);
+    atomic_init(&cache->bytes_stored, 0);
+    return true;
+}
+
+void cache_destroy(ResponseCache *cache) {
+    free(cache->dir);
+    cache->dir = NULL;
+}
+
+// Build the path of the entry for url: DIR/xx/xxxxxxxxxxxxxxxx, where the first two hex digits of the
+// hash name the subdirectory.
+static void entry_path(ResponseCache *cache, const char *url, char *path) {
+    uint64_t hash = url_hash(url, strlen(url));
+    snprintf(path, CACHE_PATH_MAX, "%s/%02x/%016llx", cache->dir, (unsigned int)(hash >> 56),
+             (unsigned long long)hash);
+}
+
+// Read a string of len bytes into a new terminated buffer. Returns NULL on a short read or no memory.
+static char *read_string(FILE *in, size_t len) {
+    char *s = malloc(len + 1);
+    if (s == NULL || fread(s, 1, len, in) != len) {
+        free(s);
+        return NULL;
+    }
+    s[len] = '\0';
+    return s;
+}
+
+// Open the entry for url and read its header, checking that it is an entry for this very URL. On
+// success the file is positioned at the ETag.
+static FILE *entry_open(ResponseCache *cache, const char *url, CacheEntryHeader *header) {
+    char path[CACHE_PATH_MAX];
+    entry_path(cache, url, path);
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        return NULL;
+    }
+    size_t url_len = strlen(url);
+    char *stored_url = NULL;
+    if (fread(header, sizeof(*header), 1, in) != 1 || memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CACHE_VERSION || header->url_len != url_len ||
+        (stored_url = read_string(in, url_len)) == NULL || memcmp(stored_url, url, url_len) != 0) {
+        free(stored_url);
+        fclose(in);
+        return NULL;
+    }
+    free(stored_url);
+    return in;
+}
+
+bool cache_lookup(ResponseCache *cache, const char *url, CacheValidators *validators) {
+    atomic_fetch_add_explicit(&cache->lookups, 1, memory_order_relaxed);
+    validators->etag = validators->last_modified = NULL;
+    CacheEntryHeader header;
+    FILE *in = entry_open(cache, url, &header);
+    if (in == NULL) {
+        return false;
+    }
+    bool ok = true;
+    if (header.etag_len > 0) {
+        ok = (validators->etag = read_string(in, header.etag_len)) != NULL;
+    }
+    if (ok && header.modified_len > 0) {
+        ok = (validators->last_modified = read_string(in, header.modified_len)) != NULL;
+    }
+    fclose(in);
+    if (!ok || (validators->etag == NULL && validators->last_modified == NULL)) {
+        cache_validators_free(validators);
+        return false;
+    }
+    atomic_fetch_add_explicit(&cache->hits, 1, memory_order_relaxed);
+    return true;
+}
+
+void cache_validators_free(CacheValidators *validators) {
+    free(validators->etag);
+    free(validators->last_modified);
+    validators->etag = validators->last_modified = NULL;
+}
+
+bool cache_load(ResponseCache *cache, const char *url, ResponseBuffer *response, BufferPool *pool) {
+    CacheEntryHeader header;
+    FILE *in = entry_open(cache, url, &header);
+    if (in == NULL) {
+        return false;
+    }
+    unsigned char *input = malloc(CACHE_IO_BUFFER);
+    unsigned char *output = malloc(CACHE_IO_BUFFER);
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    bool ok = input != NULL && output != NULL &&
+              fseek(in, (long)(header.etag_len + header.modified_len), SEEK_CUR) == 0 && inflateInit(&stream) == Z_OK;
+    if (ok) {
+        // The stored size lets the body land in a single chunk
+        response_init(response, pool, (size_t)header.body_len);
+        uint64_t remaining = header.compressed_len;
+        int status = Z_OK;
+        while (ok && status != Z_STREAM_END) {
+            if (stream.avail_in == 0) {
+                size_t want = remaining < CACHE_IO_BUFFER ? (size_t)remaining : CACHE_IO_BUFFER;
+                if (want == 0 || fread(input, 1, want, in) != want) {
+                    ok = false; // Truncated entry
+                    break;
+                }
+                remaining -= want;
+                stream.next_in = input;
+                stream.avail_in = (uInt)want;
+            }
+            stream.next_out = output;
+            stream.avail_out = CACHE_IO_BUFFER;
+            status = inflate(&stream, Z_NO_FLUSH);
+            ok = (status == Z_OK || status == Z_STREAM_END) &&
+                 response_append(response, pool, (const char *)output, CACHE_IO_BUFFER - stream.avail_out);
+        }
+        ok = ok && response->size == header.body_len;
+        inflateEnd(&stream);
+    }
+    free(input);
+    free(output);
+    fclose(in);
+    if (ok) {
+        atomic_fetch_add_explicit(&cache->loads, 1, memory_order_relaxed);
+    }
+    return ok;
+}
+
+// Compress every chunk of body into out. Returns the compressed size, or -1 on an error.
+static long write_body(FILE *out, const ResponseBuffer *body) {
+    unsigned char *output = malloc(CACHE_IO_BUFFER);
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (output == NULL || deflateInit(&stream, CACHE_COMPRESSION_LEVEL) != Z_OK) {
+        free(output);
+        return -1;
+    }
+    long written = 0;
+    bool ok = true;
+    const BufferChunk *chunk = body->head;
+    int flush = Z_NO_FLUSH;
+    while (ok && flush != Z_FINISH) {
+        if (chunk != NULL) {
+            stream.next_in = (unsigned char *)chunk->data;
+            stream.avail_in = (uInt)chunk->used;
+            chunk = chunk->next;
+        }
+        flush = chunk == NULL ? Z_FINISH : Z_NO_FLUSH;
+        // Run deflate until it has taken all of this chunk (or, at the end, written everything out)
+        do {
+            stream.next_out = output;
+            stream.avail_out = CACHE_IO_BUFFER;
+            deflate(&stream, flush);
+            size_t n = CACHE_IO_BUFFER - stream.avail_out;
+            ok = fwrite(output, 1, n, out) == n;
+            written += (long)n;
+        } while (ok && stream.avail_out == 0);
+    }
+    deflateEnd(&stream);
+    free(output);
+    return ok ? written : -1;
+}
+
+bool cache_store(ResponseCache *cache, const char *url, const char *etag, const char *last_modified,
+                 const ResponseBuffer *body) {
+    char path[CACHE_PATH_MAX], tmp_path[CACHE_PATH_MAX + 32];
+    entry_path(cache, url, path);
+
+    // Create the entry's subdirectory the first time it is needed
+    char *slash = strrchr(path, '/');
+    *slash = '\0';
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        return false;
+    }
+    *slash = '/';
+
+    // Several crawls may share the cache; give each writer its own temporary file
+    static atomic_ulong tmp_counter;
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.%lu.tmp", path, (long)getpid(), atomic_fetch_add(&tmp_counter, 1));
+    FILE *out = fopen(tmp_path, "wb");
+    if (out == NULL) {
+        return false;
+    }
+
+    CacheEntryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.url_len = (uint32_t)strlen(url);
+    header.etag_len = etag != NULL ? (uint32_t)strlen(etag) : 0;
+    header.modified_len = last_modified != NULL ? (uint32_t)strlen(last_modified) : 0;
+    header.body_len = body->size;
+    header.stored_at = (int64_t)time(NULL);
+
+    // Write the header once the compressed size is known
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 && fwrite(url, 1, header.url_len, out) == header.url_len &&
+              fwrite(etag != NULL ? etag : "", 1, header.etag_len, out) == header.etag_len &&
+              fwrite(last_modified != NULL ? last_modified : "", 1, header.modified_len, out) == header.modified_len;
+    long compressed = ok ? write_body(out, body) : -1;
+    if (compressed >= 0) {
+        header.compressed_len = (uint64_t)compressed;
+        ok = fseek(out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, out) == 1;
+    } else {
+        ok = false;
+    }
+    if (fclose(out) != 0) {
+        ok = false;
+    }
+    if (!ok || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        return false;
+    }
+    atomic_fetch_add_explicit(&cache->stores, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&cache->bytes_stored, (unsigned long)compressed, memory_order_relaxed);
+    return true;
+}
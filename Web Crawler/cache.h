@@ -0,0 +1,81 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+// Include size types.
+#include <stddef.h>
+// Include fixed-width integer types.
+#include <stdint.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+// Include atomic types for the counters.
+#include <stdatomic.h>
+// Include the response buffers cached bodies are stored from and loaded into.
+#include "bufpool.h"
+
+// Define the magic bytes and format version at the start of every cache entry.
+#define CACHE_MAGIC "CRAWLRSP"
+#define CACHE_VERSION 1
+// Define the zlib level bodies are compressed with (1 = fastest, 9 = smallest).
+#define CACHE_COMPRESSION_LEVEL 6
+// Define the size of the buffers compressed data is streamed through.
+#define CACHE_IO_BUFFER (64 * 1024)
+
+/**
+ * @brief Header of a cache entry file.
+ *
+ * The header is followed by the URL, the ETag and the Last-Modified value (lengths below, no
+ * terminators) and then the zlib-compressed body. The URL is stored so that two URLs whose hashes
+ * collide on one file name are told apart.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t url_len;
+    uint32_t etag_len;               // 0 if the response had no ETag
+    uint32_t modified_len;           // 0 if the response had no Last-Modified
+    uint64_t body_len;               // Uncompressed body size
+    uint64_t compressed_len;
+    int64_t stored_at;               // Unix time the entry was written
+} CacheEntryHeader;
+
+// The validators of a cached response, sent back in a conditional request.
+typedef struct {
+    char *etag;                      // NULL if none
+    char *last_modified;             // NULL if none
+} CacheValidators;
+
+/**
+ * @brief On-disk cache of fetched pages, keyed by canonical URL.
+ *
+ * Each page that came with an ETag or a Last-Modified header is stored in its own file, named after the
+ * hash of its URL and spread over 256 subdirectories, with its validators and its body compressed with
+ * zlib. A later crawl sends the validators as If-None-Match and If-Modified-Since, and when the server
+ * answers 304 Not Modified the body is read back from the cache instead of being downloaded again.
+ * Entries are written to a temporary file and renamed into place, so a reader never sees a partial
+ * entry and several crawls may share a directory. Thread-safe.
+ */
+typedef struct {
+    char *dir;
+    atomic_ulong lookups;            // cache_lookup calls
+    atomic_ulong hits;               // Lookups that found an entry
+    atomic_ulong loads;              // Bodies read back after a 304
+    atomic_ulong stores;             // Entries written
+    atomic_ulong bytes_stored;       // Compressed bytes written
+} ResponseCache;
+
+// Open (creating if needed) the cache directory dir. Returns false if it cannot be created.
+bool cache_init(ResponseCache *cache, const char *dir);
+// Free the cache's memory. The entries stay on disk.
+void cache_destroy(ResponseCache *cache);
+// Read the validators stored for url. Returns false if the URL is not cached.
+bool cache_lookup(ResponseCache *cache, const char *url, CacheValidators *validators);
+// Free the strings of validators filled in by cache_lookup.
+void cache_validators_free(CacheValidators *validators);
+// Decompress the body stored for url into response, which must be empty. Returns false if the entry is
+// missing or damaged, in which case response may hold part of the body.
+bool cache_load(ResponseCache *cache, const char *url, ResponseBuffer *response, BufferPool *pool);
+// Store a body with its validators (either may be NULL) under url, replacing any older entry.
+bool cache_store(ResponseCache *cache, const char *url, const char *etag, const char *last_modified,
+                 const ResponseBuffer *body);
+
+#endif
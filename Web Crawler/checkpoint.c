@@ -0,0 +1,161 @@
+// Define the required feature test macro to enable fileno(), fsync() and mmap().
+#define _POSIX_C_SOURCE 200809L
+
+// Include the checkpoint interface.
+#include "checkpoint.h"
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+// Include limits for the depth scan.
+#include <limits.h>
+// Include open() and fstat().
+#include <fcntl.h>
+#include <sys/stat.h>
+// Include mmap().
+#include <sys/mman.h>
+// Include fsync() and close().
+#include <unistd.h>
+
+// Define the stdio buffer size used while writing a checkpoint.
+#define CHECKPOINT_IO_BUFFER (1024 * 1024)
+
+bool checkpoint_write(const char *path, int max_depth, VisitedSet *visited, Scheduler *sched,
+                      const SpillSnapshot *spill, URLQueueNode *const *inflight, size_t inflight_count) {
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *out = fopen(tmp_path, "wb");
+    if (out == NULL) {
+        perror("Failed to create checkpoint");
+        return false;
+    }
+    char *buffer = malloc(CHECKPOINT_IO_BUFFER);
+    if (buffer != NULL) {
+        setvbuf(out, buffer, _IOFBF, CHECKPOINT_IO_BUFFER);
+    }
+
+    // Reserve room for the header; it is filled in once the section sizes are known
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.max_depth = max_depth;
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+
+    header.visited_offset = sizeof(header);
+    ok = ok && visited_save(visited, out);
+    long visited_end = ftell(out);
+    header.visited_bytes = (uint64_t)visited_end - header.visited_offset;
+
+    // Nodes being fetched have left the queues; they go first since they are the oldest
+    header.frontier_offset = (uint64_t)visited_end;
+    size_t count = 0;
+    for (size_t i = 0; ok && i < inflight_count; i++) {
+        ok = spill_record_write(out, inflight[i]) != 0;
+        count++;
+    }
+    ok = ok && sched_save(sched, out, spill, &count);
+    header.frontier_bytes = (uint64_t)ftell(out) - header.frontier_offset;
+    header.frontier_count = count;
+
+    ok = ok && fseek(out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, out) == 1;
+    // Make the data durable before the rename makes it the checkpoint
+    ok = ok && fflush(out) == 0 && fsync(fileno(out)) == 0;
+    if (fclose(out) != 0) {
+        ok = false;
+    }
+    free(buffer);
+    if (!ok || rename(tmp_path, path) != 0) {
+        perror("Failed to write checkpoint");
+        remove(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+bool checkpoint_open(const char *path, Checkpoint *checkpoint) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open checkpoint");
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CheckpointHeader)) {
+        fprintf(stderr, "Checkpoint %s is truncated\n", path);
+        close(fd);
+        return false;
+    }
+    checkpoint->size = (size_t)st.st_size;
+    checkpoint->map = mmap(NULL, checkpoint->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file alive
+    if (checkpoint->map == MAP_FAILED) {
+        perror("Failed to map checkpoint");
+        return false;
+    }
+    checkpoint->header = checkpoint->map;
+
+    const CheckpointHeader *header = checkpoint->header;
+    if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CHECKPOINT_VERSION ||
+        header->visited_offset + header->visited_bytes > checkpoint->size ||
+        header->frontier_offset + header->frontier_bytes > checkpoint->size) {
+        fprintf(stderr, "%s is not a valid checkpoint\n", path);
+        checkpoint_close(checkpoint);
+        return false;
+    }
+    return true;
+}
+
+bool checkpoint_load_visited(Checkpoint *checkpoint, VisitedSet *visited) {
+    const char *data = (const char *)checkpoint->map + checkpoint->header->visited_offset;
+    return visited_load(visited, data, checkpoint->header->visited_bytes);
+}
+
+// Decode the record at *cursor into its header and string pointers, advancing the cursor. Returns
+// false at the end of the section or on a truncated record.
+static bool next_record(const char **cursor, const char *end, SpillRecord *record, const char **url,
+                        const char **base_url) {
+    if ((size_t)(end - *cursor) < sizeof(SpillRecord)) {
+        return false;
+    }
+    memcpy(record, *cursor, sizeof(SpillRecord));
+    size_t base_len = record->base_len != UINT32_MAX ? record->base_len : 0;
+    if ((size_t)(end - *cursor) - sizeof(SpillRecord) < (size_t)record->url_len + base_len) {
+        return false;
+    }
+    *url = *cursor + sizeof(SpillRecord);
+    *base_url = record->base_len != UINT32_MAX ? *url + record->url_len : NULL;
+    *cursor += sizeof(SpillRecord) + record->url_len + base_len;
+    return true;
+}
+
+size_t checkpoint_load_frontier(Checkpoint *checkpoint, void (*push)(URLQueueNode *node, void *arg), void *arg) {
+    const char *begin = (const char *)checkpoint->map + checkpoint->header->frontier_offset;
+    const char *end = begin + checkpoint->header->frontier_bytes;
+    SpillRecord record;
+    const char *url, *base_url;
+
+    // The saved queues interleave depths; push one depth at a time so the crawl stays breadth-first
+    int min_depth = INT_MAX, max_depth = INT_MIN;
+    for (const char *cursor = begin; next_record(&cursor, end, &record, &url, &base_url);) {
+        min_depth = record.depth < min_depth ? record.depth : min_depth;
+        max_depth = record.depth > max_depth ? record.depth : max_depth;
+    }
+
+    size_t count = 0;
+    for (int depth = min_depth; depth <= max_depth; depth++) {
+        for (const char *cursor = begin; next_record(&cursor, end, &record, &url, &base_url);) {
+            if (record.depth != depth) {
+                continue;
+            }
+            push(node_create(url, record.url_len, base_url, record.base_len, record.depth), arg);
+            count++;
+        }
+    }
+    return count;
+}
+
+void checkpoint_close(Checkpoint *checkpoint) {
+    munmap(checkpoint->map, checkpoint->size);
+    checkpoint->map = NULL;
+}
@@ -0,0 +1,53 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+// Include the visited set, whose contents are saved.
+#include "visited.h"
+// Include the scheduler, whose queues are saved.
+#include "scheduler.h"
+
+// Define the magic bytes and format version at the start of every checkpoint file.
+#define CHECKPOINT_MAGIC "CRAWLCKP"
+#define CHECKPOINT_VERSION 1
+
+/**
+ * @brief Header of a checkpoint file.
+ *
+ * The header is followed by two sections at the given offsets: the visited set as written by
+ * visited_save(), and the frontier as a sequence of SpillRecords (depth, lengths, URL and base URL
+ * bytes). Every field is fixed-size and the sections are read in place, so a checkpoint is loaded by
+ * memory-mapping the file rather than parsing it into buffers first.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    int32_t max_depth;               // Depth limit of the crawl that wrote the checkpoint
+    uint64_t visited_offset;
+    uint64_t visited_bytes;
+    uint64_t frontier_offset;
+    uint64_t frontier_bytes;
+    uint64_t frontier_count;         // Number of SpillRecords in the frontier section
+} CheckpointHeader;
+
+// A checkpoint file mapped into memory for loading.
+typedef struct {
+    void *map;
+    size_t size;
+    const CheckpointHeader *header;
+} Checkpoint;
+
+// Write a checkpoint of the visited set, every queued node, the disk-spilled nodes captured in spill
+// (may be NULL) and the nodes being fetched. The crawl must not change any of them meanwhile. The file
+// is written next to path and renamed over it, so path always holds a complete checkpoint.
+bool checkpoint_write(const char *path, int max_depth, VisitedSet *visited, Scheduler *sched,
+                      const SpillSnapshot *spill, URLQueueNode *const *inflight, size_t inflight_count);
+// Map a checkpoint file and check its header. Returns false if it is missing or malformed.
+bool checkpoint_open(const char *path, Checkpoint *checkpoint);
+// Initialize a visited set from a mapped checkpoint.
+bool checkpoint_load_visited(Checkpoint *checkpoint, VisitedSet *visited);
+// Hand every frontier node of a mapped checkpoint to push, shallowest first. Returns the number of nodes.
+size_t checkpoint_load_frontier(Checkpoint *checkpoint, void (*push)(URLQueueNode *node, void *arg), void *arg);
+// Unmap a checkpoint.
+void checkpoint_close(Checkpoint *checkpoint);
+
+#endif
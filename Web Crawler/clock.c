@@ -0,0 +1,10 @@
+// Include the clock interface.
+#include "clock.h"
+// Include clock_gettime().
+#include <time.h>
+
+uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
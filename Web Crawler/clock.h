@@ -0,0 +1,11 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+// Include fixed-width integer types.
+#include <stdint.h>
+
+// Read the monotonic clock in nanoseconds. Every expiry time, deadline and duration the crawler keeps is
+// on this clock.
+uint64_t now_ns();
+
+#endif
@@ -9,293 +9,557 @@
 #include <pthread.h>
 // Include string manipulation functions.
 #include <string.h>
+// Include strncasecmp() for header names.
+#include <strings.h>
 // Include the boolean type definition.
 #include <stdbool.h>
+// Include atomic types for counters shared between worker threads.
+#include <stdatomic.h>
+// Include fixed-width integer types.
+#include <stdint.h>
 // Include system-specific functions and types.
 #include <unistd.h>
+// Include long command-line option parsing.
+#include <getopt.h>
+// Include the monotonic clock used to time workers.
+#include <time.h>
+// Include sigaction() for the verbosity and metrics signals.
+#include <signal.h>
+// Include poll() for the metrics socket.
+#include <poll.h>
+// Include the Unix domain socket the metrics may be served on.
+#include <sys/socket.h>
+#include <sys/un.h>
 // Include the libcurl library for performing HTTP requests.
 #include <curl/curl.h>
 // Include system-specific types.
 #include <sys/types.h>
-// Include GLib, a general-purpose utility library.
-#include <glib.h>
+// Include waitpid() for the checkpoint writer process.
+#include <sys/wait.h>
 // Include libxml2 for XML parsing functionality.
 #include <libxml2/libxml/HTMLparser.h>
-
-// Define the maximum number of threads.
-#define MAX_THREADS 4
+// Include the lock-free URL frontier.
+#include "frontier.h"
+// Include the work-stealing scheduler that sits on top of the frontier.
+#include "scheduler.h"
+// Include the sharded set of visited URLs.
+#include "visited.h"
+// Include checkpoint writing and loading.
+#include "checkpoint.h"
+// Include the vectorized href scanner.
+#include "hrefscan.h"
+// Include the pooled response buffers.
+#include "bufpool.h"
+// Include the scratch arena for URLs built while parsing.
+#include "arena.h"
+// Include the RFC 3986 URL resolver.
+#include "url.h"
+// Include the per-host politeness queues.
+#include "politeness.h"
+// Include the on-disk response cache.
+#include "cache.h"
+// Include the duplicate content index.
+#include "dedup.h"
+// Include the asynchronous logger.
+#include "log.h"
+// Include the latency histograms and counters.
+#include "metrics.h"
+// Include the robots.txt cache.
+#include "robots.h"
+// Include the shared DNS cache.
+#include "dns.h"
+// Include the frontier budget.
+#include "budget.h"
+// Include the monotonic clock.
+#include "clock.h"
+
+// Define how many worker threads per online CPU adaptive mode may grow to by default.
+#define ADAPTIVE_THREADS_PER_CPU 4
+// Define how often (in milliseconds) the adaptive controller re-evaluates the pool size.
+#define ADAPT_INTERVAL_MS 1000
+// Define the share of time workers spend parsing above which the pool is CPU-bound and should grow.
+#define ADAPT_GROW_BUSY 0.75
+// Define the share of time workers spend parsing below which the pool may shrink.
+#define ADAPT_SHRINK_BUSY 0.25
+// Define the maximum number of transfers each worker keeps in flight on its multi handle.
+#define MAX_INFLIGHT 256
+// Define how long (in milliseconds) a worker waits on its sockets before checking the queue for new work.
+#define POLL_TIMEOUT_MS 50
+// Define the most URLs a worker sends back to the spill store in one pass because their host's queue is
+// full. A worker that sends back that many leaves the frontier alone for POLL_TIMEOUT_MS, so a frontier
+// that holds little else is not cycled through the disk over and over.
+#define HOST_SPILL_BATCH 32
+// Define the default target false-positive rate of the fingerprint visited set.
+#define DEFAULT_FALSE_POSITIVE_RATE 0.001
+// Define the default number of seconds between checkpoints.
+#define DEFAULT_CHECKPOINT_INTERVAL 60
+// Define the default number of seconds between metrics dumps.
+#define DEFAULT_METRICS_INTERVAL 10
+// Define how often (in milliseconds) the metrics thread checks for a dump request or a connection.
+#define METRICS_POLL_MS 100
+// Define the factor a compressed Content-Length is multiplied by to presize the decoded body.
+#define COMPRESSED_PRESIZE_RATIO 4
 // Define the user agent string used in HTTP requests.
 #define USER_AGENT "Mozilla/5.0 (compatible; Googlebot/2.1; +http://www.google.com/bot.html)"
-
-//Global hashmap to store urls that have been processed.
-GHashTable *hashmap;
-GMutex mutex;
-
-//Structure to hold the HTTP response data.
-struct ResponseData {
-    char *data;
-    size_t size;
-};
-
-// Define a structure for queue elements.
-typedef struct URLQueueNode {
-    char *url;
-    char *base_url; // New field to store the base URL
-    int depth;
-    struct URLQueueNode *next;
-} URLQueueNode;
-
-// Define a structure for a thread-safe queue.
+// Define the product token of USER_AGENT that robots.txt groups are matched against.
+#define ROBOTS_AGENT "Googlebot"
+// Define the timeout (in seconds) of a robots.txt request.
+#define ROBOTS_TIMEOUT 5L
+
+//Global set to store urls that have been processed.
+VisitedSet visited;
+
+// How links are extracted from a fetched page.
+typedef enum {
+    PARSE_DOM,                       // Buffer the whole body, build a libxml2 DOM and walk it
+    PARSE_STREAM,                    // Feed each received chunk to a libxml2 push parser with SAX callbacks
+    PARSE_SCAN                       // Buffer the whole body and scan it for hrefs with SIMD; libxml2 as fallback
+} ParseMode;
+
+// Link extraction mode chosen on the command line.
+ParseMode parse_mode = PARSE_STREAM;
+// Whether buffered bodies that span several chunks go to a push parser (or the href scanner) chunk by
+// chunk instead of being joined into one buffer first.
+bool zero_copy = false;
+// Cache of fetched pages for conditional requests, or NULL without --cache.
+ResponseCache *response_cache = NULL;
+// Index of the bodies parsed so far, or NULL without --dedup.
+DedupIndex *content_index = NULL;
+// Rules of the robots.txt of every host seen, or NULL without --robots.
+RobotsCache *robots = NULL;
+// Addresses of the hosts seen, resolved in the background, or NULL without --dns-cache.
+DnsCache *dns = NULL;
+// Memory and length budgets of the queued URLs, or NULL without --frontier-urls and --frontier-memory.
+FrontierBudget *budget = NULL;
+
+struct ThreadPool;
+struct FetchJob;
+
+// Worker slot: the thread running in it and the counters the adaptive controller reads.
 typedef struct {
-    URLQueueNode *head, *tail;
-    pthread_mutex_t lock;
-} URLQueue;
+    struct ThreadPool *pool;         // Pool the worker belongs to
+    int id;                          // Index of the worker in the scheduler
+    pthread_t thread;                // Thread ID, valid while joinable
+    bool joinable;                   // Set from creation until the thread is joined (guarded by pool->lock)
+    atomic_bool running;             // Set while the thread is alive
+    atomic_bool retire;              // Asks the worker to finish its in-flight transfers and exit
+    atomic_int inflight;             // Transfers currently on the worker's multi handle
+    atomic_ulong parse_ns;           // Time spent parsing pages
+    atomic_ulong wait_ns;            // Time spent waiting on sockets or parked without work
+    atomic_ulong fetches;            // Completed transfers
+    atomic_ulong fetch_us;           // Total duration of the completed transfers
+    struct FetchJob *active;         // Transfers on the multi handle, for checkpoints
+    HrefScanner scanner;             // Link buffers reused by every page the worker scans (PARSE_SCAN)
+    BufferPool buffers;              // Chunks for the bodies of the worker's transfers
+    Arena scratch;                   // URLs built while parsing; reset after every page
+    MetricsShard metrics;            // Latencies and counters, written by the worker's thread only
+} Worker;
 
 // Thread pool structure
-typedef struct {
-    pthread_t threads[MAX_THREADS];  // Array to store thread IDs
+typedef struct ThreadPool {
+    Worker *workers;                 // Array of max_threads worker slots
+    int max_threads;                 // Number of worker slots, and of scheduler deques
     URLQueue *queue;                 // Pointer to the shared URL queue
-    pthread_mutex_t lock;            // Mutex for thread synchronization
-    pthread_cond_t task_available;   // Condition variable to signal availability of tasks
+    Scheduler scheduler;             // Per-worker deques and parking on top of the shared queue
+    HostScheduler *hosts;            // Per-host queues between the scheduler and the fetches, or NULL
     int depth;                       // Depth limit for crawling
+    atomic_long outstanding;         // URLs queued or being fetched and parsed, plus one while the
+                                     // starting URLs are being queued; the crawl is over at zero
+    pthread_mutex_t lock;            // Guards live and the workers' joinable flags
+    pthread_cond_t all_exited;       // Signaled when the last live worker exits
+    int live;                        // Number of worker threads that have not exited
+    bool adaptive;                   // Whether the controller thread resizes the pool
+    pthread_t controller;            // Adaptive controller thread
+    atomic_bool checkpoint_requested; // Asks every worker to stop at its safe point
+    int paused;                      // Number of workers stopped for a checkpoint (guarded by lock)
+    pthread_cond_t paused_cond;      // Signaled when paused or live changes, or the checkpoint is done
+    const char *checkpoint_path;     // File checkpoints are written to, or NULL
+    int checkpoint_interval;         // Seconds between checkpoints
+    pthread_t checkpointer;          // Checkpoint thread
+    unsigned long checkpoints;       // Checkpoints written
+    const char *metrics_path;        // File the metrics are dumped to, or NULL
+    int metrics_listener;            // Listening Unix socket the metrics are served on, or -1
+    int metrics_interval;            // Seconds between dumps to metrics_path
+    pthread_t metrics_thread;        // Metrics thread, running if metrics_path or metrics_listener is set
+    pthread_mutex_t metrics_lock;    // Held across a metrics dump, and by a checkpoint until it has forked
+    uint64_t started_ns;             // Monotonic time the pool was created
 } ThreadPool;
 
-void thread_pool_init(ThreadPool *pool, URLQueue *queue, int depth);
-void thread_pool_submit(ThreadPool *pool);
+// Index of the calling worker in the scheduler, or -1 for threads outside the pool.
+_Thread_local int worker_id = -1;
+// Number of nodes the calling thread has queued since it last woke parked workers.
+_Thread_local int pending_pushes = 0;
+// Set by SIGUSR1 to ask the metrics thread for a dump.
+atomic_bool metrics_requested = false;
 
-void hashmap_init() {
-    // Create a new hash table with string keys and NULL as the hash function and equality function
-    hashmap = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
-    // Initialize the mutex
-    g_mutex_init(&mutex);
+void thread_pool_init(ThreadPool *pool, URLQueue *queue, PriorityFrontier *priority, HostScheduler *hosts, int depth,
+                      int threads, int max_threads, bool adaptive);
+void thread_pool_submit(ThreadPool *pool);
+void thread_pool_worker_exit(ThreadPool *pool, Worker *self);
+void thread_pool_pause(ThreadPool *pool);
+
+// Shared libcurl state (DNS cache and TLS sessions) used by the easy handles of every worker.
+CURLSH *share;
+// One lock per kind of shared data, so DNS lookups and TLS session lookups do not serialize each other.
+pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+// Counters for how many transfers had to open a connection and how many reused an open one.
+atomic_ulong connections_opened;
+atomic_ulong connections_reused;
+// Counters for the bytes received (headers and encoded bodies) and the bodies they decoded to, and for
+// the pages the server reported as not modified.
+atomic_ulong bytes_received;
+atomic_ulong bytes_decoded;
+atomic_ulong not_modified;
+// Counters for how many pages the href scanner handled and how many it handed back to libxml2.
+atomic_ulong scan_pages;
+atomic_ulong scan_fallbacks;
+
+// Per-worker stack of idle easy handles. A worker never has more than MAX_INFLIGHT handles alive.
+typedef struct {
+    CURL *idle[MAX_INFLIGHT];
+    int count;
+} HandleCache;
+
+void share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr) {
+    (void)handle;
+    (void)access;
+    (void)userptr;
+    pthread_mutex_lock(&share_locks[data]);
 }
 
-void hashmap_insert(const char* key) {
-    g_mutex_lock(&mutex); // Acquire the mutex lock to ensure thread safety while modifying the hash map.
-    // Insert the key into the hash table, using the key as the key and a NULL value.
-    // g_strdup() is used to duplicate the key string because g_hash_table_insert() takes ownership of the key.
-    g_hash_table_insert(hashmap, g_strdup(key), NULL);
-    g_mutex_unlock(&mutex); // Release the mutex lock to allow other threads to access the hash map.
+void share_unlock(CURL *handle, curl_lock_data data, void *userptr) {
+    (void)handle;
+    (void)userptr;
+    pthread_mutex_unlock(&share_locks[data]);
 }
 
-bool is_relative_url(const char *url) {
-    // A relative URL does not start with "http://", "https://", "//", or "?"
-    return !(strncmp(url, "http://", 7) == 0 || strncmp(url, "https://", 8) == 0 ||
-             strncmp(url, "//", 2) == 0 || url[0] == '?'|| url[0] == '/');
+/**
+ * @brief Create the share object used by all workers for DNS and TLS session reuse.
+ *
+ * Open connections are not put in the share object: libcurl does not support using one connection
+ * cache from several threads at once. Each worker's multi handle already keeps its own connection
+ * pool, and because handles are long-lived those connections stay open between fetches.
+ */
+void connection_cache_init() {
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&share_locks[i], NULL);
+    }
+    share = curl_share_init();
+    if (share == NULL) {
+        fprintf(stderr, "Failed to initialize cURL share object\n");
+        return;
+    }
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS); // Resolved host names
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION); // TLS session tickets
 }
 
-bool hashmap_contains(const char* key) {
-    g_mutex_lock(&mutex);
-    // Check if the key exists in the hash table
-    bool found = g_hash_table_contains(hashmap, key);
-    g_mutex_unlock(&mutex);
-    return found;
+void connection_cache_cleanup() {
+    curl_share_cleanup(share);
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_destroy(&share_locks[i]);
+    }
 }
 
-void hashmap_cleanup() {
-    // Free the memory used by the hash table
-    g_hash_table_destroy(hashmap);
-    // Destroy the mutex
-    g_mutex_clear(&mutex);
+// Take an idle easy handle from the worker's cache, or create and configure a new one.
+CURL *handle_cache_acquire(HandleCache *cache) {
+    if (cache->count > 0) {
+        return cache->idle[--cache->count];
+    }
+
+    CURL *curl = curl_easy_init();
+    if (!curl) {
+        return NULL;
+    }
+
+    // Set the libcurl options that are the same for every request made with this handle
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, USER_AGENT); // Set user-agent header
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L); // Follow redirects
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L); // Set timeout for request
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L); // Keep idle pooled connections alive
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, ""); // Offer every encoding libcurl decodes (gzip, br, zstd)
+    if (share != NULL) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, share); // Use the shared DNS cache and TLS sessions
+    }
+    return curl;
 }
 
-// Initialize a URL queue.
-void initQueue(URLQueue *queue) {
-    queue->head = queue->tail = NULL;
-    pthread_mutex_init(&queue->lock, NULL);
+// A robots.txt body being received, cut off at ROBOTS_MAX_SIZE.
+typedef struct {
+    char *data;
+    size_t size;
+    bool truncated;
+} RobotsBody;
+
+size_t robots_write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
+    size_t realsize = size * nmemb;
+    RobotsBody *body = (RobotsBody *)userp;
+    size_t room = ROBOTS_MAX_SIZE - body->size;
+    if (realsize > room) {
+        body->truncated = true; // The rest would be ignored anyway: stop the transfer
+        realsize = room;
+    }
+    char *data = realloc(body->data, body->size + realsize + 1);
+    if (data == NULL) {
+        return 0;
+    }
+    memcpy(data + body->size, contents, realsize);
+    body->data = data;
+    body->size += realsize;
+    return body->truncated ? 0 : realsize;
 }
 
-// Add a URL to the queue with its depth.
-void enqueue(URLQueue *queue, const char *url, const char *base_url, int depth, ThreadPool *pool) {
-    URLQueueNode *newNode = malloc(sizeof(URLQueueNode));
-    newNode->url = strdup(url);
-    newNode->base_url = strdup(base_url); // Store the base URL
-    newNode->depth = depth;
-    newNode->next = NULL;
-    pthread_mutex_lock(&queue->lock);
-    if (queue->tail) {
-        queue->tail->next = newNode;
-    } else {
-        queue->head = newNode;
+/**
+ * @brief Fetch a robots.txt for the robots cache.
+ *
+ * The request runs on an easy handle of its own with curl_easy_perform(), on one of the cache's
+ * fetcher threads, so no worker waits for it. It shares the DNS cache and TLS sessions with the
+ * workers and follows redirects, as RFC 9309 asks for.
+ *
+ * @param url The URL of the robots.txt.
+ * @param body Receives the malloc'ed body, or NULL.
+ * @param len Receives the length of the body.
+ * @param arg Unused.
+ * @return The HTTP status of the response, or 0 if there was none.
+ */
+long robots_fetch(const char *url, char **body, size_t *len, void *arg) {
+    (void)arg;
+    RobotsBody received = { NULL, 0, false };
+    long status = 0;
+    CURL *curl = curl_easy_init();
+    if (curl != NULL) {
+        curl_easy_setopt(curl, CURLOPT_URL, url);
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, USER_AGENT);
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, ROBOTS_TIMEOUT);
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, robots_write_callback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&received);
+        if (share != NULL) {
+            curl_easy_setopt(curl, CURLOPT_SHARE, share);
+        }
+        CURLcode result = curl_easy_perform(curl);
+        if (result == CURLE_OK || (result == CURLE_WRITE_ERROR && received.truncated)) {
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+        } else {
+            log_write(LOG_WARN, "robots", url, -1, "%s", curl_easy_strerror(result));
+        }
+        curl_easy_cleanup(curl);
     }
-    queue->tail = newNode;
-    pthread_mutex_unlock(&queue->lock);
+    if (status == 0) {
+        free(received.data);
+        received.data = NULL;
+        received.size = 0;
+    }
+    *body = received.data;
+    *len = received.size;
+    return status;
+}
 
-    // Signal that a task is available
-    pthread_mutex_lock(&pool->lock);
-    pthread_cond_signal(&pool->task_available);
-    pthread_mutex_unlock(&pool->lock);
+// Crawl-delay of a host for the per-host queues.
+double robots_host_delay(const char *host, size_t len, void *arg) {
+    return robots_crawl_delay((RobotsCache *)arg, host, len);
 }
 
-// Remove a URL from the queue.
-URLQueueNode *dequeue(URLQueue *queue) {
-    pthread_mutex_lock(&queue->lock);
-    if (queue->head == NULL) {
-        pthread_mutex_unlock(&queue->lock);
-        return NULL;
+// Return an easy handle to the worker's cache once its transfer is finished.
+void handle_cache_release(HandleCache *cache, CURL *curl) {
+    if (cache->count < MAX_INFLIGHT) {
+        cache->idle[cache->count++] = curl;
+    } else {
+        curl_easy_cleanup(curl);
     }
-    URLQueueNode *temp = queue->head;
-    queue->head = queue->head->next;
-    if (queue->head == NULL) {
-        queue->tail = NULL;
+}
+
+void handle_cache_cleanup(HandleCache *cache) {
+    while (cache->count > 0) {
+        curl_easy_cleanup(cache->idle[--cache->count]);
     }
-    pthread_mutex_unlock(&queue->lock);
-    return temp;
 }
 
-size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
-    size_t realsize = size * nmemb; // Calculate the total size of the received data.
+// Count a URL that is about to be queued. It stays outstanding until work_done() is called for it.
+void work_add(ThreadPool *pool) {
+    atomic_fetch_add(&pool->outstanding, 1);
+}
 
-    // Cast the userp pointer to a struct ResponseData pointer to access the response data.
-    struct ResponseData *response = (struct ResponseData *)userp;
+// Count a URL as finished: fetched and parsed, or dropped. Every link the page had is queued, and so
+// counted, by now, so when the count reaches zero nothing is queued or in flight and nothing more can
+// be found; the crawl is over and the workers are released.
+void work_done(ThreadPool *pool) {
+    if (atomic_fetch_sub(&pool->outstanding, 1) == 1) {
+        sched_close(&pool->scheduler);
+    }
+}
 
-    // Reallocate memory for the response data buffer to accommodate the newly received data.
-    // The size is increased by the size of the received data plus one for the null terminator.
-    response->data = realloc(response->data, response->size + realsize + 1);
+// Drop a URL its host's robots.txt disallows.
+void robots_drop(ThreadPool *pool, URLQueueNode *node) {
+    log_write(LOG_DEBUG, "robots", node->url, node->depth, NULL);
+    node_free(node);
+    work_done(pool);
+}
 
-    // Check if memory reallocation was successful.
-    if (response->data == NULL) {
-        fprintf(stderr, "Failed to allocate memory for response data\n");
-        return 0; // Return 0 to indicate failure.
+// Take back a URL the robots cache parked until its host's rules were known: queue it again, to be
+// admitted to the host queues like any other, or drop it if the rules disallow it.
+void robots_release(URLQueueNode *node, bool allowed, void *arg) {
+    ThreadPool *pool = (ThreadPool *)arg;
+    if (!allowed) {
+        robots_drop(pool, node);
+        return;
+    }
+    sched_push(&pool->scheduler, worker_id, node);
+    sched_notify(&pool->scheduler, 1); // A worker may have parked meanwhile
+}
+
+// How promising a link is for the drop policy, from 0 to 1: its level in the priority frontier, or the
+// level the built-in score would give it when the crawl is breadth-first.
+double link_rank(ThreadPool *pool, const char *url, int depth) {
+    int level;
+    if (pool->scheduler.priority != NULL) {
+        level = prio_level(pool->scheduler.priority, url, depth);
+    } else {
+        PriorityInput input = { url, NULL, 0, depth, 0 };
+        input.host = url_host(url, &input.host_len);
+        level = priority_default_score(&input, NULL);
+        level = level < 0 ? 0 : level > PRIORITY_LEVELS - 1 ? PRIORITY_LEVELS - 1 : level;
     }
+    return (double)level / (PRIORITY_LEVELS - 1);
+}
 
-    // Copy the received data into the response buffer starting from the current position.
-    memcpy(&(response->data[response->size]), contents, realsize);
+// Give back the budget charge of a freed queue node.
+void budget_node_release(size_t charge, void *arg) {
+    budget_release((FrontierBudget *)arg, charge);
+}
 
-    // Update the size of the response data to reflect the addition of the newly received data.
-    response->size += realsize;
+// Add a URL to the queue with its depth, unless the frontier budget turns it away.
+void enqueue(URLQueue *queue, const char *url, const char *base_url, int depth, ThreadPool *pool) {
+    size_t url_len = strlen(url);
+
+    // Over the budget, the policy drops the link or sends it to disk; blocking holds back the fetches
+    // instead (see fetch_url()) and only sends the link to disk past the overshoot allowance
+    size_t charge = 0;
+    bool spill = false;
+    if (budget != NULL) {
+        double rank = budget->policy == BUDGET_DROP ? link_rank(pool, url, depth) : 0;
+        BudgetDecision decision = budget_admit(budget, node_bytes(url_len), rank);
+        MetricsShard *metrics = worker_id >= 0 ? &pool->workers[worker_id].metrics : NULL;
+        if (decision == BUDGET_DROPPED) {
+            if (metrics != NULL) {
+                metrics_count(metrics, COUNTER_BUDGET_DROPPED, 1);
+            }
+            log_write(LOG_DEBUG, "dropped", url, depth, NULL);
+            return;
+        }
+        if (decision == BUDGET_SPILLED) {
+            if (metrics != NULL) {
+                metrics_count(metrics, COUNTER_BUDGET_SPILLED, 1);
+            }
+            spill = true;
+        } else {
+            charge = node_bytes(url_len);
+        }
+    }
 
-    // Null-terminate the response string to ensure it is properly terminated.
-    response->data[response->size] = '\0';
+    // One pooled allocation for the node and its URL; the base URL is shared with the page's other links
+    URLQueueNode *newNode = node_create(url, url_len, base_url, base_url != NULL ? strlen(base_url) : 0, depth);
+    newNode->queued_ns = now_ns(); // The queue stage lasts until the node's transfer starts
+    newNode->charge = (uint32_t)charge; // Given back by node_free()
+
+    // Push the node onto this worker's own deque (or the shared frontier outside the pool), or straight
+    // to disk behind everything queued; parked workers are woken once for the whole batch by
+    // thread_pool_submit()
+    work_add(pool);
+    if (spill) {
+        frontier_push_overflow(queue, newNode);
+    } else {
+        sched_push(&pool->scheduler, worker_id, newNode);
+    }
+    pending_pushes++;
 
-    return realsize; // Return the size of the received data.
+    // Start resolving the URL's host now, so its address is known by the time the URL is fetched
+    if (dns != NULL) {
+        dns_prefetch(dns, url);
+    }
 }
 
-char *extract_base_url(const char *url) {
-    char *base_url = NULL;
-
-    // Check if the URL starts with "http://" or "https://"
-    const char *http_prefix = "http://";
-    const char *https_prefix = "https://";
+// Remove a URL from the calling worker's deque, the shared queue, or another worker's deque.
+URLQueueNode *dequeue(ThreadPool *pool) {
+    uint64_t start = now_ns();
+    URLQueueNode *node = sched_pop(&pool->scheduler, worker_id);
+    if (node != NULL) {
+        metrics_record(&pool->workers[worker_id].metrics, STAGE_DEQUEUE, now_ns() - start);
+    }
+    return node;
+}
 
-    const char *start_pos = strstr(url, http_prefix);
-    if (!start_pos) {
-        start_pos = strstr(url, https_prefix);
+// Resolve an extracted href against the page's base URL and queue it if it has not been visited. The
+// href stays owned by the caller; the resolved URL is built in the worker's scratch arena.
+void process_href(URLQueue *queue, const xmlChar *href, const char *base_url, int depth, ThreadPool *pool) {
+    if (href == NULL) {
+        return;
+    }
+    if (depth + 1 >= pool->depth) {
+        return; // The link would be at the depth limit, where nothing is fetched
+    }
+    const char *href_str = (const char *)href;
+    size_t href_len = strlen(href_str);
+
+    // The canonical form is both what gets fetched and the visited-set key, so every spelling of a
+    // URL is fetched once
+    char *full_url = arena_alloc(&pool->workers[worker_id].scratch, URL_RESOLVE_MAX(strlen(base_url), href_len));
+    if (full_url == NULL) {
+        log_write(LOG_ERROR, "memory", NULL, depth, "Failed to allocate memory for full URL");
+        return;
+    }
+    if (url_resolve(base_url, href_str, href_len, full_url) == 0) {
+        log_write(LOG_DEBUG, "not-http", href_str, depth + 1, NULL);
+        return;
+    }
+    // A URL the host's robots.txt disallows never takes room in the visited set or the frontier. Until
+    // the host's rules are known its URLs are queued, and checked again before they are fetched
+    if (robots != NULL && robots_check(robots, full_url) == ROBOTS_DISALLOWED) {
+        log_write(LOG_DEBUG, "robots", full_url, depth + 1, NULL);
+        return;
     }
 
-    if (start_pos == url) { // Make sure "http://" or "https://" is at the beginning
-        // Find the end position of the host part of the URL
-        start_pos += strlen(http_prefix);
-        const char *end_pos = strstr(start_pos, ".com");
-        if (end_pos) {
-            // Allocate memory for the base URL
-            size_t base_length = end_pos - url + strlen(".com"); // Adjust to include ".com"
-            base_url = (char *)malloc((base_length + 1) * sizeof(char));
-            if (base_url) {
-                // Copy the host part of the URL to the base URL
-                strncpy(base_url, url, base_length);
-                base_url[base_length] = '\0'; // Null-terminate the string
-            }
-        } else {
-            // If no ".com" component, base URL is the same as the input URL
-            base_url = strdup(url);
-        }
+    if (pool->scheduler.priority != NULL) {
+        prio_count_link(pool->scheduler.priority, full_url); // Every link counts, including repeats
+    }
+    if (visited_insert(&visited, full_url)) {
+        enqueue(queue, full_url, base_url, depth + 1, pool); // Decrease depth and pass thread ID
+        metrics_count(&pool->workers[worker_id].metrics, COUNTER_LINKS, 1);
+        log_write(LOG_DEBUG, "link", full_url, depth + 1, NULL);
+    } else {
+        log_write(LOG_DEBUG, "seen", full_url, depth + 1, NULL);
     }
+}
 
+// Resolve the href of a <base> element against the page URL. Returns the page URL if the href is not
+// a usable http or https URL. The result lives in the worker's scratch arena.
+const char *resolve_base(const char *page_url, const char *href, ThreadPool *pool) {
+    size_t href_len = strlen(href);
+    char *base_url = arena_alloc(&pool->workers[worker_id].scratch, URL_RESOLVE_MAX(strlen(page_url), href_len));
+    if (base_url == NULL || url_resolve(page_url, href, href_len, base_url) == 0) {
+        return page_url;
+    }
     return base_url;
 }
-void process_href(URLQueue *queue, xmlChar *href, const char *base_url, int depth, ThreadPool *pool) {
-    if (href != NULL) {
-        // Check if the href is a relative URL
-        if (is_relative_url((char *)href)) {
-            // Concatenate the base URL with the extracted href.
-            char *full_url = malloc(strlen(base_url) + xmlStrlen(href) + 2);
-            if (full_url != NULL) {
-                strcpy(full_url, base_url);
-                strcat(full_url, "/");
-                strcat(full_url, (char *)href);
-                if (!hashmap_contains(full_url)) {
-                    hashmap_insert(full_url);
-                    enqueue(queue, full_url, base_url, depth + 1, pool);; // Decrease depth and pass thread ID
-                    printf("Extracted relative href: %s (Thread ID: %lu) (Depth: %d)\n", full_url, pthread_self(), depth);
-                    thread_pool_submit(pool); // Submit work to the thread pool
-                } else {
-                    printf("This link has already been crawled!: %s\n", full_url);
-                    free(full_url);
-                }
-            } else {
-                fprintf(stderr, "Failed to allocate memory for full URL\n");
-            }
-        } else if (((char *)href)[0] == '/' && ((char *)href)[1] != '/') {
-            // Concatenate the base URL with the extracted href.
-            char *full_url = malloc(strlen(base_url) + xmlStrlen(href) + 1);
-            if (full_url != NULL) {
-                strcpy(full_url, base_url);
-                strcat(full_url, (char *)href);
-                if (!hashmap_contains(full_url)) {
-                    hashmap_insert(full_url);
-                    enqueue(queue, full_url, base_url, depth + 1, pool);// Decrease depth and pass thread ID
-                    printf("Extracted relative href: %s (Thread ID: %lu) (Depth: %d)\n", full_url, pthread_self(), depth);
-                    thread_pool_submit(pool); // Submit work to the thread pool
-                } else {
-                    printf("This link has already been crawled!: %s\n", full_url);
-                    free(full_url);
-                }
-            } else {
-                fprintf(stderr, "Failed to allocate memory for full URL\n");
-            }
-        } else if (((char *)href)[0] == '/' && ((char *)href)[1] == '/') {
-            // Append 'https:' to the href and enqueue the URL
-            char *full_url = malloc(strlen(base_url) + xmlStrlen(href) + 1);
-            if (full_url != NULL) {
-                strcpy(full_url, "https:");
-                strcat(full_url, (char *)href);
-                if (!hashmap_contains(full_url)) {
-                    hashmap_insert(full_url);
-                    enqueue(queue, full_url, base_url, depth + 1, pool); // Decrease depth and pass thread ID
-                    printf("Extracted relative href: %s (Thread ID: %lu) (Depth: %d)\n", full_url, pthread_self(), depth);
-                    thread_pool_submit(pool); // Submit work to the thread pool
-                } else {
-                    printf("This link has already been crawled!: %s\n", full_url);
-                    free(full_url);
-                }
-            } else {
-                fprintf(stderr, "Failed to allocate memory for full URL\n");
-            }
-        } else if (((char *)href)[0] == '?') {
-            // Append the base URL to the href and enqueue the URL
-            char *full_url = malloc(strlen(base_url) + xmlStrlen(href) + 1);
-            if (full_url != NULL) {
-                strcpy(full_url, base_url);
-                strcat(full_url, "/");
-                strcat(full_url, (char *)href);
-                if (!hashmap_contains(full_url)) {
-                    hashmap_insert(full_url);
-                    enqueue(queue, full_url, base_url, depth + 1, pool); // Decrease depth and pass thread ID
-                    printf("Extracted relative href: %s (Thread ID: %lu) (Depth: %d)\n", full_url, pthread_self(), depth);
-                    thread_pool_submit(pool); // Submit work to the thread pool
-                } else {
-                    printf("This link has already been crawled!: %s\n", full_url);
-                    free(full_url);
-                }
-            } else {
-                fprintf(stderr, "Failed to allocate memory for full URL\n");
-            }
-        } else {
-            // Otherwise, enqueue the href as it is.
-            char *href_str = (char *)href;
-            // Check if the href is not NULL before enqueuing
-            if (href_str != NULL && !hashmap_contains(href_str)) {
-                hashmap_insert(href_str);
-                enqueue(queue, href_str, base_url, depth + 1, pool); // Decrease depth and pass thread ID
-                printf("Extracted href: %s (Thread ID: %lu) (Depth: %d) \n", href_str, pthread_self(), depth);
-                thread_pool_submit(pool); // Submit work to the thread pool
-            } else if (href_str != NULL) {
-                printf("This link has already been crawled!: %s\n", href_str);
-                free(href);
+
+// Find the href of the first <base> element that has one, in document order.
+xmlChar *find_base_href(htmlNodePtr node) {
+    for (htmlNodePtr cur_node = node; cur_node; cur_node = cur_node->next) {
+        if (cur_node->type == XML_ELEMENT_NODE && !xmlStrcmp(cur_node->name, (const xmlChar *)"base")) {
+            xmlChar *href = xmlGetProp(cur_node, (const xmlChar *)"href");
+            if (href != NULL) {
+                return href;
             }
         }
+        xmlChar *href = find_base_href(cur_node->children);
+        if (href != NULL) {
+            return href;
+        }
     }
+    return NULL;
 }
 
 void recursive_parse_html(htmlNodePtr node, URLQueue *queue, const char *base_url, int depth, ThreadPool *pool) {
@@ -310,6 +574,7 @@ void recursive_parse_html(htmlNodePtr node, URLQueue *queue, const char *base_ur
                 if (href != NULL) {
                     // Process the extracted hyperlink and enqueue it
                     process_href(queue, href, base_url, depth, pool);
+                    xmlFree(href);
                 }
             }
         }
@@ -318,12 +583,24 @@ void recursive_parse_html(htmlNodePtr node, URLQueue *queue, const char *base_ur
     }
 }
 
+// Walk a parsed document and process its links against the document's base URL: the first <base href>
+// if there is one, the page URL otherwise.
+void parse_document(htmlDocPtr document, URLQueue *queue, const char *base_url, int depth, ThreadPool *pool) {
+    htmlNodePtr root = xmlDocGetRootElement(document);
+    xmlChar *base_href = find_base_href(root);
+    if (base_href != NULL) {
+        base_url = resolve_base(base_url, (const char *)base_href, pool);
+        xmlFree(base_href);
+    }
+    recursive_parse_html(root, queue, base_url, depth, pool);
+}
+
 void parse_html(URLQueue *queue, const char *html_content, const char *base_url, int depth, ThreadPool *pool) {
     // Parse the HTML content into a DOM tree using libxml2
     htmlDocPtr document = htmlReadMemory(html_content, strlen(html_content), NULL, NULL, HTML_PARSE_NOWARNING | HTML_PARSE_NOERROR);
     if (document == NULL) {
         // Print error message if parsing fails
-        fprintf(stderr, "Failed to parse HTML content\n");
+        log_write(LOG_ERROR, "parse", base_url, depth, "Failed to parse HTML content");
         return;
     }
 
@@ -332,210 +609,2038 @@ void parse_html(URLQueue *queue, const char *html_content, const char *base_url,
 
     // Traverse the DOM tree using depth-first search (DFS), processing each node recursively.
     // The recursive_parse_html() function is called to extract hyperlinks and enqueue them for further processing.
-    recursive_parse_html(xmlDocGetRootElement(document), queue, base_url, depth, pool);
+    parse_document(document, queue, base_url, depth, pool);
 
     // Free the memory allocated for the DOM tree
     xmlFreeDoc(document);
 }
 
-// Function to fetch and process a URL
-/**
- * @brief Function executed by worker threads to fetch and process URLs.
- *
- * This function is executed by worker threads in the thread pool to fetch and process URLs.
- * It continuously dequeues URLs from the URL queue, fetches their content using libcurl, and
- * processes the HTML content to extract hyperlinks. The extracted hyperlinks are then enqueued
- * for further processing.
- *
- * @param arg A pointer to the ThreadPool structure containing thread pool information.
- * @return NULL upon completion of the task.
- */
-void *fetch_url(void *arg) {
-    ThreadPool *pool = (ThreadPool*)arg; // Cast the argument to ThreadPool pointer
-    URLQueue *queue = pool->queue; // Retrieve URL queue from ThreadPool
-    int depth = pool->depth; // Retrieve the maximum depth from ThreadPool
-
-    // Main loop to continuously fetch and process URLs until depth is to url depth
-    while (true) {
-        pthread_mutex_lock(&pool->lock); // Acquire the thread pool lock
-
-        // Wait while the URL queue is empty
-        while (queue->head == NULL) {
-            pthread_cond_wait(&pool->task_available, &pool->lock); // Wait for task availability
-        }
-
+// Like parse_html(), but builds the DOM tree by pushing a body's chunks into a libxml2 push parser, so
+// the body never has to be copied into one contiguous buffer.
+void parse_html_chunks(URLQueue *queue, const ResponseBuffer *response, const char *base_url, int depth, ThreadPool *pool) {
+    htmlParserCtxtPtr parser = htmlCreatePushParserCtxt(NULL, NULL, NULL, 0, NULL, XML_CHAR_ENCODING_NONE);
+    if (parser == NULL) {
+        log_write(LOG_ERROR, "parse", base_url, depth, "Failed to create HTML push parser");
+        return;
+    }
+    htmlCtxtUseOptions(parser, HTML_PARSE_NOWARNING | HTML_PARSE_NOERROR | HTML_PARSE_NONET);
+    for (const BufferChunk *chunk = response->head; chunk != NULL; chunk = chunk->next) {
+        htmlParseChunk(parser, chunk->data, (int)chunk->used, 0);
+    }
+    htmlParseChunk(parser, NULL, 0, 1);
 
-        pthread_mutex_unlock(&pool->lock); // Unlock the mutex
+    htmlDocPtr document = parser->myDoc;
+    parser->myDoc = NULL;
+    htmlFreeParserCtxt(parser);
+    if (document == NULL) {
+        log_write(LOG_ERROR, "parse", base_url, depth, "Failed to parse HTML content");
+        return;
+    }
+    parse_document(document, queue, base_url, depth, pool);
+    xmlFreeDoc(document);
+}
 
-        // Dequeue the next URL to process
-        URLQueueNode *node = dequeue(queue);
+// Queue the links of a page the href scanner accepted. The first <base href> of the page, if any,
+// replaces base_url for all of its links.
+void scan_queue_links(URLQueue *queue, const HrefScanner *scanner, const char *base_url, int depth, ThreadPool *pool) {
+    atomic_fetch_add(&scan_pages, 1);
 
-        // Check if the dequeued node is NULL (indicating an empty queue)
-        if (!node) {
-            continue; // Continue to the next iteration of the loop
+    // The first <base href> sets the base URL of the whole document, including links before it
+    for (size_t i = 0; i < scanner->count; i++) {
+        if (scanner->links[i].base) {
+            base_url = resolve_base(base_url, href_scan_value(scanner, i), pool);
+            break;
         }
-
-        int curr_depth = node->depth; // Retrieve the current depth of the URL
-        if (curr_depth == depth) {
-            // If the current depth reaches the maximum depth, free resources and exit thread
-            free(node->url);
-            free(node);
-            pthread_exit(NULL);
+    }
+    for (size_t i = 0; i < scanner->count; i++) {
+        if (!scanner->links[i].base) {
+            process_href(queue, (const xmlChar *)href_scan_value(scanner, i), base_url, depth, pool);
         }
+    }
+}
 
-        // Fetch URL content using libcurl
-        struct ResponseData response;
-        response.data = NULL;
-        response.size = 0;
-
-        char *url = strdup(node->url); // Duplicate the URL string
-        char *base_url = node->base_url; // Retrieve the base 0*URL from the URLNode
+/**
+ * @brief Extract links with the vectorized href scanner, falling back to parse_html().
+ *
+ * The scanner only looks at <a> and <base> tags and never builds a tree, so on well-formed pages it is
+ * several times faster than libxml2. It gives up on the pages where it could disagree with libxml2
+ * (unterminated markup, HTML named entities, non-ASCII hrefs), and those are parsed with libxml2 as
+ * before. Links are only queued once the scan has succeeded, so a fallback never queues a link twice.
+ */
+void scan_html(URLQueue *queue, const char *html_content, const char *base_url, int depth, ThreadPool *pool) {
+    HrefScanner *scanner = &pool->workers[worker_id].scanner;
 
-        // Extract base URL from the URL if not provided
-        if (base_url == NULL && (strncmp(url, "http://", 7) == 0 || strncmp(url, "https://", 8) == 0)) {
-            base_url = extract_base_url(url);
-        }
+    if (!href_scan(scanner, html_content, strlen(html_content))) {
+        atomic_fetch_add(&scan_fallbacks, 1);
+        parse_html(queue, html_content, base_url, depth, pool);
+        return;
+    }
+    scan_queue_links(queue, scanner, base_url, depth, pool);
+}
 
-        // Initialize libcurl handle
-        CURL *curl = curl_easy_init();
-        if (!curl) {
-            // Print error message if libcurl initialization fails
-            fprintf(stderr, "Failed to initialize cURL\n");
-            free(node->url);
-            free(node);
-            continue;
+// Like scan_html(), but scans a body's chunks where they are (--zero-copy), carrying only the markup cut
+// by a chunk boundary across it, and falls back to parse_html_chunks().
+void scan_html_chunks(URLQueue *queue, const ResponseBuffer *response, const char *base_url, int depth, ThreadPool *pool) {
+    HrefScanner *scanner = &pool->workers[worker_id].scanner;
+
+    href_scan_begin(scanner);
+    for (const BufferChunk *chunk = response->head; chunk != NULL; chunk = chunk->next) {
+        if (!href_scan_feed(scanner, chunk->data, chunk->used, chunk->next == NULL)) {
+            atomic_fetch_add(&scan_fallbacks, 1);
+            parse_html_chunks(queue, response, base_url, depth, pool);
+            return;
         }
+    }
+    scan_queue_links(queue, scanner, base_url, depth, pool);
+}
 
-        // Set libcurl options for HTTP request
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, USER_AGENT); // Set user-agent header
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L); // Follow redirects
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L); // Set timeout for request
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback); // Set write callback
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&response); // Set write data
-        curl_easy_setopt(curl, CURLOPT_URL, url); // Set URL for request
-
-        // Perform HTTP request
-        CURLcode request_result = curl_easy_perform(curl);
-        if (request_result != CURLE_OK) {
-            // Print error message if HTTP request fails
-            fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(request_result));
-        } else {
-            // Check if HTML content is received
-            if (response.data == NULL || response.size == 0) {
-                // Print error message if no HTML content received
-                fprintf(stderr, "Error: No HTML content received for URL: %s\n", url);
-            } else {
-                // Print status and process received HTML content
-                printf("\nThread ID: %lu is processing URL: %s\n", pthread_self(), url);
-                printf("Parsing HTML content...\n");
-                parse_html(queue, response.data, base_url, curr_depth, pool); // Parse HTML content
+// Structure describing one transfer owned by a worker's multi handle.
+typedef struct FetchJob {
+    CURL *curl;                      // Easy handle performing the transfer
+    URLQueueNode *node;              // Queue node the transfer was started for
+    HostQueue *host;                 // Host the transfer counts against, or NULL without politeness limits
+    const char *base_url;            // Base URL used to resolve relative links on the page: its URL after
+                                     // redirects, or its <base href> (PARSE_STREAM)
+    char *document_base;             // The resolved <base href> seen by the streaming parser
+    ResponseBuffer response;         // Response body collected by write_callback
+    CURLcode result;                 // Transfer result reported by curl_multi_info_read
+    struct FetchJob *next;           // Next job in the worker's finished list
+    struct FetchJob *active_prev;    // Neighbors in the worker's list of in-flight jobs
+    struct FetchJob *active_next;
+    ThreadPool *pool;                // Pool the owning worker belongs to
+    htmlParserCtxtPtr parser;        // Push parser fed by stream_write_callback (PARSE_STREAM)
+    bool encoded;                    // The response has a Content-Encoding; its Content-Length is encoded
+    struct curl_slist *conditions;   // If-None-Match and If-Modified-Since sent for a cached page, or NULL
+    struct curl_slist *resolve;      // Addresses of the host from the DNS cache, or NULL
+    char *etag;                      // Validators of the response, stored with it in the cache
+    char *last_modified;
+    uint64_t parse_ns;               // Time spent parsing the page so far
+} FetchJob;
+
+// SAX callback of the streaming parser: hand every <a href> to process_href as soon as the tag is parsed.
+void stream_start_element(void *ctx, const xmlChar *name, const xmlChar **atts) {
+    FetchJob *job = (FetchJob *)ctx;
+    // The HTML parser reports tag and attribute names in lower case
+    if (atts == NULL) {
+        return;
+    }
+    if (xmlStrEqual(name, (const xmlChar *)"base") && job->document_base == NULL) {
+        // Links already queued were resolved against the page URL; the usual <base> in <head> comes first
+        for (int i = 0; atts[i] != NULL; i += 2) {
+            if (xmlStrEqual(atts[i], (const xmlChar *)"href") && atts[i + 1] != NULL) {
+                job->document_base = strdup(resolve_base(job->base_url, (const char *)atts[i + 1], job->pool));
+                if (job->document_base != NULL) {
+                    job->base_url = job->document_base;
+                }
+                break;
             }
         }
-
-        // Cleanup: free resources and memory
-        printf("Thread %lu: Finished processing URL: %s\n", pthread_self(), node->url);
-        free(response.data); // Free response buffer
-        free(url); // Free duplicated URL string
-        free(node->url); // Free URL stored in URLNode
-        free(node); // Free URLNode
+        return;
+    }
+    if (!xmlStrEqual(name, (const xmlChar *)"a")) {
+        return;
+    }
+    for (int i = 0; atts[i] != NULL; i += 2) {
+        if (xmlStrEqual(atts[i], (const xmlChar *)"href") && atts[i + 1] != NULL) {
+            process_href(job->pool->queue, atts[i + 1], job->base_url, job->node->depth, job->pool);
+            break;
+        }
     }
-
-    return NULL;
 }
 
+// SAX handler of the streaming parser. Only start tags are of interest, so no document tree is built.
+xmlSAXHandler stream_sax = { .startElement = stream_start_element };
 
-void thread_pool_init(ThreadPool *pool, URLQueue *queue, int depth) {
-    // Initialize the mutex lock for thread synchronization
-    pthread_mutex_init(&pool->lock, NULL);
-
-    // Initialize the condition variable for signaling task availability
-    pthread_cond_init(&pool->task_available, NULL);
+// Once the body starts arriving any redirects have been followed; the page's relative links resolve
+// against the URL it was finally fetched from.
+void job_use_effective_url(FetchJob *job) {
+    char *effective_url = NULL;
+    curl_easy_getinfo(job->curl, CURLINFO_EFFECTIVE_URL, &effective_url);
+    if (effective_url != NULL) {
+        job->base_url = effective_url;
+    }
+}
 
-    // Assign the task queue, maximum depth, and
-    pool->queue = queue;
-    pool->depth = depth;
+// Copy the value of a header line if its name is name (lower case). Returns NULL if it is not.
+char *header_value(const char *line, size_t len, const char *name) {
+    size_t name_len = strlen(name);
+    if (len <= name_len || strncasecmp(line, name, name_len) != 0 || line[name_len] != ':') {
+        return NULL;
+    }
+    const char *value = line + name_len + 1;
+    const char *end = line + len;
+    while (value < end && (*value == ' ' || *value == '\t')) {
+        value++;
+    }
+    while (end > value && (end[-1] == '\r' || end[-1] == '\n' || end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+    return strndup(value, (size_t)(end - value));
+}
 
+// libcurl header callback: note the response's encoding and, with a cache, its validators. Redirects
+// deliver several responses; each status line starts over, so the final response's headers win.
+size_t header_callback(char *buffer, size_t size, size_t nitems, void *userp) {
+    size_t len = size * nitems;
+    FetchJob *job = (FetchJob *)userp;
+    char *value;
+    if (len >= 5 && strncmp(buffer, "HTTP/", 5) == 0) {
+        job->encoded = false;
+        free(job->etag);
+        free(job->last_modified);
+        job->etag = job->last_modified = NULL;
+    } else if ((value = header_value(buffer, len, "content-encoding")) != NULL) {
+        job->encoded = strcmp(value, "identity") != 0;
+        free(value);
+    } else if (response_cache != NULL && (value = header_value(buffer, len, "etag")) != NULL) {
+        free(job->etag);
+        job->etag = value;
+    } else if (response_cache != NULL && (value = header_value(buffer, len, "last-modified")) != NULL) {
+        free(job->last_modified);
+        job->last_modified = value;
+    }
+    return len;
+}
 
-    // Create worker threads to populate the thread pool
-    for (int i = 0; i < MAX_THREADS; i++) {
-        // Create a new thread and assign the fetch_url function as its entry point
-        // Pass the ThreadPool pointer (pool) as the argument to the fetch_url function
-        pthread_create(&pool->threads[i], NULL, fetch_url, (void*) pool);
+/**
+ * @brief libcurl write callback for the buffered parse modes, and for PARSE_STREAM with --dedup: append
+ * the chunk to the job's body.
+ *
+ * The body is a chain of chunks from the worker's buffer pool, so a chunk is copied once, into free
+ * space, and nothing received earlier is moved. On the first chunk the headers are complete, so a known
+ * Content-Length sizes the body's first chunk to hold the whole page.
+ *
+ * @param contents The received bytes.
+ * @param size Always 1.
+ * @param nmemb The number of bytes received.
+ * @param userp The FetchJob the transfer belongs to.
+ * @return The number of bytes consumed, or 0 to abort the transfer.
+ */
+size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
+    size_t realsize = size * nmemb; // Calculate the total size of the received data.
+    FetchJob *job = (FetchJob *)userp;
+    BufferPool *buffers = &job->pool->workers[worker_id].buffers;
+
+    if (job->response.head == NULL) {
+        job_use_effective_url(job);
+        curl_off_t content_length = -1;
+        curl_easy_getinfo(job->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
+        if (job->encoded && content_length > 0) {
+            // The length is that of the compressed body; guess what it decodes to
+            content_length *= COMPRESSED_PRESIZE_RATIO;
+        }
+        response_init(&job->response, buffers, content_length > 0 ? (size_t)content_length : 0);
+    }
+    if (!response_append(&job->response, buffers, (const char *)contents, realsize)) {
+        log_write(LOG_ERROR, "memory", job->node->url, job->node->depth, "Failed to allocate memory for response data");
+        return 0; // Return 0 to indicate failure.
     }
+    return realsize; // Return the size of the received data.
 }
 
-// Submit a task to the thread pool
-void thread_pool_submit(ThreadPool *pool) {
-    pthread_mutex_lock(&pool->lock); // Acquire the thread pool mutex lock
+// Start a push parser for a job whose SAX callbacks receive the job (PARSE_STREAM).
+bool stream_parser_start(FetchJob *job) {
+    job->parser = htmlCreatePushParserCtxt(&stream_sax, job, NULL, 0, NULL, XML_CHAR_ENCODING_NONE);
+    if (job->parser == NULL) {
+        log_write(LOG_ERROR, "parse", job->node->url, job->node->depth, "Failed to create HTML push parser");
+        return false;
+    }
+    htmlCtxtUseOptions(job->parser, HTML_PARSE_NOWARNING | HTML_PARSE_NOERROR | HTML_PARSE_NONET);
+    return true;
+}
 
-    // Broadcast the task_available signal to wake up all waiting threads
-    pthread_cond_broadcast(&pool->task_available);
+/**
+ * @brief libcurl write callback for PARSE_STREAM: parse each chunk as it arrives.
+ *
+ * Instead of appending the chunk to a response buffer, the chunk is pushed into the job's libxml2 push
+ * parser, whose SAX callback queues the links it finds. The first links of a page are therefore queued,
+ * and parked workers woken for them, while the rest of the page is still downloading, and a page costs
+ * the parser's fixed state rather than its whole body in memory. With a response cache the body is
+ * also kept, so it can be stored once the transfer is done.
+ *
+ * @param contents The received bytes.
+ * @param size Always 1.
+ * @param nmemb The number of bytes received.
+ * @param userp The FetchJob the transfer belongs to.
+ * @return The number of bytes consumed, or 0 to abort the transfer.
+ */
+size_t stream_write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
+    size_t realsize = size * nmemb;
+    FetchJob *job = (FetchJob *)userp;
+    Worker *self = &job->pool->workers[worker_id];
+    uint64_t parse_start = now_ns();
+
+    if (job->parser == NULL) {
+        job_use_effective_url(job);
+        // The first chunk: start the push parser
+        if (!stream_parser_start(job)) {
+            return 0;
+        }
+    }
+    htmlParseChunk(job->parser, (const char *)contents, (int)realsize, 0);
+    if (response_cache != NULL) {
+        if (!response_append(&job->response, &self->buffers, (const char *)contents, realsize)) {
+            log_write(LOG_ERROR, "memory", job->node->url, job->node->depth, "Failed to allocate memory for response data");
+            return 0;
+        }
+    } else {
+        job->response.size += realsize; // Only the byte count is kept
+    }
 
-    pthread_mutex_unlock(&pool->lock); // Release the thread pool mutex lock
+    uint64_t elapsed = now_ns() - parse_start;
+    atomic_fetch_add_explicit(&self->parse_ns, elapsed, memory_order_relaxed);
+    job->parse_ns += elapsed;
+    thread_pool_submit(job->pool); // Wake workers for the links found in this chunk
+    return realsize;
 }
 
 /**
- * @brief The main function responsible for initiating the web crawler.
+ * @brief Start the transfer for a dequeued node on a worker's multi handle.
  *
- * This function serves as the entry point for the web crawler program. It parses command-line arguments,
- * initializes necessary data structures, creates a thread pool, enqueues starting URLs, and waits for
- * worker threads to complete their tasks before exiting.
+ * Takes an easy handle from the worker's handle cache, points it at the node's URL, and adds it to the
+ * multi handle so the transfer runs alongside the worker's other in-flight transfers.
  *
- * @param argc An integer representing the number of command-line arguments.
- * @param argv An array of strings containing the command-line arguments.
- * @return An integer indicating the exit status of the program.
+ * @param multi The worker's multi handle.
+ * @param cache The worker's cache of idle easy handles.
+ * @param node The dequeued node to fetch. Ownership passes to the returned job.
+ * @param pool The thread pool the worker belongs to.
+ * @return The started job, or NULL if the transfer could not be started (the node is freed).
  */
-int main(int argc, char *argv[]) {
-    // Check if the correct number of command-line arguments is provided
-    if (argc < 3) {
-        // If insufficient arguments, display usage information and exit with status 1
-        printf("Usage: %s <starting-url> <depth>\n", argv[0]);
-        return 1;
+FetchJob *fetch_job_start(CURLM *multi, HandleCache *cache, URLQueueNode *node, ThreadPool *pool) {
+    FetchJob *job = calloc(1, sizeof(FetchJob));
+    if (job == NULL) {
+        log_write(LOG_ERROR, "memory", node->url, node->depth, "Failed to allocate memory for fetch job");
+        node_free(node);
+        return NULL;
+    }
+    job->node = node;
+    job->pool = pool;
+    job->base_url = node->url; // Until a redirect moves the page, links resolve against its own URL
+    if (node->queued_ns != 0) {
+        metrics_record(&pool->workers[worker_id].metrics, STAGE_QUEUE, now_ns() - node->queued_ns);
     }
 
-    // Extract the depth from the command-line arguments
-    int depth = atoi(argv[argc - 1]);
-
-    if (depth < 0) {
-        printf("Invalid depth: Depth cannot be negative.\n");
-        return 1;
+    // Take the host's addresses from the DNS cache; a host whose name just failed to resolve is not
+    // tried again until the failure expires
+    char resolve_entry[DNS_ENTRY_MAX];
+    DnsStatus resolved = dns != NULL ? dns_lookup(dns, node->url, resolve_entry) : DNS_UNKNOWN;
+    if (resolved == DNS_FAILED) {
+        log_write(LOG_ERROR, "transfer", node->url, node->depth, "Couldn't resolve host name (cached)");
+        metrics_count(&pool->workers[worker_id].metrics, COUNTER_ERRORS, 1);
+        node_free(node);
+        free(job);
+        return NULL;
+    }
+    if (resolved == DNS_RESOLVED) {
+        job->resolve = curl_slist_append(NULL, resolve_entry);
     }
 
-    // Extract the base URL from the first command-line argument
-    char *base_url = extract_base_url(argv[1]);
+    // Reuse an idle libcurl handle, or initialize a new one
+    job->curl = handle_cache_acquire(cache);
+    if (!job->curl) {
+        // Print error message if libcurl initialization fails
+        log_write(LOG_ERROR, "curl", node->url, node->depth, "Failed to initialize cURL");
+        curl_slist_free_all(job->resolve);
+        node_free(node);
+        free(job);
+        return NULL;
+    }
 
-    // Initialize the URL queue and hash map for tracking visited URLs
-    URLQueue queue;
-    initQueue(&queue);
-    hashmap_init();
+    // Set the per-request libcurl options
+    if (parse_mode == PARSE_STREAM && content_index == NULL) {
+        // Parse chunks as they arrive instead of buffering the body. A body that may be a duplicate is
+        // buffered instead, since none of its links may be queued before it has been checked.
+        curl_easy_setopt(job->curl, CURLOPT_WRITEFUNCTION, stream_write_callback);
+        curl_easy_setopt(job->curl, CURLOPT_WRITEDATA, (void *)job);
+    } else {
+        curl_easy_setopt(job->curl, CURLOPT_WRITEFUNCTION, write_callback);
+        curl_easy_setopt(job->curl, CURLOPT_WRITEDATA, (void *)job); // Set write data
+    }
+    curl_easy_setopt(job->curl, CURLOPT_PRIVATE, (void *)job); // Map the handle back to its job on completion
+    curl_easy_setopt(job->curl, CURLOPT_URL, node->url); // Set URL for request
+    curl_easy_setopt(job->curl, CURLOPT_HEADERFUNCTION, header_callback);
+    curl_easy_setopt(job->curl, CURLOPT_HEADERDATA, (void *)job);
+    if (dns != NULL) {
+        // libcurl adds the entry to the shared DNS cache instead of resolving the name itself. Setting
+        // the option also clears a list set for the handle's previous transfer.
+        curl_easy_setopt(job->curl, CURLOPT_RESOLVE, job->resolve);
+    }
 
-    // Print status message indicating the creation of the thread pool
-    printf("Creating thread pool...\n");
+    // Ask only for a page that changed since the cached copy was fetched
+    if (response_cache != NULL) {
+        CacheValidators validators;
+        if (cache_lookup(response_cache, node->url, &validators)) {
+            char header[1024];
+            if (validators.etag != NULL && strlen(validators.etag) < sizeof(header) - 32) {
+                snprintf(header, sizeof(header), "If-None-Match: %s", validators.etag);
+                job->conditions = curl_slist_append(job->conditions, header);
+            }
+            if (validators.last_modified != NULL && strlen(validators.last_modified) < sizeof(header) - 32) {
+                snprintf(header, sizeof(header), "If-Modified-Since: %s", validators.last_modified);
+                job->conditions = curl_slist_append(job->conditions, header);
+            }
+            cache_validators_free(&validators);
+        }
+        // Also clears a list set for the handle's previous transfer
+        curl_easy_setopt(job->curl, CURLOPT_HTTPHEADER, job->conditions);
+    }
 
-    // Initialize the thread pool with the specified depth and associated URL queue
-    ThreadPool pool;
-    thread_pool_init(&pool, &queue, depth);
+    // Hand the transfer to the multi handle; it starts on the next curl_multi_perform()
+    CURLMcode add_result = curl_multi_add_handle(multi, job->curl);
+    if (add_result != CURLM_OK) {
+        log_write(LOG_ERROR, "curl", node->url, node->depth, "curl_multi_add_handle() failed: %s",
+                  curl_multi_strerror(add_result));
+        handle_cache_release(cache, job->curl);
+        curl_slist_free_all(job->conditions);
+        curl_slist_free_all(job->resolve);
+        node_free(node);
+        free(job);
+        return NULL;
+    }
+    return job;
+}
 
-    // Add tasks to the thread pool for processing
-    for (int i = 0; i < MAX_THREADS; i++) {
-        thread_pool_submit(&pool);
+// Add a started job to the worker's list of in-flight jobs.
+void job_link(Worker *self, FetchJob *job) {
+    job->active_prev = NULL;
+    job->active_next = self->active;
+    if (self->active != NULL) {
+        self->active->active_prev = job;
     }
+    self->active = job;
+}
 
-    // Enqueue the provided starting URL with depth 0
-    enqueue(&queue, argv[1], base_url, 0, &pool);
+// Remove a job whose transfer has finished from the worker's list of in-flight jobs.
+void job_unlink(Worker *self, FetchJob *job) {
+    if (job->active_prev != NULL) {
+        job->active_prev->active_next = job->active_next;
+    } else {
+        self->active = job->active_next;
+    }
+    if (job->active_next != NULL) {
+        job->active_next->active_prev = job->active_prev;
+    }
+}
 
-    // Print status message indicating the creation of the thread pool
-    printf("Thread pool created with %d threads.\n\n", MAX_THREADS);
+// Nanoseconds between two of libcurl's timestamps (microseconds since the transfer started), or 0 if
+// the later one is missing.
+uint64_t curl_span_ns(curl_off_t from_us, curl_off_t to_us) {
+    return to_us > from_us ? (uint64_t)(to_us - from_us) * 1000 : 0;
+}
 
-    // Wait for all worker threads to complete their tasks before exiting
-    for (int i = 0; i < MAX_THREADS; i++) {
-        pthread_join(pool.threads[i], NULL);
+// Record the stages of a finished transfer from libcurl's timestamps. The name lookup, connect and TLS
+// stages are only recorded for transfers that opened a new connection.
+void record_transfer_times(MetricsShard *metrics, CURL *curl, long num_connects) {
+    curl_off_t lookup_us = 0, connect_us = 0, tls_us = 0, pretransfer_us = 0, first_byte_us = 0, total_us = 0;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &lookup_us);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect_us);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls_us);
+    curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer_us);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &first_byte_us);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total_us);
+    if (num_connects > 0) {
+        metrics_record(metrics, STAGE_DNS, curl_span_ns(0, lookup_us));
+        metrics_record(metrics, STAGE_CONNECT, curl_span_ns(lookup_us, connect_us));
+        if (tls_us > 0) {
+            metrics_record(metrics, STAGE_TLS, curl_span_ns(connect_us, tls_us));
+        }
     }
+    metrics_record(metrics, STAGE_FIRST_BYTE, curl_span_ns(pretransfer_us, first_byte_us));
+    metrics_record(metrics, STAGE_TRANSFER, curl_span_ns(first_byte_us, total_us));
+}
 
-    // Print status message indicating the completion of all threads
-    printf("All threads have completed.\n");
+/**
+ * @brief Parse stage: process the transfers a worker's event loop has finished.
+ *
+ * Parsing is kept out of the event loop itself so that the multi handle only ever moves bytes; the
+ * finished list is handed over here, in completion order, once the loop has collected it.
+ *
+ * @param finished The head of the finished list. Every job in the list is freed.
+ * @param cache The worker's cache of idle easy handles that finished handles are returned to.
+ * @param queue The URL queue that extracted links are added to.
+ * @param pool The thread pool the worker belongs to.
+ */
+void parse_stage(FetchJob *finished, HandleCache *cache, URLQueue *queue, ThreadPool *pool) {
+    while (finished != NULL) {
+        FetchJob *job = finished;
+        finished = job->next;
+        const char *url = job->node->url;
+        Worker *self = &pool->workers[worker_id];
+
+        // Record how long the transfer took, for the adaptive controller
+        curl_off_t total_us = 0;
+        curl_easy_getinfo(job->curl, CURLINFO_TOTAL_TIME_T, &total_us);
+        atomic_fetch_add_explicit(&self->fetches, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&self->fetch_us, (unsigned long)total_us, memory_order_relaxed);
+        metrics_record(&self->metrics, STAGE_FETCH, curl_span_ns(0, total_us));
+
+        // Count whether the transfer needed new connections or ran on one left open by an earlier fetch
+        long num_connects = 0;
+        curl_easy_getinfo(job->curl, CURLINFO_NUM_CONNECTS, &num_connects);
+        if (num_connects > 0) {
+            atomic_fetch_add(&connections_opened, (unsigned long)num_connects);
+        } else if (job->result == CURLE_OK) {
+            atomic_fetch_add(&connections_reused, 1);
+        }
 
-    // Cleanup and program termination.
+        // Count the bytes that crossed the network against the bytes they decoded to
+        curl_off_t body_bytes = 0;
+        long header_bytes = 0;
+        curl_easy_getinfo(job->curl, CURLINFO_SIZE_DOWNLOAD_T, &body_bytes);
+        curl_easy_getinfo(job->curl, CURLINFO_HEADER_SIZE, &header_bytes);
+        atomic_fetch_add_explicit(&bytes_received, (unsigned long)body_bytes + (unsigned long)header_bytes,
+                                  memory_order_relaxed);
+        atomic_fetch_add_explicit(&bytes_decoded, job->response.size, memory_order_relaxed);
+        metrics_count(&self->metrics, COUNTER_BYTES, (unsigned long)body_bytes + (unsigned long)header_bytes);
+
+        long status = 0;
+        curl_easy_getinfo(job->curl, CURLINFO_RESPONSE_CODE, &status);
+        if (job->result == CURLE_OK) {
+            metrics_count(&self->metrics, COUNTER_PAGES, 1);
+            record_transfer_times(&self->metrics, job->curl, num_connects);
+            if (status >= 200 && status < 600) {
+                metrics_count(&self->metrics, COUNTER_STATUS_2XX + (int)(status / 100 - 2), 1);
+            }
+        } else {
+            metrics_count(&self->metrics, COUNTER_ERRORS, 1);
+        }
+        if (job->result == CURLE_OK && status == 304 && job->conditions != NULL) {
+            // Not modified: parse the cached copy as if it had just been downloaded
+            atomic_fetch_add(&not_modified, 1);
+            job_use_effective_url(job);
+            response_release(&job->response, &self->buffers);
+            if (!cache_load(response_cache, job->node->url, &job->response, &self->buffers)) {
+                log_write(LOG_WARN, "cache", url, job->node->depth, "Cached copy is missing or damaged");
+                response_release(&job->response, &self->buffers);
+            }
+        } else if (job->result == CURLE_OK && status == 200 && response_cache != NULL &&
+                   (job->etag != NULL || job->last_modified != NULL) && job->response.size > 0) {
+            // Keep the page for the next crawl's conditional request
+            cache_store(response_cache, job->node->url, job->etag, job->last_modified, &job->response);
+        }
+
+        // Skip pages whose body was already parsed under another URL, along with all their links
+        ContentVerdict verdict = CONTENT_UNIQUE;
+        if (content_index != NULL && job->result == CURLE_OK && job->response.size > 0) {
+            uint64_t check_start = now_ns();
+            verdict = dedup_check(content_index, &job->response);
+            atomic_fetch_add_explicit(&self->parse_ns, now_ns() - check_start, memory_order_relaxed);
+        }
+
+        if (job->result != CURLE_OK) {
+            // Print error message if HTTP request fails
+            log_write(LOG_ERROR, "transfer", url, job->node->depth, "%s", curl_easy_strerror(job->result));
+        } else if (job->response.size == 0) {
+            // Print error message if no HTML content received
+            log_write(LOG_WARN, "empty", url, job->node->depth, "No HTML content received (status %ld)", status);
+        } else if (verdict != CONTENT_UNIQUE) {
+            log_write(LOG_INFO, verdict == CONTENT_DUPLICATE ? "duplicate" : "near-duplicate", url, job->node->depth,
+                      "Skipped; the same content was already crawled");
+        } else if (parse_mode == PARSE_STREAM) {
+            // The links were queued while the page downloaded; flush whatever the parser still holds
+            log_write(LOG_INFO, "page", url, job->node->depth, "%zu bytes", job->response.size);
+            uint64_t parse_start = now_ns();
+            if (job->parser == NULL && stream_parser_start(job)) {
+                // The body was read from the cache or held back for the duplicate check; parse it now
+                for (BufferChunk *chunk = job->response.head; chunk != NULL; chunk = chunk->next) {
+                    htmlParseChunk(job->parser, chunk->data, (int)chunk->used, 0);
+                }
+            }
+            if (job->parser != NULL) {
+                htmlParseChunk(job->parser, NULL, 0, 1);
+            }
+            uint64_t elapsed = now_ns() - parse_start;
+            atomic_fetch_add_explicit(&self->parse_ns, elapsed, memory_order_relaxed);
+            metrics_record(&self->metrics, STAGE_PARSE, job->parse_ns + elapsed); // Including the chunks parsed earlier
+            thread_pool_submit(pool);
+        } else {
+            // Print status and process received HTML content
+            log_write(LOG_INFO, "page", url, job->node->depth, "%zu bytes", job->response.size);
+            uint64_t parse_start = now_ns();
+            if (zero_copy && job->response.head->next != NULL) {
+                // Several chunks: scan them, or let libxml2 take them, one at a time rather than joining them
+                if (parse_mode == PARSE_SCAN) {
+                    scan_html_chunks(queue, &job->response, job->base_url, job->node->depth, pool);
+                } else {
+                    parse_html_chunks(queue, &job->response, job->base_url, job->node->depth, pool);
+                }
+            } else {
+                const char *html_content = response_contiguous(&job->response, &self->buffers);
+                if (html_content == NULL) {
+                    log_write(LOG_ERROR, "memory", url, job->node->depth, "Failed to allocate memory for response data");
+                } else if (parse_mode == PARSE_SCAN) {
+                    scan_html(queue, html_content, job->base_url, job->node->depth, pool);
+                } else {
+                    parse_html(queue, html_content, job->base_url, job->node->depth, pool); // Parse HTML content
+                }
+            }
+            uint64_t elapsed = now_ns() - parse_start;
+            atomic_fetch_add_explicit(&self->parse_ns, elapsed, memory_order_relaxed);
+            metrics_record(&self->metrics, STAGE_PARSE, elapsed);
+            thread_pool_submit(pool); // Submit the page's links to the thread pool
+        }
+
+        // Cleanup: free resources and memory
+        log_write(LOG_DEBUG, "done", url, job->node->depth, NULL);
+        handle_cache_release(cache, job->curl); // Keep the handle, and its connection, for the next fetch
+        if (job->parser != NULL) {
+            htmlFreeParserCtxt(job->parser);
+        }
+        free(job->document_base);
+        curl_slist_free_all(job->conditions);
+        curl_slist_free_all(job->resolve);
+        free(job->etag);
+        free(job->last_modified);
+        response_release(&job->response, &self->buffers); // Give the body's chunks back to the pool
+        arena_reset(&self->scratch); // Nothing built while parsing the page outlives it
+        node_free(job->node); // Free URLNode and its strings
+        free(job);
+        work_done(pool); // The page's links are queued; this may end the crawl
+    }
+}
+
+// End a stretch in which a worker held back new transfers for the frontier budget, and count it.
+void worker_unblock(Worker *self, uint64_t *blocked_since) {
+    uint64_t blocked = now_ns() - *blocked_since;
+    budget_blocked(budget, blocked);
+    metrics_record(&self->metrics, STAGE_BACKPRESSURE, blocked);
+    *blocked_since = 0;
+}
+
+// Function to fetch and process URLs
+/**
+ * @brief Function executed by worker threads to fetch and process URLs.
+ *
+ * Each worker owns a libcurl multi handle and runs an event loop over it. On every iteration it tops
+ * the multi handle up to MAX_INFLIGHT transfers from the URL queue, drives all of them with
+ * curl_multi_perform(), collects the finished ones with curl_multi_info_read(), and hands those to
+ * parse_stage(). When nothing has finished it sleeps in curl_multi_poll() until a socket is ready.
+ * Crawl throughput is therefore bounded by the number of transfers in flight rather than by one
+ * round trip per worker; while a block-policy frontier budget is full that number drops to one, which
+ * is how the budget holds back the discovery of new links. Easy handles are kept in a per-worker cache and reused, so consecutive fetches
+ * from the same host run over the connection the previous fetch left open. Links the worker discovers
+ * go onto its own deque; when it has nothing in flight and no queue has work, it parks until woken.
+ * Every worker keeps fetching until no URL is queued or being processed anywhere in the pool (see
+ * work_done()); links beyond the depth limit are never queued. The worker records the time it spends
+ * parsing and waiting so the adaptive controller can tell CPU-bound workers from ones waiting on the
+ * network, and exits early if the controller retires it.
+ *
+ * @param arg A pointer to the Worker structure naming the pool and the worker's index.
+ * @return NULL upon completion of the task.
+ */
+void *fetch_url(void *arg) {
+    Worker *self = (Worker*)arg; // Cast the argument to Worker pointer
+    ThreadPool *pool = self->pool; // Retrieve the ThreadPool the worker belongs to
+    worker_id = self->id; // Make the worker's index visible to enqueue() and dequeue()
+    URLQueue *queue = pool->queue; // Retrieve URL queue from ThreadPool
+
+    // Create the multi handle that drives all of this worker's transfers
+    CURLM *multi = curl_multi_init();
+    if (!multi) {
+        log_write(LOG_ERROR, "curl", NULL, -1, "Failed to initialize cURL multi handle");
+        thread_pool_worker_exit(pool, self);
+        return NULL;
+    }
+
+    // Let the multi handle keep an open connection for every transfer slot
+    curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long)MAX_INFLIGHT);
+
+    HandleCache cache = { .count = 0 }; // Idle easy handles kept for reuse by this worker
+    int inflight = 0; // Number of transfers currently added to the multi handle
+    bool draining = false; // Set once the worker is retired; no new transfers are started
+    uint64_t admit_after = 0; // With the host queues, when the frontier may be looked at again
+    uint64_t blocked_since = 0; // While the frontier budget holds new transfers back, since when
+
+    // Main loop to continuously fetch and process URLs until the crawl is over
+    while (true) {
+        // Safe point: every node this worker holds is either queued or in self->active
+        if (atomic_load_explicit(&pool->checkpoint_requested, memory_order_relaxed)) {
+            thread_pool_pause(pool);
+        }
+
+        if (!draining && atomic_load_explicit(&self->retire, memory_order_relaxed)) {
+            draining = true; // The adaptive controller is shrinking the pool
+        }
+
+        uint64_t next_ready = UINT64_MAX; // Earliest time a host held back by its limits may be fetched
+        if (!draining) {
+            if (pool->hosts != NULL && now_ns() >= admit_after) {
+                // Sort new work into the per-host queues; the transfers below are started from those. A host
+                // whose queue is full keeps the rest of its URLs as a backlog that does not hold up other
+                // hosts; when the frontier spills, only while the host queues hold fewer than
+                // HOST_QUEUE_LIMIT URLs in all, and the rest are left on disk. A URL whose host's
+                // robots.txt is still being fetched is parked by the robots cache until it is
+                int admitted = 0, spilled = 0;
+                while (host_sched_window(pool->hosts) < HOST_QUEUE_LIMIT && spilled < HOST_SPILL_BATCH &&
+                       (robots == NULL || robots_parked(robots) < HOST_QUEUE_LIMIT)) {
+                    URLQueueNode *node = dequeue(pool);
+                    if (!node) {
+                        break; // The queue is empty for now
+                    }
+                    RobotsVerdict verdict = robots != NULL ? robots_admit(robots, node) : ROBOTS_ALLOWED;
+                    if (verdict == ROBOTS_PARKED) {
+                        continue; // robots_release() queues it again
+                    }
+                    if (verdict == ROBOTS_DISALLOWED) {
+                        robots_drop(pool, node);
+                        continue;
+                    }
+                    bool backlog = !pool->queue->spilling || host_sched_size(pool->hosts) < HOST_QUEUE_LIMIT;
+                    if (host_sched_push(pool->hosts, node, now_ns(), backlog)) {
+                        admitted++;
+                    } else {
+                        frontier_push_overflow(pool->queue, node);
+                        spilled++;
+                    }
+                }
+                atomic_fetch_add_explicit(&pool->hosts->spilled, (unsigned long)spilled, memory_order_relaxed);
+                if (spilled == HOST_SPILL_BATCH) {
+                    // The frontier is mostly URLs of full hosts; give them time to drain
+                    admit_after = now_ns() + POLL_TIMEOUT_MS * 1000000ull;
+                }
+                // Parked workers do not look at the host queues, so wake them for what was moved there
+                sched_notify(&pool->scheduler, admitted);
+            }
+
+            // The fetches are what find new links, so under the block policy a full frontier budget holds
+            // them back: the worker keeps driving the transfers it has and starts one only when it has none
+            int limit = MAX_INFLIGHT;
+            if (budget != NULL && budget->policy == BUDGET_BLOCK && budget_full(budget)) {
+                limit = 1;
+                if (blocked_since == 0) {
+                    blocked_since = now_ns();
+                    metrics_count(&self->metrics, COUNTER_BUDGET_BLOCKED, 1);
+                }
+            } else if (blocked_since != 0) {
+                worker_unblock(self, &blocked_since);
+            }
+
+            // Top the multi handle up with new transfers
+            while (inflight < limit) {
+                URLQueueNode *node;
+                HostQueue *host = NULL;
+                if (pool->hosts != NULL) {
+                    // Only hosts under their rate and connection limits hand out URLs
+                    node = host_sched_pop(pool->hosts, worker_id, now_ns(), &host, &next_ready);
+                } else {
+                    node = dequeue(pool);
+                }
+                if (!node) {
+                    break; // The queue is empty for now
+                }
+
+                FetchJob *job = fetch_job_start(multi, &cache, node, pool);
+                if (job != NULL) {
+                    job->host = host;
+                    job_link(self, job);
+                    inflight++;
+                } else {
+                    // The node has been freed
+                    if (host != NULL) {
+                        host_sched_done(pool->hosts, host, now_ns());
+                    }
+                    work_done(pool);
+                }
+            }
+
+            if (inflight == 0) {
+                if (atomic_load(&pool->scheduler.closed)) {
+                    break; // Every URL has been fetched and parsed: the crawl is over
+                }
+                uint64_t wait_start = now_ns();
+                if (pool->hosts != NULL && host_sched_size(pool->hosts) > 0) {
+                    // URLs are waiting on their hosts' limits: sleep until the first may go, or until
+                    // the next poll interval if their hosts are busy with transfers of other workers
+                    uint64_t wait = POLL_TIMEOUT_MS * 1000000ull;
+                    if (next_ready != UINT64_MAX && next_ready - wait_start < wait) {
+                        wait = next_ready > wait_start ? next_ready - wait_start : 0;
+                    }
+                    struct timespec pause = { (time_t)(wait / 1000000000ull), (long)(wait % 1000000000ull) };
+                    nanosleep(&pause, NULL);
+                } else {
+                    // Park while no queue has work and there is nothing in flight
+                    sched_park(&pool->scheduler, worker_id);
+                }
+                uint64_t waited = now_ns() - wait_start;
+                atomic_fetch_add_explicit(&self->wait_ns, waited, memory_order_relaxed);
+                metrics_record(&self->metrics, STAGE_PARK, waited);
+                continue;
+            }
+        }
+
+        atomic_store_explicit(&self->inflight, inflight, memory_order_relaxed);
+
+        if (inflight == 0) {
+            break; // Retired, and everything in flight has been processed
+        }
+
+        // Drive every transfer on the multi handle as far as it can go without blocking
+        int running = 0;
+        CURLMcode perform_result = curl_multi_perform(multi, &running);
+        if (perform_result != CURLM_OK) {
+            log_write(LOG_ERROR, "curl", NULL, -1, "curl_multi_perform() failed: %s", curl_multi_strerror(perform_result));
+        }
+
+        // Collect the transfers that have completed, keeping them in completion order
+        FetchJob *finished = NULL, **finished_tail = &finished;
+        CURLMsg *msg;
+        int msgs_left;
+        while ((msg = curl_multi_info_read(multi, &msgs_left)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            FetchJob *job = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&job);
+            job->result = msg->data.result; // msg is invalid once the handle is removed
+            curl_multi_remove_handle(multi, job->curl);
+            if (job->host != NULL) {
+                // The host may take its next fetch while this page is parsed
+                host_sched_done(pool->hosts, job->host, now_ns());
+            }
+            job_unlink(self, job);
+            inflight--;
+            job->next = NULL;
+            *finished_tail = job;
+            finished_tail = &job->next;
+        }
+
+        if (finished != NULL) {
+            parse_stage(finished, &cache, queue, pool);
+        } else {
+            // Nothing finished: sleep until a socket is ready, but wake up regularly to pick up new work,
+            // and in time for the next host that becomes ready
+            uint64_t wait_start = now_ns();
+            int timeout_ms = POLL_TIMEOUT_MS;
+            if (next_ready != UINT64_MAX) {
+                uint64_t until_ready_ms = next_ready > wait_start ? (next_ready - wait_start) / 1000000 + 1 : 0;
+                if (until_ready_ms < (uint64_t)timeout_ms) {
+                    timeout_ms = (int)until_ready_ms;
+                }
+            }
+            curl_multi_poll(multi, NULL, 0, timeout_ms, NULL);
+            atomic_fetch_add_explicit(&self->wait_ns, now_ns() - wait_start, memory_order_relaxed);
+        }
+    }
+
+    if (blocked_since != 0) {
+        worker_unblock(self, &blocked_since);
+    }
+    curl_multi_cleanup(multi);
+    handle_cache_cleanup(&cache);
+    href_scanner_destroy(&self->scanner);
+    bufpool_destroy(&self->buffers);
+    arena_destroy(&self->scratch);
+    node_pool_flush();
+    atomic_store_explicit(&self->inflight, 0, memory_order_relaxed);
+    thread_pool_worker_exit(pool, self);
+    return NULL;
+}
+
+
+// Start a worker thread in a free slot. Must be called with pool->lock held.
+void thread_pool_start_worker(ThreadPool *pool, Worker *worker) {
+    // Reap the thread that previously ran in this slot
+    if (worker->joinable) {
+        pthread_join(worker->thread, NULL);
+        worker->joinable = false;
+    }
+
+    atomic_store(&worker->retire, false);
+    atomic_store(&worker->running, true);
+    // Create a new thread and assign the fetch_url function as its entry point
+    // Pass the worker slot as the argument to the fetch_url function
+    if (pthread_create(&worker->thread, NULL, fetch_url, (void*) worker) != 0) {
+        log_write(LOG_ERROR, "pool", NULL, -1, "Failed to create worker thread %d", worker->id);
+        atomic_store(&worker->running, false);
+        return;
+    }
+    worker->joinable = true;
+    pool->live++;
+}
+
+// Called by a worker thread as it exits.
+void thread_pool_worker_exit(ThreadPool *pool, Worker *self) {
+    pthread_mutex_lock(&pool->lock);
+    atomic_store(&self->running, false);
+    pool->live--;
+    if (pool->live == 0) {
+        pthread_cond_broadcast(&pool->all_exited);
+    }
+    pthread_cond_broadcast(&pool->paused_cond); // A pending checkpoint waits for one fewer worker
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Called by a worker at its safe point while a checkpoint is requested; returns once it has been taken.
+void thread_pool_pause(ThreadPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->paused++;
+    pthread_cond_broadcast(&pool->paused_cond);
+    while (atomic_load(&pool->checkpoint_requested)) {
+        pthread_cond_wait(&pool->paused_cond, &pool->lock);
+    }
+    pool->paused--;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Take one checkpoint of the crawl.
+ *
+ * Every live worker is stopped at its safe point, where each node it holds is either queued or on its
+ * list of in-flight jobs. The process then forks: the child gets a copy-on-write image of the visited
+ * set and the queues as they are at that instant and writes the checkpoint from it, while the workers
+ * resume as soon as the fork returns. The pause therefore lasts as long as fork() takes, not as long as
+ * writing the file.
+ *
+ * @param pool A pointer to the ThreadPool structure.
+ * @return true if the checkpoint was written.
+ */
+bool thread_pool_checkpoint(ThreadPool *pool) {
+    uint64_t start = now_ns();
+    // A dump takes the visited set's shard locks among others, so keep the metrics thread out of them
+    // until the fork; taken before the pool lock, which a dump also takes
+    pthread_mutex_lock(&pool->metrics_lock);
+    pthread_mutex_lock(&pool->lock);
+    atomic_store(&pool->checkpoint_requested, true);
+    while (pool->paused < pool->live) {
+        // A worker that parked just before the request can miss one wake-up, so keep waking them
+        sched_wake_all(&pool->scheduler);
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += POLL_TIMEOUT_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&pool->paused_cond, &pool->lock, &deadline);
+    }
+    uint64_t paused_at = now_ns();
+
+    // The nodes being fetched, and those in the host queues or parked by the robots cache, are not in the
+    // scheduler's queues; collect them for the child. The robots cache stays paused until the fork, so
+    // that its fetcher threads do not release parked nodes meanwhile
+    if (robots != NULL) {
+        robots_pause(robots);
+    }
+    size_t inflight_count = pool->hosts != NULL ? host_sched_size(pool->hosts) : 0;
+    inflight_count += robots != NULL ? robots_parked(robots) : 0;
+    for (int i = 0; i < pool->max_threads; i++) {
+        for (FetchJob *job = pool->workers[i].active; job != NULL; job = job->active_next) {
+            inflight_count++;
+        }
+    }
+    URLQueueNode **inflight = malloc((inflight_count + 1) * sizeof(URLQueueNode *));
+    inflight_count = 0;
+    if (inflight != NULL && pool->hosts != NULL) {
+        inflight_count = host_sched_collect(pool->hosts, inflight);
+    }
+    if (inflight != NULL && robots != NULL) {
+        inflight_count += robots_collect(robots, inflight + inflight_count);
+    }
+    for (int i = 0; inflight != NULL && i < pool->max_threads; i++) {
+        for (FetchJob *job = pool->workers[i].active; job != NULL; job = job->active_next) {
+            inflight[inflight_count++] = job->node;
+        }
+    }
+
+    // Segment files keep changing after the fork, so note which bytes of which files hold the queue now
+    SpillSnapshot spill;
+    bool spill_ok = !pool->queue->spilling || spill_snapshot(&pool->queue->spill, &spill);
+
+    pid_t child = -1;
+    if (inflight != NULL && spill_ok) {
+        child = fork();
+    }
+    if (child == 0) {
+        // Only this thread exists in the child, and every other thread was stopped outside the locks the
+        // writer takes (the workers at their safe point, the robots fetchers by robots_pause(), the
+        // metrics thread by metrics_lock), so it can read the shared structures without synchronization
+        bool ok = checkpoint_write(pool->checkpoint_path, pool->depth, &visited, &pool->scheduler,
+                                   pool->queue->spilling ? &spill : NULL, inflight, inflight_count);
+        _exit(ok ? 0 : 1);
+    }
+
+    // Let the workers go
+    if (robots != NULL) {
+        robots_resume(robots);
+    }
+    atomic_store(&pool->checkpoint_requested, false);
+    pthread_cond_broadcast(&pool->paused_cond);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->metrics_lock);
+    uint64_t resumed_at = now_ns();
+
+    free(inflight);
+    if (pool->queue->spilling && spill_ok) {
+        spill_snapshot_release(&spill);
+    }
+    if (child < 0) {
+        log_write(LOG_ERROR, "checkpoint", NULL, -1, "Failed to start the checkpoint writer");
+        return false;
+    }
+    int status;
+    if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        log_write(LOG_ERROR, "checkpoint", NULL, -1, "Failed to write checkpoint %s", pool->checkpoint_path);
+        return false;
+    }
+    pool->checkpoints++;
+    log_write(LOG_INFO, "checkpoint", NULL, -1, "Written to %s in %.1f ms (workers paused for %.2f ms)",
+              pool->checkpoint_path, (now_ns() - start) / 1e6, (resumed_at - paused_at) / 1e6);
+    return true;
+}
+
+// Checkpoint thread: writes a checkpoint every checkpoint_interval seconds until the crawl is over.
+void *checkpoint_loop(void *arg) {
+    ThreadPool *pool = (ThreadPool*)arg;
+    while (true) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += pool->checkpoint_interval;
+
+        // all_exited doubles as the signal that the crawl ended before the interval did
+        pthread_mutex_lock(&pool->lock);
+        while (pool->live > 0 && pthread_cond_timedwait(&pool->all_exited, &pool->lock, &deadline) == 0) {
+        }
+        bool done = pool->live == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (done) {
+            break;
+        }
+        thread_pool_checkpoint(pool);
+    }
+    return NULL;
+}
+
+// Start writing a checkpoint to path every interval seconds.
+void thread_pool_start_checkpoints(ThreadPool *pool, const char *path, int interval) {
+    pool->checkpoint_path = path;
+    pool->checkpoint_interval = interval;
+    pthread_create(&pool->checkpointer, NULL, checkpoint_loop, (void*) pool);
+}
+
+// Sum the workers' metrics and write them, with the current queue and pool sizes, to out.
+void metrics_dump(ThreadPool *pool, FILE *out) {
+    MetricsShard *total = malloc(sizeof(MetricsShard));
+    if (total == NULL) {
+        log_write(LOG_ERROR, "memory", NULL, -1, "Failed to allocate memory for the metrics");
+        return;
+    }
+    pthread_mutex_lock(&pool->metrics_lock); // Not while a checkpoint is about to fork
+    metrics_init(total);
+    int inflight = 0;
+    for (int i = 0; i < pool->max_threads; i++) {
+        metrics_merge(total, &pool->workers[i].metrics);
+        inflight += atomic_load_explicit(&pool->workers[i].inflight, memory_order_relaxed);
+    }
+    pthread_mutex_lock(&pool->lock);
+    int live = pool->live;
+    pthread_mutex_unlock(&pool->lock);
+
+    MetricGauge gauges[9] = {
+        { "queued_urls", "URLs waiting to be fetched.",
+          (double)(sched_size(&pool->scheduler) + (pool->hosts != NULL ? host_sched_size(pool->hosts) : 0)) },
+        { "outstanding_urls", "URLs queued or being fetched and parsed.",
+          (double)atomic_load_explicit(&pool->outstanding, memory_order_relaxed) },
+        { "inflight_transfers", "Transfers on the workers' multi handles.", (double)inflight },
+        { "worker_threads", "Worker threads alive.", (double)live },
+        { "visited_urls", "URLs in the visited set.", (double)visited_size(&visited) },
+        { "uptime_seconds", "Time since the crawl started.", (now_ns() - pool->started_ns) / 1e9 },
+    };
+    int gauge_count = 6;
+    if (budget != NULL) {
+        gauges[gauge_count++] = (MetricGauge){ "budget_urls", "Queue nodes charged to the frontier budget.",
+                                               (double)atomic_load_explicit(&budget->urls, memory_order_relaxed) };
+        gauges[gauge_count++] = (MetricGauge){ "budget_bytes", "Bytes charged to the frontier budget.",
+                                               (double)atomic_load_explicit(&budget->bytes, memory_order_relaxed) };
+        gauges[gauge_count++] = (MetricGauge){ "budget_fill", "Fill of the frontier budget (1 is full).",
+                                               budget_fill(budget) };
+    }
+    pthread_mutex_unlock(&pool->metrics_lock);
+    metrics_write_prometheus(out, total, gauges, gauge_count);
+    free(total);
+}
+
+// Dump the metrics to the metrics file through a temporary file, so a reader never sees half a dump.
+void metrics_dump_file(ThreadPool *pool) {
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", pool->metrics_path);
+    FILE *out = fopen(tmp_path, "w");
+    if (out == NULL) {
+        log_write(LOG_ERROR, "metrics", NULL, -1, "Failed to open %s", tmp_path);
+        return;
+    }
+    metrics_dump(pool, out);
+    if (fclose(out) != 0 || rename(tmp_path, pool->metrics_path) != 0) {
+        log_write(LOG_ERROR, "metrics", NULL, -1, "Failed to write %s", pool->metrics_path);
+        unlink(tmp_path);
+    }
+}
+
+// Serve one dump to a client of the metrics socket, then close the connection.
+void metrics_serve(ThreadPool *pool) {
+    int client = accept(pool->metrics_listener, NULL, NULL);
+    if (client < 0) {
+        return;
+    }
+    FILE *out = fdopen(client, "w");
+    if (out == NULL) {
+        close(client);
+        return;
+    }
+    metrics_dump(pool, out);
+    fclose(out);
+}
+
+/**
+ * @brief Metrics thread: dumps the metrics until the crawl is over.
+ *
+ * With a metrics file the thread writes a dump every metrics_interval seconds, whenever SIGUSR1 asks for
+ * one, and once more after the last worker has exited. With a metrics socket it writes a dump to every
+ * client that connects. Either way it wakes every METRICS_POLL_MS, so the workers never wait for it.
+ *
+ * @param arg A pointer to the ThreadPool structure.
+ * @return NULL once every worker has exited.
+ */
+void *metrics_loop(void *arg) {
+    ThreadPool *pool = (ThreadPool*)arg;
+    uint64_t next_dump = now_ns() + (uint64_t)pool->metrics_interval * 1000000000ull;
+    while (true) {
+        if (pool->metrics_listener >= 0) {
+            struct pollfd listener = { .fd = pool->metrics_listener, .events = POLLIN };
+            if (poll(&listener, 1, METRICS_POLL_MS) > 0) {
+                metrics_serve(pool);
+            }
+        } else {
+            struct timespec pause = { 0, METRICS_POLL_MS * 1000000L };
+            nanosleep(&pause, NULL);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        bool done = pool->live == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (pool->metrics_path != NULL) {
+            bool requested = atomic_exchange(&metrics_requested, false);
+            if (done || requested || now_ns() >= next_dump) {
+                metrics_dump_file(pool); // After the last worker exited, this is the final dump
+                next_dump = now_ns() + (uint64_t)pool->metrics_interval * 1000000000ull;
+            }
+        }
+        if (done) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Start dumping the metrics to path every interval seconds, or serving them on listener (if >= 0).
+void thread_pool_start_metrics(ThreadPool *pool, const char *path, int listener, int interval) {
+    pool->metrics_path = path;
+    pool->metrics_listener = listener;
+    pool->metrics_interval = interval;
+    pthread_create(&pool->metrics_thread, NULL, metrics_loop, (void*) pool);
+}
+
+// Create a Unix socket listening at path, replacing a stale socket left there. Returns -1 on failure.
+int metrics_listen(const char *path) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Metrics socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(path);
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 16) != 0) {
+        perror(path);
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+/**
+ * @brief Adaptive controller: grows or shrinks the pool once per ADAPT_INTERVAL_MS.
+ *
+ * Each worker splits its time between parsing (CPU) and waiting on sockets or for work (network).
+ * The pool grows when there is queued work and either the workers are mostly parsing, so another
+ * thread would add CPU, or every transfer slot is taken, so another thread would add transfers in
+ * flight to hide fetch latency. It shrinks when the workers are mostly waiting and one fewer worker
+ * could still carry every queued and in-flight transfer at half its capacity.
+ *
+ * @param arg A pointer to the ThreadPool structure.
+ * @return NULL once every worker has exited.
+ */
+void *adaptive_controller(void *arg) {
+    ThreadPool *pool = (ThreadPool*)arg;
+    struct timespec interval = { ADAPT_INTERVAL_MS / 1000, (ADAPT_INTERVAL_MS % 1000) * 1000000L };
+    uint64_t last_time = now_ns();
+    unsigned long last_parse_ns = 0, last_fetches = 0, last_fetch_us = 0;
+
+    while (true) {
+        nanosleep(&interval, NULL);
+
+        pthread_mutex_lock(&pool->lock);
+        if (pool->live == 0) {
+            pthread_mutex_unlock(&pool->lock);
+            break; // The crawl is over
+        }
+
+        // Sum the worker counters; they only ever grow, so deltas cover exited workers too
+        int active = 0;
+        long inflight = 0;
+        unsigned long parse_ns = 0, fetches = 0, fetch_us = 0;
+        for (int i = 0; i < pool->max_threads; i++) {
+            Worker *worker = &pool->workers[i];
+            if (atomic_load(&worker->running) && !atomic_load(&worker->retire)) {
+                active++;
+            }
+            inflight += atomic_load_explicit(&worker->inflight, memory_order_relaxed);
+            parse_ns += atomic_load_explicit(&worker->parse_ns, memory_order_relaxed);
+            fetches += atomic_load_explicit(&worker->fetches, memory_order_relaxed);
+            fetch_us += atomic_load_explicit(&worker->fetch_us, memory_order_relaxed);
+        }
+
+        uint64_t now = now_ns();
+        double elapsed_ns = (double)(now - last_time);
+        double busy = active > 0 ? (parse_ns - last_parse_ns) / (elapsed_ns * active) : 0.0;
+        unsigned long completed = fetches - last_fetches;
+        double latency_ms = completed > 0 ? (fetch_us - last_fetch_us) / 1000.0 / completed : 0.0;
+        size_t backlog = sched_size(&pool->scheduler) + (pool->hosts != NULL ? host_sched_size(pool->hosts) : 0);
+        long capacity = (long)active * MAX_INFLIGHT;
+        last_time = now;
+        last_parse_ns = parse_ns;
+        last_fetches = fetches;
+        last_fetch_us = fetch_us;
+
+        if (active < pool->max_threads && backlog > 0 && (busy > ADAPT_GROW_BUSY || inflight >= capacity * 9 / 10)) {
+            // Grow: start a worker in the first free slot
+            for (int i = 0; i < pool->max_threads; i++) {
+                if (!atomic_load(&pool->workers[i].running)) {
+                    thread_pool_start_worker(pool, &pool->workers[i]);
+                    log_write(LOG_INFO, "adaptive", NULL, -1,
+                              "Growing to %d threads (parsing %.0f%%, %ld in flight, %zu queued, %.1f ms/fetch)",
+                              active + 1, busy * 100, inflight, backlog, latency_ms);
+                    break;
+                }
+            }
+        } else if (active > 1 && busy < ADAPT_SHRINK_BUSY &&
+                   inflight + (long)backlog < (long)(active - 1) * MAX_INFLIGHT / 2) {
+            // Shrink: retire the highest-numbered active worker; it drains its transfers and exits
+            for (int i = pool->max_threads - 1; i >= 0; i--) {
+                Worker *worker = &pool->workers[i];
+                if (atomic_load(&worker->running) && !atomic_load(&worker->retire)) {
+                    atomic_store(&worker->retire, true);
+                    sched_wake_all(&pool->scheduler); // A parked worker has to wake up to notice
+                    log_write(LOG_INFO, "adaptive", NULL, -1,
+                              "Shrinking to %d threads (parsing %.0f%%, %ld in flight, %zu queued, %.1f ms/fetch)",
+                              active - 1, busy * 100, inflight, backlog, latency_ms);
+                    break;
+                }
+            }
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+void thread_pool_init(ThreadPool *pool, URLQueue *queue, PriorityFrontier *priority, HostScheduler *hosts, int depth,
+                      int threads, int max_threads, bool adaptive) {
+    // Assign the task queue, maximum depth, and
+    pool->queue = queue;
+    pool->hosts = hosts;
+    pool->depth = depth;
+    atomic_init(&pool->outstanding, 1); // Held until main() has queued the starting URLs
+    pool->max_threads = max_threads;
+    pool->adaptive = adaptive;
+    pool->live = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->all_exited, NULL);
+    atomic_init(&pool->checkpoint_requested, false);
+    pool->paused = 0;
+    pthread_cond_init(&pool->paused_cond, NULL);
+    pthread_mutex_init(&pool->metrics_lock, NULL);
+    pool->checkpoint_path = NULL;
+    pool->checkpoints = 0;
+    pool->metrics_path = NULL;
+    pool->metrics_listener = -1;
+    pool->started_ns = now_ns();
+
+    // Give every worker slot its own deque on top of the shared queue, unless the crawl is best-first
+    scheduler_init(&pool->scheduler, queue, priority, max_threads);
+
+    pool->workers = calloc(max_threads, sizeof(Worker));
+    if (pool->workers == NULL) {
+        fprintf(stderr, "Failed to allocate memory for worker threads\n");
+        exit(1);
+    }
+    for (int i = 0; i < max_threads; i++) {
+        Worker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->id = i;
+        worker->joinable = false;
+        atomic_init(&worker->running, false);
+        atomic_init(&worker->retire, false);
+        atomic_init(&worker->inflight, 0);
+        atomic_init(&worker->parse_ns, 0);
+        atomic_init(&worker->wait_ns, 0);
+        atomic_init(&worker->fetches, 0);
+        atomic_init(&worker->fetch_us, 0);
+        href_scanner_init(&worker->scanner);
+        bufpool_init(&worker->buffers);
+        arena_init(&worker->scratch);
+        metrics_init(&worker->metrics);
+        worker->active = NULL;
+    }
+
+    // Create worker threads to populate the thread pool
+    pthread_mutex_lock(&pool->lock);
+    for (int i = 0; i < threads; i++) {
+        thread_pool_start_worker(pool, &pool->workers[i]);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (adaptive) {
+        pthread_create(&pool->controller, NULL, adaptive_controller, (void*) pool);
+    }
+}
+
+// Wait until every worker thread has exited, then reap them and the controller.
+void thread_pool_wait(ThreadPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->live > 0) {
+        pthread_cond_wait(&pool->all_exited, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (pool->adaptive) {
+        pthread_join(pool->controller, NULL);
+    }
+    if (pool->checkpoint_path != NULL) {
+        pthread_join(pool->checkpointer, NULL);
+    }
+    if (pool->metrics_path != NULL || pool->metrics_listener >= 0) {
+        pthread_join(pool->metrics_thread, NULL);
+    }
+    for (int i = 0; i < pool->max_threads; i++) {
+        if (pool->workers[i].joinable) {
+            pthread_join(pool->workers[i].thread, NULL);
+            pool->workers[i].joinable = false;
+        }
+    }
+}
+
+void thread_pool_destroy(ThreadPool *pool) {
+    scheduler_destroy(&pool->scheduler);
+    free(pool->workers);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->all_exited);
+    pthread_cond_destroy(&pool->paused_cond);
+    pthread_mutex_destroy(&pool->metrics_lock);
+}
+
+// Submit the nodes the calling thread has queued since its last submit to the thread pool
+void thread_pool_submit(ThreadPool *pool) {
+    // Wake one parked worker per queued node, and only if any are parked; busy workers find the
+    // nodes by stealing
+    sched_notify(&pool->scheduler, pending_pushes);
+    pending_pushes = 0;
+}
+
+// Queue a node restored from a checkpoint.
+void resume_push(URLQueueNode *node, void *arg) {
+    ThreadPool *pool = (ThreadPool*)arg;
+    if (node->depth >= pool->depth) {
+        node_free(node); // Checkpoints of older versions hold URLs at the depth limit
+        return;
+    }
+    work_add(pool);
+    sched_push(&pool->scheduler, worker_id, node);
+    pending_pushes++;
+}
+
+// Print the command-line usage.
+void print_usage(const char *program) {
+    printf("Usage: %s [options] <starting-url> <depth>\n", program);
+    printf("       %s [options] --resume FILE\n", program);
+    printf("Options:\n");
+    printf("  --threads N        Number of worker threads (default: number of online CPUs)\n");
+    printf("  --adaptive         Grow and shrink the pool based on parse time, queue depth and fetch latency\n");
+    printf("  --max-threads N    Upper bound for adaptive mode (default: %d per online CPU)\n", ADAPTIVE_THREADS_PER_CPU);
+    printf("  --visited MODE     How visited URLs are remembered: exact (default) or fingerprint\n");
+    printf("  --fpr RATE         Target false-positive rate in fingerprint mode (default: %g)\n", DEFAULT_FALSE_POSITIVE_RATE);
+    printf("  --expected-urls N  Size the visited set for about N URLs up front\n");
+    printf("  --parser MODE      Link extraction: stream (default, parse while downloading), dom, or scan\n");
+    printf("                     (SIMD href scanner with libxml2 as fallback)\n");
+    printf("  --zero-copy        Parse bodies that span several buffer chunks chunk by chunk instead of\n");
+    printf("                     joining them (dom and scan)\n");
+    printf("  --host-connections N\n");
+    printf("                     Fetch at most N pages from the same host at a time\n");
+    printf("  --host-rate R      Start at most R fetches per second on the same host\n");
+    printf("  --host-burst B     Let a host that has been idle take up to B fetches at once (default: 1)\n");
+    printf("  --priority         Crawl best-first: fetch shallow URLs, popular hosts and short paths first\n");
+    printf("  --prefer TEXT      With --priority, fetch URLs containing TEXT early (may be repeated)\n");
+    printf("  --cache DIR        Keep fetched pages in DIR and only re-download pages that changed\n");
+    printf("  --dedup            Skip pages whose body duplicates or nearly duplicates one already parsed\n");
+    printf("  --dedup-distance N With --dedup, SimHash bits (0 to %d) two near-duplicates may differ in;\n",
+           DEDUP_MAX_DISTANCE);
+    printf("                     0 only skips exact copies (default: %d)\n", DEDUP_DEFAULT_DISTANCE);
+    printf("  --robots           Fetch each host's robots.txt and skip the URLs it disallows; honour its\n");
+    printf("                     Crawl-delay\n");
+    printf("  --dns-cache        Resolve the hosts of queued URLs in the background and cache the answers\n");
+    printf("                     for their TTL, failures included\n");
+    printf("  --dns-resolvers N  Number of resolver threads for --dns-cache (default: %d)\n", DNS_DEFAULT_RESOLVERS);
+    printf("  --log-level LEVEL  error, warn, info (default; one line per page) or debug (one line per link);\n");
+    printf("                     SIGUSR2 steps to the next level while crawling\n");
+    printf("  --log-format FMT   text (default) or jsonl\n");
+    printf("  --log-file FILE    Append the log to FILE instead of stdout and stderr\n");
+    printf("  --metrics TARGET   Dump latency histograms and counters in the Prometheus text format to a\n");
+    printf("                     file, rewritten periodically and on SIGUSR1, or with unix:PATH to every\n");
+    printf("                     client of a Unix socket at PATH\n");
+    printf("  --metrics-interval SECONDS\n");
+    printf("                     Time between dumps to a metrics file (default: %d)\n", DEFAULT_METRICS_INTERVAL);
+    printf("  --spill-dir DIR    Keep queued URLs that do not fit in memory in segment files under DIR\n");
+    printf("  --frontier-urls N  Keep at most about N queued URLs in memory\n");
+    printf("  --frontier-memory SIZE\n");
+    printf("                     Keep at most about SIZE bytes of queued URLs in memory (suffixes K, M, G)\n");
+    printf("  --backpressure POLICY\n");
+    printf("                     What happens over those budgets: block (default; hold back new fetches),\n");
+    printf("                     drop (new links, least promising first) or spill (new links, to\n");
+    printf("                     --spill-dir)\n");
+    printf("  --checkpoint FILE  Periodically save the crawl state to FILE\n");
+    printf("  --checkpoint-interval SECONDS\n");
+    printf("                     Time between checkpoints (default: %d)\n", DEFAULT_CHECKPOINT_INTERVAL);
+    printf("  --resume FILE      Continue the crawl saved in FILE; <starting-url> and <depth> may be omitted\n");
+}
+
+// SIGUSR2 handler: step the log level to the next one, from debug back to error.
+void log_level_step(int signal_number) {
+    (void)signal_number;
+    int level = atomic_load(&log_level);
+    atomic_store(&log_level, level >= LOG_DEBUG ? LOG_ERROR : level + 1);
+}
+
+// SIGUSR1 handler: ask the metrics thread for a dump.
+void metrics_request(int signal_number) {
+    (void)signal_number;
+    atomic_store(&metrics_requested, true);
+}
+
+/**
+ * @brief The main function responsible for initiating the web crawler.
+ *
+ * This function serves as the entry point for the web crawler program. It parses command-line arguments,
+ * initializes necessary data structures, creates a thread pool, enqueues starting URLs, and waits for
+ * worker threads to complete their tasks before exiting.
+ *
+ * @param argc An integer representing the number of command-line arguments.
+ * @param argv An array of strings containing the command-line arguments.
+ * @return An integer indicating the exit status of the program.
+ */
+int main(int argc, char *argv[]) {
+    // Default to one worker per online CPU
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) {
+        cpus = 1;
+    }
+    int threads = (int)cpus;
+    int max_threads = 0;
+    bool adaptive = false;
+    VisitedMode visited_mode = VISITED_EXACT;
+    double false_positive_rate = DEFAULT_FALSE_POSITIVE_RATE;
+    size_t expected_urls = 0;
+    const char *spill_dir = NULL;
+    const char *checkpoint_path = NULL;
+    int checkpoint_interval = DEFAULT_CHECKPOINT_INTERVAL;
+    const char *resume_path = NULL;
+    int host_connections = 0;
+    bool best_first = false;
+    const char **prefer = NULL;
+    const char *cache_dir = NULL;
+    bool dedup = false;
+    bool use_robots = false;
+    bool use_dns = false;
+    size_t frontier_urls = 0, frontier_memory = 0;
+    BudgetPolicy backpressure = BUDGET_BLOCK;
+    bool backpressure_set = false;
+    int dns_resolvers = DNS_DEFAULT_RESOLVERS;
+    int dedup_distance = DEDUP_DEFAULT_DISTANCE;
+    LogLevel level = LOG_INFO;
+    LogFormat log_format = LOG_TEXT;
+    const char *log_path = NULL;
+    const char *metrics_target = NULL;
+    int metrics_interval = DEFAULT_METRICS_INTERVAL;
+    int prefer_count = 0;
+    double host_rate = 0, host_burst = 1;
+
+    // Parse the command-line options
+    static struct option long_options[] = {
+        {"threads", required_argument, NULL, 't'},
+        {"max-threads", required_argument, NULL, 'm'},
+        {"adaptive", no_argument, NULL, 'a'},
+        {"visited", required_argument, NULL, 'v'},
+        {"fpr", required_argument, NULL, 'f'},
+        {"expected-urls", required_argument, NULL, 'e'},
+        {"spill-dir", required_argument, NULL, 's'},
+        {"frontier-urls", required_argument, NULL, 'u'},
+        {"frontier-memory", required_argument, NULL, 'y'},
+        {"backpressure", required_argument, NULL, 'B'},
+        {"parser", required_argument, NULL, 'p'},
+        {"zero-copy", no_argument, NULL, 'z'},
+        {"checkpoint", required_argument, NULL, 'c'},
+        {"checkpoint-interval", required_argument, NULL, 'i'},
+        {"resume", required_argument, NULL, 'r'},
+        {"host-connections", required_argument, NULL, 'n'},
+        {"host-rate", required_argument, NULL, 'R'},
+        {"host-burst", required_argument, NULL, 'b'},
+        {"priority", no_argument, NULL, 'P'},
+        {"prefer", required_argument, NULL, 'w'},
+        {"cache", required_argument, NULL, 'C'},
+        {"dedup", no_argument, NULL, 'D'},
+        {"robots", no_argument, NULL, 'T'},
+        {"dns-cache", no_argument, NULL, 'N'},
+        {"dns-resolvers", required_argument, NULL, 'S'},
+        {"dedup-distance", required_argument, NULL, 'd'},
+        {"log-level", required_argument, NULL, 'L'},
+        {"log-format", required_argument, NULL, 'F'},
+        {"log-file", required_argument, NULL, 'O'},
+        {"metrics", required_argument, NULL, 'M'},
+        {"metrics-interval", required_argument, NULL, 'I'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "t:m:av:f:e:s:u:y:B:c:i:r:p:zn:R:b:Pw:C:Dd:TNS:L:F:O:M:I:", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'm':
+                max_threads = atoi(optarg);
+                break;
+            case 'a':
+                adaptive = true;
+                break;
+            case 'v':
+                if (strcmp(optarg, "exact") == 0) {
+                    visited_mode = VISITED_EXACT;
+                } else if (strcmp(optarg, "fingerprint") == 0) {
+                    visited_mode = VISITED_FINGERPRINT;
+                } else {
+                    printf("Invalid visited mode: %s (expected exact or fingerprint).\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'f':
+                false_positive_rate = atof(optarg);
+                if (false_positive_rate <= 0 || false_positive_rate >= 1) {
+                    printf("Invalid false-positive rate: need 0 < --fpr < 1.\n");
+                    return 1;
+                }
+                break;
+            case 'e':
+                expected_urls = strtoull(optarg, NULL, 10);
+                break;
+            case 's':
+                spill_dir = optarg;
+                break;
+            case 'u':
+                frontier_urls = (size_t)strtoull(optarg, NULL, 10);
+                if (frontier_urls == 0) {
+                    printf("Invalid URL budget: need --frontier-urls >= 1.\n");
+                    return 1;
+                }
+                break;
+            case 'y':
+                frontier_memory = budget_parse_size(optarg);
+                if (frontier_memory == 0) {
+                    printf("Invalid memory budget: %s (expected a size such as 256M).\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'B':
+                if (!budget_policy_parse(optarg, &backpressure)) {
+                    printf("Invalid backpressure policy: %s (expected block, drop or spill).\n", optarg);
+                    return 1;
+                }
+                backpressure_set = true;
+                break;
+            case 'p':
+                if (strcmp(optarg, "stream") == 0) {
+                    parse_mode = PARSE_STREAM;
+                } else if (strcmp(optarg, "dom") == 0) {
+                    parse_mode = PARSE_DOM;
+                } else if (strcmp(optarg, "scan") == 0) {
+                    parse_mode = PARSE_SCAN;
+                } else {
+                    printf("Invalid parser: %s (expected stream, dom or scan).\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'z':
+                zero_copy = true;
+                break;
+            case 'c':
+                checkpoint_path = optarg;
+                break;
+            case 'i':
+                checkpoint_interval = atoi(optarg);
+                if (checkpoint_interval < 1) {
+                    printf("Invalid checkpoint interval: need at least 1 second.\n");
+                    return 1;
+                }
+                break;
+            case 'r':
+                resume_path = optarg;
+                break;
+            case 'n':
+                host_connections = atoi(optarg);
+                if (host_connections < 1) {
+                    printf("Invalid host connection limit: need at least 1.\n");
+                    return 1;
+                }
+                break;
+            case 'R':
+                host_rate = atof(optarg);
+                if (host_rate <= 0) {
+                    printf("Invalid host rate: need --host-rate > 0.\n");
+                    return 1;
+                }
+                break;
+            case 'b':
+                host_burst = atof(optarg);
+                if (host_burst < 1) {
+                    printf("Invalid host burst: need --host-burst >= 1.\n");
+                    return 1;
+                }
+                break;
+            case 'P':
+                best_first = true;
+                break;
+            case 'C':
+                cache_dir = optarg;
+                break;
+            case 'D':
+                dedup = true;
+                break;
+            case 'T':
+                use_robots = true;
+                break;
+            case 'N':
+                use_dns = true;
+                break;
+            case 'S':
+                dns_resolvers = atoi(optarg);
+                if (dns_resolvers < 1) {
+                    printf("Invalid resolver count: need --dns-resolvers >= 1.\n");
+                    return 1;
+                }
+                break;
+            case 'd':
+                dedup_distance = atoi(optarg);
+                if (dedup_distance < 0 || dedup_distance > DEDUP_MAX_DISTANCE) {
+                    printf("Invalid duplicate distance: need 0 <= --dedup-distance <= %d.\n", DEDUP_MAX_DISTANCE);
+                    return 1;
+                }
+                break;
+            case 'L':
+                if (!log_level_parse(optarg, &level)) {
+                    printf("Invalid log level: %s (expected error, warn, info or debug).\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'F':
+                if (strcmp(optarg, "text") == 0) {
+                    log_format = LOG_TEXT;
+                } else if (strcmp(optarg, "jsonl") == 0) {
+                    log_format = LOG_JSONL;
+                } else {
+                    printf("Invalid log format: %s (expected text or jsonl).\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'O':
+                log_path = optarg;
+                break;
+            case 'M':
+                metrics_target = optarg;
+                break;
+            case 'I':
+                metrics_interval = atoi(optarg);
+                if (metrics_interval < 1) {
+                    printf("Invalid metrics interval: need at least 1 second.\n");
+                    return 1;
+                }
+                break;
+            case 'w':
+                prefer = realloc(prefer, (prefer_count + 1) * sizeof(*prefer));
+                if (prefer == NULL) {
+                    fprintf(stderr, "Failed to allocate memory for --prefer\n");
+                    return 1;
+                }
+                prefer[prefer_count++] = optarg;
+                break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    // Check if the correct number of command-line arguments is provided; a resumed crawl takes both
+    // from the checkpoint
+    if (argc - optind < 2 && resume_path == NULL) {
+        // If insufficient arguments, display usage information and exit with status 1
+        print_usage(argv[0]);
+        return 1;
+    }
+    Checkpoint checkpoint;
+    if (resume_path != NULL && !checkpoint_open(resume_path, &checkpoint)) {
+        return 1;
+    }
+    const char *start_url = argc - optind >= 2 ? argv[optind] : NULL;
+
+    // Extract the depth from the command-line arguments, or the checkpoint
+    int depth = argc - optind >= 2 ? atoi(argv[optind + 1]) : checkpoint.header->max_depth;
+
+    if (depth < 0) {
+        printf("Invalid depth: Depth cannot be negative.\n");
+        return 1;
+    }
+
+    // Without adaptive mode the pool never grows past its starting size
+    if (max_threads == 0) {
+        max_threads = adaptive ? (int)cpus * ADAPTIVE_THREADS_PER_CPU : threads;
+    }
+    if (threads < 1 || max_threads < threads) {
+        printf("Invalid thread count: need 1 <= --threads <= --max-threads.\n");
+        return 1;
+    }
+    if (best_first && spill_dir != NULL) {
+        printf("--priority keeps every queued URL in memory and cannot be combined with --spill-dir.\n");
+        return 1;
+    }
+    if (backpressure_set && frontier_urls == 0 && frontier_memory == 0) {
+        printf("--backpressure needs a budget: --frontier-urls or --frontier-memory.\n");
+        return 1;
+    }
+    if (backpressure == BUDGET_SPILL && spill_dir == NULL) {
+        printf("--backpressure spill needs --spill-dir.\n");
+        return 1;
+    }
+
+    // Bring the starting URL into the canonical form every discovered URL is compared in
+    char *seed_url = NULL;
+    if (start_url != NULL) {
+        seed_url = malloc(URL_RESOLVE_MAX(0, strlen(start_url)));
+        if (seed_url == NULL || url_resolve(NULL, start_url, strlen(start_url), seed_url) == 0) {
+            printf("Invalid starting URL: %s (expected an absolute http or https URL).\n", start_url);
+            return 1;
+        }
+    }
+
+    // Start the log writer before any worker logs
+    FILE *log_file = NULL;
+    if (log_path != NULL && (log_file = fopen(log_path, "a")) == NULL) {
+        perror(log_path);
+        return 1;
+    }
+    log_init(log_format, level, log_file);
+    struct sigaction step = { 0 };
+    step.sa_handler = log_level_step;
+    sigemptyset(&step.sa_mask);
+    step.sa_flags = SA_RESTART;
+    sigaction(SIGUSR2, &step, NULL);
+
+    // Open the metrics socket up front, so a bad path fails before the crawl starts
+    const char *metrics_path = NULL;
+    const char *metrics_socket = NULL;
+    int metrics_listener = -1;
+    if (metrics_target != NULL) {
+        if (strncmp(metrics_target, "unix:", 5) == 0) {
+            metrics_socket = metrics_target + 5;
+            if ((metrics_listener = metrics_listen(metrics_socket)) < 0) {
+                return 1;
+            }
+        } else {
+            metrics_path = metrics_target;
+            struct sigaction request = { 0 };
+            request.sa_handler = metrics_request;
+            sigemptyset(&request.sa_mask);
+            request.sa_flags = SA_RESTART;
+            sigaction(SIGUSR1, &request, NULL);
+        }
+    }
+
+    // Initialize libcurl once, before any worker thread creates a handle
+    curl_global_init(CURL_GLOBAL_ALL);
+    // Pick the widest byte search the CPU supports
+    HrefScanImpl scan_impl = href_scan_init(HREF_SCAN_AUTO);
+    connection_cache_init();
+    ResponseCache cache;
+    if (cache_dir != NULL) {
+        if (!cache_init(&cache, cache_dir)) {
+            return 1;
+        }
+        response_cache = &cache;
+    }
+    DedupIndex dedup_index;
+    if (dedup) {
+        dedup_init(&dedup_index, dedup_distance);
+        content_index = &dedup_index;
+    }
+    DnsCache dns_cache;
+    if (use_dns) {
+        if (!dns_init(&dns_cache, dns_resolvers)) {
+            fprintf(stderr, "Failed to start the DNS resolver threads\n");
+            return 1;
+        }
+        dns = &dns_cache;
+    }
+
+    // Initialize the URL queue and hash map for tracking visited URLs
+    URLQueue queue;
+    initQueue(&queue);
+    if (spill_dir != NULL && !frontier_enable_spill(&queue, spill_dir)) {
+        return 1;
+    }
+    if (resume_path != NULL) {
+        // The checkpoint decides how the visited set works, whatever the options say
+        if (!checkpoint_load_visited(&checkpoint, &visited)) {
+            fprintf(stderr, "Failed to load the visited set from %s\n", resume_path);
+            return 1;
+        }
+    } else {
+        visited_init(&visited, visited_mode, false_positive_rate, expected_urls);
+    }
+
+    // Print status message indicating the creation of the thread pool
+    printf("Creating thread pool...\n");
+
+    // Initialize the thread pool with the specified depth and associated URL queue
+    // Put per-host queues in front of the fetches if any per-host limit was asked for
+    HostScheduler hosts;
+    // A Crawl-delay is kept by the per-host queues as well
+    bool polite = host_connections > 0 || host_rate > 0 || use_robots;
+    if (polite) {
+        host_sched_init(&hosts, host_connections, host_rate, host_burst);
+    }
+    // Rank queued URLs instead of crawling breadth-first if asked to
+    PriorityFrontier priority;
+    PriorityWeights weights = { prefer, prefer_count };
+    if (best_first) {
+        prio_init(&priority, priority_default_score, &weights);
+    }
+    ThreadPool pool;
+    thread_pool_init(&pool, &queue, best_first ? &priority : NULL, polite ? &hosts : NULL, depth, threads, max_threads,
+                     adaptive);
+    RobotsCache robots_cache;
+    if (use_robots) {
+        if (!robots_init(&robots_cache, ROBOTS_AGENT, robots_fetch, NULL, robots_release, &pool)) {
+            fprintf(stderr, "Failed to start the robots.txt fetcher threads\n");
+            return 1;
+        }
+        robots = &robots_cache;
+        host_sched_set_delay(&hosts, robots_host_delay, robots);
+    }
+    // Hold the queued URLs to their budgets; nodes restored from a checkpoint are not charged
+    FrontierBudget frontier_budget;
+    if (frontier_urls > 0 || frontier_memory > 0) {
+        budget_init(&frontier_budget, backpressure, frontier_urls, frontier_memory, spill_dir != NULL);
+        node_pool_set_release(budget_node_release, &frontier_budget);
+        budget = &frontier_budget;
+    }
+
+    if (resume_path != NULL) {
+        // Queue the saved frontier instead of the starting URL, whose links are already in it
+        size_t restored = checkpoint_load_frontier(&checkpoint, resume_push, &pool);
+        checkpoint_close(&checkpoint);
+        printf("Resumed from %s: %zu visited URLs, %zu queued URLs, depth %d.\n", resume_path,
+               visited_size(&visited), restored, depth);
+    } else {
+        // Enqueue the provided starting URL with depth 0, unless a depth of 0 allows no fetch at all
+        // Mark it visited so links back to it are not fetched again
+        visited_insert(&visited, seed_url);
+        RobotsVerdict verdict = ROBOTS_ALLOWED;
+        // Wait for the rules of the starting URL's host, so that a disallowed starting URL gets its own
+        // message; no worker has anything to do meanwhile
+        while (depth > 0 && robots != NULL && (verdict = robots_check(robots, seed_url)) == ROBOTS_UNKNOWN) {
+            struct timespec pause = { 0, POLL_TIMEOUT_MS * 1000000L };
+            nanosleep(&pause, NULL);
+        }
+        if (verdict == ROBOTS_DISALLOWED) {
+            printf("The starting URL is disallowed by its host's robots.txt.\n");
+        } else if (depth > 0) {
+            enqueue(&queue, seed_url, NULL, 0, &pool);
+        }
+    }
+    free(seed_url); // The queued node has its own copy
+    thread_pool_submit(&pool); // Submit the queued URLs to the thread pool
+    work_done(&pool); // Release the hold taken by thread_pool_init; from now on the workers end the crawl
+    if (checkpoint_path != NULL) {
+        thread_pool_start_checkpoints(&pool, checkpoint_path, checkpoint_interval);
+    }
+    if (metrics_target != NULL) {
+        thread_pool_start_metrics(&pool, metrics_path, metrics_listener, metrics_interval);
+    }
+
+    // Print status message indicating the creation of the thread pool
+    if (adaptive) {
+        printf("Thread pool created with %d threads (adaptive, up to %d).\n\n", threads, max_threads);
+    } else {
+        printf("Thread pool created with %d threads.\n\n", threads);
+    }
+
+    // Wait for all worker threads to complete their tasks before exiting
+    thread_pool_wait(&pool);
+
+    // Write out the workers' log before the summary
+    log_shutdown();
+
+    // Print status message indicating the completion of all threads
+    printf("All threads have completed.\n");
+    if (log_dropped() > 0) {
+        printf("Log: %lu records dropped because a thread logged faster than they could be written.\n", log_dropped());
+    }
+
+    // Report how much connection reuse the crawl got
+    unsigned long opened = atomic_load(&connections_opened);
+    unsigned long reused = atomic_load(&connections_reused);
+    printf("Connections: %lu opened, %lu transfers reused an open connection (%.1f%%).\n",
+           opened, reused, opened + reused > 0 ? 100.0 * reused / (opened + reused) : 0.0);
+    printf("Transfer: %.2f MiB received for %.2f MiB of decoded bodies.\n", atomic_load(&bytes_received) / 1048576.0,
+           atomic_load(&bytes_decoded) / 1048576.0);
+    if (response_cache != NULL) {
+        printf("Response cache: %lu of %lu pages cached, %lu not modified (%lu served from the cache), %lu stored (%.2f MiB).\n",
+               atomic_load(&cache.hits), atomic_load(&cache.lookups), atomic_load(&not_modified),
+               atomic_load(&cache.loads), atomic_load(&cache.stores), atomic_load(&cache.bytes_stored) / 1048576.0);
+    }
+
+    if (content_index != NULL) {
+        printf("Duplicate content: %lu pages checked, %lu duplicates and %lu near-duplicates skipped; index %.1f MiB.\n",
+               atomic_load(&dedup_index.checked), atomic_load(&dedup_index.duplicates),
+               atomic_load(&dedup_index.near_duplicates), dedup_memory(&dedup_index) / 1048576.0);
+    }
+
+    if (parse_mode != PARSE_STREAM || content_index != NULL) {
+        unsigned long allocations = 0, reuses = 0, bytes_copied = 0, pages = 0;
+        for (int i = 0; i < pool.max_threads; i++) {
+            allocations += pool.workers[i].buffers.allocations;
+            reuses += pool.workers[i].buffers.reuses;
+            bytes_copied += pool.workers[i].buffers.bytes_copied;
+            pages += pool.workers[i].buffers.pages;
+        }
+        printf("Response buffers: %lu pages, %.2f allocations/page, %.2f chunks reused/page, %.0f bytes copied/page.\n",
+               pages, pages > 0 ? (double)allocations / pages : 0.0, pages > 0 ? (double)reuses / pages : 0.0,
+               pages > 0 ? (double)bytes_copied / pages : 0.0);
+    }
+    if (parse_mode == PARSE_SCAN) {
+        printf("Href scanner (%s): %lu pages scanned, %lu handed to libxml2.\n", href_scan_impl_name(scan_impl),
+               atomic_load(&scan_pages), atomic_load(&scan_fallbacks));
+    }
+
+    // Report how the work was distributed between the workers
+    unsigned long local_pops = 0, steals = 0, parks = 0;
+    for (int i = 0; i < pool.max_threads; i++) {
+        local_pops += pool.scheduler.deques[i].local_pops;
+        steals += pool.scheduler.deques[i].steals;
+        parks += pool.scheduler.deques[i].parks;
+    }
+    printf("Scheduler: %lu URLs from own deques, %lu stolen, %lu parks.\n", local_pops, steals, parks);
+    if (best_first) {
+        unsigned long pushed = atomic_load(&priority.pushed), popped = atomic_load(&priority.popped);
+        printf("Priority frontier: %lu URLs scored (mean level %.1f), %lu fetched (mean level %.1f).\n", pushed,
+               pushed > 0 ? (double)atomic_load(&priority.pushed_levels) / pushed : 0.0, popped,
+               popped > 0 ? (double)atomic_load(&priority.popped_levels) / popped : 0.0);
+    }
+    if (robots != NULL) {
+        printf("Robots: %zu hosts, %lu robots.txt requests (%lu failed), %lu of %lu URLs disallowed.\n",
+               robots_hosts(robots), atomic_load(&robots_cache.fetches), atomic_load(&robots_cache.failures),
+               atomic_load(&robots_cache.disallowed), atomic_load(&robots_cache.checked));
+    }
+    if (dns != NULL) {
+        printf("DNS cache: %zu hosts, %lu lookups (%lu failed); %lu transfers given their addresses, %lu not yet "
+               "resolved, %lu failed from the cache.\n",
+               dns_hosts(dns), atomic_load(&dns_cache.lookups), atomic_load(&dns_cache.failures),
+               atomic_load(&dns_cache.hits), atomic_load(&dns_cache.misses), atomic_load(&dns_cache.negative_hits));
+    }
+    if (budget != NULL) {
+        printf("Frontier budget: peak %ld URLs and %.1f MiB in memory; fetches held back %lu times for %.2f s in "
+               "total, %lu links admitted over the budget, %lu dropped, %lu spilled.\n",
+               atomic_load(&budget->peak_urls), atomic_load(&budget->peak_bytes) / 1048576.0,
+               atomic_load(&budget->blocks), atomic_load(&budget->blocked_ns) / 1e9, atomic_load(&budget->overshoots),
+               atomic_load(&budget->dropped), atomic_load(&budget->spilled));
+    }
+    if (polite) {
+        printf("Host queues: %zu hosts, %lu times every waiting host was held back by its limits, %lu URLs "
+               "of full host queues left on disk.\n",
+               host_sched_hosts(&hosts), atomic_load(&hosts.throttled), atomic_load(&hosts.spilled));
+    }
+
+    // Report the visited set's footprint and how hard its lookups worked
+    VisitedStats stats;
+    visited_stats(&visited, &stats);
+    printf("Visited set: %zu URLs in %.1f MiB (%.1f bytes/URL), %.2f probes/lookup",
+           stats.urls, stats.bytes / 1048576.0, stats.urls > 0 ? (double)stats.bytes / stats.urls : 0.0,
+           stats.lookups > 0 ? (double)stats.probes / stats.lookups : 0.0);
+    if (visited_mode == VISITED_FINGERPRINT) {
+        printf(", %d-bit fingerprints in %d filters, %lu evictions, estimated false-positive rate %.2g",
+               visited.fingerprint_bits, stats.filters, stats.kicks, stats.false_positive_rate);
+    }
+    printf(".\n");
+    if (queue.spilling) {
+        printf("Frontier spill: %lu segments, %.1f MiB written, %.1f MiB read back.\n", queue.spill.segments,
+               queue.spill.bytes_written / 1048576.0, queue.spill.bytes_read / 1048576.0);
+    }
+
+    // Report how often queue nodes and base URLs came from the pools instead of malloc
+    node_pool_flush();
+    NodePoolStats node_stats;
+    node_pool_stats(&node_stats);
+    unsigned long scratch_blocks = 0;
+    for (int i = 0; i < pool.max_threads; i++) {
+        scratch_blocks += pool.workers[i].scratch.allocations;
+    }
+    printf("Queue nodes: %lu allocated, %lu reused; %lu base URLs shared by %lu nodes; %lu scratch blocks.\n",
+           node_stats.allocated, node_stats.reused, node_stats.bases_created,
+           node_stats.bases_created + node_stats.bases_shared, scratch_blocks);
+
+    // Cleanup and program termination.
+    thread_pool_destroy(&pool);
+    if (polite) {
+        host_sched_destroy(&hosts);
+    }
+    if (best_first) {
+        prio_destroy(&priority);
+    }
+    free(prefer);
+    queue_destroy(&queue);
+    visited_destroy(&visited);
+    node_pool_flush(); // Nodes still queued went back to this thread's pool
+    if (budget != NULL) {
+        node_pool_set_release(NULL, NULL);
+    }
+    connection_cache_cleanup();
+    if (response_cache != NULL) {
+        cache_destroy(&cache);
+    }
+    if (content_index != NULL) {
+        dedup_destroy(&dedup_index);
+    }
+    if (robots != NULL) {
+        robots_destroy(&robots_cache);
+    }
+    if (dns != NULL) {
+        dns_destroy(&dns_cache);
+    }
+    curl_global_cleanup();
+    if (metrics_listener >= 0) {
+        close(metrics_listener);
+        unlink(metrics_socket);
+    }
+    if (log_file != NULL) {
+        fclose(log_file);
+    }
 
     return 0;
 }
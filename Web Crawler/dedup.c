@@ -0,0 +1,470 @@
+// Include the content index interface.
+#include "dedup.h"
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+
+// Define the number of slots each shard of the exact index starts with. Must be a power of two.
+#define DEDUP_INITIAL_CAPACITY 256
+// Define the number of buckets per block of the near-duplicate index (one per 16-bit block value).
+#define DEDUP_BUCKETS (1 << 16)
+// Define the number of slots the set of a body's distinct word pairs starts with. Must be a power of two.
+#define DEDUP_FEATURES_INITIAL 1024
+
+// Define the xxHash64 primes.
+#define XXH_PRIME1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME3 0x165667B19E3779F9ULL
+#define XXH_PRIME4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME5 0x27D4EB2F165667C5ULL
+
+// State of an xxHash64 computation over data that arrives in pieces.
+typedef struct {
+    uint64_t total;                  // Bytes hashed so far
+    uint64_t acc[4];                 // The four lanes of 32-byte stripes
+    unsigned char stripe[32];        // Bytes of a stripe not yet complete
+    size_t buffered;
+} XXH64State;
+
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME2;
+    acc = rotl64(acc, 31);
+    return acc * XXH_PRIME1;
+}
+
+static uint64_t xxh_merge(uint64_t h, uint64_t acc) {
+    h ^= xxh_round(0, acc);
+    return h * XXH_PRIME1 + XXH_PRIME4;
+}
+
+static void xxh64_init(XXH64State *state) {
+    state->total = 0;
+    state->acc[0] = XXH_PRIME1 + XXH_PRIME2;
+    state->acc[1] = XXH_PRIME2;
+    state->acc[2] = 0;
+    state->acc[3] = -XXH_PRIME1;
+    state->buffered = 0;
+}
+
+static void xxh64_stripe(XXH64State *state, const unsigned char *p) {
+    state->acc[0] = xxh_round(state->acc[0], read64(p));
+    state->acc[1] = xxh_round(state->acc[1], read64(p + 8));
+    state->acc[2] = xxh_round(state->acc[2], read64(p + 16));
+    state->acc[3] = xxh_round(state->acc[3], read64(p + 24));
+}
+
+static void xxh64_update(XXH64State *state, const unsigned char *data, size_t len) {
+    state->total += len;
+    // Complete a stripe left over from the previous piece
+    if (state->buffered > 0) {
+        size_t take = 32 - state->buffered < len ? 32 - state->buffered : len;
+        memcpy(state->stripe + state->buffered, data, take);
+        state->buffered += take;
+        data += take;
+        len -= take;
+        if (state->buffered < 32) {
+            return;
+        }
+        xxh64_stripe(state, state->stripe);
+        state->buffered = 0;
+    }
+    while (len >= 32) {
+        xxh64_stripe(state, data);
+        data += 32;
+        len -= 32;
+    }
+    memcpy(state->stripe, data, len);
+    state->buffered = len;
+}
+
+static uint64_t xxh64_digest(const XXH64State *state) {
+    uint64_t h;
+    if (state->total >= 32) {
+        h = rotl64(state->acc[0], 1) + rotl64(state->acc[1], 7) + rotl64(state->acc[2], 12) +
+            rotl64(state->acc[3], 18);
+        for (int i = 0; i < 4; i++) {
+            h = xxh_merge(h, state->acc[i]);
+        }
+    } else {
+        h = XXH_PRIME5; // Seed 0
+    }
+    h += state->total;
+
+    const unsigned char *p = state->stripe;
+    const unsigned char *end = p + state->buffered;
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxh_round(0, read64(p));
+        h = rotl64(h, 27) * XXH_PRIME1 + XXH_PRIME4;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)read32(p) * XXH_PRIME1;
+        h = rotl64(h, 23) * XXH_PRIME2 + XXH_PRIME3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= *p * XXH_PRIME5;
+        h = rotl64(h, 11) * XXH_PRIME1;
+    }
+
+    // Final avalanche
+    h ^= h >> 33;
+    h *= XXH_PRIME2;
+    h ^= h >> 29;
+    h *= XXH_PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t content_hash(const ResponseBuffer *body) {
+    XXH64State state;
+    xxh64_init(&state);
+    for (const BufferChunk *chunk = body->head; chunk != NULL; chunk = chunk->next) {
+        xxh64_update(&state, (const unsigned char *)chunk->data, chunk->used);
+    }
+    return xxh64_digest(&state);
+}
+
+static uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Word characters: ASCII letters and digits, and every byte of a multi-byte UTF-8 character.
+static bool word_byte(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+// The distinct word pairs of a body seen so far, as an open-addressed table of their hashes.
+typedef struct {
+    uint64_t *slots;                 // 0 marks an empty slot
+    size_t capacity;                 // A power of two
+    size_t count;
+} FeatureSet;
+
+// Add a feature. Returns false if it was already present, or if memory ran out while growing.
+static bool feature_add(FeatureSet *set, uint64_t feature) {
+    if (feature == 0) {
+        feature = 1;
+    }
+    if (set->count * 2 >= set->capacity) {
+        size_t capacity = set->capacity * 2;
+        uint64_t *slots = calloc(capacity, sizeof(uint64_t));
+        if (slots == NULL) {
+            return false;
+        }
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (set->slots[i] != 0) {
+                size_t slot = set->slots[i] & (capacity - 1);
+                while (slots[slot] != 0) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                slots[slot] = set->slots[i];
+            }
+        }
+        free(set->slots);
+        set->slots = slots;
+        set->capacity = capacity;
+    }
+    size_t slot = feature & (set->capacity - 1);
+    while (set->slots[slot] != 0) {
+        if (set->slots[slot] == feature) {
+            return false;
+        }
+        slot = (slot + 1) & (set->capacity - 1);
+    }
+    set->slots[slot] = feature;
+    set->count++;
+    return true;
+}
+
+/**
+ * @brief SimHash of a body: every distinct pair of consecutive words votes on each of the 64 bits.
+ *
+ * Words are runs of letters, digits and non-ASCII bytes, compared without regard to ASCII case, and
+ * markup is not skipped, so tag and attribute names and the words of URLs count as well as the text.
+ * Each pair of consecutive words is hashed to 64 bits; a 1 bit adds one to that bit's vote and a 0 bit
+ * subtracts one, and the fingerprint has a 1 wherever the vote is positive. A pair votes once however
+ * often it occurs, so the markup every page repeats ("a href" on every link) does not outvote the words
+ * that tell pages apart. Changing a few words changes the votes of a few pairs, so similar bodies get
+ * fingerprints a few bits apart. A word split across two chunks is hashed as one.
+ *
+ * @param body The body to fingerprint.
+ * @param features Set to the number of distinct word pairs that voted.
+ * @return The 64-bit fingerprint.
+ */
+uint64_t content_simhash(const ResponseBuffer *body, size_t *features) {
+    int votes[64] = { 0 };
+    uint64_t previous = 0;           // Hash of the word before the current one
+    uint64_t word = 0xcbf29ce484222325ULL; // FNV-1a state of the current word
+    bool in_word = false;
+    FeatureSet seen = { calloc(DEDUP_FEATURES_INITIAL, sizeof(uint64_t)), DEDUP_FEATURES_INITIAL, 0 };
+    if (seen.slots == NULL) {
+        seen.capacity = 0; // Every pair votes as often as it occurs
+    }
+
+    for (const BufferChunk *chunk = body->head; chunk != NULL; chunk = chunk->next) {
+        const unsigned char *p = (const unsigned char *)chunk->data;
+        const unsigned char *end = p + chunk->used;
+        for (; p <= end; p++) {
+            // The end of the last chunk ends the last word
+            bool at_end = p == end;
+            if (at_end && chunk->next != NULL) {
+                break;
+            }
+            if (!at_end && word_byte(*p)) {
+                unsigned char c = *p >= 'A' && *p <= 'Z' ? *p + ('a' - 'A') : *p;
+                word = (word ^ c) * 0x100000001b3ULL;
+                in_word = true;
+                continue;
+            }
+            if (in_word) {
+                uint64_t feature = mix64(previous * XXH_PRIME1 + word);
+                if (seen.capacity == 0 || feature_add(&seen, feature)) {
+                    for (int bit = 0; bit < 64; bit++) {
+                        votes[bit] += (int)((feature >> bit) & 1) * 2 - 1;
+                    }
+                }
+                previous = word;
+                word = 0xcbf29ce484222325ULL;
+                in_word = false;
+            }
+        }
+    }
+
+    free(seen.slots);
+    *features = seen.count;
+
+    uint64_t fingerprint = 0;
+    for (int bit = 0; bit < 64; bit++) {
+        if (votes[bit] > 0) {
+            fingerprint |= 1ULL << bit;
+        }
+    }
+    return fingerprint;
+}
+
+void dedup_init(DedupIndex *index, int distance) {
+    if (distance < 0) {
+        distance = 0;
+    } else if (distance > DEDUP_MAX_DISTANCE) {
+        distance = DEDUP_MAX_DISTANCE;
+    }
+    index->distance = distance;
+
+    for (int i = 0; i < DEDUP_SHARDS; i++) {
+        DedupShard *shard = &index->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->capacity = DEDUP_INITIAL_CAPACITY;
+        shard->count = 0;
+        shard->hashes = calloc(shard->capacity, sizeof(uint64_t));
+        if (shard->hashes == NULL) {
+            fprintf(stderr, "Failed to allocate memory for the content index\n");
+            exit(1);
+        }
+    }
+
+    for (int b = 0; b < DEDUP_BLOCKS; b++) {
+        index->blocks[b] = NULL;
+        if (distance > 0) {
+            // The pages of an untouched bucket are never written, so this costs little until it fills up
+            index->blocks[b] = calloc(DEDUP_BUCKETS, sizeof(DedupBucket));
+            if (index->blocks[b] == NULL) {
+                fprintf(stderr, "Failed to allocate memory for the content index\n");
+                exit(1);
+            }
+        }
+        for (int s = 0; s < DEDUP_LOCK_STRIPES; s++) {
+            pthread_mutex_init(&index->locks[b][s], NULL);
+        }
+    }
+
+    atomic_init(&index->checked, 0);
+    atomic_init(&index->duplicates, 0);
+    atomic_init(&index->near_duplicates, 0);
+    atomic_init(&index->fingerprints, 0);
+}
+
+void dedup_destroy(DedupIndex *index) {
+    for (int i = 0; i < DEDUP_SHARDS; i++) {
+        free(index->shards[i].hashes);
+        pthread_mutex_destroy(&index->shards[i].lock);
+    }
+    for (int b = 0; b < DEDUP_BLOCKS; b++) {
+        if (index->blocks[b] != NULL) {
+            for (size_t i = 0; i < DEDUP_BUCKETS; i++) {
+                free(index->blocks[b][i].fingerprints);
+            }
+            free(index->blocks[b]);
+        }
+        for (int s = 0; s < DEDUP_LOCK_STRIPES; s++) {
+            pthread_mutex_destroy(&index->locks[b][s]);
+        }
+    }
+}
+
+// Double a shard's table. Called with the shard lock held.
+static bool shard_grow(DedupShard *shard) {
+    size_t capacity = shard->capacity * 2;
+    uint64_t *hashes = calloc(capacity, sizeof(uint64_t));
+    if (hashes == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < shard->capacity; i++) {
+        uint64_t hash = shard->hashes[i];
+        if (hash != 0) {
+            size_t slot = hash & (capacity - 1);
+            while (hashes[slot] != 0) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            hashes[slot] = hash;
+        }
+    }
+    free(shard->hashes);
+    shard->hashes = hashes;
+    shard->capacity = capacity;
+    return true;
+}
+
+// Insert a content hash if it is not already present. Returns true if this call inserted it.
+static bool exact_insert(DedupIndex *index, uint64_t hash) {
+    if (hash == 0) {
+        hash = 1; // 0 marks an empty slot
+    }
+    // The top bits pick the shard; the low bits pick the slot within it
+    DedupShard *shard = &index->shards[hash >> (64 - DEDUP_SHARD_BITS)];
+
+    pthread_mutex_lock(&shard->lock);
+    size_t mask = shard->capacity - 1;
+    size_t slot = hash & mask;
+    while (shard->hashes[slot] != 0) {
+        if (shard->hashes[slot] == hash) {
+            pthread_mutex_unlock(&shard->lock);
+            return false;
+        }
+        slot = (slot + 1) & mask;
+    }
+    shard->hashes[slot] = hash;
+    shard->count++;
+    // Keep the load factor under 70% so probe sequences stay short
+    if (shard->count * 10 > shard->capacity * 7 && !shard_grow(shard)) {
+        fprintf(stderr, "Failed to grow the content index\n");
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return true;
+}
+
+// Whether a fingerprint within the index's distance is filed under block b of fingerprint.
+static bool near_lookup(DedupIndex *index, int b, uint64_t fingerprint) {
+    unsigned int value = (unsigned int)(fingerprint >> (16 * b)) & (DEDUP_BUCKETS - 1);
+    DedupBucket *bucket = &index->blocks[b][value];
+    pthread_mutex_t *lock = &index->locks[b][value % DEDUP_LOCK_STRIPES];
+    bool found = false;
+
+    pthread_mutex_lock(lock);
+    for (uint32_t i = 0; i < bucket->count; i++) {
+        if (__builtin_popcountll(bucket->fingerprints[i] ^ fingerprint) <= index->distance) {
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(lock);
+    return found;
+}
+
+// File a fingerprint under block b. A full bucket is left alone, which only costs recall.
+static void near_insert(DedupIndex *index, int b, uint64_t fingerprint) {
+    unsigned int value = (unsigned int)(fingerprint >> (16 * b)) & (DEDUP_BUCKETS - 1);
+    DedupBucket *bucket = &index->blocks[b][value];
+    pthread_mutex_t *lock = &index->locks[b][value % DEDUP_LOCK_STRIPES];
+
+    pthread_mutex_lock(lock);
+    if (bucket->count == bucket->capacity && bucket->capacity < DEDUP_BUCKET_LIMIT) {
+        uint32_t capacity = bucket->capacity == 0 ? 4 : bucket->capacity * 2;
+        uint64_t *fingerprints = realloc(bucket->fingerprints, capacity * sizeof(uint64_t));
+        if (fingerprints != NULL) {
+            bucket->fingerprints = fingerprints;
+            bucket->capacity = capacity;
+        }
+    }
+    if (bucket->count < bucket->capacity) {
+        bucket->fingerprints[bucket->count++] = fingerprint;
+    }
+    pthread_mutex_unlock(lock);
+}
+
+ContentVerdict dedup_check(DedupIndex *index, const ResponseBuffer *body) {
+    atomic_fetch_add_explicit(&index->checked, 1, memory_order_relaxed);
+
+    if (!exact_insert(index, content_hash(body))) {
+        atomic_fetch_add_explicit(&index->duplicates, 1, memory_order_relaxed);
+        return CONTENT_DUPLICATE;
+    }
+    if (index->distance == 0) {
+        return CONTENT_UNIQUE;
+    }
+
+    // A fingerprint of a few words says little; short pages are only compared exactly
+    size_t features;
+    uint64_t fingerprint = content_simhash(body, &features);
+    if (features < DEDUP_MIN_FEATURES) {
+        return CONTENT_UNIQUE;
+    }
+    for (int b = 0; b < DEDUP_BLOCKS; b++) {
+        if (near_lookup(index, b, fingerprint)) {
+            atomic_fetch_add_explicit(&index->near_duplicates, 1, memory_order_relaxed);
+            return CONTENT_NEAR_DUPLICATE;
+        }
+    }
+    for (int b = 0; b < DEDUP_BLOCKS; b++) {
+        near_insert(index, b, fingerprint);
+    }
+    atomic_fetch_add_explicit(&index->fingerprints, 1, memory_order_relaxed);
+    return CONTENT_UNIQUE;
+}
+
+size_t dedup_memory(DedupIndex *index) {
+    size_t bytes = 0;
+    for (int i = 0; i < DEDUP_SHARDS; i++) {
+        DedupShard *shard = &index->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        bytes += shard->capacity * sizeof(uint64_t);
+        pthread_mutex_unlock(&shard->lock);
+    }
+    for (int b = 0; b < DEDUP_BLOCKS; b++) {
+        if (index->blocks[b] == NULL) {
+            continue;
+        }
+        bytes += DEDUP_BUCKETS * sizeof(DedupBucket);
+        for (int s = 0; s < DEDUP_LOCK_STRIPES; s++) {
+            pthread_mutex_lock(&index->locks[b][s]);
+            for (size_t i = (size_t)s; i < DEDUP_BUCKETS; i += DEDUP_LOCK_STRIPES) {
+                bytes += index->blocks[b][i].capacity * sizeof(uint64_t);
+            }
+            pthread_mutex_unlock(&index->locks[b][s]);
+        }
+    }
+    return bytes;
+}
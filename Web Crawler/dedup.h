@@ -0,0 +1,98 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+// Include size types.
+#include <stddef.h>
+// Include fixed-width integer types.
+#include <stdint.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+// Include atomic types for the counters.
+#include <stdatomic.h>
+// Include the pthread library for the shard locks.
+#include <pthread.h>
+// Include the response buffers whose bodies are fingerprinted.
+#include "bufpool.h"
+
+// Define the number of bits of a content hash that pick a shard of the exact index, and the number of shards.
+#define DEDUP_SHARD_BITS 6
+#define DEDUP_SHARDS (1 << DEDUP_SHARD_BITS)
+// Define the number of 16-bit blocks a SimHash is split into. Two fingerprints at most DEDUP_BLOCKS - 1
+// bits apart agree on at least one block, which bounds the near-duplicate distance.
+#define DEDUP_BLOCKS 4
+#define DEDUP_MAX_DISTANCE (DEDUP_BLOCKS - 1)
+// Define the default number of differing SimHash bits up to which two pages are near-duplicates.
+#define DEDUP_DEFAULT_DISTANCE 3
+// Define the number of distinct word pairs a body needs before it is compared by SimHash at all.
+#define DEDUP_MIN_FEATURES 64
+// Define the number of locks guarding each block table of the near-duplicate index.
+#define DEDUP_LOCK_STRIPES 64
+// Define the number of fingerprints a bucket holds before new ones are no longer added to it.
+#define DEDUP_BUCKET_LIMIT 1024
+
+// What dedup_check found out about a body.
+typedef enum {
+    CONTENT_UNIQUE,                  // Not seen before; now in the index
+    CONTENT_DUPLICATE,               // Byte-for-byte the same as a body already checked
+    CONTENT_NEAR_DUPLICATE           // Within the SimHash distance of a body already checked
+} ContentVerdict;
+
+// One shard of the exact index: a linear-probing table of content hashes, 0 meaning empty.
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    uint64_t *hashes;
+    size_t capacity;                 // Number of slots, a power of two
+    size_t count;
+} DedupShard;
+
+// The fingerprints of the near-duplicate index that share one 16-bit block value.
+typedef struct {
+    uint64_t *fingerprints;
+    uint32_t count;
+    uint32_t capacity;
+} DedupBucket;
+
+/**
+ * @brief Concurrent index of the bodies of the pages crawled so far.
+ *
+ * A body is first hashed with xxHash64. The hashes live in DEDUP_SHARDS independently locked
+ * linear-probing tables, so an exact copy of an earlier body (a page reachable under several URLs,
+ * e.g. with a session ID or a tracking parameter) is found with one lookup, and checking and inserting
+ * a hash is a single operation under its shard's lock.
+ *
+ * A body seen for the first time also gets a 64-bit SimHash of the pairs of consecutive words in it,
+ * markup included, so pages that differ in a few words or links (a timestamp, a counter, a mirror's
+ * host name) get fingerprints a few bits apart. Each fingerprint is filed under each of its
+ * DEDUP_BLOCKS 16-bit blocks; two fingerprints at most DEDUP_BLOCKS - 1 bits apart share a block, so a
+ * near-duplicate is found by comparing against the fingerprints in DEDUP_BLOCKS buckets only. A body
+ * with fewer than DEDUP_MIN_FEATURES distinct word pairs is too short for its SimHash to mean much and
+ * is only compared exactly. Looking
+ * up and inserting a fingerprint are separate steps, so two near-duplicates checked at the same moment
+ * may both come out unique.
+ */
+typedef struct {
+    DedupShard shards[DEDUP_SHARDS];
+    DedupBucket *blocks[DEDUP_BLOCKS];   // 65536 buckets per block, or NULL with a distance of 0
+    pthread_mutex_t locks[DEDUP_BLOCKS][DEDUP_LOCK_STRIPES];
+    int distance;                    // Largest SimHash distance counted as a near-duplicate
+    atomic_ulong checked;            // dedup_check calls
+    atomic_ulong duplicates;         // Exact duplicates found
+    atomic_ulong near_duplicates;    // Near-duplicates found
+    atomic_ulong fingerprints;       // SimHashes stored
+} DedupIndex;
+
+// Hash a body to 64 bits with xxHash64, chunk by chunk.
+uint64_t content_hash(const ResponseBuffer *body);
+// SimHash of a body's distinct word pairs, chunk by chunk. Sets *features to the number of pairs.
+uint64_t content_simhash(const ResponseBuffer *body, size_t *features);
+// Initialize an empty index. distance (0 to DEDUP_MAX_DISTANCE) is the number of differing SimHash bits
+// up to which two bodies are near-duplicates; 0 detects exact duplicates only.
+void dedup_init(DedupIndex *index, int distance);
+// Free the index.
+void dedup_destroy(DedupIndex *index);
+// Check a body against every body checked before it and add it to the index if it is unique.
+ContentVerdict dedup_check(DedupIndex *index, const ResponseBuffer *body);
+// Bytes used by the tables and buckets.
+size_t dedup_memory(DedupIndex *index);
+
+#endif
@@ -0,0 +1,415 @@
+// Expose getaddrinfo() and the resolver library's res_nsearch() and message parser.
+#define _DEFAULT_SOURCE
+
+// Include the DNS cache interface.
+#include "dns.h"
+// Include the URL hash shared with the visited set.
+#include "visited.h"
+// Include url_host().
+#include "url.h"
+// Include the monotonic clock for the expiry times.
+#include "clock.h"
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+// Include getaddrinfo().
+#include <netdb.h>
+// Include inet_ntop() for writing the addresses.
+#include <arpa/inet.h>
+// Include the DNS message parser, for the addresses and TTLs of the records.
+#include <arpa/nameser.h>
+// Include res_nsearch().
+#include <resolv.h>
+
+// Define the longest host name that is cached; URLs with longer authorities are left to libcurl.
+#define DNS_NAME_MAX 255
+// Define the size of the buffer a DNS response is read into.
+#define DNS_RESPONSE_MAX 4096
+
+// The host the calling thread looked up last.
+static _Thread_local HostTableHint last_key = { NULL, NULL };
+
+static void *dns_alloc(size_t size) {
+    void *p = malloc(size);
+    if (p == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the DNS cache\n");
+        exit(1);
+    }
+    return p;
+}
+
+// Build the "host:port" key of a URL's host in key, which holds DNS_NAME_MAX + 7 bytes, and store the
+// length of the name in *name_length. Returns the key's length, or 0 if the host is an IP literal, has
+// user information, or is too long: those are left to libcurl.
+static size_t dns_key(const char *url, char *key, size_t *name_length) {
+    size_t authority_len;
+    const char *authority = url_host(url, &authority_len);
+    if (authority_len == 0 || authority[0] == '[' || memchr(authority, '@', authority_len) != NULL) {
+        return 0;
+    }
+    const char *colon = memchr(authority, ':', authority_len);
+    size_t name_len = colon != NULL ? (size_t)(colon - authority) : authority_len;
+    if (name_len == 0 || name_len > DNS_NAME_MAX || strspn(authority, "0123456789.") >= name_len) {
+        return 0;
+    }
+    memcpy(key, authority, name_len);
+    size_t len = name_len;
+    if (colon != NULL) {
+        size_t port_len = authority_len - name_len; // The colon included
+        if (port_len < 2 || port_len > 6) {
+            return 0;
+        }
+        memcpy(key + len, colon, port_len);
+        len += port_len;
+    } else {
+        // Canonical URLs drop the default port; libcurl's entry needs it
+        const char *port = strncmp(url, "https:", 6) == 0 ? ":443" : ":80";
+        memcpy(key + len, port, strlen(port));
+        len += strlen(port);
+    }
+    key[len] = '\0';
+    *name_length = name_len;
+    return len;
+}
+
+// Make the record of a new host, without an answer. arg points to the length of the host name.
+static HostEntry *dns_host_create(const char *key, size_t len, void *arg) {
+    DnsHost *host = dns_alloc(sizeof(DnsHost) + len + 1);
+    host->queued_next = NULL;
+    atomic_init(&host->answer, NULL);
+    atomic_init(&host->resolving, false);
+    atomic_init(&host->expires_ns, 0);
+    host->name_length = *(size_t *)arg;
+    memcpy(host->key, key, len);
+    host->key[len] = '\0';
+    host->entry.key = host->key;
+    return &host->entry;
+}
+
+// The host of a URL, or NULL if it is not cached.
+static DnsHost *dns_host(DnsCache *cache, const char *url) {
+    char key[DNS_NAME_MAX + 7];
+    size_t name_length;
+    size_t len = dns_key(url, key, &name_length);
+    if (len == 0) {
+        return NULL;
+    }
+    return (DnsHost *)host_table_get(&cache->hosts, &last_key, key, len, dns_host_create, &name_length);
+}
+
+// Queue a host for the resolver threads, unless its answer is still fresh or it is queued already.
+static void dns_refresh(DnsCache *cache, DnsHost *host, uint64_t now) {
+    if (atomic_load_explicit(&host->answer, memory_order_acquire) != NULL &&
+        now < atomic_load_explicit(&host->expires_ns, memory_order_relaxed)) {
+        return;
+    }
+    bool expected = false;
+    if (atomic_load_explicit(&host->resolving, memory_order_relaxed) ||
+        !atomic_compare_exchange_strong(&host->resolving, &expected, true)) {
+        return;
+    }
+    pthread_mutex_lock(&cache->queue_lock);
+    host->queued_next = NULL;
+    if (cache->queue_tail != NULL) {
+        cache->queue_tail->queued_next = host;
+    } else {
+        cache->queue_head = host;
+    }
+    cache->queue_tail = host;
+    pthread_cond_signal(&cache->queue_ready);
+    pthread_mutex_unlock(&cache->queue_lock);
+}
+
+// Load the names /etc/hosts lists, lowercased, as "\nname\nname\n...", so that dns_resolve_host() can
+// leave them to getaddrinfo(). Returns NULL if the file cannot be read.
+static char *dns_load_hosts_file() {
+    FILE *file = fopen("/etc/hosts", "r");
+    if (file == NULL) {
+        return NULL;
+    }
+    size_t used = 1, capacity = 256;
+    char *names = dns_alloc(capacity);
+    names[0] = '\n';
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "#")] = '\0';
+        char *field = strtok(line, " \t\r\n");
+        // The first field is the address; every other one names it
+        while ((field = strtok(NULL, " \t\r\n")) != NULL) {
+            size_t len = strlen(field);
+            if (used + len + 2 > capacity) {
+                capacity = 2 * (used + len + 2);
+                char *grown = realloc(names, capacity);
+                if (grown == NULL) {
+                    fprintf(stderr, "Failed to allocate memory for the DNS cache\n");
+                    exit(1);
+                }
+                names = grown;
+            }
+            for (size_t i = 0; i < len; i++) {
+                names[used++] = (char)(field[i] >= 'A' && field[i] <= 'Z' ? field[i] | 0x20 : field[i]);
+            }
+            names[used++] = '\n';
+        }
+    }
+    names[used] = '\0';
+    fclose(file);
+    return names;
+}
+
+// Whether /etc/hosts lists a name (which canonical URLs have in lowercase).
+static bool dns_in_hosts_file(DnsCache *cache, const char *name, size_t len) {
+    char needle[DNS_NAME_MAX + 3];
+    if (cache->hosts_file == NULL) {
+        return false;
+    }
+    needle[0] = '\n';
+    memcpy(needle + 1, name, len);
+    needle[len + 1] = '\n';
+    needle[len + 2] = '\0';
+    return strstr(cache->hosts_file, needle) != NULL;
+}
+
+// Ask the name server for the A records of a name, appending at most DNS_MAX_ADDRESSES addresses to
+// *p, comma-separated, and storing the smallest TTL in the answer in *ttl. Returns the number of
+// addresses. The addresses and their TTL come from one query, so each lookup costs one round trip.
+static int dns_query(const char *name, char **p, uint32_t *ttl) {
+    struct __res_state state;
+    memset(&state, 0, sizeof(state));
+    if (res_ninit(&state) != 0) {
+        return 0;
+    }
+    unsigned char *response = dns_alloc(DNS_RESPONSE_MAX);
+    int count = 0;
+    *ttl = UINT32_MAX;
+    int len = res_nsearch(&state, name, ns_c_in, ns_t_a, response, DNS_RESPONSE_MAX);
+    ns_msg message;
+    if (len > 0 && ns_initparse(response, len < DNS_RESPONSE_MAX ? len : DNS_RESPONSE_MAX, &message) == 0) {
+        for (int i = 0; i < ns_msg_count(message, ns_s_an); i++) {
+            ns_rr record;
+            if (ns_parserr(&message, ns_s_an, i, &record) != 0) {
+                continue;
+            }
+            if (ns_rr_ttl(record) < *ttl) {
+                *ttl = ns_rr_ttl(record); // CNAMEs count too: the chain expires with its first link
+            }
+            char address[INET_ADDRSTRLEN];
+            if (ns_rr_type(record) == ns_t_a && ns_rr_rdlen(record) == 4 && count < DNS_MAX_ADDRESSES &&
+                inet_ntop(AF_INET, ns_rr_rdata(record), address, sizeof(address)) != NULL) {
+                *p += sprintf(*p, "%s%s", count > 0 ? "," : "", address);
+                count++;
+            }
+        }
+    }
+    free(response);
+    res_nclose(&state);
+    return count;
+}
+
+// Resolve a name with getaddrinfo(), appending at most DNS_MAX_ADDRESSES addresses to *p in the order
+// it sorted them, IPv6 ones in brackets. Returns the number of addresses and stores the error of
+// getaddrinfo() in *error.
+static int dns_getaddrinfo(const char *name, const char *port, char **p, int *error) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *result = NULL;
+    *error = getaddrinfo(name, port, &hints, &result);
+    int count = 0;
+    for (struct addrinfo *ai = *error == 0 ? result : NULL; ai != NULL && count < DNS_MAX_ADDRESSES; ai = ai->ai_next) {
+        char address[INET6_ADDRSTRLEN];
+        const void *raw = ai->ai_family == AF_INET ? (const void *)&((struct sockaddr_in *)ai->ai_addr)->sin_addr
+                        : ai->ai_family == AF_INET6 ? (const void *)&((struct sockaddr_in6 *)ai->ai_addr)->sin6_addr
+                        : NULL;
+        if (raw == NULL || inet_ntop(ai->ai_family, raw, address, sizeof(address)) == NULL) {
+            continue;
+        }
+        *p += sprintf(*p, ai->ai_family == AF_INET6 ? "%s[%s]" : "%s%s", count > 0 ? "," : "", address);
+        count++;
+    }
+    if (result != NULL) {
+        freeaddrinfo(result);
+    }
+    return count;
+}
+
+/**
+ * @brief Resolve a queued host and publish the answer.
+ *
+ * Called by the resolver thread that took the host off the queue. The host's A records are asked for
+ * with one query, which also gives their TTL, clamped to DNS_MIN_TTL and DNS_MAX_TTL. Names listed in
+ * /etc/hosts, and names with no A record (IPv6-only hosts, names the name server does not know, or
+ * no name server at all), are resolved with getaddrinfo() instead and kept for DNS_DEFAULT_TTL. A
+ * failed lookup does not replace a good answer: the old addresses are kept for DNS_NEGATIVE_TTL, since
+ * a name server that stops answering is more likely than a host that vanished.
+ *
+ * The answer is published, and the one it replaces freed, under the host's shard lock, which
+ * dns_lookup() holds while it copies an answer, so no reader can still be using the freed one.
+ */
+static void dns_resolve_host(DnsCache *cache, DnsHost *host) {
+    char name[DNS_NAME_MAX + 1];
+    memcpy(name, host->key, host->name_length);
+    name[host->name_length] = '\0';
+    const char *port = host->key + host->name_length + 1;
+
+    // "host:port:" followed by the addresses, which fits in DNS_ENTRY_MAX
+    size_t length = host->entry.length;
+    DnsAnswer *answer = dns_alloc(sizeof(DnsAnswer) + length + 1 + DNS_MAX_ADDRESSES * (INET6_ADDRSTRLEN + 3));
+    memcpy(answer->entry, host->key, length);
+    char *p = answer->entry + length;
+    *p++ = ':';
+    atomic_fetch_add(&cache->lookups, 1);
+    uint32_t ttl = 0;
+    int error = 0;
+    int count = dns_in_hosts_file(cache, name, host->name_length) ? 0 : dns_query(name, &p, &ttl);
+    if (count > 0) {
+        ttl = ttl < DNS_MIN_TTL ? DNS_MIN_TTL : ttl > DNS_MAX_TTL ? DNS_MAX_TTL : ttl;
+    } else {
+        count = dns_getaddrinfo(name, port, &p, &error);
+        ttl = DNS_DEFAULT_TTL;
+    }
+    *p = '\0';
+
+    answer->failed = count == 0;
+    if (answer->failed) {
+        atomic_fetch_add(&cache->failures, 1);
+        answer->entry[0] = '\0';
+        // A name that does not exist stays that way for a while; a server that did not answer may soon
+        ttl = error == 0 || error == EAI_NONAME || error == EAI_FAIL ? DNS_NEGATIVE_TTL : DNS_RETRY_TTL;
+    }
+
+    HostTableShard *shard = host_table_shard(&cache->hosts, host->entry.hash);
+    pthread_mutex_lock(&shard->lock);
+    DnsAnswer *previous = atomic_load_explicit(&host->answer, memory_order_acquire);
+    if (answer->failed && previous != NULL && !previous->failed) {
+        previous = answer; // Keep serving the last good addresses
+        ttl = DNS_NEGATIVE_TTL;
+    } else {
+        atomic_store_explicit(&host->answer, answer, memory_order_release);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    free(previous);
+    atomic_store_explicit(&host->expires_ns, now_ns() + ttl * 1000000000ull, memory_order_relaxed);
+    atomic_store(&host->resolving, false);
+}
+
+// Resolver thread: resolve queued hosts until the cache is closed.
+static void *dns_resolver(void *arg) {
+    DnsCache *cache = (DnsCache *)arg;
+    pthread_mutex_lock(&cache->queue_lock);
+    for (;;) {
+        while (cache->queue_head == NULL && !cache->closed) {
+            pthread_cond_wait(&cache->queue_ready, &cache->queue_lock);
+        }
+        if (cache->closed) {
+            break;
+        }
+        DnsHost *host = cache->queue_head;
+        cache->queue_head = host->queued_next;
+        if (cache->queue_head == NULL) {
+            cache->queue_tail = NULL;
+        }
+        pthread_mutex_unlock(&cache->queue_lock);
+        dns_resolve_host(cache, host);
+        pthread_mutex_lock(&cache->queue_lock);
+    }
+    pthread_mutex_unlock(&cache->queue_lock);
+    return NULL;
+}
+
+static void dns_host_free(HostEntry *entry) {
+    DnsHost *host = (DnsHost *)entry;
+    free(atomic_load(&host->answer));
+    free(host);
+}
+
+bool dns_init(DnsCache *cache, int resolvers) {
+    atomic_init(&cache->lookups, 0);
+    atomic_init(&cache->failures, 0);
+    atomic_init(&cache->hits, 0);
+    atomic_init(&cache->misses, 0);
+    atomic_init(&cache->negative_hits, 0);
+    host_table_init(&cache->hosts, DNS_SHARD_BITS, "the DNS cache");
+    pthread_mutex_init(&cache->queue_lock, NULL);
+    pthread_cond_init(&cache->queue_ready, NULL);
+    cache->queue_head = NULL;
+    cache->queue_tail = NULL;
+    cache->closed = false;
+    cache->hosts_file = dns_load_hosts_file();
+
+    cache->resolvers = dns_alloc(sizeof(pthread_t) * (size_t)resolvers);
+    cache->resolver_count = 0;
+    for (int i = 0; i < resolvers; i++) {
+        if (pthread_create(&cache->resolvers[cache->resolver_count], NULL, dns_resolver, cache) != 0) {
+            break;
+        }
+        cache->resolver_count++;
+    }
+    if (cache->resolver_count == 0) {
+        dns_destroy(cache);
+        return false;
+    }
+    return true;
+}
+
+void dns_destroy(DnsCache *cache) {
+    pthread_mutex_lock(&cache->queue_lock);
+    cache->closed = true;
+    pthread_cond_broadcast(&cache->queue_ready);
+    pthread_mutex_unlock(&cache->queue_lock);
+    for (int i = 0; i < cache->resolver_count; i++) {
+        pthread_join(cache->resolvers[i], NULL);
+    }
+    free(cache->resolvers);
+    pthread_mutex_destroy(&cache->queue_lock);
+    pthread_cond_destroy(&cache->queue_ready);
+
+    host_table_destroy(&cache->hosts, dns_host_free);
+    free(cache->hosts_file);
+    last_key.table = NULL;
+}
+
+void dns_prefetch(DnsCache *cache, const char *url) {
+    DnsHost *host = dns_host(cache, url);
+    if (host != NULL) {
+        dns_refresh(cache, host, now_ns());
+    }
+}
+
+DnsStatus dns_lookup(DnsCache *cache, const char *url, char *entry) {
+    DnsHost *host = dns_host(cache, url);
+    if (host == NULL) {
+        return DNS_UNKNOWN;
+    }
+    uint64_t now = now_ns();
+    dns_refresh(cache, host, now);
+    if (atomic_load_explicit(&host->answer, memory_order_relaxed) == NULL) {
+        atomic_fetch_add_explicit(&cache->misses, 1, memory_order_relaxed);
+        return DNS_UNKNOWN;
+    }
+
+    // The answer is freed once replaced, so it is only read under the shard lock
+    DnsStatus status = DNS_RESOLVED;
+    HostTableShard *shard = host_table_shard(&cache->hosts, host->entry.hash);
+    pthread_mutex_lock(&shard->lock);
+    DnsAnswer *answer = atomic_load_explicit(&host->answer, memory_order_acquire);
+    if (answer->failed) {
+        // Once the failure has expired the name is being looked up again; meanwhile libcurl may try
+        status = now < atomic_load_explicit(&host->expires_ns, memory_order_relaxed) ? DNS_FAILED : DNS_UNKNOWN;
+    } else {
+        strcpy(entry, answer->entry);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    atomic_fetch_add_explicit(status == DNS_RESOLVED ? &cache->hits :
+                              status == DNS_FAILED ? &cache->negative_hits : &cache->misses,
+                              1, memory_order_relaxed);
+    return status;
+}
+
+size_t dns_hosts(DnsCache *cache) {
+    return host_table_count(&cache->hosts);
+}
@@ -0,0 +1,105 @@
+#ifndef DNS_H
+#define DNS_H
+
+// Include size types.
+#include <stddef.h>
+// Include fixed-width integer types.
+#include <stdint.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+// Include atomic types for the published answers and the counters.
+#include <stdatomic.h>
+// Include the pthread library for the queue lock and the resolver threads.
+#include <pthread.h>
+// Include the sharded host table.
+#include "hosttable.h"
+
+// Define the number of bits of the host hash that pick a shard, and the resulting number of shards.
+#define DNS_SHARD_BITS 6
+#define DNS_SHARDS (1 << DNS_SHARD_BITS)
+// Define the default number of resolver threads.
+#define DNS_DEFAULT_RESOLVERS 4
+// Define the bounds (in seconds) the TTL of a record is clamped to, and the TTL used when the record's
+// own TTL cannot be learned (e.g. for names from /etc/hosts).
+#define DNS_MIN_TTL 30
+#define DNS_MAX_TTL (24 * 60 * 60)
+#define DNS_DEFAULT_TTL 300
+// Define how long (in seconds) a name that does not exist is remembered as such, and how long a lookup
+// that failed for another reason (no answer from the name server) is.
+#define DNS_NEGATIVE_TTL 60
+#define DNS_RETRY_TTL 5
+// Define the most addresses kept for one host.
+#define DNS_MAX_ADDRESSES 8
+// Define the size of the buffer dns_lookup() copies an entry into, enough for the longest host name and
+// port followed by DNS_MAX_ADDRESSES IPv6 addresses.
+#define DNS_ENTRY_MAX 1024
+
+// What is known about the host of a URL.
+typedef enum {
+    DNS_UNKNOWN,                     // Not resolved yet (now queued), or an IP literal: let libcurl resolve it
+    DNS_RESOLVED,                    // The addresses are known
+    DNS_FAILED                       // The name did not resolve, recently
+} DnsStatus;
+
+// One answer for a host, immutable once published.
+typedef struct DnsAnswer {
+    bool failed;
+    char entry[];                    // "host:port:address,..." as CURLOPT_RESOLVE takes it, or ""
+} DnsAnswer;
+
+// The DNS state of one host and port.
+typedef struct DnsHost {
+    HostEntry entry;                 // Keyed by "host:port"
+    struct DnsHost *queued_next;     // Next host waiting for a resolver thread
+    _Atomic(DnsAnswer *) answer;     // Current answer, or NULL until the first lookup finished; only
+                                     // read or replaced under the host's shard lock, except to test it
+    atomic_bool resolving;           // Set while the host is queued or being resolved
+    _Atomic uint64_t expires_ns;     // Monotonic time after which the answer is looked up again
+    size_t name_length;              // Length of the host name in key
+    char key[];                      // e.g. "example.com:443"
+} DnsHost;
+
+/**
+ * @brief Shared cache of resolved host names, filled in the background.
+ *
+ * dns_prefetch() is called for every URL as it is queued: a host that is new or whose answer has
+ * expired is handed to a pool of resolver threads, so that by the time the URL is dequeued its
+ * addresses are usually known and its transfer can be given them through CURLOPT_RESOLVE instead of
+ * resolving the name itself. An answer is kept for the TTL of its record, clamped to DNS_MIN_TTL and
+ * DNS_MAX_TTL; an expired answer stays in use while it is looked up again, and keeps being used for
+ * DNS_NEGATIVE_TTL more if that lookup fails. A name that does not resolve is remembered as failed for
+ * DNS_NEGATIVE_TTL, so its other URLs fail at once instead of each waiting for the name server.
+ * An answer is replaced, and the one it replaces freed, under the lock of the host's shard, which
+ * dns_lookup() holds while it copies the answer out.
+ */
+typedef struct {
+    HostTable hosts;                 // DnsHost records
+    pthread_mutex_t queue_lock;      // Protects the queue of hosts to resolve
+    pthread_cond_t queue_ready;
+    DnsHost *queue_head;
+    DnsHost *queue_tail;
+    bool closed;                     // Set when the resolver threads should exit
+    char *hosts_file;                // Names listed in /etc/hosts (see dns_resolve_host), or NULL
+    pthread_t *resolvers;
+    int resolver_count;
+    atomic_ulong lookups;            // Names resolved by the resolver threads
+    atomic_ulong failures;           // Lookups that found no address
+    atomic_ulong hits;               // Transfers that were given the addresses of their host
+    atomic_ulong misses;             // Transfers whose host was not resolved yet
+    atomic_ulong negative_hits;      // Transfers failed at once because their host did not resolve
+} DnsCache;
+
+// Initialize an empty cache and start its resolver threads. Returns false if no thread could be started.
+bool dns_init(DnsCache *cache, int resolvers);
+// Stop the resolver threads and free the cache and every answer.
+void dns_destroy(DnsCache *cache);
+// Queue the host of a canonical http or https URL for resolution if its answer is missing or expired.
+void dns_prefetch(DnsCache *cache, const char *url);
+// What is known about the host of a canonical http or https URL. If it is DNS_RESOLVED, its
+// CURLOPT_RESOLVE entry is copied into entry, which holds DNS_ENTRY_MAX bytes. Queues the host like
+// dns_prefetch().
+DnsStatus dns_lookup(DnsCache *cache, const char *url, char *entry);
+// Number of hosts seen.
+size_t dns_hosts(DnsCache *cache);
+
+#endif
@@ -0,0 +1,226 @@
+// Include the frontier interface.
+#include "frontier.h"
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include integer types used for sequence arithmetic.
+#include <stdint.h>
+
+// Define how many overflow nodes a consumer moves back into the ring at once.
+#define OVERFLOW_REFILL_BATCH 256
+
+void initQueue(URLQueue *queue) {
+    queue->slots = malloc(FRONTIER_CAPACITY * sizeof(FrontierSlot));
+    if (queue->slots == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the URL frontier\n");
+        exit(1);
+    }
+    queue->mask = FRONTIER_CAPACITY - 1;
+    // Slot i is free for the producer that claims position i
+    for (size_t i = 0; i < FRONTIER_CAPACITY; i++) {
+        atomic_init(&queue->slots[i].sequence, i);
+        queue->slots[i].node = NULL;
+    }
+    atomic_init(&queue->enqueue_pos, 0);
+    atomic_init(&queue->dequeue_pos, 0);
+    pthread_mutex_init(&queue->overflow_lock, NULL);
+    queue->overflow_head = queue->overflow_tail = NULL;
+    queue->pending_head = queue->pending_tail = NULL;
+    queue->pending_count = 0;
+    atomic_init(&queue->overflow_count, 0);
+    queue->spilling = false;
+}
+
+bool frontier_enable_spill(URLQueue *queue, const char *dir) {
+    if (!spill_init(&queue->spill, dir)) {
+        return false;
+    }
+    queue->spilling = true;
+    return true;
+}
+
+static void free_list(URLQueueNode *node) {
+    while (node != NULL) {
+        URLQueueNode *next = node->next;
+        node_free(node);
+        node = next;
+    }
+}
+
+// Claim the next free slot and publish the node in it. Returns false if the ring is full.
+static bool ring_push(URLQueue *queue, URLQueueNode *node) {
+    size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    FrontierSlot *slot;
+    while (true) {
+        slot = &queue->slots[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            // The slot is free for this position; try to claim it
+            if (atomic_compare_exchange_weak(&queue->enqueue_pos, &pos, pos + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; // The consumer of the previous lap has not freed the slot: the ring is full
+        } else {
+            pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed); // Another producer won
+        }
+    }
+    slot->node = node;
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release); // Hand the slot to consumers
+    return true;
+}
+
+// Claim the oldest published slot and take its node. Returns NULL if there is none.
+static URLQueueNode *ring_pop(URLQueue *queue) {
+    size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    FrontierSlot *slot;
+    while (true) {
+        slot = &queue->slots[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak(&queue->dequeue_pos, &pos, pos + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return NULL; // Nothing has been published at this position yet
+        } else {
+            pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    URLQueueNode *node = slot->node;
+    // Free the slot for the producer one lap ahead
+    atomic_store_explicit(&slot->sequence, pos + queue->mask + 1, memory_order_release);
+    return node;
+}
+
+void queue_destroy(URLQueue *queue) {
+    // Free what is in memory; nodes still on disk go away with their segment files
+    URLQueueNode *node;
+    while ((node = ring_pop(queue)) != NULL) {
+        node->next = NULL;
+        free_list(node);
+    }
+    free_list(queue->overflow_head);
+    free_list(queue->pending_head);
+    if (queue->spilling) {
+        spill_destroy(&queue->spill);
+    }
+    free(queue->slots);
+    pthread_mutex_destroy(&queue->overflow_lock);
+}
+
+void frontier_push_overflow(URLQueue *queue, URLQueueNode *node) {
+    node->next = NULL;
+    pthread_mutex_lock(&queue->overflow_lock);
+    if (queue->pending_tail) {
+        queue->pending_tail->next = node;
+    } else {
+        queue->pending_head = node;
+    }
+    queue->pending_tail = node;
+    queue->pending_count++;
+    atomic_fetch_add(&queue->overflow_count, 1);
+    // Move a full batch to disk in one sequential write
+    if (queue->spilling && queue->pending_count >= SPILL_WRITE_BATCH) {
+        spill_write(&queue->spill, queue->pending_head);
+        queue->pending_head = queue->pending_tail = NULL;
+        queue->pending_count = 0;
+    }
+    pthread_mutex_unlock(&queue->overflow_lock);
+}
+
+void frontier_push(URLQueue *queue, URLQueueNode *node) {
+    // Once anything has overflowed, keep appending to the overflow list until it drains so older
+    // nodes are not overtaken by newer ones
+    if (atomic_load(&queue->overflow_count) != 0 || !ring_push(queue, node)) {
+        frontier_push_overflow(queue, node);
+    }
+}
+
+URLQueueNode *frontier_pop(URLQueue *queue) {
+    URLQueueNode *node = ring_pop(queue);
+    if (node != NULL || atomic_load(&queue->overflow_count) == 0) {
+        return node;
+    }
+
+    // The ring is drained but the overflow is not: take its head and move a batch into the ring
+    pthread_mutex_lock(&queue->overflow_lock);
+    if (queue->overflow_head == NULL) {
+        if (queue->spilling && queue->spill.records > 0) {
+            // Disk holds the oldest overflow; read the next batch of it back
+            spill_read(&queue->spill, SPILL_READ_BATCH, &queue->overflow_head, &queue->overflow_tail);
+        } else {
+            // Nothing on disk: the pending list is next in line
+            queue->overflow_head = queue->pending_head;
+            queue->overflow_tail = queue->pending_tail;
+            queue->pending_head = queue->pending_tail = NULL;
+            queue->pending_count = 0;
+        }
+    }
+    node = queue->overflow_head;
+    if (node != NULL) {
+        URLQueueNode *cur = node->next;
+        size_t moved = 1;
+        while (cur != NULL && moved < OVERFLOW_REFILL_BATCH) {
+            URLQueueNode *next = cur->next;
+            if (!ring_push(queue, cur)) {
+                break;
+            }
+            cur = next;
+            moved++;
+        }
+        queue->overflow_head = cur;
+        if (cur == NULL) {
+            queue->overflow_tail = NULL;
+        }
+        atomic_fetch_sub(&queue->overflow_count, moved);
+    }
+    pthread_mutex_unlock(&queue->overflow_lock);
+    return node;
+}
+
+bool frontier_empty(URLQueue *queue) {
+    return atomic_load(&queue->enqueue_pos) == atomic_load(&queue->dequeue_pos) &&
+           atomic_load(&queue->overflow_count) == 0;
+}
+
+size_t frontier_size(URLQueue *queue) {
+    size_t enqueued = atomic_load(&queue->enqueue_pos);
+    size_t dequeued = atomic_load(&queue->dequeue_pos);
+    return (enqueued > dequeued ? enqueued - dequeued : 0) + atomic_load(&queue->overflow_count);
+}
+
+// Write a list of nodes as records.
+static bool save_list(const URLQueueNode *node, FILE *out, size_t *count) {
+    for (; node != NULL; node = node->next) {
+        if (spill_record_write(out, node) == 0) {
+            return false;
+        }
+        (*count)++;
+    }
+    return true;
+}
+
+bool frontier_save(URLQueue *queue, FILE *out, const SpillSnapshot *spill, size_t *count) {
+    // Oldest first: the ring, the head list, disk, then the pending list
+    size_t end = atomic_load(&queue->enqueue_pos);
+    for (size_t pos = atomic_load(&queue->dequeue_pos); pos != end; pos++) {
+        if (spill_record_write(out, queue->slots[pos & queue->mask].node) == 0) {
+            return false;
+        }
+        (*count)++;
+    }
+    if (!save_list(queue->overflow_head, out, count)) {
+        return false;
+    }
+    if (spill != NULL) {
+        if (!spill_snapshot_copy(spill, out)) {
+            return false;
+        }
+        *count += spill->records;
+    }
+    return save_list(queue->pending_head, out, count);
+}
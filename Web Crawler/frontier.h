@@ -0,0 +1,83 @@
+#ifndef FRONTIER_H
+#define FRONTIER_H
+
+// Include size types.
+#include <stddef.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+// Include the pthread library for the overflow list lock.
+#include <pthread.h>
+// Include atomic types for the lock-free ring.
+#include <stdatomic.h>
+// Include the disk spill store for the overflow.
+#include "spill.h"
+// Include the queue node definition and its allocator.
+#include "nodepool.h"
+
+// Define the number of slots in the lock-free ring. Must be a power of two.
+#define FRONTIER_CAPACITY (1 << 16)
+// Define the size of a cache line, used to keep producer and consumer counters apart.
+#define CACHE_LINE_SIZE 64
+// Define how many overflow nodes are collected in memory before they are written to disk together.
+#define SPILL_WRITE_BATCH 4096
+// Define how many nodes are read back from disk at once.
+#define SPILL_READ_BATCH 4096
+
+// One ring slot. The sequence number tells producers and consumers whose turn the slot is.
+typedef struct {
+    atomic_size_t sequence;
+    URLQueueNode *node;
+} FrontierSlot;
+
+/**
+ * @brief The URL frontier: a bounded lock-free multi-producer/multi-consumer ring.
+ *
+ * The ring is the algorithm by Dmitry Vyukov: each slot carries a sequence number, so a push or pop is
+ * a single compare-and-swap on the shared position followed by a store to the slot. Nodes pushed while
+ * the ring is full go to a mutex-protected overflow list, which is moved back into the ring in batches
+ * as it drains, so the frontier as a whole stays unbounded. Blocking consumers is left to the scheduler,
+ * which parks workers until any of its queues, this one included, has work.
+ *
+ * The overflow is kept in up to three parts, oldest first: the head list being moved into the ring, the
+ * spill store on disk, and the pending list that new overflow is appended to. Without a spill store the
+ * pending list simply becomes the head list once that drains. With one (frontier_enable_spill), the
+ * pending list is written to disk every SPILL_WRITE_BATCH nodes and the head list is refilled from disk
+ * SPILL_READ_BATCH nodes at a time, so the frontier's memory stays bounded by the ring and two batches
+ * however many URLs are queued.
+ */
+typedef struct {
+    FrontierSlot *slots;                                  // FRONTIER_CAPACITY ring slots
+    size_t mask;                                          // FRONTIER_CAPACITY - 1
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t enqueue_pos;  // Next slot a producer claims
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t dequeue_pos;  // Next slot a consumer claims
+    _Alignas(CACHE_LINE_SIZE) pthread_mutex_t overflow_lock;
+    URLQueueNode *overflow_head, *overflow_tail;          // Oldest overflow, next to move into the ring
+    URLQueueNode *pending_head, *pending_tail;            // Newest overflow, not yet on disk
+    size_t pending_count;
+    atomic_size_t overflow_count;                         // Nodes in both lists and on disk
+    bool spilling;                                        // Whether the spill store is in use
+    SpillStore spill;
+} URLQueue;
+
+// Initialize a URL queue.
+void initQueue(URLQueue *queue);
+// Free the ring and any nodes still queued, and delete any spill segments.
+void queue_destroy(URLQueue *queue);
+// Spill overflow to segment files in dir instead of keeping it in memory. Returns false on failure.
+bool frontier_enable_spill(URLQueue *queue, const char *dir);
+// Add a node to the queue.
+void frontier_push(URLQueue *queue, URLQueueNode *node);
+// Add a node behind everything queued, bypassing the ring. With a spill store it goes to disk with the
+// next batch.
+void frontier_push_overflow(URLQueue *queue, URLQueueNode *node);
+// Remove a node from the queue without blocking. Returns NULL if the queue is empty.
+URLQueueNode *frontier_pop(URLQueue *queue);
+// Check whether the queue is empty. The answer may be stale by the time the caller acts on it.
+bool frontier_empty(URLQueue *queue);
+// Approximate number of queued nodes, for monitoring.
+size_t frontier_size(URLQueue *queue);
+// Write every queued node as a SpillRecord, including those on disk as captured by spill (NULL if the
+// queue does not spill). Nothing may push or pop meanwhile. Adds the number of records to *count.
+bool frontier_save(URLQueue *queue, FILE *out, const SpillSnapshot *spill, size_t *count);
+
+#endif
@@ -0,0 +1,144 @@
+// Include the host table interface.
+#include "hosttable.h"
+// Include the URL hash shared with the visited set.
+#include "visited.h"
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+
+// Define the initial number of hash buckets per shard. Must be a power of two.
+#define HOST_TABLE_BUCKETS_INITIAL 64
+
+void host_table_init(HostTable *table, int shard_bits, const char *owner) {
+    size_t shards = (size_t)1 << shard_bits;
+    table->shard_bits = shard_bits;
+    table->owner = owner;
+    table->shards = aligned_alloc(_Alignof(HostTableShard), shards * sizeof(HostTableShard));
+    if (table->shards == NULL) {
+        fprintf(stderr, "Failed to allocate memory for %s\n", owner);
+        exit(1);
+    }
+    for (size_t i = 0; i < shards; i++) {
+        HostTableShard *shard = &table->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->bucket_count = HOST_TABLE_BUCKETS_INITIAL;
+        shard->buckets = calloc(shard->bucket_count, sizeof(HostEntry *));
+        if (shard->buckets == NULL) {
+            fprintf(stderr, "Failed to allocate memory for %s\n", owner);
+            exit(1);
+        }
+        shard->count = 0;
+    }
+}
+
+void host_table_destroy(HostTable *table, void (*visit)(HostEntry *entry)) {
+    for (size_t i = 0; i < (size_t)1 << table->shard_bits; i++) {
+        HostTableShard *shard = &table->shards[i];
+        for (size_t b = 0; visit != NULL && b < shard->bucket_count; b++) {
+            HostEntry *entry = shard->buckets[b];
+            while (entry != NULL) {
+                HostEntry *next = entry->next;
+                visit(entry);
+                entry = next;
+            }
+        }
+        free(shard->buckets);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    free(table->shards);
+}
+
+HostTableShard *host_table_shard(HostTable *table, uint64_t hash) {
+    return &table->shards[hash >> (64 - table->shard_bits)];
+}
+
+bool host_entry_is(const HostEntry *entry, const char *key, size_t len) {
+    return entry->length == len && memcmp(entry->key, key, len) == 0;
+}
+
+HostEntry *host_table_find(HostTableShard *shard, const char *key, size_t len, uint64_t hash) {
+    for (HostEntry *entry = shard->buckets[hash & (shard->bucket_count - 1)]; entry != NULL; entry = entry->next) {
+        if (entry->hash == hash && host_entry_is(entry, key, len)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Double a shard's bucket array. Called with the shard locked.
+static void host_table_grow(HostTableShard *shard) {
+    size_t count = shard->bucket_count * 2;
+    HostEntry **buckets = calloc(count, sizeof(HostEntry *));
+    if (buckets == NULL) {
+        return; // Keep the longer chains
+    }
+    for (size_t b = 0; b < shard->bucket_count; b++) {
+        HostEntry *entry = shard->buckets[b];
+        while (entry != NULL) {
+            HostEntry *next = entry->next;
+            size_t index = entry->hash & (count - 1);
+            entry->next = buckets[index];
+            buckets[index] = entry;
+            entry = next;
+        }
+    }
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->bucket_count = count;
+}
+
+void host_table_insert(HostTableShard *shard, HostEntry *entry) {
+    HostEntry **bucket = &shard->buckets[entry->hash & (shard->bucket_count - 1)];
+    entry->next = *bucket;
+    *bucket = entry;
+    if (++shard->count > shard->bucket_count) {
+        host_table_grow(shard);
+    }
+}
+
+HostEntry *host_table_get(HostTable *table, HostTableHint *hint, const char *key, size_t len,
+                          HostEntry *(*create)(const char *key, size_t len, void *arg), void *arg) {
+    if (hint != NULL && hint->table == table && hint->entry != NULL && host_entry_is(hint->entry, key, len)) {
+        return hint->entry;
+    }
+    uint64_t hash = url_hash(key, len);
+    HostTableShard *shard = host_table_shard(table, hash);
+    pthread_mutex_lock(&shard->lock);
+    HostEntry *entry = host_table_find(shard, key, len, hash);
+    if (entry == NULL && create != NULL) {
+        entry = create(key, len, arg);
+        entry->hash = hash;
+        entry->length = len;
+        host_table_insert(shard, entry);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    if (hint != NULL && entry != NULL) {
+        hint->table = table;
+        hint->entry = entry;
+    }
+    return entry;
+}
+
+void host_table_each(HostTable *table, void (*visit)(HostEntry *entry, void *arg), void *arg) {
+    for (size_t i = 0; i < (size_t)1 << table->shard_bits; i++) {
+        HostTableShard *shard = &table->shards[i];
+        for (size_t b = 0; b < shard->bucket_count; b++) {
+            for (HostEntry *entry = shard->buckets[b]; entry != NULL; entry = entry->next) {
+                visit(entry, arg);
+            }
+        }
+    }
+}
+
+size_t host_table_count(HostTable *table) {
+    size_t count = 0;
+    for (size_t i = 0; i < (size_t)1 << table->shard_bits; i++) {
+        pthread_mutex_lock(&table->shards[i].lock);
+        count += table->shards[i].count;
+        pthread_mutex_unlock(&table->shards[i].lock);
+    }
+    return count;
+}
@@ -0,0 +1,79 @@
+#ifndef HOSTTABLE_H
+#define HOSTTABLE_H
+
+// Include size types.
+#include <stddef.h>
+// Include fixed-width integer types.
+#include <stdint.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+// Include the pthread library for the shard locks.
+#include <pthread.h>
+
+// A record kept in a HostTable. It is the first member of the record, so a found entry is cast back to
+// the record that holds it.
+typedef struct HostEntry {
+    struct HostEntry *next;          // Next entry in the same hash bucket
+    uint64_t hash;                   // url_hash() of the key
+    size_t length;
+    const char *key;                 // Host, origin or "host:port"; points into the record
+} HostEntry;
+
+// One shard: a lock and a hash table of entries.
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    HostEntry **buckets;
+    size_t bucket_count;             // A power of two
+    size_t count;
+} HostTableShard;
+
+// The entry a thread found last in a table (see host_table_get).
+typedef struct {
+    const void *table;
+    HostEntry *entry;
+} HostTableHint;
+
+/**
+ * @brief A sharded hash table of hosts, the index of the per-host queues, the robots.txt cache and
+ * the DNS cache.
+ *
+ * Entries are spread over 2^shard_bits independently locked shards by the top bits of their hash, each
+ * a chained table that doubles its buckets once it holds more entries than buckets. Entries are only
+ * ever added; the table's owner allocates and frees them.
+ */
+typedef struct {
+    HostTableShard *shards;
+    int shard_bits;
+    const char *owner;               // Named in the message printed when memory runs out
+} HostTable;
+
+// Initialize an empty table with 2^shard_bits shards. owner names the table in out-of-memory messages,
+// e.g. "the DNS cache"; running out of memory exits.
+void host_table_init(HostTable *table, int shard_bits, const char *owner);
+// Free the table. visit (if not NULL) is called for every entry first, and may free it.
+void host_table_destroy(HostTable *table, void (*visit)(HostEntry *entry));
+// The shard a hash belongs to.
+HostTableShard *host_table_shard(HostTable *table, uint64_t hash);
+// Find an entry in its shard, which the caller has locked. Returns NULL if there is none.
+HostEntry *host_table_find(HostTableShard *shard, const char *key, size_t len, uint64_t hash);
+// Add an entry whose hash, length and key are set to the shard the caller has locked.
+void host_table_insert(HostTableShard *shard, HostEntry *entry);
+/**
+ * @brief Find an entry, adding it if it is new.
+ *
+ * The entry hint remembers is tried first without a lock, so that the links of a page, which mostly
+ * share the page's host, skip the hash probe; pass a thread-local hint per table. If the key is not in
+ * the table and create is not NULL, create(key, len, arg) makes its record, which is added.
+ *
+ * @return The entry, or NULL if it is not there and create is NULL.
+ */
+HostEntry *host_table_get(HostTable *table, HostTableHint *hint, const char *key, size_t len,
+                          HostEntry *(*create)(const char *key, size_t len, void *arg), void *arg);
+// Call visit for every entry. The table must not change meanwhile.
+void host_table_each(HostTable *table, void (*visit)(HostEntry *entry, void *arg), void *arg);
+// Number of entries.
+size_t host_table_count(HostTable *table);
+// Whether an entry has the given key.
+bool host_entry_is(const HostEntry *entry, const char *key, size_t len);
+
+#endif
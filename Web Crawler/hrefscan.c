@@ -0,0 +1,544 @@
+// Include the href scanner interface.
+#include "hrefscan.h"
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+// Include fixed-width integer types.
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+// Include the SSE2 and AVX2 intrinsics.
+#include <immintrin.h>
+#define HREF_SCAN_X86 1
+#endif
+
+// Signature of a byte search: the first occurrence of c in [p, end), or end if there is none.
+typedef const char *(*FindByteFn)(const char *p, const char *end, char c);
+
+static const char *find_byte_scalar(const char *p, const char *end, char c) {
+    while (p < end && *p != c) {
+        p++;
+    }
+    return p;
+}
+
+#ifdef HREF_SCAN_X86
+static const char *find_byte_sse2(const char *p, const char *end, char c) {
+    const __m128i needle = _mm_set1_epi8(c);
+    // Compare 16 bytes at a time; the mask has one bit per matching byte
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)p);
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return find_byte_scalar(p, end, c);
+}
+
+__attribute__((target("avx2")))
+static const char *find_byte_avx2(const char *p, const char *end, char c) {
+    const __m256i needle = _mm256_set1_epi8(c);
+    while (end - p >= 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)p);
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return find_byte_sse2(p, end, c);
+}
+#endif
+
+// Byte search picked by href_scan_init().
+static FindByteFn find_byte = find_byte_scalar;
+
+HrefScanImpl href_scan_init(HrefScanImpl impl) {
+#ifdef HREF_SCAN_X86
+    __builtin_cpu_init();
+    if (impl == HREF_SCAN_AUTO) {
+        impl = HREF_SCAN_SSE2; // Faster than AVX2 on HTML; see hrefscan.h
+    }
+    if (impl == HREF_SCAN_AVX2 && !__builtin_cpu_supports("avx2")) {
+        impl = HREF_SCAN_SSE2;
+    }
+#else
+    impl = HREF_SCAN_SCALAR;
+#endif
+    switch (impl) {
+#ifdef HREF_SCAN_X86
+        case HREF_SCAN_AVX2: find_byte = find_byte_avx2; break;
+        case HREF_SCAN_SSE2: find_byte = find_byte_sse2; break;
+#endif
+        default: impl = HREF_SCAN_SCALAR; find_byte = find_byte_scalar; break;
+    }
+    return impl;
+}
+
+const char *href_scan_impl_name(HrefScanImpl impl) {
+    switch (impl) {
+        case HREF_SCAN_AVX2: return "avx2";
+        case HREF_SCAN_SSE2: return "sse2";
+        case HREF_SCAN_SCALAR: return "scalar";
+        default: return "auto";
+    }
+}
+
+void href_scanner_init(HrefScanner *scanner) {
+    memset(scanner, 0, sizeof(HrefScanner));
+}
+
+void href_scanner_destroy(HrefScanner *scanner) {
+    free(scanner->buffer);
+    free(scanner->links);
+    free(scanner->carry);
+    memset(scanner, 0, sizeof(HrefScanner));
+}
+
+const char *href_scan_value(const HrefScanner *scanner, size_t i) {
+    return scanner->buffer + scanner->links[i].offset;
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+static bool is_alpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static bool is_alnum(char c) {
+    return is_alpha(c) || (c >= '0' && c <= '9');
+}
+
+// Value of a decimal or hexadecimal digit, or -1.
+static int digit_value(char c, bool hex) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (hex && (c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+        return (c | 0x20) - 'a' + 10;
+    }
+    return -1;
+}
+
+// Case-insensitive comparison of [p, p + len) with a lower-case word.
+static bool name_is(const char *p, size_t len, const char *word) {
+    if (strlen(word) != len) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = p[i];
+        if (c >= 'A' && c <= 'Z') {
+            c = (char)(c - 'A' + 'a');
+        }
+        if (c != word[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Find the case-insensitive end tag "</name" at or after p. Returns NULL if there is none.
+static const char *find_end_tag(const char *p, const char *end, const char *name) {
+    size_t len = strlen(name);
+    while ((p = find_byte(p, end, '<')) < end) {
+        if ((size_t)(end - p) >= len + 2 && p[1] == '/' && name_is(p + 2, len, name)) {
+            return p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+// Make room for n more bytes in the value buffer.
+static bool reserve(HrefScanner *scanner, size_t n) {
+    if (scanner->used + n <= scanner->capacity) {
+        return true;
+    }
+    size_t capacity = scanner->capacity ? scanner->capacity * 2 : 4096;
+    while (capacity < scanner->used + n) {
+        capacity *= 2;
+    }
+    char *buffer = realloc(scanner->buffer, capacity);
+    if (buffer == NULL) {
+        return false;
+    }
+    scanner->buffer = buffer;
+    scanner->capacity = capacity;
+    return true;
+}
+
+// Append a code point to the value buffer as UTF-8.
+static void put_utf8(char *out, size_t *n, unsigned long cp) {
+    if (cp < 0x80) {
+        out[(*n)++] = (char)cp;
+    } else if (cp < 0x800) {
+        out[(*n)++] = (char)(0xC0 | (cp >> 6));
+        out[(*n)++] = (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out[(*n)++] = (char)(0xE0 | (cp >> 12));
+        out[(*n)++] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[(*n)++] = (char)(0x80 | (cp & 0x3F));
+    } else {
+        out[(*n)++] = (char)(0xF0 | (cp >> 18));
+        out[(*n)++] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        out[(*n)++] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[(*n)++] = (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+/**
+ * @brief Decode an attribute value and record it as a link.
+ *
+ * Character references are decoded the way libxml2 does for the cases the scanner accepts. An '&' that
+ * is not followed by a name and ';' is kept literally, as in a query string like "?a=1&b=2".
+ *
+ * @return false if the value needs libxml2: a non-ASCII byte, a NUL, an entity outside the five XML
+ * ones, or a malformed numeric reference.
+ */
+static bool add_link(HrefScanner *scanner, const char *p, const char *end, bool base) {
+    // A decoded value is never longer than the raw one, and numeric references shrink too
+    if (!reserve(scanner, (size_t)(end - p) + 1)) {
+        return false;
+    }
+    char *out = scanner->buffer + scanner->used;
+    size_t n = 0;
+    while (p < end) {
+        unsigned char c = (unsigned char)*p;
+        if (c >= 0x80 || c == 0) {
+            return false; // Depends on the page's encoding, which only libxml2 works out
+        }
+        if (c != '&') {
+            out[n++] = (char)c;
+            p++;
+            continue;
+        }
+        const char *ref = p + 1;
+        if (ref < end && *ref == '#') {
+            // Numeric reference: &#DDD; or &#xHHH;
+            unsigned long cp = 0;
+            const char *digits = ref + 1;
+            bool hex = digits < end && (*digits == 'x' || *digits == 'X');
+            const char *q = hex ? digits + 1 : digits;
+            const char *first = q;
+            int digit;
+            while (q < end && q - first < 8 && (digit = digit_value(*q, hex)) >= 0) {
+                cp = cp * (hex ? 16 : 10) + (unsigned long)digit;
+                q++;
+            }
+            if (q == first || q >= end || *q != ';' || cp == 0 || cp > 0x10FFFF) {
+                return false;
+            }
+            put_utf8(out, &n, cp);
+            p = q + 1;
+            continue;
+        }
+        const char *q = ref;
+        while (q < end && is_alnum(*q)) {
+            q++;
+        }
+        if (q == ref || q >= end || *q != ';') {
+            out[n++] = '&'; // Not a reference
+            p++;
+            continue;
+        }
+        size_t len = (size_t)(q - ref);
+        if (name_is(ref, len, "amp")) {
+            out[n++] = '&';
+        } else if (name_is(ref, len, "lt")) {
+            out[n++] = '<';
+        } else if (name_is(ref, len, "gt")) {
+            out[n++] = '>';
+        } else if (name_is(ref, len, "quot")) {
+            out[n++] = '"';
+        } else if (name_is(ref, len, "apos")) {
+            out[n++] = '\'';
+        } else {
+            return false; // One of the HTML entities; leave it to libxml2
+        }
+        p = q + 1;
+    }
+    out[n] = '\0';
+
+    if (scanner->count == scanner->links_capacity) {
+        size_t capacity = scanner->links_capacity ? scanner->links_capacity * 2 : 256;
+        HrefScanLink *links = realloc(scanner->links, capacity * sizeof(HrefScanLink));
+        if (links == NULL) {
+            return false;
+        }
+        scanner->links = links;
+        scanner->links_capacity = capacity;
+    }
+    scanner->links[scanner->count].offset = scanner->used;
+    scanner->links[scanner->count].len = n;
+    scanner->links[scanner->count].base = base;
+    scanner->count++;
+    scanner->used += n + 1;
+    return true;
+}
+
+/**
+ * @brief Parse the attributes of a start tag, starting right after its name.
+ *
+ * @param p The first byte after the tag name.
+ * @param end The end of the page.
+ * @param want_href Whether the href of this tag is wanted; only the first href counts, as in libxml2.
+ * @param base Whether the tag is <base>, whose href is recorded as such.
+ * @param fallback Set if the tag's href needs libxml2.
+ * @return The byte after the closing '>', or NULL if the tag is not terminated before end or its href
+ * needs libxml2.
+ */
+static const char *parse_attributes(HrefScanner *scanner, const char *p, const char *end, bool want_href,
+                                    bool base, bool *fallback) {
+    bool found = false;
+    while (p < end) {
+        while (p < end && (is_space(*p) || *p == '/')) {
+            p++;
+        }
+        if (p >= end) {
+            break;
+        }
+        if (*p == '>') {
+            return p + 1;
+        }
+        const char *name = p;
+        while (p < end && !is_space(*p) && *p != '=' && *p != '>' && *p != '/') {
+            p++;
+        }
+        size_t name_len = (size_t)(p - name);
+        while (p < end && is_space(*p)) {
+            p++;
+        }
+        if (p >= end || *p != '=') {
+            // An attribute without a value; libxml2 reports an empty one
+            if (want_href && !found && name_is(name, name_len, "href")) {
+                found = true;
+                if (!add_link(scanner, p, p, base)) {
+                    *fallback = true;
+                    return NULL;
+                }
+            }
+            continue;
+        }
+        p++;
+        while (p < end && is_space(*p)) {
+            p++;
+        }
+        if (p >= end) {
+            break;
+        }
+        const char *value, *value_end;
+        if (*p == '"' || *p == '\'') {
+            value = p + 1;
+            value_end = find_byte(value, end, *p);
+            if (value_end >= end) {
+                return NULL; // Unterminated quote
+            }
+            p = value_end + 1;
+        } else {
+            value = p;
+            while (p < end && !is_space(*p) && *p != '>') {
+                p++;
+            }
+            value_end = p;
+        }
+        if (want_href && !found && name_is(name, name_len, "href")) {
+            found = true;
+            if (!add_link(scanner, value, value_end, base)) {
+                *fallback = true;
+                return NULL;
+            }
+        }
+    }
+    return NULL;
+}
+
+// How far scan_range() got.
+typedef enum {
+    SCAN_DONE,                       // Scanned to the end
+    SCAN_MORE,                       // Stopped at markup cut by the end of the piece
+    SCAN_FALLBACK                    // The page needs libxml2
+} ScanStatus;
+
+/**
+ * @brief Scan [p, end) for links, continuing in the raw text of a <script> or <style> if the previous
+ * piece ended inside one.
+ *
+ * @param last Whether end is the end of the page. If it is not, markup that is not finished before end
+ * is left for the next piece instead of making the page fall back to libxml2.
+ * @param stop Receives where the unfinished markup starts, for SCAN_MORE. Links of that markup are
+ * taken back, since it is scanned again once finished.
+ */
+static ScanStatus scan_range(HrefScanner *scanner, const char *p, const char *end, bool last, const char **stop) {
+    while (true) {
+        if (scanner->raw[0] != '\0') {
+            // Script and style content is raw text; tags inside it are not tags
+            const char *close = find_end_tag(p, end, scanner->raw);
+            if (close == NULL) {
+                if (last) {
+                    return SCAN_DONE; // The rest of the page is raw text, as libxml2 sees it too
+                }
+                // Keep the bytes that could begin the end tag, if any
+                size_t keep = strlen(scanner->raw) + 1;
+                *stop = find_byte((size_t)(end - p) > keep ? end - keep : p, end, '<');
+                return SCAN_MORE;
+            }
+            scanner->raw[0] = '\0';
+            p = close;
+        }
+        if ((p = find_byte(p, end, '<')) >= end) {
+            return SCAN_DONE;
+        }
+        const char *open = p;
+        size_t count = scanner->count, used = scanner->used;
+        const char *tag = p + 1;
+        if (tag >= end) {
+            if (last) {
+                return SCAN_DONE;
+            }
+            goto cut;
+        }
+        if (*tag == '!') {
+            if (end - tag >= 3 && tag[1] == '-' && tag[2] == '-') {
+                // Comment: skip to "-->"
+                const char *q = tag + 3;
+                while ((q = find_byte(q, end, '>')) < end && !(q - tag >= 5 && q[-1] == '-' && q[-2] == '-')) {
+                    q++;
+                }
+                if (q >= end) {
+                    goto cut;
+                }
+                p = q + 1;
+            } else {
+                // Doctype or other declaration
+                p = find_byte(tag, end, '>');
+                if (p >= end) {
+                    goto cut;
+                }
+                p++;
+            }
+            continue;
+        }
+        if (*tag == '/' || *tag == '?') {
+            p = find_byte(tag, end, '>');
+            if (p >= end) {
+                goto cut;
+            }
+            p++;
+            continue;
+        }
+        if (!is_alpha(*tag)) {
+            p = tag; // A literal '<' in text
+            continue;
+        }
+
+        const char *name = tag;
+        while (tag < end && is_alnum(*tag)) {
+            tag++;
+        }
+        size_t name_len = (size_t)(tag - name);
+        bool anchor = name_is(name, name_len, "a");
+        bool base = name_is(name, name_len, "base");
+        bool fallback = false;
+        p = parse_attributes(scanner, tag, end, anchor || base, base, &fallback);
+        if (fallback) {
+            return SCAN_FALLBACK;
+        }
+        if (p == NULL) {
+            goto cut;
+        }
+        if (name_is(name, name_len, "script") || name_is(name, name_len, "style")) {
+            for (size_t i = 0; i < name_len; i++) {
+                scanner->raw[i] = (char)(name[i] | 0x20);
+            }
+            scanner->raw[name_len] = '\0';
+        }
+        continue;
+
+    cut:
+        // Unterminated markup: the page needs libxml2, unless the next piece may finish it
+        if (last) {
+            return SCAN_FALLBACK;
+        }
+        scanner->count = count;
+        scanner->used = used;
+        *stop = open;
+        return SCAN_MORE;
+    }
+}
+
+bool href_scan(HrefScanner *scanner, const char *html, size_t len) {
+    const char *stop;
+    href_scan_begin(scanner);
+    return scan_range(scanner, html, html + len, true, &stop) != SCAN_FALLBACK;
+}
+
+void href_scan_begin(HrefScanner *scanner) {
+    scanner->used = 0;
+    scanner->count = 0;
+    scanner->carry_len = 0;
+    scanner->raw[0] = '\0';
+}
+
+// Append bytes to the carried markup.
+static bool carry_append(HrefScanner *scanner, const char *data, size_t len) {
+    if (scanner->carry_len + len > scanner->carry_capacity) {
+        size_t capacity = scanner->carry_capacity ? scanner->carry_capacity * 2 : 1024;
+        while (capacity < scanner->carry_len + len) {
+            capacity *= 2;
+        }
+        char *carry = realloc(scanner->carry, capacity);
+        if (carry == NULL) {
+            return false;
+        }
+        scanner->carry = carry;
+        scanner->carry_capacity = capacity;
+    }
+    memcpy(scanner->carry + scanner->carry_len, data, len);
+    scanner->carry_len += len;
+    return true;
+}
+
+bool href_scan_feed(HrefScanner *scanner, const char *data, size_t len, bool last) {
+    const char *end = data + len;
+    const char *stop;
+    // Finish the markup carried over from the previous piece, a '>' at a time, before scanning the rest
+    // of this piece in place
+    while (scanner->carry_len > 0) {
+        if (data == end && !last) {
+            return true;
+        }
+        const char *gt = find_byte(data, end, '>');
+        const char *next = gt < end ? gt + 1 : end;
+        if (!carry_append(scanner, data, (size_t)(next - data))) {
+            return false;
+        }
+        data = next;
+        ScanStatus status = scan_range(scanner, scanner->carry, scanner->carry + scanner->carry_len,
+                                       last && data == end, &stop);
+        if (status == SCAN_FALLBACK) {
+            return false;
+        }
+        if (status == SCAN_DONE) {
+            scanner->carry_len = 0;
+        } else {
+            scanner->carry_len -= (size_t)(stop - scanner->carry);
+            memmove(scanner->carry, stop, scanner->carry_len);
+        }
+    }
+    if (data == end) {
+        return true;
+    }
+
+    ScanStatus status = scan_range(scanner, data, end, last, &stop);
+    if (status == SCAN_MORE) {
+        return carry_append(scanner, stop, (size_t)(end - stop));
+    }
+    return status == SCAN_DONE;
+}
@@ -0,0 +1,71 @@
+#ifndef HREFSCAN_H
+#define HREFSCAN_H
+
+// Include size types.
+#include <stddef.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+
+// Byte search used to find tags and closing quotes.
+typedef enum {
+    HREF_SCAN_AUTO,                  // SSE2 where the CPU has it (see href_scan_init())
+    HREF_SCAN_AVX2,                  // 32 bytes per step
+    HREF_SCAN_SSE2,                  // 16 bytes per step
+    HREF_SCAN_SCALAR                 // One byte per step
+} HrefScanImpl;
+
+// One href found by the scanner: its decoded value in the scanner's buffer, and whether it came from
+// <base> rather than <a>.
+typedef struct {
+    size_t offset;
+    size_t len;
+    bool base;
+} HrefScanLink;
+
+/**
+ * @brief Reusable state of the href scanner: the links of the last page scanned.
+ *
+ * Values are decoded into one growing buffer, NUL-terminated, and both arrays are kept between pages,
+ * so a scanner that is reused allocates only when a page has more or longer links than any before it.
+ * A page fed in pieces also keeps the markup cut by the end of a piece in carry until the next piece
+ * finishes it.
+ */
+typedef struct {
+    char *buffer;
+    size_t used;
+    size_t capacity;
+    HrefScanLink *links;
+    size_t count;
+    size_t links_capacity;
+    char *carry;                     // Unfinished tag, comment or end tag from the previous piece
+    size_t carry_len;
+    size_t carry_capacity;
+    char raw[8];                     // "script" or "style" while inside its raw text, otherwise ""
+} HrefScanner;
+
+// Pick the byte search implementation. Call before any thread scans; returns the one actually used. AUTO
+// picks SSE2 even where AVX2 is available: tags and quotes are usually only a few bytes apart in HTML,
+// so the 32-byte steps rarely skip more than the 16-byte ones while each step costs more, and in
+// bench/hrefscan_bench the SSE2 search comes out ahead in most runs.
+HrefScanImpl href_scan_init(HrefScanImpl impl);
+// Name of an implementation, for reports.
+const char *href_scan_impl_name(HrefScanImpl impl);
+// Initialize an empty scanner.
+void href_scanner_init(HrefScanner *scanner);
+// Free a scanner's buffers.
+void href_scanner_destroy(HrefScanner *scanner);
+// Find the href of every <a> and <base> tag in html, in document order. Returns false if the page has
+// markup the scanner does not handle exactly like libxml2's HTML parser (an unterminated tag, quote or
+// comment, an entity other than &amp; &lt; &gt; &quot; &apos; and numeric references, or a non-ASCII
+// byte in an href); the caller should parse the page with libxml2 instead.
+bool href_scan(HrefScanner *scanner, const char *html, size_t len);
+// Start scanning a page that arrives in pieces, with href_scan_feed().
+void href_scan_begin(HrefScanner *scanner);
+// Scan the next piece of a page; last says it is the final one. Markup cut by the end of a piece (at
+// most one tag, comment or end tag) is copied aside and finished with the next piece, so the result is
+// the same as href_scan() over the joined pieces. Returns false when href_scan() would.
+bool href_scan_feed(HrefScanner *scanner, const char *data, size_t len, bool last);
+// The NUL-terminated value of the i-th link found by the last successful href_scan().
+const char *href_scan_value(const HrefScanner *scanner, size_t i);
+
+#endif
@@ -0,0 +1,413 @@
+// Define the required feature test macro to enable certain POSIX functions.
+#define _POSIX_C_SOURCE 200809L
+
+// Include the logging interface.
+#include "log.h"
+// Include the monotonic clock for the record times.
+#include "clock.h"
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+// Include variable argument lists for the printf-style messages.
+#include <stdarg.h>
+// Include the pthread library for the writer thread and the ring release on thread exit.
+#include <pthread.h>
+// Include nanosleep().
+#include <time.h>
+
+atomic_int log_level = LOG_INFO;
+
+static const char *level_names[] = { "error", "warn", "info", "debug" };
+static const char *level_labels[] = { "ERROR", "WARN ", "INFO ", "DEBUG" };
+
+// Every ring ever created, newest first. Rings are only added while the writer runs.
+static _Atomic(LogRing *) rings = NULL;
+// The calling thread's ring, or NULL until its first record.
+static _Thread_local LogRing *thread_ring = NULL;
+// Releases a thread's ring when the thread exits.
+static pthread_key_t ring_key;
+
+static LogFormat log_format = LOG_TEXT;
+static FILE *log_out = NULL;         // Destination of every record, or NULL to split stdout/stderr
+static uint64_t log_start_ns;
+static pthread_t writer;
+static atomic_bool running = false;  // Set while the writer thread owns the output
+static atomic_bool stopping = false;
+static atomic_ulong dropped_total = 0;
+
+// log_flush() callers wait for flush_done to catch up with their flush_requested ticket.
+static atomic_ulong flush_requested = 0;
+static unsigned long flush_done = 0;
+static pthread_mutex_t flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_cond = PTHREAD_COND_INITIALIZER;
+
+// Formatted records waiting to be written to one stream.
+typedef struct {
+    FILE *stream;
+    size_t used;
+    char data[LOG_BATCH_SIZE];
+} LogBatch;
+
+static LogBatch out_batch;
+static LogBatch err_batch;
+
+static void batch_flush(LogBatch *batch) {
+    if (batch->used > 0) {
+        fwrite(batch->data, 1, batch->used, batch->stream);
+        batch->used = 0;
+    }
+}
+
+// Append bytes to a batch, writing it out first if they do not fit.
+static void batch_append(LogBatch *batch, const char *data, size_t len) {
+    if (batch->used + len > sizeof(batch->data)) {
+        batch_flush(batch);
+        if (len > sizeof(batch->data)) {
+            fwrite(data, 1, len, batch->stream);
+            return;
+        }
+    }
+    memcpy(batch->data + batch->used, data, len);
+    batch->used += len;
+}
+
+// Append a string to a line being built, cutting it short at the end of the buffer.
+static size_t line_append(char *line, size_t used, size_t size, const char *data, size_t len) {
+    if (used >= size) {
+        return size;
+    }
+    if (len > size - used) {
+        len = size - used;
+    }
+    memcpy(line + used, data, len);
+    return used + len;
+}
+
+// Append a string as the contents of a JSON string literal.
+static size_t line_append_json(char *line, size_t used, size_t size, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)data[i];
+        char escaped[8];
+        if (c == '"' || c == '\\') {
+            escaped[0] = '\\';
+            escaped[1] = (char)c;
+            used = line_append(line, used, size, escaped, 2);
+        } else if (c < 0x20) {
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            used = line_append(line, used, size, escaped, 6);
+        } else {
+            used = line_append(line, used, size, (const char *)&c, 1);
+        }
+    }
+    return used;
+}
+
+/**
+ * @brief Format a record as one line of text or JSON.
+ *
+ * @param line The buffer to format into.
+ * @param size The size of the buffer; a line that does not fit is cut short but still ends in '\n'.
+ * @param record The record's header.
+ * @param thread The thread that made the record.
+ * @param url The record's URL (record->url_len bytes).
+ * @param text The record's message (record->text_len bytes).
+ * @return The length of the line.
+ */
+static size_t format_record(char *line, size_t size, const LogRecord *record, unsigned long thread,
+                            const char *url, const char *text) {
+    double seconds = (record->time_ns - log_start_ns) / 1e9;
+    size--; // Room for the newline
+    size_t used;
+    if (log_format == LOG_JSONL) {
+        used = (size_t)snprintf(line, size, "{\"t\":%.6f,\"level\":\"%s\",\"thread\":%lu,\"event\":\"%s\"", seconds,
+                                level_names[record->level], thread, record->event);
+        used = used < size ? used : size;
+        if (record->url_len > 0) {
+            used = line_append(line, used, size, ",\"url\":\"", 8);
+            used = line_append_json(line, used, size, url, record->url_len);
+            used = line_append(line, used, size, "\"", 1);
+        }
+        if (record->depth >= 0) {
+            char depth[32];
+            used = line_append(line, used, size, depth, (size_t)snprintf(depth, sizeof(depth), ",\"depth\":%d", record->depth));
+        }
+        if (record->text_len > 0) {
+            used = line_append(line, used, size, ",\"msg\":\"", 8);
+            used = line_append_json(line, used, size, text, record->text_len);
+            used = line_append(line, used, size, "\"", 1);
+        }
+        used = line_append(line, used, size, "}", 1);
+    } else {
+        used = (size_t)snprintf(line, size, "%.6f %s %lu %s", seconds, level_labels[record->level], thread,
+                                record->event);
+        used = used < size ? used : size;
+        if (record->url_len > 0) {
+            used = line_append(line, used, size, " ", 1);
+            used = line_append(line, used, size, url, record->url_len);
+        }
+        if (record->depth >= 0) {
+            char depth[32];
+            used = line_append(line, used, size, depth, (size_t)snprintf(depth, sizeof(depth), " depth=%d", record->depth));
+        }
+        if (record->text_len > 0) {
+            used = line_append(line, used, size, ": ", 2);
+            used = line_append(line, used, size, text, record->text_len);
+        }
+    }
+    line[used++] = '\n';
+    return used;
+}
+
+// The batch a record of the given level goes to.
+static LogBatch *batch_for(uint32_t level) {
+    return log_out == NULL && level <= LOG_WARN ? &err_batch : &out_batch;
+}
+
+// Format every record in a ring into the batches and free their space. Returns the number of records.
+static size_t ring_drain(LogRing *ring) {
+    static char line[LOG_URL_MAX + 2 * LOG_TEXT_MAX + 256];
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t records = 0;
+    while (head != tail) {
+        size_t offset = head & (LOG_RING_SIZE - 1);
+        const LogRecord *record = (const LogRecord *)(ring->data + offset);
+        if (record->size == 0) {
+            head += LOG_RING_SIZE - offset; // Skip the unused end of the ring
+            continue;
+        }
+        const char *url = (const char *)(record + 1);
+        const char *text = url + record->url_len;
+        LogBatch *batch = batch_for(record->level);
+        batch_append(batch, line, format_record(line, sizeof(line), record, ring->thread, url, text));
+        head += record->size;
+        records++;
+        // Give the space back at once, so a busy thread blocked on a full ring can go on
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+    }
+    return records;
+}
+
+/**
+ * @brief Writer thread: drains every ring into batched writes until log_shutdown().
+ *
+ * Each pass formats the pending records of every ring, thread by thread, so lines of different threads
+ * are not in time order; their timestamps are. The streams are flushed after every pass that wrote
+ * something, and the writer sleeps LOG_IDLE_MS when there was nothing to write.
+ */
+static void *log_writer(void *arg) {
+    (void)arg;
+    while (true) {
+        // Read the flags before draining, so everything made before them is drained in this pass
+        bool stop = atomic_load(&stopping);
+        unsigned long ticket = atomic_load(&flush_requested);
+
+        size_t records = 0;
+        for (LogRing *ring = atomic_load(&rings); ring != NULL; ring = ring->next) {
+            records += ring_drain(ring);
+        }
+        if (records > 0) {
+            batch_flush(&out_batch);
+            batch_flush(&err_batch);
+            fflush(out_batch.stream);
+            fflush(err_batch.stream);
+        }
+
+        pthread_mutex_lock(&flush_lock);
+        if (flush_done != ticket) {
+            flush_done = ticket;
+            pthread_cond_broadcast(&flush_cond);
+        }
+        pthread_mutex_unlock(&flush_lock);
+
+        if (stop) {
+            break;
+        }
+        if (records == 0) {
+            struct timespec idle = { 0, LOG_IDLE_MS * 1000000L };
+            nanosleep(&idle, NULL);
+        }
+    }
+    return NULL;
+}
+
+// Thread exit: hand the ring over to whichever thread needs one next.
+static void ring_release(void *arg) {
+    LogRing *ring = (LogRing *)arg;
+    atomic_store(&ring->owned, false);
+}
+
+// The calling thread's ring: a released ring the writer has emptied, or a new one.
+static LogRing *ring_acquire(void) {
+    for (LogRing *ring = atomic_load(&rings); ring != NULL; ring = ring->next) {
+        bool expected = false;
+        if (!atomic_load(&ring->owned) && atomic_load(&ring->head) == atomic_load(&ring->tail) &&
+            atomic_compare_exchange_strong(&ring->owned, &expected, true)) {
+            ring->thread = (unsigned long)pthread_self();
+            thread_ring = ring;
+            pthread_setspecific(ring_key, ring);
+            return ring;
+        }
+    }
+
+    LogRing *ring = aligned_alloc(64, sizeof(LogRing));
+    if (ring == NULL) {
+        return NULL;
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->owned, true);
+    atomic_init(&ring->dropped, 0);
+    ring->thread = (unsigned long)pthread_self();
+    ring->next = atomic_load(&rings);
+    while (!atomic_compare_exchange_weak(&rings, &ring->next, ring)) {
+    }
+    thread_ring = ring;
+    pthread_setspecific(ring_key, ring);
+    return ring;
+}
+
+void log_init(LogFormat format, LogLevel level, FILE *out) {
+    log_format = format;
+    atomic_store(&log_level, level);
+    log_out = out;
+    log_start_ns = now_ns();
+    out_batch.stream = out != NULL ? out : stdout;
+    err_batch.stream = out != NULL ? out : stderr;
+    out_batch.used = err_batch.used = 0;
+    pthread_key_create(&ring_key, ring_release);
+    atomic_store(&stopping, false);
+    if (pthread_create(&writer, NULL, log_writer, NULL) != 0) {
+        fprintf(stderr, "Failed to start the log writer; logging synchronously\n");
+        return;
+    }
+    atomic_store(&running, true);
+}
+
+void log_shutdown(void) {
+    if (!atomic_load(&running)) {
+        return;
+    }
+    atomic_store(&stopping, true);
+    pthread_join(writer, NULL);
+    atomic_store(&running, false);
+
+    // No thread logs into a ring any more; records are written directly from now on
+    pthread_key_delete(ring_key);
+    LogRing *ring = atomic_exchange(&rings, NULL);
+    while (ring != NULL) {
+        LogRing *next = ring->next;
+        atomic_fetch_add(&dropped_total, atomic_load(&ring->dropped));
+        free(ring);
+        ring = next;
+    }
+    thread_ring = NULL;
+}
+
+void log_flush(void) {
+    if (!atomic_load(&running)) {
+        return;
+    }
+    unsigned long ticket = atomic_fetch_add(&flush_requested, 1) + 1;
+    pthread_mutex_lock(&flush_lock);
+    while ((long)(flush_done - ticket) < 0) {
+        pthread_cond_wait(&flush_cond, &flush_lock);
+    }
+    pthread_mutex_unlock(&flush_lock);
+}
+
+bool log_enabled(LogLevel level) {
+    return (int)level <= atomic_load_explicit(&log_level, memory_order_relaxed);
+}
+
+/**
+ * @brief Copy a record into the calling thread's ring.
+ *
+ * A record that does not fit before the end of the ring goes to its beginning, and the bytes left at
+ * the end are marked unused. When the ring is full an error or warning waits for the writer to make
+ * room; anything else is dropped and counted, so a flood of debug records never holds up a worker.
+ *
+ * @return false if the record was dropped.
+ */
+static bool ring_put(LogRing *ring, const LogRecord *header, const char *url, const char *text) {
+    size_t size = (sizeof(LogRecord) + header->url_len + header->text_len + 7) & ~(size_t)7;
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t offset = tail & (LOG_RING_SIZE - 1);
+    size_t skip = LOG_RING_SIZE - offset < size ? LOG_RING_SIZE - offset : 0;
+
+    while (LOG_RING_SIZE - (tail - atomic_load_explicit(&ring->head, memory_order_acquire)) < skip + size) {
+        if (header->level > LOG_WARN || !atomic_load(&running)) {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return false;
+        }
+        struct timespec pause = { 0, 100000L };
+        nanosleep(&pause, NULL);
+    }
+
+    if (skip > 0) {
+        ((LogRecord *)(ring->data + offset))->size = 0; // Offsets are multiples of 8, so a header fits
+        tail += skip;
+        offset = 0;
+    }
+    LogRecord *record = (LogRecord *)(ring->data + offset);
+    *record = *header;
+    record->size = (uint32_t)size;
+    memcpy((char *)(record + 1), url, header->url_len);
+    memcpy((char *)(record + 1) + header->url_len, text, header->text_len);
+    // Publish the record only once its bytes are in place
+    atomic_store_explicit(&ring->tail, tail + size, memory_order_release);
+    return true;
+}
+
+void log_write(LogLevel level, const char *event, const char *url, int depth, const char *fmt, ...) {
+    if (!log_enabled(level)) {
+        return;
+    }
+    char text[LOG_TEXT_MAX];
+    size_t text_len = 0;
+    if (fmt != NULL) {
+        va_list args;
+        va_start(args, fmt);
+        int len = vsnprintf(text, sizeof(text), fmt, args);
+        va_end(args);
+        if (len > 0) {
+            text_len = (size_t)len < sizeof(text) ? (size_t)len : sizeof(text) - 1;
+        }
+    }
+    size_t url_len = url != NULL ? strlen(url) : 0;
+    if (url_len > LOG_URL_MAX) {
+        url_len = LOG_URL_MAX;
+    }
+
+    LogRecord header = { 0, (uint32_t)level, depth, (uint32_t)url_len, (uint32_t)text_len, 0, now_ns(), event };
+    LogRing *ring = thread_ring;
+    if (atomic_load(&running) && (ring != NULL || (ring = ring_acquire()) != NULL)) {
+        ring_put(ring, &header, url, text);
+        return;
+    }
+
+    // No writer thread (before log_init, after log_shutdown, or if it failed to start): write directly
+    char line[LOG_URL_MAX + 2 * LOG_TEXT_MAX + 256];
+    size_t len = format_record(line, sizeof(line), &header, (unsigned long)pthread_self(), url, text);
+    FILE *stream = log_out != NULL ? log_out : level <= LOG_WARN ? stderr : stdout;
+    fwrite(line, 1, len, stream);
+}
+
+bool log_level_parse(const char *name, LogLevel *level) {
+    for (int i = LOG_ERROR; i <= LOG_DEBUG; i++) {
+        if (strcmp(name, level_names[i]) == 0) {
+            *level = (LogLevel)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned long log_dropped(void) {
+    unsigned long dropped = atomic_load(&dropped_total);
+    for (LogRing *ring = atomic_load(&rings); ring != NULL; ring = ring->next) {
+        dropped += atomic_load(&ring->dropped);
+    }
+    return dropped;
+}
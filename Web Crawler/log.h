@@ -0,0 +1,97 @@
+#ifndef LOG_H
+#define LOG_H
+
+// Include size types.
+#include <stddef.h>
+// Include fixed-width integer types.
+#include <stdint.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+// Include atomic types for the rings and the level.
+#include <stdatomic.h>
+// Include standard input/output functionality for the output streams.
+#include <stdio.h>
+
+// Define the size in bytes of each thread's ring of pending records. Must be a power of two.
+#define LOG_RING_SIZE (1 << 16)
+// Define the longest URL and message a record keeps; longer ones are cut short.
+#define LOG_URL_MAX 2048
+#define LOG_TEXT_MAX 512
+// Define how long (in milliseconds) the writer sleeps when every ring is empty.
+#define LOG_IDLE_MS 10
+// Define the size of the buffer the writer formats a batch of records into before writing it.
+#define LOG_BATCH_SIZE (64 * 1024)
+
+// How important a record is. A record is kept if its level is at most the current level.
+typedef enum {
+    LOG_ERROR,                       // Something failed
+    LOG_WARN,                        // Something looks wrong but the crawl goes on
+    LOG_INFO,                        // One line per page and per pool or checkpoint event
+    LOG_DEBUG                        // One line per link
+} LogLevel;
+
+// How records are written out.
+typedef enum {
+    LOG_TEXT,                        // One human-readable line per record
+    LOG_JSONL                        // One JSON object per line
+} LogFormat;
+
+/**
+ * @brief Header of a record in a thread's ring, followed by the URL and the message (no terminators).
+ *
+ * The event name is a string literal, so only its pointer is stored. A size of 0 marks the unused end
+ * of the ring; the next record starts at its beginning.
+ */
+typedef struct {
+    uint32_t size;                   // Bytes of the header, URL and message, rounded up to a multiple of 8
+    uint32_t level;
+    int32_t depth;                   // Crawl depth the record is about, or -1
+    uint32_t url_len;
+    uint32_t text_len;
+    uint32_t reserved;
+    uint64_t time_ns;                // Monotonic time the record was made
+    const char *event;
+} LogRecord;
+
+/**
+ * @brief A thread's ring of records not yet written: one producer (the thread), one consumer (the
+ * writer).
+ *
+ * Positions only ever grow and are reduced modulo LOG_RING_SIZE when used, so the ring holds
+ * tail - head bytes. The producer publishes a record by advancing tail, and the writer frees its space
+ * by advancing head; neither ever waits for the other. When its thread exits the ring is released and
+ * may be taken over by a new thread once the writer has emptied it.
+ */
+typedef struct LogRing {
+    _Alignas(64) atomic_size_t head; // Next byte the writer reads
+    _Alignas(64) atomic_size_t tail; // Next byte the producer writes
+    struct LogRing *next;            // Next ring in the list of every ring ever created
+    atomic_bool owned;               // Set while a live thread logs into the ring
+    unsigned long thread;            // pthread_self() of the owner
+    atomic_ulong dropped;            // Records lost because the ring was full
+    char data[LOG_RING_SIZE];
+} LogRing;
+
+// Level above which records are discarded; may be changed at any time.
+extern atomic_int log_level;
+
+// Start the writer thread. Records go to out, and with out == NULL errors and warnings to stderr and
+// the rest to stdout.
+void log_init(LogFormat format, LogLevel level, FILE *out);
+// Write every pending record and stop the writer. Records made afterwards are written directly.
+void log_shutdown(void);
+// Wait until every record made before the call has been written.
+void log_flush(void);
+// Whether records of a level are currently kept.
+bool log_enabled(LogLevel level);
+// Log an event, optionally about a URL (may be NULL) at a depth (-1 for none), with a printf-style
+// message (fmt may be NULL). Never blocks on I/O; an info or debug record is dropped if the calling
+// thread's ring is full, while an error or warning waits for space.
+void log_write(LogLevel level, const char *event, const char *url, int depth, const char *fmt, ...)
+    __attribute__((format(printf, 5, 6)));
+// Parse a level name (error, warn, info or debug). Returns false if the name is unknown.
+bool log_level_parse(const char *name, LogLevel *level);
+// Records dropped so far because a ring was full.
+unsigned long log_dropped(void);
+
+#endif
@@ -0,0 +1,210 @@
+// Include the metrics interface.
+#include "metrics.h"
+
+// Define the bucket bounds (in seconds) of the histograms in the Prometheus dump. The histograms' own
+// buckets are much finer and are folded into these when dumped.
+static const double PROMETHEUS_BOUNDS[] = {
+    0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+    0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60
+};
+#define PROMETHEUS_BOUND_COUNT (sizeof(PROMETHEUS_BOUNDS) / sizeof(PROMETHEUS_BOUNDS[0]))
+
+// Define the quantiles written for every stage.
+static const double PROMETHEUS_QUANTILES[] = {0.5, 0.9, 0.99};
+#define PROMETHEUS_QUANTILE_COUNT (sizeof(PROMETHEUS_QUANTILES) / sizeof(PROMETHEUS_QUANTILES[0]))
+
+// Label values of the stages, in MetricStage order.
+static const char *STAGE_NAMES[STAGE_COUNT] = {
+    "queue", "dequeue", "park", "dns", "connect", "tls", "first_byte", "transfer", "fetch", "parse", "backpressure"
+};
+
+// Add to a field only its owner writes: a plain load and store, no locked instruction.
+static void add_relaxed(atomic_ulong *field, unsigned long n) {
+    atomic_store_explicit(field, atomic_load_explicit(field, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+// Bucket of a value: the value itself below 2 * HISTOGRAM_SUB_BUCKETS, otherwise its power of two and
+// its HISTOGRAM_SUB_BITS bits after the leading one.
+static size_t bucket_index(uint64_t ns) {
+    if (ns < 2 * HISTOGRAM_SUB_BUCKETS) {
+        return (size_t)ns;
+    }
+    int msb = 63 - __builtin_clzll(ns);
+    if (msb >= HISTOGRAM_MAX_BITS) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+    int shift = msb - HISTOGRAM_SUB_BITS;
+    return 2 * HISTOGRAM_SUB_BUCKETS + (size_t)(msb - HISTOGRAM_SUB_BITS - 1) * HISTOGRAM_SUB_BUCKETS
+           + (size_t)((ns >> shift) - HISTOGRAM_SUB_BUCKETS);
+}
+
+// Largest value that falls into a bucket.
+static uint64_t bucket_upper(size_t index) {
+    if (index < 2 * HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+    size_t offset = index - 2 * HISTOGRAM_SUB_BUCKETS;
+    int shift = (int)(offset / HISTOGRAM_SUB_BUCKETS) + 1;
+    uint64_t sub = HISTOGRAM_SUB_BUCKETS + offset % HISTOGRAM_SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+void metrics_init(MetricsShard *shard) {
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        Histogram *histogram = &shard->stages[stage];
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            atomic_init(&histogram->buckets[i], 0);
+        }
+        atomic_init(&histogram->count, 0);
+        atomic_init(&histogram->sum_ns, 0);
+        atomic_init(&histogram->max_ns, 0);
+    }
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        atomic_init(&shard->counters[counter], 0);
+    }
+}
+
+void metrics_record(MetricsShard *shard, MetricStage stage, uint64_t ns) {
+    Histogram *histogram = &shard->stages[stage];
+    add_relaxed(&histogram->buckets[bucket_index(ns)], 1);
+    add_relaxed(&histogram->count, 1);
+    add_relaxed(&histogram->sum_ns, ns);
+    if (ns > atomic_load_explicit(&histogram->max_ns, memory_order_relaxed)) {
+        atomic_store_explicit(&histogram->max_ns, ns, memory_order_relaxed);
+    }
+}
+
+void metrics_count(MetricsShard *shard, MetricCounter counter, unsigned long n) {
+    add_relaxed(&shard->counters[counter], n);
+}
+
+void metrics_merge(MetricsShard *total, const MetricsShard *shard) {
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        Histogram *sum = &total->stages[stage];
+        const Histogram *part = &shard->stages[stage];
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            add_relaxed(&sum->buckets[i], atomic_load_explicit(&part->buckets[i], memory_order_relaxed));
+        }
+        add_relaxed(&sum->count, atomic_load_explicit(&part->count, memory_order_relaxed));
+        add_relaxed(&sum->sum_ns, atomic_load_explicit(&part->sum_ns, memory_order_relaxed));
+        unsigned long max_ns = atomic_load_explicit(&part->max_ns, memory_order_relaxed);
+        if (max_ns > atomic_load_explicit(&sum->max_ns, memory_order_relaxed)) {
+            atomic_store_explicit(&sum->max_ns, max_ns, memory_order_relaxed);
+        }
+    }
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        add_relaxed(&total->counters[counter], atomic_load_explicit(&shard->counters[counter], memory_order_relaxed));
+    }
+}
+
+uint64_t histogram_quantile(const Histogram *histogram, double q) {
+    // The buckets are read one at a time while their owner may be adding to them, so their sum rather
+    // than the count field is the total the rank is taken from
+    unsigned long counts[HISTOGRAM_BUCKETS];
+    unsigned long total = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        counts[i] = atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    unsigned long rank = (unsigned long)(q * total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > total) {
+        rank = total;
+    }
+
+    uint64_t max_ns = atomic_load_explicit(&histogram->max_ns, memory_order_relaxed);
+    unsigned long seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            uint64_t upper = bucket_upper(i);
+            return upper < max_ns ? upper : max_ns; // Never report more than was recorded
+        }
+    }
+    return max_ns;
+}
+
+// Write a counter with its HELP and TYPE lines.
+static void write_counter(FILE *out, const char *name, const char *help, unsigned long value) {
+    fprintf(out, "# HELP crawler_%s %s\n# TYPE crawler_%s counter\ncrawler_%s %lu\n", name, help, name, name, value);
+}
+
+void metrics_write_prometheus(FILE *out, const MetricsShard *total, const MetricGauge *gauges, int gauge_count) {
+    const atomic_ulong *counters = total->counters;
+    write_counter(out, "pages_total", "Transfers that completed.",
+                  atomic_load_explicit(&counters[COUNTER_PAGES], memory_order_relaxed));
+    write_counter(out, "errors_total", "Transfers that failed.",
+                  atomic_load_explicit(&counters[COUNTER_ERRORS], memory_order_relaxed));
+    write_counter(out, "received_bytes_total", "Bytes received, headers included.",
+                  atomic_load_explicit(&counters[COUNTER_BYTES], memory_order_relaxed));
+    write_counter(out, "links_total", "Links queued.",
+                  atomic_load_explicit(&counters[COUNTER_LINKS], memory_order_relaxed));
+
+    fprintf(out, "# HELP crawler_responses_total Responses by status class.\n"
+                 "# TYPE crawler_responses_total counter\n");
+    static const char *classes[] = {"2xx", "3xx", "4xx", "5xx"};
+    for (int i = 0; i < 4; i++) {
+        fprintf(out, "crawler_responses_total{class=\"%s\"} %lu\n", classes[i],
+                atomic_load_explicit(&counters[COUNTER_STATUS_2XX + i], memory_order_relaxed));
+    }
+
+    fprintf(out, "# HELP crawler_backpressure_total Frontier budget actions: fetch stalls (block), links dropped or spilled.\n"
+                 "# TYPE crawler_backpressure_total counter\n");
+    static const char *actions[] = {"block", "drop", "spill"};
+    for (int i = 0; i < 3; i++) {
+        fprintf(out, "crawler_backpressure_total{action=\"%s\"} %lu\n", actions[i],
+                atomic_load_explicit(&counters[COUNTER_BUDGET_BLOCKED + i], memory_order_relaxed));
+    }
+
+    // The histograms, folded into the coarser Prometheus buckets: a bucket of ours counts towards a
+    // bound if its largest value is within the bound
+    fprintf(out, "# HELP crawler_stage_seconds Latency of each stage of a page's life.\n"
+                 "# TYPE crawler_stage_seconds histogram\n");
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        const Histogram *histogram = &total->stages[stage];
+        unsigned long cumulative = 0;
+        size_t next = 0;
+        for (size_t b = 0; b < PROMETHEUS_BOUND_COUNT; b++) {
+            uint64_t bound_ns = (uint64_t)(PROMETHEUS_BOUNDS[b] * 1e9);
+            while (next < HISTOGRAM_BUCKETS && bucket_upper(next) <= bound_ns) {
+                cumulative += atomic_load_explicit(&histogram->buckets[next], memory_order_relaxed);
+                next++;
+            }
+            fprintf(out, "crawler_stage_seconds_bucket{stage=\"%s\",le=\"%g\"} %lu\n", STAGE_NAMES[stage],
+                    PROMETHEUS_BOUNDS[b], cumulative);
+        }
+        while (next < HISTOGRAM_BUCKETS) {
+            cumulative += atomic_load_explicit(&histogram->buckets[next], memory_order_relaxed);
+            next++;
+        }
+        fprintf(out, "crawler_stage_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %lu\n", STAGE_NAMES[stage], cumulative);
+        fprintf(out, "crawler_stage_seconds_sum{stage=\"%s\"} %.9f\n", STAGE_NAMES[stage],
+                atomic_load_explicit(&histogram->sum_ns, memory_order_relaxed) / 1e9);
+        fprintf(out, "crawler_stage_seconds_count{stage=\"%s\"} %lu\n", STAGE_NAMES[stage], cumulative);
+    }
+
+    // The quantiles at the full resolution of our buckets
+    fprintf(out, "# HELP crawler_stage_quantile_seconds Latency quantiles of each stage.\n"
+                 "# TYPE crawler_stage_quantile_seconds gauge\n");
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        for (size_t i = 0; i < PROMETHEUS_QUANTILE_COUNT; i++) {
+            fprintf(out, "crawler_stage_quantile_seconds{stage=\"%s\",quantile=\"%g\"} %.9f\n", STAGE_NAMES[stage],
+                    PROMETHEUS_QUANTILES[i], histogram_quantile(&total->stages[stage], PROMETHEUS_QUANTILES[i]) / 1e9);
+        }
+    }
+    fprintf(out, "# HELP crawler_stage_max_seconds Longest latency of each stage.\n"
+                 "# TYPE crawler_stage_max_seconds gauge\n");
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        fprintf(out, "crawler_stage_max_seconds{stage=\"%s\"} %.9f\n", STAGE_NAMES[stage],
+                atomic_load_explicit(&total->stages[stage].max_ns, memory_order_relaxed) / 1e9);
+    }
+
+    for (int i = 0; i < gauge_count; i++) {
+        fprintf(out, "# HELP crawler_%s %s\n# TYPE crawler_%s gauge\ncrawler_%s %.12g\n", gauges[i].name,
+                gauges[i].help, gauges[i].name, gauges[i].name, gauges[i].value);
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+// Include size types.
+#include <stddef.h>
+// Include fixed-width integer types.
+#include <stdint.h>
+// Include atomic types for counters read while they are written.
+#include <stdatomic.h>
+// Include standard input/output functionality for the Prometheus dump.
+#include <stdio.h>
+
+// Define the number of linear sub-buckets per power of two of a histogram (as a power of two). 4 bits
+// keep every recorded value within 1/16 (6%) of its bucket's bounds.
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+// Define the largest power of two a histogram tells apart; larger values go to the last bucket.
+// 2^40 ns is about 18 minutes.
+#define HISTOGRAM_MAX_BITS 40
+// Define the number of buckets: values below 2 * HISTOGRAM_SUB_BUCKETS each have their own bucket, and
+// every power of two from there up to 2^HISTOGRAM_MAX_BITS has HISTOGRAM_SUB_BUCKETS.
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_BUCKETS * (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1))
+
+// The stages of a page's life whose latency is recorded.
+typedef enum {
+    STAGE_QUEUE,                     // Queued until its transfer started (scheduler and host queues)
+    STAGE_DEQUEUE,                   // One successful dequeue() call
+    STAGE_PARK,                      // One sleep of a worker that found no work
+    STAGE_DNS,                       // Name lookup (new connections only)
+    STAGE_CONNECT,                   // TCP connect after the lookup (new connections only)
+    STAGE_TLS,                       // TLS handshake after the connect (https only)
+    STAGE_FIRST_BYTE,                // Request sent until the first byte of the response
+    STAGE_TRANSFER,                  // First byte until the last
+    STAGE_FETCH,                     // The whole transfer, as libcurl reports it
+    STAGE_PARSE,                     // Parsing the page and queueing its links
+    STAGE_BACKPRESSURE,              // One stretch of a worker holding back new fetches for the frontier budget
+    STAGE_COUNT
+} MetricStage;
+
+// The event counters.
+typedef enum {
+    COUNTER_PAGES,                   // Transfers that completed
+    COUNTER_ERRORS,                  // Transfers that failed
+    COUNTER_BYTES,                   // Bytes received, headers included
+    COUNTER_LINKS,                   // Links queued
+    COUNTER_STATUS_2XX,              // Responses by status class
+    COUNTER_STATUS_3XX,
+    COUNTER_STATUS_4XX,
+    COUNTER_STATUS_5XX,
+    COUNTER_BUDGET_BLOCKED,          // Times a worker held back new fetches for the frontier budget
+    COUNTER_BUDGET_DROPPED,          // Links dropped to keep to the budget
+    COUNTER_BUDGET_SPILLED,          // Links sent to disk to keep to the budget
+    COUNTER_COUNT
+} MetricCounter;
+
+/**
+ * @brief Log-linear latency histogram in nanoseconds, in the style of HdrHistogram.
+ *
+ * Every power of two is split into HISTOGRAM_SUB_BUCKETS equal buckets, so the relative error is the
+ * same from microseconds to minutes and quantiles can be read back to within 6%.
+ */
+typedef struct {
+    atomic_ulong buckets[HISTOGRAM_BUCKETS];
+    atomic_ulong count;
+    atomic_ulong sum_ns;
+    atomic_ulong max_ns;
+} Histogram;
+
+/**
+ * @brief One thread's counters and histograms.
+ *
+ * Only the owning thread writes a shard, with plain loads and stores rather than locked read-modify-
+ * write instructions; the fields are atomic only so that another thread may read them at any time.
+ * Shards are summed with metrics_merge() when the metrics are dumped.
+ */
+typedef struct {
+    Histogram stages[STAGE_COUNT];
+    atomic_ulong counters[COUNTER_COUNT];
+} MetricsShard;
+
+// A value sampled when the metrics are dumped, such as a queue size.
+typedef struct {
+    const char *name;                // Metric name, without the crawler_ prefix
+    const char *help;
+    double value;
+} MetricGauge;
+
+// Zero a shard.
+void metrics_init(MetricsShard *shard);
+// Record one latency. Only the shard's owner may call this.
+void metrics_record(MetricsShard *shard, MetricStage stage, uint64_t ns);
+// Add to a counter. Only the shard's owner may call this.
+void metrics_count(MetricsShard *shard, MetricCounter counter, unsigned long n);
+// Add the current values of shard to total, which no other thread may be using.
+void metrics_merge(MetricsShard *total, const MetricsShard *shard);
+// The latency below which a fraction q (0 to 1) of the recorded values fall, in nanoseconds.
+uint64_t histogram_quantile(const Histogram *histogram, double q);
+// Write the counters, histograms and gauges in the Prometheus text exposition format.
+void metrics_write_prometheus(FILE *out, const MetricsShard *total, const MetricGauge *gauges, int gauge_count);
+
+#endif
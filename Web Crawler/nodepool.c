@@ -0,0 +1,162 @@
+// Include the node pool interface.
+#include "nodepool.h"
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+// Include atomic types for the base URL reference counts and the totals.
+#include <stdatomic.h>
+// Include offsetof().
+#include <stddef.h>
+
+// A shared base URL string. Nodes point at data; the header sits just before it.
+typedef struct {
+    atomic_int refs;
+    size_t len;
+    char data[];
+} SharedBase;
+
+// Per-thread idle nodes and the last base URL handed out.
+typedef struct {
+    URLQueueNode *free[NODE_CLASSES];
+    int free_count[NODE_CLASSES];
+    SharedBase *base;                // Holds one reference of its own
+    NodePoolStats stats;
+} NodePool;
+
+static _Thread_local NodePool local_pool;
+
+static atomic_ulong total_allocated, total_reused, total_bases_created, total_bases_shared;
+
+// Where node_free() gives back the charges of charged nodes.
+static void (*charge_release)(size_t charge, void *arg) = NULL;
+static void *charge_release_arg = NULL;
+
+static SharedBase *base_header(char *base_url) {
+    return (SharedBase *)(base_url - offsetof(SharedBase, data));
+}
+
+static void base_release(SharedBase *base) {
+    if (atomic_fetch_sub_explicit(&base->refs, 1, memory_order_acq_rel) == 1) {
+        free(base);
+    }
+}
+
+// Get a reference to a shared copy of base_url, reusing the thread's last one if it matches.
+static char *base_acquire(const char *base_url, size_t base_len) {
+    NodePool *pool = &local_pool;
+    SharedBase *base = pool->base;
+    if (base != NULL && base->len == base_len && memcmp(base->data, base_url, base_len) == 0) {
+        atomic_fetch_add_explicit(&base->refs, 1, memory_order_relaxed);
+        pool->stats.bases_shared++;
+        return base->data;
+    }
+    base = malloc(sizeof(SharedBase) + base_len + 1);
+    if (base == NULL) {
+        fprintf(stderr, "Failed to allocate memory for a base URL\n");
+        exit(1);
+    }
+    atomic_init(&base->refs, 2); // The caller's and the pool's
+    base->len = base_len;
+    memcpy(base->data, base_url, base_len);
+    base->data[base_len] = '\0';
+    pool->stats.bases_created++;
+    if (pool->base != NULL) {
+        base_release(pool->base);
+    }
+    pool->base = base;
+    return base->data;
+}
+
+URLQueueNode *node_create(const char *url, size_t url_len, const char *base_url, size_t base_len, int depth) {
+    NodePool *pool = &local_pool;
+    int size_class = (int)(url_len / NODE_CLASS_BYTES);
+    URLQueueNode *node;
+    if (size_class < NODE_CLASSES && pool->free[size_class] != NULL) {
+        node = pool->free[size_class];
+        pool->free[size_class] = node->next;
+        pool->free_count[size_class]--;
+        pool->stats.reused++;
+    } else {
+        node = malloc(node_bytes(url_len));
+        if (node == NULL) {
+            fprintf(stderr, "Failed to allocate memory for a queue node\n");
+            exit(1);
+        }
+        node->size_class = size_class < NODE_CLASSES ? size_class : NODE_CLASSES;
+        pool->stats.allocated++;
+    }
+    memcpy(node->data, url, url_len);
+    node->data[url_len] = '\0';
+    node->url = node->data;
+    node->base_url = base_url != NULL ? base_acquire(base_url, base_len) : NULL;
+    node->depth = depth;
+    node->queued_ns = 0;
+    node->charge = 0;
+    node->next = NULL;
+    return node;
+}
+
+size_t node_bytes(size_t url_len) {
+    // A pooled node gets its class's full capacity so that any URL of the class fits when it is reused
+    size_t size_class = url_len / NODE_CLASS_BYTES;
+    size_t capacity = size_class < NODE_CLASSES ? (size_class + 1) * NODE_CLASS_BYTES : url_len + 1;
+    return sizeof(URLQueueNode) + capacity;
+}
+
+void node_pool_set_release(void (*release)(size_t charge, void *arg), void *arg) {
+    charge_release = release;
+    charge_release_arg = arg;
+}
+
+void node_free(URLQueueNode *node) {
+    NodePool *pool = &local_pool;
+    if (node->charge != 0 && charge_release != NULL) {
+        charge_release(node->charge, charge_release_arg);
+    }
+    if (node->base_url != NULL) {
+        base_release(base_header(node->base_url));
+    }
+    int size_class = node->size_class;
+    if (size_class < NODE_CLASSES && pool->free_count[size_class] < NODE_POOL_LIMIT) {
+        node->next = pool->free[size_class];
+        pool->free[size_class] = node;
+        pool->free_count[size_class]++;
+    } else {
+        free(node);
+    }
+}
+
+void node_pool_flush() {
+    NodePool *pool = &local_pool;
+    for (int i = 0; i < NODE_CLASSES; i++) {
+        URLQueueNode *node = pool->free[i];
+        while (node != NULL) {
+            URLQueueNode *next = node->next;
+            free(node);
+            node = next;
+        }
+        pool->free[i] = NULL;
+        pool->free_count[i] = 0;
+    }
+    if (pool->base != NULL) {
+        base_release(pool->base);
+        pool->base = NULL;
+    }
+    atomic_fetch_add(&total_allocated, pool->stats.allocated);
+    atomic_fetch_add(&total_reused, pool->stats.reused);
+    atomic_fetch_add(&total_bases_created, pool->stats.bases_created);
+    atomic_fetch_add(&total_bases_shared, pool->stats.bases_shared);
+    memset(&pool->stats, 0, sizeof(pool->stats));
+}
+
+void node_pool_stats(NodePoolStats *stats) {
+    stats->allocated = atomic_load(&total_allocated);
+    stats->reused = atomic_load(&total_reused);
+    stats->bases_created = atomic_load(&total_bases_created);
+    stats->bases_shared = atomic_load(&total_bases_shared);
+}
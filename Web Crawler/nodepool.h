@@ -0,0 +1,58 @@
+#ifndef NODEPOOL_H
+#define NODEPOOL_H
+
+// Include size types.
+#include <stddef.h>
+// Include fixed-width integer types.
+#include <stdint.h>
+
+// Define the granularity of node size classes, in bytes of URL storage.
+#define NODE_CLASS_BYTES 64
+// Define the number of node size classes; nodes with longer URLs are not pooled.
+#define NODE_CLASSES 8
+// Define the number of idle nodes a thread keeps per size class; the rest are freed.
+#define NODE_POOL_LIMIT 1024
+
+// Define a structure for queue elements.
+typedef struct URLQueueNode {
+    char *url;                       // Points into data
+    char *base_url;                  // URL of the page the link was found on, shared with the node's
+                                     // siblings (see node_create); NULL for the starting URL
+    int depth;
+    int size_class;                  // Pool the node returns to, or NODE_CLASSES if it is not pooled
+    uint64_t queued_ns;              // Monotonic time the node was queued by the crawler, or 0
+    uint32_t charge;                 // Bytes charged to the frontier budget (see node_pool_set_release), or 0
+    struct URLQueueNode *next;
+    char data[];
+} URLQueueNode;
+
+// Counters of the node pools and base URL interning, summed over the threads that flushed them.
+typedef struct {
+    unsigned long allocated;         // Nodes that needed a malloc
+    unsigned long reused;            // Nodes taken from a pool
+    unsigned long bases_created;     // Base URL strings allocated
+    unsigned long bases_shared;      // Nodes that shared an existing base URL string
+} NodePoolStats;
+
+/**
+ * @brief Create a queue node for url, with a copy of base_url.
+ *
+ * The node and its URL are one allocation, taken from the calling thread's pool for the node's size
+ * class when it has one. The base URL is reference-counted and shared: every node created for the
+ * same base URL in a row on a thread (all the links of one page) points to the same string.
+ */
+URLQueueNode *node_create(const char *url, size_t url_len, const char *base_url, size_t base_len, int depth);
+// Free a node, returning it to the calling thread's pool, and drop its reference to its base URL.
+// Any thread may free a node, whichever thread created it.
+void node_free(URLQueueNode *node);
+// Size of the allocation node_create() makes for a URL of the given length.
+size_t node_bytes(size_t url_len);
+// Have node_free() hand the charge of every charged node it frees to release(charge, arg). Set it before
+// any node is charged.
+void node_pool_set_release(void (*release)(size_t charge, void *arg), void *arg);
+// Free the calling thread's idle nodes and add its counters to the totals. Call before a thread exits.
+void node_pool_flush();
+// Totals of every flushed thread.
+void node_pool_stats(NodePoolStats *stats);
+
+#endif
@@ -0,0 +1,313 @@
+// Include the per-host scheduler interface.
+#include "politeness.h"
+// Include the URL hash shared with the visited set.
+#include "visited.h"
+// Include url_host().
+#include "url.h"
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+
+void host_sched_init(HostScheduler *hs, int max_inflight, double rate, double burst) {
+    hs->max_inflight = max_inflight;
+    hs->rate = rate;
+    hs->burst = burst >= 1.0 ? burst : 1.0;
+    hs->delay = NULL;
+    hs->delay_arg = NULL;
+    atomic_init(&hs->queued, 0);
+    atomic_init(&hs->backlog, 0);
+    atomic_init(&hs->throttled, 0);
+    atomic_init(&hs->spilled, 0);
+    host_table_init(&hs->table, HOST_SHARD_BITS, "host queues");
+    for (int i = 0; i < HOST_SHARDS; i++) {
+        HostShard *shard = &hs->shards[i];
+        shard->heap = NULL;
+        shard->heap_size = shard->heap_capacity = 0;
+    }
+}
+
+void host_sched_set_delay(HostScheduler *hs, HostDelay delay, void *arg) {
+    hs->delay = delay;
+    hs->delay_arg = arg;
+}
+
+static void host_queue_free(HostEntry *entry) {
+    HostQueue *host = (HostQueue *)entry;
+    while (host->head != NULL) {
+        URLQueueNode *node = host->head;
+        host->head = node->next;
+        node_free(node);
+    }
+    free(host);
+}
+
+void host_sched_destroy(HostScheduler *hs) {
+    host_table_destroy(&hs->table, host_queue_free);
+    for (int i = 0; i < HOST_SHARDS; i++) {
+        free(hs->shards[i].heap);
+    }
+}
+
+static bool heap_less(const HostQueue *a, const HostQueue *b) {
+    return a->ready_ns < b->ready_ns;
+}
+
+static void heap_place(HostShard *shard, HostQueue *host, size_t index) {
+    shard->heap[index] = host;
+    host->heap_index = (long)index;
+}
+
+static void heap_sift_up(HostShard *shard, size_t index) {
+    HostQueue *host = shard->heap[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!heap_less(host, shard->heap[parent])) {
+            break;
+        }
+        heap_place(shard, shard->heap[parent], index);
+        index = parent;
+    }
+    heap_place(shard, host, index);
+}
+
+static void heap_sift_down(HostShard *shard, size_t index) {
+    HostQueue *host = shard->heap[index];
+    while (true) {
+        size_t child = 2 * index + 1;
+        if (child >= shard->heap_size) {
+            break;
+        }
+        if (child + 1 < shard->heap_size && heap_less(shard->heap[child + 1], shard->heap[child])) {
+            child++;
+        }
+        if (!heap_less(shard->heap[child], host)) {
+            break;
+        }
+        heap_place(shard, shard->heap[child], index);
+        index = child;
+    }
+    heap_place(shard, host, index);
+}
+
+static void heap_insert(HostShard *shard, HostQueue *host) {
+    if (shard->heap_size == shard->heap_capacity) {
+        size_t capacity = shard->heap_capacity ? shard->heap_capacity * 2 : 64;
+        HostQueue **heap = realloc(shard->heap, capacity * sizeof(HostQueue *));
+        if (heap == NULL) {
+            fprintf(stderr, "Failed to allocate memory for host queues\n");
+            exit(1);
+        }
+        shard->heap = heap;
+        shard->heap_capacity = capacity;
+    }
+    shard->heap[shard->heap_size] = host;
+    shard->heap_size++;
+    heap_sift_up(shard, shard->heap_size - 1);
+}
+
+// Remove the host at the top of the heap.
+static void heap_pop(HostShard *shard) {
+    shard->heap[0]->heap_index = -1;
+    shard->heap_size--;
+    if (shard->heap_size > 0) {
+        heap_place(shard, shard->heap[shard->heap_size], 0);
+        heap_sift_down(shard, 0);
+    }
+}
+
+// Bring a host's token bucket up to date and return the earliest time it allows a fetch.
+static uint64_t host_ready_time(HostQueue *host, uint64_t now) {
+    if (host->rate <= 0) {
+        return now;
+    }
+    if (now > host->refilled_ns) {
+        host->tokens += (double)(now - host->refilled_ns) * host->rate / 1e9;
+        if (host->tokens > host->burst) {
+            host->tokens = host->burst;
+        }
+        host->refilled_ns = now;
+    }
+    if (host->tokens >= 1.0) {
+        return now;
+    }
+    return now + (uint64_t)((1.0 - host->tokens) * 1e9 / host->rate);
+}
+
+// Put a host in its shard's ready heap if it has URLs queued and room for another fetch.
+static void host_schedule(HostScheduler *hs, HostShard *shard, HostQueue *host, uint64_t now) {
+    if (host->heap_index >= 0 || host->count == 0) {
+        return;
+    }
+    if (hs->max_inflight > 0 && host->inflight >= hs->max_inflight) {
+        return; // host_sched_done will schedule it
+    }
+    host->ready_ns = host_ready_time(host, now);
+    heap_insert(shard, host);
+}
+
+// Find a host in its shard, adding it with a full token bucket if it is new. Called with the shard locked.
+static HostQueue *host_lookup(HostScheduler *hs, HostTableShard *shard, int shard_index, const char *name,
+                              size_t len, uint64_t hash, uint64_t now) {
+    HostQueue *host = (HostQueue *)host_table_find(shard, name, len, hash);
+    if (host != NULL) {
+        return host;
+    }
+
+    host = malloc(sizeof(HostQueue) + len + 1);
+    if (host == NULL) {
+        fprintf(stderr, "Failed to allocate memory for host queues\n");
+        exit(1);
+    }
+    host->head = host->tail = NULL;
+    host->count = 0;
+    host->inflight = 0;
+    host->rate = hs->rate;
+    host->burst = hs->burst;
+    double delay = hs->delay != NULL ? hs->delay(name, len, hs->delay_arg) : 0;
+    if (delay > 0 && (hs->rate <= 0 || 1.0 / delay < hs->rate)) {
+        host->rate = 1.0 / delay;
+        host->burst = 1.0;
+    }
+    host->tokens = host->burst;
+    host->refilled_ns = now;
+    host->ready_ns = 0;
+    host->heap_index = -1;
+    host->shard = shard_index;
+    memcpy(host->name, name, len);
+    host->name[len] = '\0';
+    host->entry.hash = hash;
+    host->entry.length = len;
+    host->entry.key = host->name;
+    host_table_insert(shard, &host->entry);
+    return host;
+}
+
+bool host_sched_push(HostScheduler *hs, URLQueueNode *node, uint64_t now, bool backlog) {
+    size_t len;
+    const char *name = url_host(node->url, &len);
+    uint64_t hash = url_hash(name, len);
+    int index = (int)(hash >> (64 - HOST_SHARD_BITS));
+    HostTableShard *table_shard = &hs->table.shards[index];
+    HostShard *shard = &hs->shards[index];
+
+    node->next = NULL;
+    pthread_mutex_lock(&table_shard->lock);
+    HostQueue *host = host_lookup(hs, table_shard, index, name, len, hash, now);
+    bool excess = host->count >= HOST_QUEUE_PER_HOST;
+    if (excess && !backlog) {
+        pthread_mutex_unlock(&table_shard->lock);
+        return false;
+    }
+    if (host->tail != NULL) {
+        host->tail->next = node;
+    } else {
+        host->head = node;
+    }
+    host->tail = node;
+    host->count++;
+    host_schedule(hs, shard, host, now);
+    pthread_mutex_unlock(&table_shard->lock);
+    atomic_fetch_add(&hs->queued, 1);
+    if (excess) {
+        atomic_fetch_add(&hs->backlog, 1);
+    }
+    return true;
+}
+
+URLQueueNode *host_sched_pop(HostScheduler *hs, int start, uint64_t now, HostQueue **host, uint64_t *next_ready) {
+    *next_ready = UINT64_MAX;
+    if (atomic_load_explicit(&hs->queued, memory_order_relaxed) == 0) {
+        return NULL;
+    }
+    for (int i = 0; i < HOST_SHARDS; i++) {
+        int index = (start + i) & (HOST_SHARDS - 1);
+        pthread_mutex_t *lock = &hs->table.shards[index].lock;
+        HostShard *shard = &hs->shards[index];
+        pthread_mutex_lock(lock);
+        if (shard->heap_size == 0) {
+            pthread_mutex_unlock(lock);
+            continue;
+        }
+        HostQueue *top = shard->heap[0];
+        if (top->ready_ns > now) {
+            // The earliest host of this shard is still waiting on its bucket
+            if (top->ready_ns < *next_ready) {
+                *next_ready = top->ready_ns;
+            }
+            pthread_mutex_unlock(lock);
+            continue;
+        }
+
+        heap_pop(shard);
+        URLQueueNode *node = top->head;
+        top->head = node->next;
+        if (top->head == NULL) {
+            top->tail = NULL;
+        }
+        top->count--;
+        bool excess = top->count >= HOST_QUEUE_PER_HOST;
+        top->inflight++;
+        if (top->rate > 0) {
+            host_ready_time(top, now);
+            top->tokens -= 1.0;
+        }
+        host_schedule(hs, shard, top, now);
+        pthread_mutex_unlock(lock);
+
+        atomic_fetch_sub(&hs->queued, 1);
+        if (excess) {
+            atomic_fetch_sub(&hs->backlog, 1);
+        }
+        node->next = NULL;
+        *host = top;
+        return node;
+    }
+    if (*next_ready != UINT64_MAX) {
+        atomic_fetch_add_explicit(&hs->throttled, 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+void host_sched_done(HostScheduler *hs, HostQueue *host, uint64_t now) {
+    pthread_mutex_t *lock = &hs->table.shards[host->shard].lock;
+    pthread_mutex_lock(lock);
+    host->inflight--;
+    host_schedule(hs, &hs->shards[host->shard], host, now);
+    pthread_mutex_unlock(lock);
+}
+
+size_t host_sched_size(HostScheduler *hs) {
+    return atomic_load_explicit(&hs->queued, memory_order_relaxed);
+}
+
+size_t host_sched_window(HostScheduler *hs) {
+    size_t queued = atomic_load_explicit(&hs->queued, memory_order_relaxed);
+    size_t backlog = atomic_load_explicit(&hs->backlog, memory_order_relaxed);
+    return queued > backlog ? queued - backlog : 0; // The two are updated one after the other
+}
+
+size_t host_sched_hosts(HostScheduler *hs) {
+    return host_table_count(&hs->table);
+}
+
+// Collects the queued URLs of one host for host_sched_collect.
+typedef struct {
+    URLQueueNode **nodes;
+    size_t count;
+} HostCollect;
+
+static void host_queue_collect(HostEntry *entry, void *arg) {
+    HostCollect *collect = (HostCollect *)arg;
+    for (URLQueueNode *node = ((HostQueue *)entry)->head; node != NULL; node = node->next) {
+        collect->nodes[collect->count++] = node;
+    }
+}
+
+size_t host_sched_collect(HostScheduler *hs, URLQueueNode **nodes) {
+    HostCollect collect = { nodes, 0 };
+    host_table_each(&hs->table, host_queue_collect, &collect);
+    return collect.count;
+}
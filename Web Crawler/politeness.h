@@ -0,0 +1,111 @@
+#ifndef POLITENESS_H
+#define POLITENESS_H
+
+// Include size types.
+#include <stddef.h>
+// Include fixed-width integer types.
+#include <stdint.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+// Include the pthread library for the shard locks.
+#include <pthread.h>
+// Include atomic types for the queued-node counter.
+#include <stdatomic.h>
+// Include the queue node definition.
+#include "nodepool.h"
+// Include the sharded host table.
+#include "hosttable.h"
+
+// Define the number of bits of the host hash that pick a shard, and the resulting number of shards.
+#define HOST_SHARD_BITS 4
+#define HOST_SHARDS (1 << HOST_SHARD_BITS)
+// Define the number of URLs the per-host queues may hold in total before workers stop moving more in
+// from the frontier. URLs a host holds beyond HOST_QUEUE_PER_HOST do not count, so one host with a
+// large backlog cannot stop other hosts' URLs from being moved in.
+#define HOST_QUEUE_LIMIT (1 << 16)
+// Define the number of URLs one host's queue holds before the rest of its URLs are its backlog.
+#define HOST_QUEUE_PER_HOST 4096
+
+/**
+ * @brief The queue of one host, with its politeness state.
+ *
+ * A host is in its shard's ready heap while it has queued URLs and fewer fetches in flight than the
+ * per-host limit; the heap orders hosts by the earliest time their token bucket allows the next fetch.
+ */
+typedef struct HostQueue {
+    HostEntry entry;                 // Keyed by name
+    URLQueueNode *head, *tail;       // Queued URLs, oldest first
+    size_t count;
+    int inflight;                    // Fetches started and not yet done
+    double rate;                     // Fetches per second the bucket refills with, 0 for no limit
+    double burst;                    // Bucket size
+    double tokens;                   // Fetches the bucket allows right now, up to the burst size
+    uint64_t refilled_ns;            // When tokens was last brought up to date
+    uint64_t ready_ns;               // Earliest time the next fetch may start, while in the heap
+    long heap_index;                 // Position in the ready heap, or -1
+    int shard;                       // Shard the host lives in
+    char name[];                     // Host and port, e.g. "example.com:8080"
+} HostQueue;
+
+// Returns the seconds a host asks to be left alone between fetches, or 0 (see host_sched_set_delay).
+typedef double (*HostDelay)(const char *host, size_t len, void *arg);
+
+// The ready heap of the hosts of one shard of the host table, guarded by the shard's lock.
+typedef struct {
+    _Alignas(64) HostQueue **heap;   // Binary min-heap on ready_ns
+    size_t heap_size;
+    size_t heap_capacity;
+} HostShard;
+
+/**
+ * @brief Per-host queues in front of the fetchers.
+ *
+ * URLs taken from the frontier are sorted into one FIFO per host, and a fetch is only started for a
+ * host whose token bucket has a token (rate fetches per second, bursts of up to burst) and that has
+ * fewer than max_inflight fetches running. Hosts are spread over HOST_SHARDS independently locked
+ * shards by the hash of their name, each with its own ready heap, so workers popping from different
+ * shards do not contend. A slow or rate-limited host only holds up its own queue; the workers keep
+ * fetching from every other host that is ready.
+ */
+typedef struct {
+    HostTable table;                 // HostQueue records
+    HostShard shards[HOST_SHARDS];   // The ready heap of each shard of table
+    int max_inflight;                // Per-host limit on concurrent fetches, 0 for none
+    double rate;                     // Per-host fetches per second, 0 for no limit
+    double burst;                    // Token bucket size
+    HostDelay delay;                 // Per-host delay looked up for every new host, or NULL
+    void *delay_arg;
+    atomic_size_t queued;            // URLs in all host queues
+    atomic_size_t backlog;           // URLs hosts hold beyond HOST_QUEUE_PER_HOST each
+    atomic_ulong throttled;          // Pops that found hosts waiting but none ready yet
+    atomic_ulong spilled;            // URLs the crawler left in the spill store because their host was full
+} HostScheduler;
+
+// Initialize empty per-host queues with the given limits.
+void host_sched_init(HostScheduler *hs, int max_inflight, double rate, double burst);
+// Look up a delay for every host seen from now on. A host with a delay gets at most one fetch per delay
+// (and no bursts), or the global rate if that is slower.
+void host_sched_set_delay(HostScheduler *hs, HostDelay delay, void *arg);
+// Free every host and every URL still queued.
+void host_sched_destroy(HostScheduler *hs);
+// Queue a URL behind the other URLs of its host. now is the current CLOCK_MONOTONIC time in nanoseconds.
+// If the host already holds HOST_QUEUE_PER_HOST URLs and backlog is false, the URL is not queued and
+// false is returned, so the caller can leave it in the frontier.
+bool host_sched_push(HostScheduler *hs, URLQueueNode *node, uint64_t now, bool backlog);
+// Take a URL from a host that may be fetched now, searching the shards from start onwards, and count it
+// as in flight for its host. Returns NULL if there is none; *next_ready is then the earliest time a
+// waiting host becomes ready, or UINT64_MAX if no host is waiting on its bucket.
+URLQueueNode *host_sched_pop(HostScheduler *hs, int start, uint64_t now, HostQueue **host, uint64_t *next_ready);
+// Report that a fetch started by host_sched_pop has finished.
+void host_sched_done(HostScheduler *hs, HostQueue *host, uint64_t now);
+// Number of URLs in the host queues.
+size_t host_sched_size(HostScheduler *hs);
+// Number of URLs in the host queues, not counting the hosts' backlogs; HOST_QUEUE_LIMIT applies to it.
+size_t host_sched_window(HostScheduler *hs);
+// Number of hosts seen.
+size_t host_sched_hosts(HostScheduler *hs);
+// Store every queued URL in nodes (which must have room for host_sched_size) and return their number.
+// The workers must be stopped.
+size_t host_sched_collect(HostScheduler *hs, URLQueueNode **nodes);
+
+#endif
@@ -0,0 +1,224 @@
+// Include the priority frontier interface.
+#include "priority.h"
+// Include the hash shared with the visited set.
+#include "visited.h"
+// Include url_host().
+#include "url.h"
+// Include the spill record format used for checkpoints.
+#include "spill.h"
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+
+// Define the level a URL starts from in priority_default_score, before its features move it up or down.
+#define SCORE_BASE 40
+// Define the levels lost per link followed from the starting URL.
+#define SCORE_PER_DEPTH 4
+// Define the levels gained by a URL that contains a preferred substring.
+#define SCORE_PREFERRED 12
+// Define the levels lost by a URL with a query string.
+#define SCORE_QUERY 3
+// Define the number of path segments a URL may have before each extra one costs a level.
+#define SCORE_FREE_SEGMENTS 3
+
+void prio_init(PriorityFrontier *pf, PriorityScore score, void *score_arg) {
+    for (int i = 0; i < PRIORITY_SHARDS; i++) {
+        PriorityShard *shard = &pf->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        atomic_init(&shard->levels, 0);
+        memset(shard->buckets, 0, sizeof(shard->buckets));
+    }
+    pf->score = score != NULL ? score : priority_default_score;
+    pf->score_arg = score_arg;
+    pf->inlinks = calloc((size_t)INLINK_SKETCH_ROWS * INLINK_SKETCH_WIDTH, sizeof(*pf->inlinks));
+    if (pf->inlinks == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the priority frontier\n");
+        exit(1);
+    }
+    atomic_init(&pf->size, 0);
+    atomic_init(&pf->next_shard, 0);
+    atomic_init(&pf->pushed, 0);
+    atomic_init(&pf->pushed_levels, 0);
+    atomic_init(&pf->popped, 0);
+    atomic_init(&pf->popped_levels, 0);
+}
+
+void prio_destroy(PriorityFrontier *pf) {
+    for (int i = 0; i < PRIORITY_SHARDS; i++) {
+        PriorityShard *shard = &pf->shards[i];
+        for (int level = 0; level < PRIORITY_LEVELS; level++) {
+            URLQueueNode *node = shard->buckets[level].head;
+            while (node != NULL) {
+                URLQueueNode *next = node->next;
+                node_free(node);
+                node = next;
+            }
+        }
+        pthread_mutex_destroy(&shard->lock);
+    }
+    free((void *)pf->inlinks);
+}
+
+// The counter of a row of the sketch for a host hash. Each row uses its own 14 bits of the hash.
+static _Atomic uint32_t *sketch_counter(PriorityFrontier *pf, int row, uint64_t hash) {
+    size_t index = (size_t)(hash >> (row * 14)) & (INLINK_SKETCH_WIDTH - 1);
+    return &pf->inlinks[(size_t)row * INLINK_SKETCH_WIDTH + index];
+}
+
+void prio_count_link(PriorityFrontier *pf, const char *url) {
+    size_t len;
+    const char *host = url_host(url, &len);
+    uint64_t hash = url_hash(host, len);
+    for (int row = 0; row < INLINK_SKETCH_ROWS; row++) {
+        atomic_fetch_add_explicit(sketch_counter(pf, row, hash), 1, memory_order_relaxed);
+    }
+}
+
+// Estimate the links to a host: the smallest of its counters, which only collisions can inflate.
+static unsigned int inlink_estimate(PriorityFrontier *pf, const char *host, size_t len) {
+    uint64_t hash = url_hash(host, len);
+    uint32_t estimate = UINT32_MAX;
+    for (int row = 0; row < INLINK_SKETCH_ROWS; row++) {
+        uint32_t count = atomic_load_explicit(sketch_counter(pf, row, hash), memory_order_relaxed);
+        if (count < estimate) {
+            estimate = count;
+        }
+    }
+    return estimate;
+}
+
+int priority_default_score(const PriorityInput *input, void *arg) {
+    const PriorityWeights *weights = arg;
+    int score = SCORE_BASE - SCORE_PER_DEPTH * input->depth;
+
+    // Popular hosts first: one level per doubling of the links seen to the host
+    for (unsigned int inlinks = input->inlinks; inlinks > 1; inlinks >>= 1) {
+        score++;
+    }
+
+    // Pages the user asked for
+    for (int i = 0; weights != NULL && i < weights->prefer_count; i++) {
+        if (strstr(input->url, weights->prefer[i]) != NULL) {
+            score += SCORE_PREFERRED;
+            break;
+        }
+    }
+
+    // Query strings and deep paths tend to be generated listings, calendars and the like
+    const char *path = input->host + input->host_len;
+    int segments = 0;
+    for (const char *p = path; *p != '\0' && *p != '?'; p++) {
+        segments += *p == '/';
+    }
+    if (segments > SCORE_FREE_SEGMENTS) {
+        score -= segments - SCORE_FREE_SEGMENTS;
+    }
+    if (strchr(path, '?') != NULL) {
+        score -= SCORE_QUERY;
+    }
+    return score;
+}
+
+int prio_level(PriorityFrontier *pf, const char *url, int depth) {
+    PriorityInput input;
+    input.url = url;
+    input.host = url_host(url, &input.host_len);
+    input.depth = depth;
+    input.inlinks = inlink_estimate(pf, input.host, input.host_len);
+    int level = pf->score(&input, pf->score_arg);
+    if (level < 0) {
+        level = 0;
+    } else if (level > PRIORITY_LEVELS - 1) {
+        level = PRIORITY_LEVELS - 1;
+    }
+    return level;
+}
+
+void prio_push(PriorityFrontier *pf, int self, URLQueueNode *node) {
+    int level = prio_level(pf, node->url, node->depth);
+    atomic_fetch_add_explicit(&pf->pushed, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pf->pushed_levels, (unsigned long)level, memory_order_relaxed);
+
+    unsigned int index = self >= 0 ? (unsigned int)self : atomic_fetch_add_explicit(&pf->next_shard, 1, memory_order_relaxed);
+    PriorityShard *shard = &pf->shards[index % PRIORITY_SHARDS];
+    PriorityBucket *bucket = &shard->buckets[level];
+    node->next = NULL;
+    pthread_mutex_lock(&shard->lock);
+    if (bucket->tail != NULL) {
+        bucket->tail->next = node;
+    } else {
+        bucket->head = node;
+        atomic_fetch_or_explicit(&shard->levels, (uint64_t)1 << level, memory_order_relaxed);
+    }
+    bucket->tail = node;
+    // Count the node before it can be popped, so the size never goes below zero
+    atomic_fetch_add(&pf->size, 1);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// Highest set bit of a non-zero level mask.
+static int top_level(uint64_t levels) {
+    return 63 - __builtin_clzll(levels);
+}
+
+URLQueueNode *prio_pop(PriorityFrontier *pf, int self) {
+    int start = self >= 0 ? self % PRIORITY_SHARDS : 0;
+    while (atomic_load(&pf->size) > 0) {
+        // Find the shard with the best level, preferring the caller's own shard on a tie
+        int best = -1, best_level = -1;
+        for (int i = 0; i < PRIORITY_SHARDS; i++) {
+            int index = (start + i) % PRIORITY_SHARDS;
+            uint64_t levels = atomic_load_explicit(&pf->shards[index].levels, memory_order_relaxed);
+            if (levels != 0 && top_level(levels) > best_level) {
+                best = index;
+                best_level = top_level(levels);
+            }
+        }
+        if (best < 0) {
+            return NULL; // A push is counted in size but not yet linked in
+        }
+
+        PriorityShard *shard = &pf->shards[best];
+        pthread_mutex_lock(&shard->lock);
+        uint64_t levels = atomic_load_explicit(&shard->levels, memory_order_relaxed);
+        if (levels == 0) {
+            pthread_mutex_unlock(&shard->lock);
+            continue; // Another worker emptied the shard; look again
+        }
+        int level = top_level(levels);
+        PriorityBucket *bucket = &shard->buckets[level];
+        URLQueueNode *node = bucket->head;
+        bucket->head = node->next;
+        if (bucket->head == NULL) {
+            bucket->tail = NULL;
+            atomic_fetch_and_explicit(&shard->levels, ~((uint64_t)1 << level), memory_order_relaxed);
+        }
+        atomic_fetch_sub(&pf->size, 1);
+        pthread_mutex_unlock(&shard->lock);
+
+        node->next = NULL;
+        atomic_fetch_add_explicit(&pf->popped, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&pf->popped_levels, (unsigned long)level, memory_order_relaxed);
+        return node;
+    }
+    return NULL;
+}
+
+size_t prio_size(PriorityFrontier *pf) {
+    return atomic_load_explicit(&pf->size, memory_order_relaxed);
+}
+
+bool prio_save(PriorityFrontier *pf, FILE *out, size_t *count) {
+    for (int level = PRIORITY_LEVELS - 1; level >= 0; level--) {
+        for (int i = 0; i < PRIORITY_SHARDS; i++) {
+            for (URLQueueNode *node = pf->shards[i].buckets[level].head; node != NULL; node = node->next) {
+                if (spill_record_write(out, node) == 0) {
+                    return false;
+                }
+                (*count)++;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,103 @@
+#ifndef PRIORITY_H
+#define PRIORITY_H
+
+// Include size types.
+#include <stddef.h>
+// Include fixed-width integer types.
+#include <stdint.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+// Include standard input/output functionality for saving the queue.
+#include <stdio.h>
+// Include the pthread library for the shard locks.
+#include <pthread.h>
+// Include atomic types for the level masks and counters.
+#include <stdatomic.h>
+// Include the queue node definition.
+#include "nodepool.h"
+
+// Define the number of priority levels; scores are clamped to 0..PRIORITY_LEVELS - 1. At most 64, so a
+// shard's non-empty levels fit in one word.
+#define PRIORITY_LEVELS 64
+// Define the number of independently locked shards.
+#define PRIORITY_SHARDS 16
+// Define the shape of the count-min sketch that counts links per host: rows of counters, each row
+// indexed by a different slice of the host's hash.
+#define INLINK_SKETCH_ROWS 4
+#define INLINK_SKETCH_WIDTH (1 << 14)
+
+// What a score function gets to see of a URL.
+typedef struct {
+    const char *url;                 // Canonical URL
+    const char *host;                // Its authority, within url
+    size_t host_len;
+    int depth;                       // Links followed from the starting URL
+    unsigned int inlinks;            // Links seen so far that point to the URL's host (an overestimate)
+} PriorityInput;
+
+// Score a URL: higher is fetched sooner. Called once per queued URL, from any thread.
+typedef int (*PriorityScore)(const PriorityInput *input, void *arg);
+
+// Settings of priority_default_score.
+typedef struct {
+    const char **prefer;             // Substrings that mark a URL as worth fetching early
+    int prefer_count;
+} PriorityWeights;
+
+// One priority level of a shard: a FIFO of nodes.
+typedef struct {
+    URLQueueNode *head, *tail;
+} PriorityBucket;
+
+// One shard: a lock, a FIFO per level, and a mask of the levels that have nodes.
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    _Atomic uint64_t levels;         // Bit l is set while buckets[l] is not empty; read without the lock
+    PriorityBucket buckets[PRIORITY_LEVELS];
+} PriorityShard;
+
+/**
+ * @brief Concurrent bucketed priority queue of URLs, for best-first crawling.
+ *
+ * A score function maps each URL to one of PRIORITY_LEVELS levels when it is pushed; within a level
+ * URLs come out oldest first. Pushes from a worker go to the shard of that worker, and a pop takes the
+ * best level of whichever shard currently has the best one, found by reading each shard's level mask
+ * without locking. The order is therefore exact within a shard and approximate across shards, which is
+ * enough to fetch valuable pages early without one lock serializing every worker.
+ */
+typedef struct {
+    PriorityShard shards[PRIORITY_SHARDS];
+    PriorityScore score;
+    void *score_arg;
+    _Atomic uint32_t *inlinks;       // INLINK_SKETCH_ROWS * INLINK_SKETCH_WIDTH counters
+    atomic_size_t size;              // Nodes queued
+    atomic_uint next_shard;          // Shard for the next push from outside the workers
+    atomic_ulong pushed;             // Nodes queued
+    atomic_ulong pushed_levels;      // Sum of their levels
+    atomic_ulong popped;             // Nodes taken
+    atomic_ulong popped_levels;      // Sum of their levels
+} PriorityFrontier;
+
+// Initialize an empty queue that ranks URLs with score (called with score_arg), or with
+// priority_default_score if score is NULL.
+void prio_init(PriorityFrontier *pf, PriorityScore score, void *score_arg);
+// Free the queue and every node still in it.
+void prio_destroy(PriorityFrontier *pf);
+// Count a link to url for the in-link counts of its host. Call for every link found, seen before or not.
+void prio_count_link(PriorityFrontier *pf, const char *url);
+// The level a URL at the given depth would be queued at, from 0 to PRIORITY_LEVELS - 1.
+int prio_level(PriorityFrontier *pf, const char *url, int depth);
+// Score a node and queue it. self is the pushing worker's index, or -1 for other threads.
+void prio_push(PriorityFrontier *pf, int self, URLQueueNode *node);
+// Take a node of the best level available, or NULL if the queue is empty.
+URLQueueNode *prio_pop(PriorityFrontier *pf, int self);
+// Number of queued nodes.
+size_t prio_size(PriorityFrontier *pf);
+// Write every queued node as a SpillRecord, best level first. The workers must be stopped. Adds the
+// number of records to *count.
+bool prio_save(PriorityFrontier *pf, FILE *out, size_t *count);
+// The built-in score: prefers shallow URLs, hosts many links point to, URLs containing one of the
+// PriorityWeights substrings in arg (may be NULL), and short paths without a query.
+int priority_default_score(const PriorityInput *input, void *arg);
+
+#endif
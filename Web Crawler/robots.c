@@ -0,0 +1,660 @@
+// Include the robots.txt cache interface.
+#include "robots.h"
+// Include the URL hash shared with the visited set.
+#include "visited.h"
+// Include url_host().
+#include "url.h"
+// Include the monotonic clock for the expiry times.
+#include "clock.h"
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+// Include strncasecmp() for field names and user agents.
+#include <strings.h>
+
+// Define the number of trie nodes compiled rules start with.
+#define ROBOTS_NODES_INITIAL 64
+
+static const char HEX[] = "0123456789ABCDEF";
+
+// The origin the calling thread checked last.
+static _Thread_local HostTableHint last_origin = { NULL, NULL };
+
+static void *robots_alloc(void *old, size_t size) {
+    void *p = realloc(old, size);
+    if (p == NULL) {
+        fprintf(stderr, "Failed to allocate memory for robots.txt rules\n");
+        exit(1);
+    }
+    return p;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+        return (c | 0x20) - 'a' + 10;
+    }
+    return -1;
+}
+
+static bool is_unreserved(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '.' ||
+           c == '_' || c == '~';
+}
+
+// Bring a pattern into the percent-encoding of canonical URLs (see url_resolve), so that it can be
+// compared with them byte by byte. out must hold 3 * len + 1 bytes. Returns the new length.
+static size_t normalize_pattern(const char *pattern, size_t len, char *out) {
+    char *p = out;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)pattern[i];
+        if (c == '%' && i + 2 < len && hex_value(pattern[i + 1]) >= 0 && hex_value(pattern[i + 2]) >= 0) {
+            unsigned char value = (unsigned char)(hex_value(pattern[i + 1]) * 16 + hex_value(pattern[i + 2]));
+            if (is_unreserved(value)) {
+                *p++ = (char)value;
+            } else {
+                *p++ = '%';
+                *p++ = HEX[value >> 4];
+                *p++ = HEX[value & 15];
+            }
+            i += 2;
+        } else if (c != '%' && (is_unreserved(c) || strchr("!$&'()*+,;=:@/?", c) != NULL)) {
+            *p++ = (char)c;
+        } else {
+            *p++ = '%';
+            *p++ = HEX[c >> 4];
+            *p++ = HEX[c & 15];
+        }
+    }
+    *p = '\0';
+    return (size_t)(p - out);
+}
+
+// Add a literal pattern to the trie with the given flag at its last node.
+static void trie_insert(RobotsRules *rules, const char *pattern, size_t len, unsigned char flag) {
+    uint32_t node = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char byte = (unsigned char)pattern[i];
+        uint32_t child = rules->nodes[node].child;
+        while (child != 0 && rules->nodes[child].byte != byte) {
+            child = rules->nodes[child].sibling;
+        }
+        if (child == 0) {
+            if (rules->node_count == rules->node_capacity) {
+                rules->node_capacity *= 2;
+                rules->nodes = robots_alloc(rules->nodes, rules->node_capacity * sizeof(RobotsNode));
+            }
+            child = rules->node_count++;
+            rules->nodes[child] = (RobotsNode){ .child = 0, .sibling = rules->nodes[node].child, .byte = byte, .flags = 0 };
+            rules->nodes[node].child = child;
+        }
+        node = child;
+    }
+    rules->nodes[node].flags |= flag;
+}
+
+// Add an Allow or Disallow rule.
+static void rules_add(RobotsRules *rules, const char *value, size_t len, bool allow) {
+    char *pattern = robots_alloc(NULL, 3 * len + 1);
+    len = normalize_pattern(value, len, pattern);
+    // A trailing * adds nothing to a prefix match
+    while (len > 0 && pattern[len - 1] == '*') {
+        len--;
+    }
+    bool exact = len > 0 && pattern[len - 1] == '$';
+    if (memchr(pattern, '*', len) == NULL && memchr(pattern, '$', exact ? len - 1 : len) == NULL) {
+        if (exact) {
+            trie_insert(rules, pattern, len - 1, allow ? ROBOTS_EXACT_ALLOW : ROBOTS_EXACT_DISALLOW);
+        } else {
+            trie_insert(rules, pattern, len, allow ? ROBOTS_PREFIX_ALLOW : ROBOTS_PREFIX_DISALLOW);
+        }
+        free(pattern);
+        return;
+    }
+    if (rules->wildcard_count == rules->wildcard_capacity) {
+        rules->wildcard_capacity = rules->wildcard_capacity > 0 ? rules->wildcard_capacity * 2 : 8;
+        rules->wildcards = robots_alloc(rules->wildcards, rules->wildcard_capacity * sizeof(RobotsWildcard));
+    }
+    pattern[len] = '\0';
+    rules->wildcards[rules->wildcard_count++] = (RobotsWildcard){ pattern, len, allow };
+}
+
+static RobotsRules *rules_create() {
+    RobotsRules *rules = robots_alloc(NULL, sizeof(RobotsRules));
+    memset(rules, 0, sizeof(RobotsRules));
+    rules->node_capacity = ROBOTS_NODES_INITIAL;
+    rules->nodes = robots_alloc(NULL, rules->node_capacity * sizeof(RobotsNode));
+    rules->nodes[0] = (RobotsNode){ 0 };
+    rules->node_count = 1;
+    atomic_init(&rules->references, 1);
+    return rules;
+}
+
+void robots_rules_free(RobotsRules *rules) {
+    if (rules == NULL) {
+        return;
+    }
+    for (int i = 0; i < rules->wildcard_count; i++) {
+        free(rules->wildcards[i].pattern);
+    }
+    free(rules->wildcards);
+    free(rules->nodes);
+    free(rules);
+}
+
+static bool is_token_char(char c) {
+    return ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || c == '-' || c == '_';
+}
+
+// Whether a User-agent value names the product token: its leading token characters equal it, ignoring case.
+static bool agent_matches(const char *value, size_t len, const char *agent) {
+    size_t token = 0;
+    while (token < len && is_token_char(value[token])) {
+        token++;
+    }
+    return token > 0 && token == strlen(agent) && strncasecmp(value, agent, token) == 0;
+}
+
+/**
+ * @brief Compile the rules in a robots.txt for a product token.
+ *
+ * The file is read line by line; a group is one or more User-agent lines followed by the rules that
+ * apply to those agents. The rules of every group naming the product token are merged, or if there is
+ * none, the rules of every * group. Unknown fields (Sitemap and the like) and lines without a colon
+ * are skipped.
+ *
+ * @param text The body of the robots.txt. Need not be terminated.
+ * @param len The length of text.
+ * @param agent The crawler's product token, e.g. "Googlebot".
+ * @return The compiled rules.
+ */
+RobotsRules *robots_compile(const char *text, size_t len, const char *agent) {
+    RobotsRules *specific = rules_create(), *fallback = rules_create();
+    bool found_specific = false;
+    bool in_agents = false;          // The previous field was a User-agent line
+    bool for_specific = false, for_fallback = false; // Which rule sets the current group feeds
+
+    const char *end = text + len;
+    for (const char *line = text; line < end;) {
+        const char *line_end = memchr(line, '\n', (size_t)(end - line));
+        if (line_end == NULL) {
+            line_end = end;
+        }
+        const char *next = line_end < end ? line_end + 1 : end;
+        const char *comment = memchr(line, '#', (size_t)(line_end - line));
+        if (comment != NULL) {
+            line_end = comment;
+        }
+        const char *colon = memchr(line, ':', (size_t)(line_end - line));
+        if (colon == NULL) {
+            line = next;
+            continue;
+        }
+
+        // Trim the field name and the value
+        const char *name = line, *name_end = colon;
+        while (name < name_end && (*name == ' ' || *name == '\t' || *name == '\r' || (unsigned char)*name == 0xEF ||
+                                   (unsigned char)*name == 0xBB || (unsigned char)*name == 0xBF)) {
+            name++; // Also skips a byte order mark
+        }
+        while (name_end > name && (name_end[-1] == ' ' || name_end[-1] == '\t')) {
+            name_end--;
+        }
+        const char *value = colon + 1, *value_end = line_end;
+        while (value < value_end && (*value == ' ' || *value == '\t')) {
+            value++;
+        }
+        while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t' || value_end[-1] == '\r')) {
+            value_end--;
+        }
+        size_t name_len = (size_t)(name_end - name), value_len = (size_t)(value_end - value);
+
+        if (name_len == 10 && strncasecmp(name, "user-agent", 10) == 0) {
+            if (!in_agents) {
+                for_specific = for_fallback = false; // A new group starts
+            }
+            in_agents = true;
+            if (agent_matches(value, value_len, agent)) {
+                for_specific = true;
+                found_specific = true;
+            } else if (value_len == 1 && value[0] == '*') {
+                for_fallback = true;
+            }
+        } else {
+            in_agents = false;
+            bool allow = name_len == 5 && strncasecmp(name, "allow", 5) == 0;
+            bool disallow = name_len == 8 && strncasecmp(name, "disallow", 8) == 0;
+            if ((allow || disallow) && value_len > 0) {
+                if (for_specific) {
+                    rules_add(specific, value, value_len, allow);
+                }
+                if (for_fallback) {
+                    rules_add(fallback, value, value_len, allow);
+                }
+            } else if (name_len == 11 && strncasecmp(name, "crawl-delay", 11) == 0) {
+                char number[32];
+                size_t n = value_len < sizeof(number) - 1 ? value_len : sizeof(number) - 1;
+                memcpy(number, value, n);
+                number[n] = '\0';
+                double delay = strtod(number, NULL);
+                if (delay > 0) {
+                    if (for_specific) {
+                        specific->crawl_delay = delay;
+                    }
+                    if (for_fallback) {
+                        fallback->crawl_delay = delay;
+                    }
+                }
+            }
+        }
+        line = next;
+    }
+
+    if (found_specific) {
+        robots_rules_free(fallback);
+        return specific;
+    }
+    robots_rules_free(specific);
+    return fallback;
+}
+
+// Whether a wildcard pattern matches a path: * matches any run of bytes, and a trailing $ the end of the path.
+static bool wildcard_match(const RobotsWildcard *wildcard, const char *path, size_t len) {
+    const char *pattern = wildcard->pattern;
+    size_t pattern_len = wildcard->length;
+    bool anchored = pattern_len > 0 && pattern[pattern_len - 1] == '$';
+    if (anchored) {
+        pattern_len--;
+    }
+    size_t p = 0, s = 0, star = SIZE_MAX, resume = 0;
+    while (true) {
+        if (p == pattern_len && (!anchored || s == len)) {
+            return true; // The pattern is a prefix of the path (or all of it, if anchored)
+        }
+        if (p < pattern_len && pattern[p] == '*') {
+            star = p++;
+            resume = s;
+        } else if (p < pattern_len && s < len && pattern[p] == path[s]) {
+            p++;
+            s++;
+        } else if (star != SIZE_MAX && resume < len) {
+            // Let the last * swallow one more byte and retry from there
+            p = star + 1;
+            s = ++resume;
+        } else {
+            return false;
+        }
+    }
+}
+
+bool robots_match(const RobotsRules *rules, const char *path, size_t len) {
+    if (rules->disallow_all) {
+        return false;
+    }
+    long best = -1;                  // Length of the longest matching pattern so far
+    bool allowed = true;
+
+    // Walk down the trie along the path; every rule passed matches
+    const RobotsNode *nodes = rules->nodes;
+    uint32_t node = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint32_t child = nodes[node].child;
+        while (child != 0 && nodes[child].byte != (unsigned char)path[i]) {
+            child = nodes[child].sibling;
+        }
+        if (child == 0) {
+            break;
+        }
+        node = child;
+        unsigned char flags = nodes[node].flags;
+        if (flags & (ROBOTS_PREFIX_ALLOW | ROBOTS_PREFIX_DISALLOW)) {
+            // Longer than anything before; Allow wins if both end here
+            best = (long)(i + 1);
+            allowed = (flags & ROBOTS_PREFIX_ALLOW) != 0;
+        }
+        if (i + 1 == len && (flags & (ROBOTS_EXACT_ALLOW | ROBOTS_EXACT_DISALLOW))) {
+            best = (long)(i + 2); // The $ counts towards the pattern's length
+            allowed = (flags & ROBOTS_EXACT_ALLOW) != 0;
+        }
+    }
+
+    for (int i = 0; i < rules->wildcard_count; i++) {
+        const RobotsWildcard *wildcard = &rules->wildcards[i];
+        if ((long)wildcard->length < best || ((long)wildcard->length == best && allowed)) {
+            continue; // Could not change the outcome
+        }
+        if (wildcard_match(wildcard, path, len)) {
+            allowed = (long)wildcard->length > best ? wildcard->allow : (allowed || wildcard->allow);
+            best = (long)wildcard->length;
+        }
+    }
+    return allowed;
+}
+
+// Make the record of a new origin, without rules.
+static HostEntry *robots_host_create(const char *origin, size_t len, void *arg) {
+    (void)arg;
+    RobotsHost *host = robots_alloc(NULL, sizeof(RobotsHost) + len + 1);
+    host->queued_next = NULL;
+    atomic_init(&host->rules, NULL);
+    atomic_init(&host->fetching, false);
+    atomic_init(&host->expires_ns, 0);
+    host->parked = host->parked_tail = NULL;
+    memcpy(host->origin, origin, len);
+    host->origin[len] = '\0';
+    host->entry.key = host->origin;
+    return &host->entry;
+}
+
+// Take a reference to the current rules of an origin, or return NULL if it has none yet. Taken under the
+// shard lock, under which robots_fetch_rules() replaces the rules and drops the origin's reference.
+static RobotsRules *robots_rules_acquire(RobotsCache *cache, RobotsHost *host) {
+    if (atomic_load_explicit(&host->rules, memory_order_acquire) == NULL) {
+        return NULL; // Rules are never taken away once published
+    }
+    HostTableShard *shard = host_table_shard(&cache->hosts, host->entry.hash);
+    pthread_mutex_lock(&shard->lock);
+    RobotsRules *rules = atomic_load_explicit(&host->rules, memory_order_acquire);
+    atomic_fetch_add_explicit(&rules->references, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&shard->lock);
+    return rules;
+}
+
+// Drop a reference to rules, freeing them if it was the last.
+static void robots_rules_release(RobotsRules *rules) {
+    if (atomic_fetch_sub_explicit(&rules->references, 1, memory_order_acq_rel) == 1) {
+        robots_rules_free(rules);
+    }
+}
+
+// Match a canonical URL of an origin against the origin's rules. A disallowed URL is counted as checked;
+// an allowed one only if final is set, since otherwise it is to be checked again with robots_admit().
+static bool robots_verdict(RobotsCache *cache, const RobotsRules *rules, const char *url, size_t origin_len,
+                           bool final) {
+    const char *path = url + origin_len;
+    bool allowed = robots_match(rules, path, strlen(path));
+    if (!allowed || final) {
+        atomic_fetch_add_explicit(&cache->checked, 1, memory_order_relaxed);
+    }
+    if (!allowed) {
+        atomic_fetch_add_explicit(&cache->disallowed, 1, memory_order_relaxed);
+    }
+    return allowed;
+}
+
+// Length of the origin (scheme, host and port) a canonical URL starts with.
+static size_t robots_origin_length(const char *url) {
+    size_t host_len;
+    const char *host_start = url_host(url, &host_len);
+    return (size_t)(host_start - url) + host_len;
+}
+
+// Queue an origin for the fetcher threads, unless its rules are still fresh or it is queued already.
+static void robots_refresh(RobotsCache *cache, RobotsHost *host, RobotsRules *rules) {
+    if (rules != NULL && now_ns() < atomic_load_explicit(&host->expires_ns, memory_order_relaxed)) {
+        return;
+    }
+    bool expected = false;
+    if (atomic_load_explicit(&host->fetching, memory_order_relaxed) ||
+        !atomic_compare_exchange_strong(&host->fetching, &expected, true)) {
+        return;
+    }
+    pthread_mutex_lock(&cache->queue_lock);
+    host->queued_next = NULL;
+    if (cache->queue_tail != NULL) {
+        cache->queue_tail->queued_next = host;
+    } else {
+        cache->queue_head = host;
+    }
+    cache->queue_tail = host;
+    pthread_cond_signal(&cache->queue_ready);
+    pthread_mutex_unlock(&cache->queue_lock);
+}
+
+/**
+ * @brief Fetch and compile a queued origin's robots.txt, publish the rules and release the URLs parked
+ * on the origin.
+ *
+ * Called by the fetcher thread that took the origin off the queue. The parked URLs are handed to the
+ * release callback with the shard still locked, so that a paused cache (see robots_pause) has every
+ * URL it holds either parked or released. The rules these replace lose the origin's reference and are
+ * freed by whichever of it and the checks still matching against them is dropped last.
+ */
+static void robots_fetch_rules(RobotsCache *cache, RobotsHost *host) {
+    size_t length = host->entry.length;
+    char *url = robots_alloc(NULL, length + sizeof("/robots.txt"));
+    memcpy(url, host->origin, length);
+    memcpy(url + length, "/robots.txt", sizeof("/robots.txt"));
+
+    char *body = NULL;
+    size_t len = 0;
+    atomic_fetch_add(&cache->fetches, 1);
+    long status = cache->fetch(url, &body, &len, cache->fetch_arg);
+    RobotsRules *rules;
+    uint64_t ttl = ROBOTS_TTL;
+    if (status >= 200 && status < 300) {
+        rules = robots_compile(body != NULL ? body : "", len, cache->agent);
+    } else if (status >= 400 && status < 500) {
+        rules = rules_create(); // No robots.txt: everything is allowed
+    } else {
+        // The server failed or could not be reached: assume everything is disallowed for now
+        atomic_fetch_add(&cache->failures, 1);
+        rules = rules_create();
+        rules->disallow_all = true;
+        ttl = ROBOTS_ERROR_TTL;
+    }
+    free(body);
+    free(url);
+
+    HostTableShard *shard = host_table_shard(&cache->hosts, host->entry.hash);
+    pthread_mutex_lock(&shard->lock);
+    RobotsRules *previous = atomic_load(&host->rules);
+    atomic_store_explicit(&host->expires_ns, now_ns() + ttl * 1000000000ull, memory_order_relaxed);
+    atomic_store_explicit(&host->rules, rules, memory_order_release);
+    atomic_store(&host->fetching, false);
+    URLQueueNode *node = host->parked;
+    host->parked = host->parked_tail = NULL;
+    while (node != NULL) {
+        URLQueueNode *next = node->next;
+        node->next = NULL;
+        atomic_fetch_sub(&cache->parked, 1);
+        cache->release(node, robots_verdict(cache, rules, node->url, length, false), cache->release_arg);
+        node = next;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    if (previous != NULL) {
+        robots_rules_release(previous);
+    }
+}
+
+// Fetcher thread: fetch queued robots.txt files until the cache is closed.
+static void *robots_fetcher(void *arg) {
+    RobotsCache *cache = (RobotsCache *)arg;
+    pthread_mutex_lock(&cache->queue_lock);
+    for (;;) {
+        while (cache->queue_head == NULL && !cache->closed) {
+            pthread_cond_wait(&cache->queue_ready, &cache->queue_lock);
+        }
+        if (cache->closed) {
+            break;
+        }
+        RobotsHost *host = cache->queue_head;
+        cache->queue_head = host->queued_next;
+        if (cache->queue_head == NULL) {
+            cache->queue_tail = NULL;
+        }
+        pthread_mutex_unlock(&cache->queue_lock);
+        robots_fetch_rules(cache, host);
+        pthread_mutex_lock(&cache->queue_lock);
+    }
+    pthread_mutex_unlock(&cache->queue_lock);
+    node_pool_flush(); // Disallowed URLs were freed on this thread
+    return NULL;
+}
+
+bool robots_init(RobotsCache *cache, const char *agent, RobotsFetch fetch, void *fetch_arg, RobotsRelease release,
+                 void *release_arg) {
+    cache->agent = agent;
+    cache->fetch = fetch;
+    cache->fetch_arg = fetch_arg;
+    cache->release = release;
+    cache->release_arg = release_arg;
+    atomic_init(&cache->parked, 0);
+    atomic_init(&cache->fetches, 0);
+    atomic_init(&cache->failures, 0);
+    atomic_init(&cache->checked, 0);
+    atomic_init(&cache->disallowed, 0);
+    host_table_init(&cache->hosts, ROBOTS_SHARD_BITS, "the robots.txt cache");
+    pthread_mutex_init(&cache->queue_lock, NULL);
+    pthread_cond_init(&cache->queue_ready, NULL);
+    cache->queue_head = NULL;
+    cache->queue_tail = NULL;
+    cache->closed = false;
+
+    cache->fetcher_count = 0;
+    for (int i = 0; i < ROBOTS_FETCHERS; i++) {
+        if (pthread_create(&cache->fetchers[cache->fetcher_count], NULL, robots_fetcher, cache) != 0) {
+            break;
+        }
+        cache->fetcher_count++;
+    }
+    if (cache->fetcher_count == 0) {
+        robots_destroy(cache);
+        return false;
+    }
+    return true;
+}
+
+static void robots_host_free(HostEntry *entry) {
+    RobotsHost *host = (RobotsHost *)entry;
+    while (host->parked != NULL) {
+        URLQueueNode *node = host->parked;
+        host->parked = node->next;
+        node_free(node);
+    }
+    robots_rules_free(atomic_load(&host->rules));
+    free(host);
+}
+
+void robots_destroy(RobotsCache *cache) {
+    pthread_mutex_lock(&cache->queue_lock);
+    cache->closed = true;
+    pthread_cond_broadcast(&cache->queue_ready);
+    pthread_mutex_unlock(&cache->queue_lock);
+    for (int i = 0; i < cache->fetcher_count; i++) {
+        pthread_join(cache->fetchers[i], NULL);
+    }
+    pthread_mutex_destroy(&cache->queue_lock);
+    pthread_cond_destroy(&cache->queue_ready);
+    host_table_destroy(&cache->hosts, robots_host_free);
+    last_origin.table = NULL;
+}
+
+RobotsVerdict robots_check(RobotsCache *cache, const char *url) {
+    size_t origin_len = robots_origin_length(url);
+    RobotsHost *host = (RobotsHost *)host_table_get(&cache->hosts, &last_origin, url, origin_len, robots_host_create, NULL);
+    RobotsRules *rules = robots_rules_acquire(cache, host);
+    robots_refresh(cache, host, rules);
+    if (rules == NULL) {
+        return ROBOTS_UNKNOWN;
+    }
+    bool allowed = robots_verdict(cache, rules, url, origin_len, false);
+    robots_rules_release(rules);
+    return allowed ? ROBOTS_ALLOWED : ROBOTS_DISALLOWED;
+}
+
+RobotsVerdict robots_admit(RobotsCache *cache, URLQueueNode *node) {
+    size_t origin_len = robots_origin_length(node->url);
+    RobotsHost *host = (RobotsHost *)host_table_get(&cache->hosts, &last_origin, node->url, origin_len,
+                                                    robots_host_create, NULL);
+    RobotsRules *rules = robots_rules_acquire(cache, host);
+    robots_refresh(cache, host, rules);
+    if (rules == NULL) {
+        // Park the node, unless the rules were published meanwhile: they are published with the shard locked
+        HostTableShard *shard = host_table_shard(&cache->hosts, host->entry.hash);
+        pthread_mutex_lock(&shard->lock);
+        rules = atomic_load_explicit(&host->rules, memory_order_acquire);
+        if (rules != NULL) {
+            atomic_fetch_add_explicit(&rules->references, 1, memory_order_relaxed);
+        } else {
+            node->next = NULL;
+            if (host->parked_tail != NULL) {
+                host->parked_tail->next = node;
+            } else {
+                host->parked = node;
+            }
+            host->parked_tail = node;
+            atomic_fetch_add(&cache->parked, 1);
+        }
+        pthread_mutex_unlock(&shard->lock);
+        if (rules == NULL) {
+            return ROBOTS_PARKED;
+        }
+    }
+    bool allowed = robots_verdict(cache, rules, node->url, origin_len, true);
+    robots_rules_release(rules);
+    return allowed ? ROBOTS_ALLOWED : ROBOTS_DISALLOWED;
+}
+
+void robots_pause(RobotsCache *cache) {
+    for (size_t i = 0; i < (size_t)1 << ROBOTS_SHARD_BITS; i++) {
+        pthread_mutex_lock(&cache->hosts.shards[i].lock);
+    }
+}
+
+void robots_resume(RobotsCache *cache) {
+    for (size_t i = 0; i < (size_t)1 << ROBOTS_SHARD_BITS; i++) {
+        pthread_mutex_unlock(&cache->hosts.shards[i].lock);
+    }
+}
+
+size_t robots_parked(RobotsCache *cache) {
+    return atomic_load(&cache->parked);
+}
+
+// Collects the parked URLs of one origin for robots_collect.
+typedef struct {
+    URLQueueNode **nodes;
+    size_t count;
+} RobotsCollect;
+
+static void robots_host_collect(HostEntry *entry, void *arg) {
+    RobotsCollect *collect = (RobotsCollect *)arg;
+    for (URLQueueNode *node = ((RobotsHost *)entry)->parked; node != NULL; node = node->next) {
+        collect->nodes[collect->count++] = node;
+    }
+}
+
+size_t robots_collect(RobotsCache *cache, URLQueueNode **nodes) {
+    RobotsCollect collect = { nodes, 0 };
+    host_table_each(&cache->hosts, robots_host_collect, &collect);
+    return collect.count;
+}
+
+double robots_crawl_delay(RobotsCache *cache, const char *host, size_t len) {
+    static const char *schemes[] = {"http://", "https://"};
+    double delay = 0;
+    char *origin = robots_alloc(NULL, strlen("https://") + len);
+    for (int i = 0; i < 2; i++) {
+        size_t scheme_len = strlen(schemes[i]);
+        memcpy(origin, schemes[i], scheme_len);
+        memcpy(origin + scheme_len, host, len);
+        RobotsHost *entry = (RobotsHost *)host_table_get(&cache->hosts, NULL, origin, scheme_len + len, NULL, NULL);
+        RobotsRules *rules = entry != NULL ? robots_rules_acquire(cache, entry) : NULL;
+        if (rules != NULL) {
+            delay = rules->crawl_delay > delay ? rules->crawl_delay : delay;
+            robots_rules_release(rules);
+        }
+    }
+    free(origin);
+    return delay;
+}
+
+size_t robots_hosts(RobotsCache *cache) {
+    return host_table_count(&cache->hosts);
+}
@@ -0,0 +1,172 @@
+#ifndef ROBOTS_H
+#define ROBOTS_H
+
+// Include size types.
+#include <stddef.h>
+// Include fixed-width integer types.
+#include <stdint.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+// Include atomic types for the published rules and the counters.
+#include <stdatomic.h>
+// Include the pthread library for the fetch queue and the fetcher threads.
+#include <pthread.h>
+// Include the sharded host table.
+#include "hosttable.h"
+// Include the queue node definition, for the URLs waiting on their host's rules.
+#include "nodepool.h"
+
+// Define the number of bits of the host hash that pick a shard.
+#define ROBOTS_SHARD_BITS 6
+// Define the number of threads that fetch robots.txt files.
+#define ROBOTS_FETCHERS 4
+// Define the most bytes of a robots.txt that are read (RFC 9309 asks for at least 500 KiB).
+#define ROBOTS_MAX_SIZE (500 * 1024)
+// Define how long (in seconds) the rules of a host are kept before they are fetched again.
+#define ROBOTS_TTL (24 * 60 * 60)
+// Define how long (in seconds) a host whose robots.txt could not be fetched stays disallowed before
+// it is tried again.
+#define ROBOTS_ERROR_TTL 60
+
+// Flags of a trie node: the pattern spelled by the path to the node ends there.
+#define ROBOTS_PREFIX_ALLOW 1        // Allow rule matching every path that starts with the pattern
+#define ROBOTS_PREFIX_DISALLOW 2
+#define ROBOTS_EXACT_ALLOW 4         // Allow rule ending in $, matching only the pattern itself
+#define ROBOTS_EXACT_DISALLOW 8
+
+// A node of the trie of literal patterns. Children are kept in a list of siblings; 0 ends a list,
+// since the root (node 0) is nobody's child.
+typedef struct {
+    uint32_t child;                  // First child
+    uint32_t sibling;                // Next child of the same parent
+    unsigned char byte;              // Byte on the edge from the parent
+    unsigned char flags;             // ROBOTS_* rules that end here
+} RobotsNode;
+
+// A pattern with a * in it, matched on its own.
+typedef struct {
+    char *pattern;                   // Normalized pattern, $ included
+    size_t length;                   // Its length, which is its priority
+    bool allow;
+} RobotsWildcard;
+
+/**
+ * @brief The rules of one host for the crawler's user agent, compiled for matching.
+ *
+ * Allow and Disallow patterns without a * (almost all of them) are merged into one trie, so a path is
+ * matched against all of them in a single walk down the trie, one byte at a time; the deepest rule
+ * passed is the longest matching pattern. Patterns with a * are kept in a short list and matched one
+ * by one. As in RFC 9309 the longest matching pattern decides, and Allow wins a tie; a path no pattern
+ * matches is allowed.
+ */
+typedef struct RobotsRules {
+    RobotsNode *nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+    RobotsWildcard *wildcards;
+    int wildcard_count;
+    int wildcard_capacity;
+    double crawl_delay;              // Seconds between fetches the host asks for, or 0
+    bool disallow_all;               // The robots.txt could not be fetched: nothing may be crawled
+    atomic_int references;           // The host's while these are its rules, plus one per check using them
+} RobotsRules;
+
+// The robots state of one origin (scheme, host and port).
+typedef struct RobotsHost {
+    HostEntry entry;                 // Keyed by origin
+    struct RobotsHost *queued_next;  // Next host waiting for a fetcher thread
+    _Atomic(RobotsRules *) rules;    // Current rules, or NULL until the first fetch finished; replaced
+                                     // and referenced under the shard lock
+    atomic_bool fetching;            // Set while the robots.txt is queued or being fetched
+    _Atomic uint64_t expires_ns;     // Monotonic time after which the rules are fetched again
+    URLQueueNode *parked;            // URLs waiting for the first rules, oldest first; guarded by the
+    URLQueueNode *parked_tail;       // shard lock
+    char origin[];                   // e.g. "https://example.com:8443"
+} RobotsHost;
+
+// What the rules of its origin say about a URL.
+typedef enum {
+    ROBOTS_ALLOWED,
+    ROBOTS_DISALLOWED,
+    ROBOTS_UNKNOWN,                  // The rules are not known yet; they are being fetched
+    ROBOTS_PARKED                    // Not known yet: the URL was kept until they are (see robots_admit)
+} RobotsVerdict;
+
+// Fetch the robots.txt at url. Returns the HTTP status, or 0 if there was no response, and stores a
+// malloc'ed body of at most ROBOTS_MAX_SIZE bytes (or NULL) in *body and its length in *len. Called by
+// the cache's fetcher threads.
+typedef long (*RobotsFetch)(const char *url, char **body, size_t *len, void *arg);
+// Hand back a URL robots_admit() parked, once the rules of its origin are known; allowed is their verdict,
+// and an allowed URL is to be checked again with robots_admit(). Called by a fetcher thread with the
+// origin's shard locked, so it must not call into the cache.
+typedef void (*RobotsRelease)(URLQueueNode *node, bool allowed, void *arg);
+
+/**
+ * @brief Per-host cache of robots.txt rules, fetched in the background.
+ *
+ * The first check of a URL on a new origin queues the origin's robots.txt for a pool of fetcher
+ * threads, which fetch it through the fetch callback and compile the group for the crawler's product
+ * token (or the * group); no thread that checks URLs ever waits for a fetch. A URL checked before the
+ * rules are known is either let through for now (robots_check, while its links are queued) or parked
+ * on its origin and handed back through the release callback once they are (robots_admit, before it
+ * is fetched). After that a check is a hash probe (skipped when the previous check of the thread was
+ * on the same origin) and a walk down the trie. Rules never change once published: a check takes a
+ * reference to them under the shard lock and matches without it, and replaced rules are freed when
+ * their last reference is dropped. Rules older than ROBOTS_TTL are fetched again while the old ones
+ * stay in use.
+ */
+typedef struct {
+    HostTable hosts;                 // RobotsHost records
+    pthread_mutex_t queue_lock;      // Protects the queue of origins to fetch
+    pthread_cond_t queue_ready;
+    RobotsHost *queue_head;
+    RobotsHost *queue_tail;
+    bool closed;                     // Set when the fetcher threads should exit
+    pthread_t fetchers[ROBOTS_FETCHERS];
+    int fetcher_count;
+    const char *agent;               // Product token the groups are matched against, e.g. "Googlebot"
+    RobotsFetch fetch;
+    void *fetch_arg;
+    RobotsRelease release;
+    void *release_arg;
+    atomic_size_t parked;            // URLs parked on origins whose rules are not known yet
+    atomic_ulong fetches;            // robots.txt files requested
+    atomic_ulong failures;           // Requests without a usable answer (no response or 5xx)
+    atomic_ulong checked;            // URLs checked
+    atomic_ulong disallowed;         // URLs turned away
+} RobotsCache;
+
+// Compile the rules in a robots.txt for a product token. Never returns NULL; allocation failures exit.
+RobotsRules *robots_compile(const char *text, size_t len, const char *agent);
+// Whether a path (with its query, as in a canonical URL) is allowed by compiled rules.
+bool robots_match(const RobotsRules *rules, const char *path, size_t len);
+// Free compiled rules, whatever their references.
+void robots_rules_free(RobotsRules *rules);
+// Initialize an empty cache that fetches robots.txt files with fetch and hands parked URLs to release,
+// and start its fetcher threads. Returns false if no thread could be started.
+bool robots_init(RobotsCache *cache, const char *agent, RobotsFetch fetch, void *fetch_arg, RobotsRelease release,
+                 void *release_arg);
+// Stop the fetcher threads and free the cache, every host's rules and every URL still parked.
+void robots_destroy(RobotsCache *cache);
+// What the rules say about a canonical http or https URL, or ROBOTS_UNKNOWN if they are not known yet.
+// Never blocks; unknown or expired rules are queued for a fetch. Only a disallowed URL is counted: one
+// that is let through is expected to be checked again with robots_admit().
+RobotsVerdict robots_check(RobotsCache *cache, const char *url);
+// What the rules say about the URL of a node about to be fetched. If they are not known yet the node is
+// parked and ROBOTS_PARKED returned; the release callback gets it once they are. Never blocks.
+RobotsVerdict robots_admit(RobotsCache *cache, URLQueueNode *node);
+// Keep the fetcher threads from publishing rules or releasing parked URLs until robots_resume().
+void robots_pause(RobotsCache *cache);
+void robots_resume(RobotsCache *cache);
+// Number of parked URLs.
+size_t robots_parked(RobotsCache *cache);
+// Store every parked URL in nodes (which must have room for robots_parked) and return their number.
+// The cache must be paused.
+size_t robots_collect(RobotsCache *cache, URLQueueNode **nodes);
+// Crawl-delay of a host ("host:port", as url_host() returns it), the larger of its http and https
+// origins', or 0 if their rules are not known yet or have none. Never fetches.
+double robots_crawl_delay(RobotsCache *cache, const char *host, size_t len);
+// Number of origins seen.
+size_t robots_hosts(RobotsCache *cache);
+
+#endif
@@ -0,0 +1,239 @@
+// Define the required feature test macro to enable syscall() for the futex calls.
+#define _GNU_SOURCE
+
+// Include the scheduler interface.
+#include "scheduler.h"
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include limits for waking every parked worker.
+#include <limits.h>
+// Include system-specific functions, such as syscall().
+#include <unistd.h>
+// Include the futex system call numbers and operations.
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static void futex_wait(atomic_uint *word, unsigned int expected) {
+    // Sleeps only if the word still holds the expected value, so a wake-up between the caller's check
+    // and this call is never lost
+    syscall(SYS_futex, (unsigned int *)word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_uint *word, int count) {
+    syscall(SYS_futex, (unsigned int *)word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+void scheduler_init(Scheduler *sched, URLQueue *global, PriorityFrontier *priority, int workers) {
+    sched->global = global;
+    sched->priority = priority;
+    sched->count = workers;
+    sched->deques = aligned_alloc(CACHE_LINE_SIZE, workers * sizeof(WorkDeque));
+    if (sched->deques == NULL) {
+        fprintf(stderr, "Failed to allocate memory for worker deques\n");
+        exit(1);
+    }
+    for (int i = 0; i < workers; i++) {
+        WorkDeque *deque = &sched->deques[i];
+        atomic_init(&deque->top, 0);
+        atomic_init(&deque->bottom, 0);
+        deque->buffer = calloc(DEQUE_CAPACITY, sizeof(*deque->buffer));
+        if (deque->buffer == NULL) {
+            fprintf(stderr, "Failed to allocate memory for worker deques\n");
+            exit(1);
+        }
+        deque->local_pops = deque->steals = deque->parks = 0;
+        deque->rng = 2654435761u * (unsigned int)(i + 1); // Distinct non-zero seed per worker
+    }
+    atomic_init(&sched->wake_seq, 0);
+    atomic_init(&sched->sleepers, 0);
+    atomic_init(&sched->closed, false);
+}
+
+// Push a node at the bottom of the owner's deque. Returns false if the deque is full.
+static bool deque_push(WorkDeque *deque, URLQueueNode *node) {
+    long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (b - t >= DEQUE_CAPACITY) {
+        return false;
+    }
+    atomic_store_explicit(&deque->buffer[b & (DEQUE_CAPACITY - 1)], node, memory_order_relaxed);
+    // Publish the slot before the new bottom makes it visible to thieves
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_release);
+    return true;
+}
+
+// Take the node at the top of a deque. Safe to call from any thread, including the owner.
+static URLQueueNode *deque_steal(WorkDeque *deque) {
+    while (true) {
+        long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+        atomic_thread_fence(memory_order_seq_cst);
+        long b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+        if (t >= b) {
+            return NULL; // Empty
+        }
+        URLQueueNode *node = atomic_load_explicit(&deque->buffer[t & (DEQUE_CAPACITY - 1)], memory_order_relaxed);
+        // The slot cannot be reused by the owner before top moves past it, so if this succeeds the
+        // node read above is the one that was at the top
+        if (atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst,
+                                                    memory_order_relaxed)) {
+            return node;
+        }
+        // Lost the race to another thief or the owner; try the new top
+    }
+}
+
+static bool deque_empty(WorkDeque *deque) {
+    return atomic_load(&deque->top) >= atomic_load(&deque->bottom);
+}
+
+void scheduler_destroy(Scheduler *sched) {
+    for (int i = 0; i < sched->count; i++) {
+        URLQueueNode *node;
+        while ((node = deque_steal(&sched->deques[i])) != NULL) {
+            node_free(node);
+        }
+        free(sched->deques[i].buffer);
+    }
+    free(sched->deques);
+}
+
+void sched_push(Scheduler *sched, int self, URLQueueNode *node) {
+    if (sched->priority != NULL) {
+        prio_push(sched->priority, self, node);
+    } else if (self < 0 || !deque_push(&sched->deques[self], node)) {
+        frontier_push(sched->global, node);
+    }
+}
+
+URLQueueNode *sched_pop(Scheduler *sched, int self) {
+    if (sched->priority != NULL) {
+        return prio_pop(sched->priority, self);
+    }
+
+    WorkDeque *own = &sched->deques[self];
+
+    URLQueueNode *node = deque_steal(own);
+    if (node != NULL) {
+        own->local_pops++;
+        return node;
+    }
+
+    node = frontier_pop(sched->global);
+    if (node != NULL) {
+        return node;
+    }
+
+    // Steal from the other workers, starting at a random victim so thieves spread out
+    own->rng ^= own->rng << 13;
+    own->rng ^= own->rng >> 17;
+    own->rng ^= own->rng << 5;
+    int start = (int)(own->rng % (unsigned int)sched->count);
+    for (int i = 0; i < sched->count; i++) {
+        int victim = (start + i) % sched->count;
+        if (victim == self) {
+            continue;
+        }
+        node = deque_steal(&sched->deques[victim]);
+        if (node != NULL) {
+            own->steals++;
+            return node;
+        }
+    }
+    return NULL;
+}
+
+// Check every queue for work, or whether the crawl is over. The answer may be stale by the time the
+// caller acts on it.
+static bool sched_has_work(Scheduler *sched) {
+    if (atomic_load(&sched->closed)) {
+        return true;
+    }
+    if (sched->priority != NULL && prio_size(sched->priority) > 0) {
+        return true;
+    }
+    if (!frontier_empty(sched->global)) {
+        return true;
+    }
+    for (int i = 0; i < sched->count; i++) {
+        if (!deque_empty(&sched->deques[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void sched_park(Scheduler *sched, int self) {
+    if (sched_has_work(sched)) {
+        return;
+    }
+    unsigned int seq = atomic_load(&sched->wake_seq);
+    atomic_fetch_add(&sched->sleepers, 1);
+    // Re-check after announcing ourselves: a producer that published before seeing us counted in
+    // sleepers has left work for us to find, and one that publishes later will wake us
+    if (!sched_has_work(sched)) {
+        sched->deques[self].parks++;
+        futex_wait(&sched->wake_seq, seq);
+    }
+    atomic_fetch_sub(&sched->sleepers, 1);
+}
+
+void sched_notify(Scheduler *sched, int pushed) {
+    if (pushed <= 0) {
+        return;
+    }
+    // Order the pushes before the sleepers check (pairs with the re-check in sched_park)
+    atomic_thread_fence(memory_order_seq_cst);
+    unsigned int sleepers = atomic_load(&sched->sleepers);
+    if (sleepers != 0) {
+        atomic_fetch_add(&sched->wake_seq, 1);
+        futex_wake(&sched->wake_seq, pushed < (int)sleepers ? pushed : (int)sleepers);
+    }
+}
+
+void sched_wake_all(Scheduler *sched) {
+    atomic_fetch_add(&sched->wake_seq, 1);
+    futex_wake(&sched->wake_seq, INT_MAX);
+}
+
+void sched_close(Scheduler *sched) {
+    // Set before the wake-up so a worker between its re-check and futex_wait either sees the flag or
+    // sleeps on a stale wake_seq and returns at once
+    atomic_store(&sched->closed, true);
+    sched_wake_all(sched);
+}
+
+size_t sched_size(Scheduler *sched) {
+    size_t size = frontier_size(sched->global);
+    if (sched->priority != NULL) {
+        size += prio_size(sched->priority);
+    }
+    for (int i = 0; i < sched->count; i++) {
+        long queued = atomic_load(&sched->deques[i].bottom) - atomic_load(&sched->deques[i].top);
+        if (queued > 0) {
+            size += (size_t)queued;
+        }
+    }
+    return size;
+}
+
+bool sched_save(Scheduler *sched, FILE *out, const SpillSnapshot *spill, size_t *count) {
+    if (!frontier_save(sched->global, out, spill, count)) {
+        return false;
+    }
+    if (sched->priority != NULL && !prio_save(sched->priority, out, count)) {
+        return false;
+    }
+    for (int i = 0; i < sched->count; i++) {
+        WorkDeque *deque = &sched->deques[i];
+        long bottom = atomic_load(&deque->bottom);
+        for (long t = atomic_load(&deque->top); t < bottom; t++) {
+            if (spill_record_write(out, atomic_load(&deque->buffer[t & (DEQUE_CAPACITY - 1)])) == 0) {
+                return false;
+            }
+            (*count)++;
+        }
+    }
+    return true;
+}
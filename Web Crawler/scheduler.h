@@ -0,0 +1,75 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// Include the shared URL frontier and queue node definition.
+#include "frontier.h"
+// Include the priority frontier used for best-first crawls.
+#include "priority.h"
+
+// Define the number of slots in each worker's local deque. Must be a power of two.
+#define DEQUE_CAPACITY (1 << 12)
+
+/**
+ * @brief A worker's local work-stealing deque (Chase-Lev).
+ *
+ * Only the owning worker pushes, at the bottom. Both the owner and thieves take from the top with a
+ * compare-and-swap, so each worker crawls its own discoveries oldest-first. The crawl has to stay
+ * breadth-first for the depth limit and the visited set to see every URL at its shallowest depth,
+ * which is why the owner does not take from the bottom as in the classic LIFO use of the deque.
+ */
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_long top;     // Next index to take; advanced by CAS
+    _Alignas(CACHE_LINE_SIZE) atomic_long bottom;  // Next index to push; written only by the owner
+    _Atomic(URLQueueNode *) *buffer;               // DEQUE_CAPACITY slots
+    unsigned long local_pops;                      // Nodes the owner took from its own deque
+    unsigned long steals;                          // Nodes the owner stole from other deques
+    unsigned long parks;                           // Times the owner went to sleep for lack of work
+    unsigned int rng;                              // Owner's victim-selection state
+} WorkDeque;
+
+/**
+ * @brief Work-stealing scheduler shared by the worker threads.
+ *
+ * Links a worker discovers go onto its own deque. A worker looking for work tries its own deque, then
+ * the shared frontier (which holds the seed URL and anything that did not fit in a deque), then steals
+ * from the other workers. A worker that finds nothing parks on a futex and is woken only when new work
+ * is published and someone is actually asleep.
+ *
+ * With a priority frontier the deques and the shared frontier are bypassed: every node is pushed to the
+ * priority frontier and popped from it best first, since a worker's own discoveries are no longer
+ * necessarily the next thing worth fetching.
+ */
+typedef struct {
+    URLQueue *global;                              // Shared frontier for external pushes and overflow
+    WorkDeque *deques;                             // One deque per worker
+    PriorityFrontier *priority;                    // Replaces the deques and the frontier if not NULL
+    int count;                                     // Number of workers
+    _Alignas(CACHE_LINE_SIZE) atomic_uint wake_seq;  // Futex word bumped on every wake-up
+    atomic_uint sleepers;                          // Number of workers parked on wake_seq
+    atomic_bool closed;                            // Set once the crawl is over; parking returns at once
+} Scheduler;
+
+// Initialize a scheduler for the given number of workers on top of a shared frontier, or of a priority
+// frontier if priority is not NULL.
+void scheduler_init(Scheduler *sched, URLQueue *global, PriorityFrontier *priority, int workers);
+// Free the deques and any nodes still in them.
+void scheduler_destroy(Scheduler *sched);
+// Queue a node. Workers (self >= 0) push to their own deque; anyone else pushes to the frontier.
+void sched_push(Scheduler *sched, int self, URLQueueNode *node);
+// Find the next node for a worker without blocking: own deque, then the frontier, then steal.
+URLQueueNode *sched_pop(Scheduler *sched, int self);
+// Park the calling worker until some queue has work in it or it is woken. May return spuriously.
+void sched_park(Scheduler *sched, int self);
+// Wake up to `pushed` parked workers after new work has been queued.
+void sched_notify(Scheduler *sched, int pushed);
+// Wake every parked worker, e.g. so one that has been asked to exit notices.
+void sched_wake_all(Scheduler *sched);
+// Mark the crawl as over and wake every parked worker; from then on sched_park never sleeps.
+void sched_close(Scheduler *sched);
+// Approximate number of queued nodes across the frontier and all deques.
+size_t sched_size(Scheduler *sched);
+// Write every node in the frontier and the deques as a SpillRecord (see frontier_save). The workers must
+// be stopped. Adds the number of records to *count.
+bool sched_save(Scheduler *sched, FILE *out, const SpillSnapshot *spill, size_t *count);
+
+#endif
@@ -0,0 +1,253 @@
+// Define the required feature test macro to enable strdup() and mkdir().
+#define _POSIX_C_SOURCE 200809L
+
+// Include the spill store interface.
+#include "spill.h"
+// Include the queue node definition.
+#include "frontier.h"
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+// Include errno for mkdir().
+#include <errno.h>
+// Include mkdir() and fstat().
+#include <sys/stat.h>
+// Include open().
+#include <fcntl.h>
+// Include pread() and close().
+#include <unistd.h>
+
+static void segment_path(const SpillStore *spill, unsigned long segment, char *path, size_t size) {
+    snprintf(path, size, "%s/frontier-%08lu.seg", spill->dir, segment);
+}
+
+bool spill_init(SpillStore *spill, const char *dir) {
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        perror("Failed to create the spill directory");
+        return false;
+    }
+    spill->dir = strdup(dir);
+    spill->writer_buffer = malloc(SPILL_IO_BUFFER);
+    spill->reader_buffer = malloc(SPILL_IO_BUFFER);
+    if (spill->dir == NULL || spill->writer_buffer == NULL || spill->reader_buffer == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the spill store\n");
+        exit(1);
+    }
+    spill->first_segment = spill->next_segment = 0;
+    spill->writer = spill->reader = NULL;
+    spill->writer_bytes = 0;
+    spill->reader_offset = 0;
+    spill->records = 0;
+    spill->bytes_written = spill->bytes_read = 0;
+    spill->segments = 0;
+    spill->string_buffer = NULL;
+    spill->string_capacity = 0;
+    return true;
+}
+
+void spill_destroy(SpillStore *spill) {
+    if (spill->writer != NULL) {
+        fclose(spill->writer);
+    }
+    if (spill->reader != NULL) {
+        fclose(spill->reader);
+    }
+    char path[4096];
+    for (unsigned long segment = spill->first_segment; segment < spill->next_segment; segment++) {
+        segment_path(spill, segment, path, sizeof(path));
+        remove(path);
+    }
+    free(spill->writer_buffer);
+    free(spill->reader_buffer);
+    free(spill->string_buffer);
+    free(spill->dir);
+}
+
+// Close the segment being written so it can be read.
+static void close_writer(SpillStore *spill) {
+    if (spill->writer != NULL) {
+        fclose(spill->writer);
+        spill->writer = NULL;
+    }
+}
+
+size_t spill_record_write(FILE *out, const URLQueueNode *node) {
+    SpillRecord record;
+    record.depth = node->depth;
+    record.url_len = (uint32_t)strlen(node->url);
+    record.base_len = node->base_url != NULL ? (uint32_t)strlen(node->base_url) : UINT32_MAX;
+    size_t base_len = node->base_url != NULL ? record.base_len : 0;
+    if (fwrite(&record, sizeof(record), 1, out) != 1 ||
+        fwrite(node->url, 1, record.url_len, out) != record.url_len ||
+        fwrite(node->base_url, 1, base_len, out) != base_len) {
+        return 0;
+    }
+    return sizeof(record) + record.url_len + base_len;
+}
+
+size_t spill_write(SpillStore *spill, URLQueueNode *head) {
+    size_t written = 0;
+    while (head != NULL) {
+        if (spill->writer == NULL) {
+            char path[4096];
+            segment_path(spill, spill->next_segment, path, sizeof(path));
+            spill->writer = fopen(path, "wb");
+            if (spill->writer == NULL) {
+                perror("Failed to create a spill segment");
+                exit(1);
+            }
+            setvbuf(spill->writer, spill->writer_buffer, _IOFBF, SPILL_IO_BUFFER);
+            spill->next_segment++;
+            spill->writer_bytes = 0;
+            spill->segments++;
+        }
+
+        size_t bytes = spill_record_write(spill->writer, head);
+        if (bytes == 0) {
+            perror("Failed to write a spill segment");
+            exit(1);
+        }
+        spill->writer_bytes += bytes;
+        spill->bytes_written += bytes;
+        spill->records++;
+        written++;
+
+        URLQueueNode *next = head->next;
+        node_free(head);
+        head = next;
+
+        if (spill->writer_bytes >= SPILL_SEGMENT_BYTES) {
+            close_writer(spill);
+        }
+    }
+    // Push the batch to the kernel so a reader opening the segment later sees all of it
+    if (spill->writer != NULL) {
+        fflush(spill->writer);
+    }
+    return written;
+}
+
+// Read a record's URL and base URL into the store's string buffer.
+static void read_strings(SpillStore *spill, size_t len) {
+    if (spill->string_capacity < len) {
+        free(spill->string_buffer);
+        spill->string_buffer = malloc(len);
+        spill->string_capacity = len;
+    }
+    if (spill->string_buffer == NULL || fread(spill->string_buffer, 1, len, spill->reader) != len) {
+        fprintf(stderr, "Failed to read a spill segment\n");
+        exit(1);
+    }
+}
+
+size_t spill_read(SpillStore *spill, size_t max, URLQueueNode **head, URLQueueNode **tail) {
+    size_t count = 0;
+    *head = *tail = NULL;
+    while (count < max && spill->records > 0) {
+        if (spill->reader == NULL) {
+            // The oldest segment may still be the one being written; close it so it is complete
+            if (spill->first_segment == spill->next_segment - 1) {
+                close_writer(spill);
+            }
+            char path[4096];
+            segment_path(spill, spill->first_segment, path, sizeof(path));
+            spill->reader = fopen(path, "rb");
+            if (spill->reader == NULL) {
+                perror("Failed to open a spill segment");
+                exit(1);
+            }
+            setvbuf(spill->reader, spill->reader_buffer, _IOFBF, SPILL_IO_BUFFER);
+            spill->reader_offset = 0;
+        }
+
+        SpillRecord record;
+        if (fread(&record, sizeof(record), 1, spill->reader) != 1) {
+            // End of the segment: it has been read completely, so delete it and move to the next one
+            char path[4096];
+            fclose(spill->reader);
+            spill->reader = NULL;
+            segment_path(spill, spill->first_segment, path, sizeof(path));
+            remove(path);
+            spill->first_segment++;
+            continue;
+        }
+
+        size_t base_len = record.base_len != UINT32_MAX ? record.base_len : 0;
+        read_strings(spill, (size_t)record.url_len + base_len);
+        const char *base_url = record.base_len != UINT32_MAX ? spill->string_buffer + record.url_len : NULL;
+        URLQueueNode *node = node_create(spill->string_buffer, record.url_len, base_url, base_len, record.depth);
+        size_t bytes = sizeof(record) + record.url_len + base_len;
+        spill->bytes_read += bytes;
+        spill->reader_offset += (off_t)bytes;
+        spill->records--;
+
+        if (*tail != NULL) {
+            (*tail)->next = node;
+        } else {
+            *head = node;
+        }
+        *tail = node;
+        count++;
+    }
+    return count;
+}
+
+bool spill_snapshot(SpillStore *spill, SpillSnapshot *snapshot) {
+    snapshot->count = 0;
+    snapshot->records = spill->records;
+    snapshot->segments = NULL;
+    if (spill->records == 0) {
+        return true;
+    }
+    // Every spill_write() ends with a flush, so each file on disk already holds all of its records
+    snapshot->segments = calloc(spill->next_segment - spill->first_segment, sizeof(SpillSnapshotSegment));
+    if (snapshot->segments == NULL) {
+        return false;
+    }
+    for (unsigned long segment = spill->first_segment; segment < spill->next_segment; segment++) {
+        char path[4096];
+        struct stat st;
+        segment_path(spill, segment, path, sizeof(path));
+        int fd = open(path, O_RDONLY);
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            perror("Failed to open a spill segment for a snapshot");
+            if (fd >= 0) {
+                close(fd);
+            }
+            spill_snapshot_release(snapshot);
+            return false;
+        }
+        SpillSnapshotSegment *part = &snapshot->segments[snapshot->count++];
+        part->fd = fd;
+        part->start = (segment == spill->first_segment && spill->reader != NULL) ? spill->reader_offset : 0;
+        part->end = st.st_size;
+    }
+    return true;
+}
+
+bool spill_snapshot_copy(const SpillSnapshot *snapshot, FILE *out) {
+    char buffer[64 * 1024];
+    for (int i = 0; i < snapshot->count; i++) {
+        const SpillSnapshotSegment *part = &snapshot->segments[i];
+        // pread() leaves the descriptor's offset alone, so a descriptor shared with a forked process is safe
+        for (off_t offset = part->start; offset < part->end;) {
+            size_t want = part->end - offset < (off_t)sizeof(buffer) ? (size_t)(part->end - offset) : sizeof(buffer);
+            ssize_t got = pread(part->fd, buffer, want, offset);
+            if (got <= 0 || fwrite(buffer, 1, (size_t)got, out) != (size_t)got) {
+                return false;
+            }
+            offset += got;
+        }
+    }
+    return true;
+}
+
+void spill_snapshot_release(SpillSnapshot *snapshot) {
+    for (int i = 0; i < snapshot->count; i++) {
+        close(snapshot->segments[i].fd);
+    }
+    free(snapshot->segments);
+    snapshot->segments = NULL;
+    snapshot->count = 0;
+}
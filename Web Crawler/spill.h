@@ -0,0 +1,89 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+// Include size types.
+#include <stddef.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+// Include standard input/output functionality for the segment files.
+#include <stdio.h>
+// Include fixed-width integer types for the record header.
+#include <stdint.h>
+// Include off_t.
+#include <sys/types.h>
+
+// Forward declaration of the queue node; the full definition is in frontier.h.
+struct URLQueueNode;
+
+// Define the size at which the segment being written is closed and a new one started.
+#define SPILL_SEGMENT_BYTES (64 * 1024 * 1024)
+// Define the stdio buffer size used for reading and writing segments.
+#define SPILL_IO_BUFFER (1024 * 1024)
+
+// Header of one stored node, followed by the URL and base URL bytes (no terminators). A NULL base URL is
+// stored with base_len == UINT32_MAX and no bytes. Checkpoints store frontier nodes in the same format.
+typedef struct {
+    int32_t depth;
+    uint32_t url_len;
+    uint32_t base_len;
+} SpillRecord;
+
+/**
+ * @brief A FIFO of queue nodes stored in append-only segment files on disk.
+ *
+ * Nodes are written to the newest segment in the order they arrive and read back from the oldest
+ * segment in the same order, so both sides do purely sequential I/O. A segment is deleted as soon as
+ * it has been read to the end. Segments are named frontier-NNNNNNNN.seg inside the spill directory.
+ * Not thread-safe; the frontier calls it under its overflow lock.
+ */
+typedef struct {
+    char *dir;                       // Directory holding the segment files
+    unsigned long first_segment;     // Oldest segment still on disk (the one being read)
+    unsigned long next_segment;      // Number the next new segment gets
+    FILE *writer;                    // Segment next_segment - 1 while it is open for appending
+    char *writer_buffer;
+    size_t writer_bytes;             // Bytes written to the open segment
+    FILE *reader;                    // Segment first_segment while it is being read
+    char *reader_buffer;
+    char *string_buffer;             // A record's URL and base URL while its node is created
+    size_t string_capacity;
+    off_t reader_offset;             // Bytes of the reader's segment already consumed
+    size_t records;                  // Nodes on disk that have not been read back
+    size_t bytes_written;            // Totals, for the end-of-crawl summary
+    size_t bytes_read;
+    unsigned long segments;
+} SpillStore;
+
+// The part of one segment that holds unread records, at the time of a snapshot.
+typedef struct {
+    int fd;                          // Open descriptor, so the segment survives being deleted
+    off_t start;
+    off_t end;
+} SpillSnapshotSegment;
+
+// The unread records of a spill store at one point in time. See spill_snapshot().
+typedef struct {
+    SpillSnapshotSegment *segments;
+    int count;
+    size_t records;
+} SpillSnapshot;
+
+// Prepare a spill store in dir, creating the directory if needed. Returns false on failure.
+bool spill_init(SpillStore *spill, const char *dir);
+// Close the store and delete the segment files it still has.
+void spill_destroy(SpillStore *spill);
+// Append a list of nodes (linked through next) to disk and free them. Returns the number written.
+size_t spill_write(SpillStore *spill, struct URLQueueNode *head);
+// Read up to max nodes back, oldest first, as a new list. Sets *tail and returns the number read.
+size_t spill_read(SpillStore *spill, size_t max, struct URLQueueNode **head, struct URLQueueNode **tail);
+// Write one node as a record. Returns the number of bytes written, or 0 on failure.
+size_t spill_record_write(FILE *out, const struct URLQueueNode *node);
+// Capture which bytes of which segments hold unread records. The store must not be in use meanwhile;
+// afterwards it may be used again and the snapshot still sees the records as they were.
+bool spill_snapshot(SpillStore *spill, SpillSnapshot *snapshot);
+// Copy a snapshot's records to out. Returns false on an I/O error.
+bool spill_snapshot_copy(const SpillSnapshot *snapshot, FILE *out);
+// Close the snapshot's descriptors.
+void spill_snapshot_release(SpillSnapshot *snapshot);
+
+#endif
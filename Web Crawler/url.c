@@ -0,0 +1,330 @@
+// Include the URL resolver interface.
+#include "url.h"
+// Include string manipulation functions.
+#include <string.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+
+// A component of a URL: a range of the input, and whether the component is present at all (an empty
+// query "?" is present, a missing one is not).
+typedef struct {
+    const char *ptr;
+    size_t len;
+    bool present;
+} Span;
+
+// The components of a URL reference (RFC 3986, appendix B). The fragment is never needed.
+typedef struct {
+    Span scheme;
+    Span authority;
+    Span path;
+    Span query;
+} UrlParts;
+
+// Which characters a component may carry unescaped besides the unreserved ones and the sub-delimiters.
+typedef enum {
+    PART_HOST,
+    PART_PATH,
+    PART_QUERY
+} PartKind;
+
+static const char HEX[] = "0123456789ABCDEF";
+
+static bool is_alpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static int hex_value(char c) {
+    if (is_digit(c)) {
+        return c - '0';
+    }
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+        return (c | 0x20) - 'a' + 10;
+    }
+    return -1;
+}
+
+static char to_lower(char c) {
+    return c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+}
+
+static bool is_unreserved(unsigned char c) {
+    return is_alpha((char)c) || is_digit((char)c) || c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+static bool is_allowed(unsigned char c, PartKind kind) {
+    if (is_unreserved(c) || strchr("!$&'()*+,;=", c) != NULL) {
+        return c != '\0';
+    }
+    switch (kind) {
+        case PART_HOST: return c == ':' || c == '[' || c == ']' || c == '@';
+        case PART_PATH: return c == ':' || c == '@' || c == '/';
+        default: return c == ':' || c == '@' || c == '/' || c == '?';
+    }
+}
+
+// Case-insensitive comparison of a span with a lower-case word.
+static bool span_is(Span span, const char *word) {
+    if (span.len != strlen(word)) {
+        return false;
+    }
+    for (size_t i = 0; i < span.len; i++) {
+        if (to_lower(span.ptr[i]) != word[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Split a reference into its components.
+static void url_split(const char *s, size_t len, UrlParts *parts) {
+    const char *end = s + len, *p = s;
+    memset(parts, 0, sizeof(UrlParts));
+
+    // scheme = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." ), ended by ':' before any '/', '?' or '#'
+    if (p < end && is_alpha(*p)) {
+        const char *q = p + 1;
+        while (q < end && (is_alpha(*q) || is_digit(*q) || *q == '+' || *q == '-' || *q == '.')) {
+            q++;
+        }
+        if (q < end && *q == ':') {
+            parts->scheme = (Span){ p, (size_t)(q - p), true };
+            p = q + 1;
+        }
+    }
+    if (end - p >= 2 && p[0] == '/' && p[1] == '/') {
+        const char *q = p + 2;
+        while (q < end && *q != '/' && *q != '?' && *q != '#') {
+            q++;
+        }
+        parts->authority = (Span){ p + 2, (size_t)(q - p - 2), true };
+        p = q;
+    }
+    const char *q = p;
+    while (q < end && *q != '?' && *q != '#') {
+        q++;
+    }
+    parts->path = (Span){ p, (size_t)(q - p), true };
+    p = q;
+    if (p < end && *p == '?') {
+        q = p + 1;
+        while (q < end && *q != '#') {
+            q++;
+        }
+        parts->query = (Span){ p + 1, (size_t)(q - p - 1), true };
+    }
+}
+
+// Append a component with its percent-encoding normalized. Returns the new end of the output.
+static char *append_normalized(char *out, const char *s, size_t len, PartKind kind, bool lower) {
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '\t' || c == '\n' || c == '\r') {
+            continue; // Dropped wherever they appear, as browsers do
+        }
+        if (c == '%' && i + 2 < len && hex_value(s[i + 1]) >= 0 && hex_value(s[i + 2]) >= 0) {
+            unsigned char value = (unsigned char)(hex_value(s[i + 1]) * 16 + hex_value(s[i + 2]));
+            if (is_unreserved(value)) {
+                *out++ = lower ? to_lower((char)value) : (char)value;
+            } else {
+                *out++ = '%';
+                *out++ = HEX[value >> 4];
+                *out++ = HEX[value & 15];
+            }
+            i += 2;
+        } else if (c != '%' && is_allowed(c, kind)) {
+            *out++ = lower ? to_lower((char)c) : (char)c;
+        } else {
+            *out++ = '%';
+            *out++ = HEX[c >> 4];
+            *out++ = HEX[c & 15];
+        }
+    }
+    return out;
+}
+
+// Remove "." and ".." segments from a path that starts with '/' (RFC 3986, section 5.2.4), in place.
+// Returns the new length.
+static size_t remove_dot_segments(char *path, size_t len) {
+    size_t in = 0, out = 0;
+    while (in < len) {
+        // path[in] is the '/' in front of a segment
+        size_t segment = in + 1, segment_end = segment;
+        while (segment_end < len && path[segment_end] != '/') {
+            segment_end++;
+        }
+        size_t segment_len = segment_end - segment;
+        bool last = segment_end == len;
+        if (segment_len == 1 && path[segment] == '.') {
+            if (last) {
+                path[out++] = '/';
+            }
+        } else if (segment_len == 2 && path[segment] == '.' && path[segment + 1] == '.') {
+            // Drop the last output segment together with the '/' in front of it
+            while (out > 0 && path[out - 1] != '/') {
+                out--;
+            }
+            if (out > 0) {
+                out--;
+            }
+            if (last) {
+                path[out++] = '/';
+            }
+        } else {
+            // The output never overtakes the input, so moving the segment down is safe
+            path[out++] = '/';
+            memmove(path + out, path + segment, segment_len);
+            out += segment_len;
+        }
+        in = segment_end;
+    }
+    if (out == 0) {
+        path[out++] = '/';
+    }
+    return out;
+}
+
+// Append a normalized authority: lower-case host, default or empty port dropped.
+static char *append_authority(char *out, Span authority, const char *default_port) {
+    const char *p = authority.ptr, *end = authority.ptr + authority.len;
+
+    // userinfo is everything up to the last '@'
+    const char *at = NULL;
+    for (const char *q = p; q < end; q++) {
+        if (*q == '@') {
+            at = q;
+        }
+    }
+    if (at != NULL) {
+        out = append_normalized(out, p, (size_t)(at - p), PART_PATH, false);
+        *out++ = '@';
+        p = at + 1;
+    }
+
+    // The port follows the last ':' that is not inside an IPv6 literal
+    const char *colon = NULL;
+    for (const char *q = p; q < end; q++) {
+        if (*q == ':') {
+            colon = q;
+        } else if (*q == ']') {
+            colon = NULL;
+        }
+    }
+    const char *host_end = colon != NULL ? colon : end;
+    out = append_normalized(out, p, (size_t)(host_end - p), PART_HOST, true);
+
+    if (colon != NULL) {
+        const char *port = colon + 1;
+        while (port < end - 1 && *port == '0') {
+            port++; // Leading zeros
+        }
+        size_t port_len = (size_t)(end - port);
+        if (port_len > 0 && !(strlen(default_port) == port_len && memcmp(port, default_port, port_len) == 0)) {
+            *out++ = ':';
+            out = append_normalized(out, port, port_len, PART_HOST, false);
+        }
+    }
+    return out;
+}
+
+size_t url_resolve(const char *base, const char *ref, size_t ref_len, char *out) {
+    // Ignore leading and trailing whitespace and control characters
+    while (ref_len > 0 && (unsigned char)ref[0] <= ' ') {
+        ref++;
+        ref_len--;
+    }
+    while (ref_len > 0 && (unsigned char)ref[ref_len - 1] <= ' ') {
+        ref_len--;
+    }
+
+    UrlParts r, b, t;
+    url_split(ref, ref_len, &r);
+    if (r.scheme.present) {
+        t = r;
+    } else {
+        if (base == NULL) {
+            return 0;
+        }
+        url_split(base, strlen(base), &b);
+        if (!b.scheme.present) {
+            return 0;
+        }
+        t.scheme = b.scheme;
+        if (r.authority.present) {
+            t.authority = r.authority;
+            t.path = r.path;
+            t.query = r.query;
+        } else {
+            t.authority = b.authority;
+            if (r.path.len == 0) {
+                t.path = b.path;
+                t.query = r.query.present ? r.query : b.query;
+            } else {
+                t.path = r.path; // Merged with the base path below unless it is absolute
+                t.query = r.query;
+            }
+        }
+    }
+
+    // Only http and https URLs with a host are crawlable
+    const char *default_port;
+    if (span_is(t.scheme, "http")) {
+        default_port = "80";
+    } else if (span_is(t.scheme, "https")) {
+        default_port = "443";
+    } else {
+        return 0;
+    }
+    if (!t.authority.present || t.authority.len == 0) {
+        return 0;
+    }
+
+    char *o = out;
+    o = append_normalized(o, t.scheme.ptr, t.scheme.len, PART_HOST, true);
+    *o++ = ':';
+    *o++ = '/';
+    *o++ = '/';
+    char *host = o;
+    o = append_authority(o, t.authority, default_port);
+    if (o == host) {
+        return 0;
+    }
+
+    // The path: the reference's, or the base's directory followed by the reference's
+    char *path = o;
+    bool merge = !r.scheme.present && !r.authority.present && r.path.len > 0 && r.path.ptr[0] != '/';
+    if (merge) {
+        if (b.path.len == 0) {
+            *o++ = '/';
+        } else {
+            size_t directory = b.path.len;
+            while (directory > 0 && b.path.ptr[directory - 1] != '/') {
+                directory--;
+            }
+            o = append_normalized(o, b.path.ptr, directory, PART_PATH, false);
+        }
+    }
+    if (o == path && (t.path.len == 0 || t.path.ptr[0] != '/')) {
+        *o++ = '/'; // A path after an authority is empty or starts with '/'
+    }
+    o = append_normalized(o, t.path.ptr, t.path.len, PART_PATH, false);
+    o = path + remove_dot_segments(path, (size_t)(o - path));
+
+    if (t.query.present && t.query.len > 0) {
+        *o++ = '?';
+        o = append_normalized(o, t.query.ptr, t.query.len, PART_QUERY, false);
+    }
+    *o = '\0';
+    return (size_t)(o - out);
+}
+
+const char *url_host(const char *url, size_t *len) {
+    const char *start = strstr(url, "://");
+    start = start != NULL ? start + 3 : url;
+    *len = strcspn(start, "/?#");
+    return start;
+}
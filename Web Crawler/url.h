@@ -0,0 +1,39 @@
+#ifndef URL_H
+#define URL_H
+
+// Include size types.
+#include <stddef.h>
+
+// Define the most bytes url_resolve() may write, terminator included, for a base and a reference of the
+// given lengths. Every input byte becomes at most three (percent-encoded) and a few separators are added.
+#define URL_RESOLVE_MAX(base_len, ref_len) (3 * ((base_len) + (ref_len)) + 8)
+
+/**
+ * @brief Resolve a reference against a base URL (RFC 3986, section 5) and normalize the result.
+ *
+ * The result is the canonical form used as the visited-set key, so that every spelling of a resource
+ * maps to one string:
+ * - scheme and host are lower-cased, and a default port (80 for http, 443 for https) or empty port is
+ *   dropped;
+ * - "." and ".." segments are removed and an empty path becomes "/";
+ * - percent-escapes of unreserved characters are decoded, other escapes get upper-case hex digits, and
+ *   bytes that may not appear in a URL (spaces, controls, non-ASCII) are percent-encoded;
+ * - the fragment and an empty query are dropped;
+ * - leading and trailing whitespace and embedded tabs and newlines in the reference are ignored.
+ *
+ * The components of both inputs are located in place and written straight to out; no intermediate
+ * string is built.
+ *
+ * @param base The absolute URL the reference appears in, or NULL if the reference must be absolute.
+ * @param ref The reference, e.g. an href value. Need not be terminated.
+ * @param ref_len The length of ref.
+ * @param out Receives the terminated result. Must hold URL_RESOLVE_MAX(strlen(base), ref_len) bytes.
+ * @return The length of the result, or 0 if it is not an http or https URL with a host.
+ */
+size_t url_resolve(const char *base, const char *ref, size_t ref_len, char *out);
+
+// Find the authority of a URL in canonical form: everything between "://" and the path, e.g.
+// "example.com:8080". Returns its start and stores its length in *len.
+const char *url_host(const char *url, size_t *len);
+
+#endif
@@ -0,0 +1,542 @@
+// Include the visited set interface.
+#include "visited.h"
+// Include standard input/output functionality.
+#include <stdio.h>
+// Include standard library functionality, such as memory allocation.
+#include <stdlib.h>
+// Include string manipulation functions.
+#include <string.h>
+
+// Define the number of slots each shard starts with. Must be a power of two.
+#define VISITED_INITIAL_CAPACITY 1024
+// Define the number of buckets in a shard's first cuckoo filter. Must be a power of two.
+#define CUCKOO_INITIAL_BUCKETS 64
+// Define the load (in percent) at which a shard starts a new cuckoo filter.
+#define CUCKOO_MAX_LOAD 95
+
+static uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t url_hash(const char *data, size_t len) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ (len * 0xff51afd7ed558ccdULL);
+    // Consume eight bytes at a time, then the tail
+    while (len >= 8) {
+        uint64_t k;
+        memcpy(&k, data, 8);
+        h = (h ^ mix64(k)) * 0x9fb21c651e98df25ULL;
+        h ^= h >> 29;
+        data += 8;
+        len -= 8;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data, len);
+    h = (h ^ mix64(tail)) * 0x9fb21c651e98df25ULL;
+    return mix64(h);
+}
+
+// Smallest power of two that is at least n.
+static size_t round_up_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+static CuckooFilter *filter_new(VisitedSet *set, size_t buckets, CuckooFilter *next) {
+    CuckooFilter *filter = malloc(sizeof(CuckooFilter));
+    if (filter == NULL) {
+        return NULL;
+    }
+    filter->slots = calloc(buckets * CUCKOO_BUCKET_SLOTS, set->fingerprint_bits / 8);
+    if (filter->slots == NULL) {
+        free(filter);
+        return NULL;
+    }
+    filter->buckets = buckets;
+    filter->count = 0;
+    filter->next = next;
+    return filter;
+}
+
+void visited_init(VisitedSet *set, VisitedMode mode, double false_positive_rate, size_t expected_urls) {
+    set->mode = mode;
+    // A lookup compares against the 2 * CUCKOO_BUCKET_SLOTS fingerprints in its two buckets, so a full
+    // filter of f-bit fingerprints answers "present" for a new URL with probability about 8 / (2^f - 1)
+    set->fingerprint_bits = 32;
+    for (int bits = 8; bits < 32; bits *= 2) {
+        if (2.0 * CUCKOO_BUCKET_SLOTS / ((1UL << bits) - 1) <= false_positive_rate) {
+            set->fingerprint_bits = bits;
+            break;
+        }
+    }
+
+    size_t per_shard = expected_urls / VISITED_SHARDS;
+    for (int i = 0; i < VISITED_SHARDS; i++) {
+        VisitedShard *shard = &set->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->count = 0;
+        shard->entries = NULL;
+        shard->capacity = 0;
+        shard->filters = NULL;
+        if (mode == VISITED_EXACT) {
+            // Size the table so the expected URLs fit under the 70% load limit
+            shard->capacity = round_up_pow2(per_shard * 10 / 7 + 1);
+            if (shard->capacity < VISITED_INITIAL_CAPACITY) {
+                shard->capacity = VISITED_INITIAL_CAPACITY;
+            }
+            shard->entries = calloc(shard->capacity, sizeof(VisitedEntry));
+        } else {
+            size_t buckets = round_up_pow2(per_shard * 100 / (CUCKOO_BUCKET_SLOTS * CUCKOO_MAX_LOAD) + 1);
+            if (buckets < CUCKOO_INITIAL_BUCKETS) {
+                buckets = CUCKOO_INITIAL_BUCKETS;
+            }
+            shard->filters = filter_new(set, buckets, NULL);
+        }
+        if (shard->entries == NULL && shard->filters == NULL) {
+            fprintf(stderr, "Failed to allocate memory for the visited set\n");
+            exit(1);
+        }
+        shard->arena = NULL;
+        shard->arena_bytes = 0;
+        shard->rng = 2654435761u * (unsigned int)(i + 1);
+        shard->lookups = shard->probes = shard->kicks = 0;
+    }
+}
+
+void visited_destroy(VisitedSet *set) {
+    for (int i = 0; i < VISITED_SHARDS; i++) {
+        VisitedShard *shard = &set->shards[i];
+        VisitedArenaBlock *block = shard->arena;
+        while (block != NULL) {
+            VisitedArenaBlock *next = block->next;
+            free(block);
+            block = next;
+        }
+        CuckooFilter *filter = shard->filters;
+        while (filter != NULL) {
+            CuckooFilter *next = filter->next;
+            free(filter->slots);
+            free(filter);
+            filter = next;
+        }
+        free(shard->entries);
+        pthread_mutex_destroy(&shard->lock);
+    }
+}
+
+// Copy a key into the shard's arena. Called with the shard lock held.
+static const char *arena_copy(VisitedShard *shard, const char *key, size_t len) {
+    VisitedArenaBlock *block = shard->arena;
+    if (block == NULL || block->size - block->used < len + 1) {
+        // Start a new block; a key longer than a block gets a block of its own
+        size_t size = len + 1 > VISITED_ARENA_BLOCK ? len + 1 : VISITED_ARENA_BLOCK;
+        block = malloc(sizeof(VisitedArenaBlock) + size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = shard->arena;
+        block->used = 0;
+        block->size = size;
+        shard->arena = block;
+        shard->arena_bytes += sizeof(VisitedArenaBlock) + size;
+    }
+    char *copy = block->data + block->used;
+    memcpy(copy, key, len + 1);
+    block->used += len + 1;
+    return copy;
+}
+
+// Double a shard's table. Stored hashes are reused, so no key is read. Called with the shard lock held.
+static bool shard_grow(VisitedShard *shard) {
+    size_t capacity = shard->capacity * 2;
+    VisitedEntry *entries = calloc(capacity, sizeof(VisitedEntry));
+    if (entries == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < shard->capacity; i++) {
+        VisitedEntry *entry = &shard->entries[i];
+        if (entry->key != NULL) {
+            size_t slot = entry->hash & (capacity - 1);
+            while (entries[slot].key != NULL) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            entries[slot] = *entry;
+        }
+    }
+    free(shard->entries);
+    shard->entries = entries;
+    shard->capacity = capacity;
+    return true;
+}
+
+// Read or write fingerprint slot i of a filter, whatever the set's fingerprint width.
+static uint32_t slot_get(const VisitedSet *set, const CuckooFilter *filter, size_t i) {
+    switch (set->fingerprint_bits) {
+        case 8: return ((const uint8_t *)filter->slots)[i];
+        case 16: return ((const uint16_t *)filter->slots)[i];
+        default: return ((const uint32_t *)filter->slots)[i];
+    }
+}
+
+static void slot_set(const VisitedSet *set, CuckooFilter *filter, size_t i, uint32_t fingerprint) {
+    switch (set->fingerprint_bits) {
+        case 8: ((uint8_t *)filter->slots)[i] = (uint8_t)fingerprint; break;
+        case 16: ((uint16_t *)filter->slots)[i] = (uint16_t)fingerprint; break;
+        default: ((uint32_t *)filter->slots)[i] = fingerprint; break;
+    }
+}
+
+// The other bucket a fingerprint may live in. Applying it twice gives back the original bucket.
+static size_t alt_bucket(const CuckooFilter *filter, size_t bucket, uint32_t fingerprint) {
+    return (bucket ^ ((size_t)fingerprint * 0x5bd1e995u)) & (filter->buckets - 1);
+}
+
+static bool bucket_contains(const VisitedSet *set, const CuckooFilter *filter, size_t bucket, uint32_t fingerprint) {
+    for (size_t i = 0; i < CUCKOO_BUCKET_SLOTS; i++) {
+        if (slot_get(set, filter, bucket * CUCKOO_BUCKET_SLOTS + i) == fingerprint) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool bucket_add(const VisitedSet *set, CuckooFilter *filter, size_t bucket, uint32_t fingerprint) {
+    for (size_t i = 0; i < CUCKOO_BUCKET_SLOTS; i++) {
+        if (slot_get(set, filter, bucket * CUCKOO_BUCKET_SLOTS + i) == 0) {
+            slot_set(set, filter, bucket * CUCKOO_BUCKET_SLOTS + i, fingerprint);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Add a fingerprint to a filter, evicting residents to their other bucket as needed.
+ *
+ * If CUCKOO_MAX_KICKS evictions do not free a slot, every eviction is undone so the filter is left
+ * exactly as it was. Called with the shard lock held.
+ *
+ * @return true if the fingerprint was stored, false if the filter is too full.
+ */
+static bool filter_add(const VisitedSet *set, VisitedShard *shard, CuckooFilter *filter, uint64_t hash,
+                       uint32_t fingerprint) {
+    size_t bucket = hash & (filter->buckets - 1);
+    size_t other = alt_bucket(filter, bucket, fingerprint);
+    if (bucket_add(set, filter, bucket, fingerprint) || bucket_add(set, filter, other, fingerprint)) {
+        filter->count++;
+        return true;
+    }
+
+    size_t path[CUCKOO_MAX_KICKS];
+    uint32_t carried = fingerprint;
+    bucket = (shard->rng & 1) ? other : bucket;
+    for (int kick = 0; kick < CUCKOO_MAX_KICKS; kick++) {
+        // Swap the carried fingerprint with a random resident and move the resident to its other bucket
+        shard->rng ^= shard->rng << 13;
+        shard->rng ^= shard->rng >> 17;
+        shard->rng ^= shard->rng << 5;
+        size_t slot = bucket * CUCKOO_BUCKET_SLOTS + shard->rng % CUCKOO_BUCKET_SLOTS;
+        path[kick] = slot;
+        uint32_t evicted = slot_get(set, filter, slot);
+        slot_set(set, filter, slot, carried);
+        carried = evicted;
+        shard->kicks++;
+        bucket = alt_bucket(filter, bucket, carried);
+        if (bucket_add(set, filter, bucket, carried)) {
+            filter->count++;
+            return true;
+        }
+    }
+    // Undo the swaps in reverse; this puts every evicted fingerprint back where it was
+    for (int kick = CUCKOO_MAX_KICKS - 1; kick >= 0; kick--) {
+        uint32_t resident = slot_get(set, filter, path[kick]);
+        slot_set(set, filter, path[kick], carried);
+        carried = resident;
+    }
+    return false;
+}
+
+// Insert-if-absent for VISITED_FINGERPRINT mode. Called with the shard lock held.
+static bool shard_insert_fingerprint(VisitedSet *set, VisitedShard *shard, uint64_t hash) {
+    // The fingerprint comes from bits 26 and up, away from the low bits that index the buckets and the
+    // top bits that picked the shard; 0 marks an empty slot, so it is never used
+    uint32_t fingerprint = (uint32_t)(hash >> 26);
+    if (set->fingerprint_bits < 32) {
+        fingerprint &= (1u << set->fingerprint_bits) - 1;
+    }
+    if (fingerprint == 0) {
+        fingerprint = 1;
+    }
+
+    for (CuckooFilter *filter = shard->filters; filter != NULL; filter = filter->next) {
+        size_t bucket = hash & (filter->buckets - 1);
+        shard->probes += 2;
+        if (bucket_contains(set, filter, bucket, fingerprint) ||
+            bucket_contains(set, filter, alt_bucket(filter, bucket, fingerprint), fingerprint)) {
+            return false; // Visited, or a false positive
+        }
+    }
+
+    // The fingerprints alone cannot be moved into a bigger table, so a full filter is kept and a new one
+    // twice its size takes further inserts
+    CuckooFilter *newest = shard->filters;
+    if (newest->count * 100 >= newest->buckets * CUCKOO_BUCKET_SLOTS * CUCKOO_MAX_LOAD ||
+        !filter_add(set, shard, newest, hash, fingerprint)) {
+        CuckooFilter *filter = filter_new(set, newest->buckets * 2, newest);
+        if (filter == NULL) {
+            fprintf(stderr, "Failed to grow the visited set\n");
+            return false;
+        }
+        shard->filters = filter;
+        filter_add(set, shard, filter, hash, fingerprint);
+    }
+    shard->count++;
+    return true;
+}
+
+bool visited_insert(VisitedSet *set, const char *url) {
+    size_t len = strlen(url);
+    uint64_t hash = url_hash(url, len);
+    // The top bits pick the shard; the low bits pick the slot within it
+    VisitedShard *shard = &set->shards[hash >> (64 - VISITED_SHARD_BITS)];
+
+    pthread_mutex_lock(&shard->lock);
+    shard->lookups++;
+    if (set->mode == VISITED_FINGERPRINT) {
+        bool inserted = shard_insert_fingerprint(set, shard, hash);
+        pthread_mutex_unlock(&shard->lock);
+        return inserted;
+    }
+
+    size_t mask = shard->capacity - 1;
+    size_t slot = hash & mask;
+    shard->probes++;
+    while (shard->entries[slot].key != NULL) {
+        if (shard->entries[slot].hash == hash && strcmp(shard->entries[slot].key, url) == 0) {
+            pthread_mutex_unlock(&shard->lock);
+            return false; // Already visited
+        }
+        slot = (slot + 1) & mask;
+        shard->probes++;
+    }
+
+    // Not present: the lookup and the insert happen under the same lock, so exactly one caller wins
+    const char *key = arena_copy(shard, url, len);
+    if (key == NULL) {
+        pthread_mutex_unlock(&shard->lock);
+        fprintf(stderr, "Failed to allocate memory for visited URL\n");
+        return false;
+    }
+    shard->entries[slot].hash = hash;
+    shard->entries[slot].key = key;
+    shard->count++;
+
+    // Keep the load factor under 70% so probe sequences stay short
+    if (shard->count * 10 > shard->capacity * 7 && !shard_grow(shard)) {
+        fprintf(stderr, "Failed to grow the visited set\n");
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return true;
+}
+
+size_t visited_size(VisitedSet *set) {
+    size_t size = 0;
+    for (int i = 0; i < VISITED_SHARDS; i++) {
+        pthread_mutex_lock(&set->shards[i].lock);
+        size += set->shards[i].count;
+        pthread_mutex_unlock(&set->shards[i].lock);
+    }
+    return size;
+}
+
+// Bytes used by one shard. Called with the shard lock held.
+static size_t shard_memory(VisitedSet *set, VisitedShard *shard) {
+    size_t bytes = shard->capacity * sizeof(VisitedEntry) + shard->arena_bytes;
+    for (CuckooFilter *filter = shard->filters; filter != NULL; filter = filter->next) {
+        bytes += sizeof(CuckooFilter) + filter->buckets * CUCKOO_BUCKET_SLOTS * (set->fingerprint_bits / 8);
+    }
+    return bytes;
+}
+
+size_t visited_memory(VisitedSet *set) {
+    size_t bytes = sizeof(VisitedSet);
+    for (int i = 0; i < VISITED_SHARDS; i++) {
+        pthread_mutex_lock(&set->shards[i].lock);
+        bytes += shard_memory(set, &set->shards[i]);
+        pthread_mutex_unlock(&set->shards[i].lock);
+    }
+    return bytes;
+}
+
+void visited_stats(VisitedSet *set, VisitedStats *stats) {
+    memset(stats, 0, sizeof(VisitedStats));
+    stats->bytes = sizeof(VisitedSet);
+    double match = 1.0 / ((double)(1UL << set->fingerprint_bits) - 1);
+    for (int i = 0; i < VISITED_SHARDS; i++) {
+        VisitedShard *shard = &set->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        stats->urls += shard->count;
+        stats->bytes += shard_memory(set, shard);
+        stats->lookups += shard->lookups;
+        stats->probes += shard->probes;
+        stats->kicks += shard->kicks;
+        // A new URL is checked against two buckets of every filter in its shard
+        for (CuckooFilter *filter = shard->filters; filter != NULL; filter = filter->next) {
+            double load = (double)filter->count / (filter->buckets * CUCKOO_BUCKET_SLOTS);
+            stats->false_positive_rate += 2 * CUCKOO_BUCKET_SLOTS * load * match / VISITED_SHARDS;
+            stats->filters++;
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+// Header of a saved set.
+typedef struct {
+    uint32_t mode;
+    uint32_t fingerprint_bits;
+    uint32_t shards;
+    uint32_t reserved;
+} VisitedFileHeader;
+
+// Header of one saved cuckoo filter, followed by its slots.
+typedef struct {
+    uint64_t buckets;
+    uint64_t count;
+} FilterFileHeader;
+
+bool visited_save(VisitedSet *set, FILE *out) {
+    VisitedFileHeader header = { (uint32_t)set->mode, (uint32_t)set->fingerprint_bits, VISITED_SHARDS, 0 };
+    if (fwrite(&header, sizeof(header), 1, out) != 1) {
+        return false;
+    }
+    for (int i = 0; i < VISITED_SHARDS; i++) {
+        VisitedShard *shard = &set->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        bool ok = true;
+        if (set->mode == VISITED_EXACT) {
+            // Shard: URL count, then each URL as a length and its bytes
+            uint64_t count = shard->count;
+            ok = fwrite(&count, sizeof(count), 1, out) == 1;
+            for (size_t slot = 0; ok && slot < shard->capacity; slot++) {
+                const char *key = shard->entries[slot].key;
+                if (key != NULL) {
+                    uint32_t len = (uint32_t)strlen(key);
+                    ok = fwrite(&len, sizeof(len), 1, out) == 1 && fwrite(key, 1, len, out) == len;
+                }
+            }
+        } else {
+            // Shard: URL count and filter count, then each filter newest first with its raw slots
+            uint64_t counts[2] = { shard->count, 0 };
+            for (CuckooFilter *filter = shard->filters; filter != NULL; filter = filter->next) {
+                counts[1]++;
+            }
+            ok = fwrite(counts, sizeof(counts), 1, out) == 1;
+            for (CuckooFilter *filter = shard->filters; ok && filter != NULL; filter = filter->next) {
+                FilterFileHeader filter_header = { filter->buckets, filter->count };
+                size_t slots = filter->buckets * CUCKOO_BUCKET_SLOTS;
+                ok = fwrite(&filter_header, sizeof(filter_header), 1, out) == 1 &&
+                     fwrite(filter->slots, set->fingerprint_bits / 8, slots, out) == slots;
+            }
+        }
+        pthread_mutex_unlock(&shard->lock);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copy n bytes out of the saved data, advancing the cursor. Returns false if fewer than n are left.
+static bool take(const char **cursor, const char *end, void *dest, size_t n) {
+    if ((size_t)(end - *cursor) < n) {
+        return false;
+    }
+    memcpy(dest, *cursor, n);
+    *cursor += n;
+    return true;
+}
+
+// Load one saved shard. Returns false if the data is malformed.
+static bool load_shard(VisitedSet *set, VisitedShard *shard, const char **cursor, const char *end) {
+    if (set->mode == VISITED_EXACT) {
+        uint64_t count;
+        if (!take(cursor, end, &count, sizeof(count))) {
+            return false;
+        }
+        char *url = NULL;
+        size_t url_size = 0;
+        for (uint64_t n = 0; n < count; n++) {
+            uint32_t len;
+            if (!take(cursor, end, &len, sizeof(len)) || (size_t)(end - *cursor) < len) {
+                free(url);
+                return false;
+            }
+            if (len + 1 > url_size) {
+                url_size = len + 1;
+                url = realloc(url, url_size);
+            }
+            memcpy(url, *cursor, len);
+            url[len] = '\0';
+            *cursor += len;
+            visited_insert(set, url);
+        }
+        free(url);
+        return true;
+    }
+
+    // Replace the shard's empty filter with the saved ones, keeping their newest-first order
+    uint64_t counts[2];
+    if (!take(cursor, end, counts, sizeof(counts)) || counts[1] == 0) {
+        return false;
+    }
+    free(shard->filters->slots);
+    free(shard->filters);
+    shard->filters = NULL;
+    CuckooFilter **tail = &shard->filters;
+    for (uint64_t n = 0; n < counts[1]; n++) {
+        FilterFileHeader filter_header;
+        if (!take(cursor, end, &filter_header, sizeof(filter_header)) || filter_header.buckets == 0 ||
+            (filter_header.buckets & (filter_header.buckets - 1)) != 0) {
+            return false;
+        }
+        CuckooFilter *filter = filter_new(set, filter_header.buckets, NULL);
+        if (filter == NULL) {
+            return false;
+        }
+        *tail = filter;
+        tail = &filter->next;
+        filter->count = filter_header.count;
+        if (!take(cursor, end, filter->slots, filter->buckets * CUCKOO_BUCKET_SLOTS * (set->fingerprint_bits / 8))) {
+            return false;
+        }
+    }
+    shard->count = counts[0];
+    return true;
+}
+
+bool visited_load(VisitedSet *set, const void *data, size_t size) {
+    const char *cursor = data, *end = cursor + size;
+    VisitedFileHeader header;
+    if (!take(&cursor, end, &header, sizeof(header)) || header.shards != VISITED_SHARDS ||
+        header.mode > VISITED_FINGERPRINT ||
+        (header.fingerprint_bits != 8 && header.fingerprint_bits != 16 && header.fingerprint_bits != 32)) {
+        return false;
+    }
+    visited_init(set, (VisitedMode)header.mode, 1.0, 0);
+    set->fingerprint_bits = (int)header.fingerprint_bits;
+
+    for (int i = 0; i < VISITED_SHARDS; i++) {
+        if (!load_shard(set, &set->shards[i], &cursor, end)) {
+            visited_destroy(set);
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,127 @@
+#ifndef VISITED_H
+#define VISITED_H
+
+// Include size types.
+#include <stddef.h>
+// Include fixed-width integer types.
+#include <stdint.h>
+// Include the boolean type definition.
+#include <stdbool.h>
+// Include the pthread library for the shard locks.
+#include <pthread.h>
+// Include standard input/output functionality for saving the set.
+#include <stdio.h>
+
+// Define the number of bits of the hash that pick a shard, and the resulting number of shards.
+#define VISITED_SHARD_BITS 6
+#define VISITED_SHARDS (1 << VISITED_SHARD_BITS)
+// Define the size of each block of the per-shard string arena.
+#define VISITED_ARENA_BLOCK (64 * 1024)
+// Define the number of fingerprints per cuckoo filter bucket.
+#define CUCKOO_BUCKET_SLOTS 4
+// Define the number of evictions an insert may make before the shard gets a bigger filter.
+#define CUCKOO_MAX_KICKS 500
+
+// How the set remembers a URL.
+typedef enum {
+    VISITED_EXACT,                   // Full URL strings; never wrong
+    VISITED_FINGERPRINT              // Short hash fingerprints in cuckoo filters; may report a false positive
+} VisitedMode;
+
+// One slot of a shard's open-addressed table. An empty slot has key == NULL.
+typedef struct {
+    uint64_t hash;
+    const char *key;                 // Points into the shard's arena
+} VisitedEntry;
+
+// A block of the per-shard string arena. Keys are packed back to back and never move.
+typedef struct VisitedArenaBlock {
+    struct VisitedArenaBlock *next;
+    size_t used;
+    size_t size;
+    char data[];
+} VisitedArenaBlock;
+
+/**
+ * @brief A cuckoo filter: buckets of CUCKOO_BUCKET_SLOTS fingerprints, 0 meaning empty.
+ *
+ * A fingerprint lives in one of two buckets: the one picked by the low bits of the URL hash, or that
+ * index XORed with a hash of the fingerprint. The second bucket can be computed from the first and the
+ * fingerprint alone, which lets an insert evict a resident fingerprint to its other bucket without
+ * knowing its URL.
+ */
+typedef struct CuckooFilter {
+    struct CuckooFilter *next;       // Older, smaller filter of the same shard
+    void *slots;                     // buckets * CUCKOO_BUCKET_SLOTS fingerprints of the set's width
+    size_t buckets;                  // Number of buckets, a power of two
+    size_t count;                    // Number of fingerprints stored
+} CuckooFilter;
+
+// One shard: a lock, a linear-probing table and the arena holding its keys, or a chain of cuckoo filters.
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    VisitedEntry *entries;
+    size_t capacity;                 // Number of slots, a power of two
+    size_t count;                    // Number of keys stored
+    VisitedArenaBlock *arena;        // Block currently being filled, linked to the older ones
+    size_t arena_bytes;              // Bytes allocated for arena blocks
+    CuckooFilter *filters;           // Newest filter first; a full filter is followed by one twice its size
+    unsigned int rng;                // Eviction victim selection
+    unsigned long lookups;           // visited_insert calls on this shard
+    unsigned long probes;            // Table slots (exact) or buckets (fingerprint) examined
+    unsigned long kicks;             // Fingerprints evicted to their other bucket
+} VisitedShard;
+
+/**
+ * @brief Concurrent set of visited URLs.
+ *
+ * The set is split into VISITED_SHARDS independently locked shards picked by the top bits of the URL's
+ * hash, so threads inserting different URLs rarely touch the same lock. Each shard is an open-addressed
+ * table that keeps the full hash next to the key, so probes compare strings only on a hash match and
+ * growing the table never rehashes a string. Keys are copied into a per-shard arena instead of getting
+ * one heap allocation each.
+ *
+ * In VISITED_FINGERPRINT mode a shard keeps only an 8, 16 or 32-bit fingerprint of each URL's hash, the
+ * smallest width that meets the requested false-positive rate, which costs one to four bytes per URL
+ * plus the filter's empty slots. A false positive makes the crawler skip a URL it has not seen.
+ */
+typedef struct {
+    VisitedShard shards[VISITED_SHARDS];
+    VisitedMode mode;
+    int fingerprint_bits;            // Fingerprint width in VISITED_FINGERPRINT mode
+} VisitedSet;
+
+// Summary of a set's size, memory use and probe counts.
+typedef struct {
+    size_t urls;                     // URLs inserted
+    size_t bytes;                    // Bytes used by tables, arenas and filters
+    unsigned long lookups;           // visited_insert calls
+    unsigned long probes;            // Slots or buckets examined
+    unsigned long kicks;             // Cuckoo evictions
+    int filters;                     // Cuckoo filters across all shards
+    double false_positive_rate;      // Estimated chance that a new URL is reported as visited
+} VisitedStats;
+
+// Hash a URL (or any byte string) to 64 bits.
+uint64_t url_hash(const char *data, size_t len);
+// Initialize an empty set sized for about expected_urls URLs (0 for a small default). false_positive_rate
+// is the target rate in VISITED_FINGERPRINT mode and is ignored in VISITED_EXACT mode.
+void visited_init(VisitedSet *set, VisitedMode mode, double false_positive_rate, size_t expected_urls);
+// Free the set and every key in it.
+void visited_destroy(VisitedSet *set);
+// Insert a URL if it is not already present. Returns true if this call inserted it.
+bool visited_insert(VisitedSet *set, const char *url);
+// Number of URLs in the set.
+size_t visited_size(VisitedSet *set);
+// Bytes used by the tables, arenas and filters.
+size_t visited_memory(VisitedSet *set);
+// Collect size, memory and probe statistics.
+void visited_stats(VisitedSet *set, VisitedStats *stats);
+// Write the set to out: every URL in VISITED_EXACT mode, the raw filters in VISITED_FINGERPRINT mode.
+// Returns false on an I/O error.
+bool visited_save(VisitedSet *set, FILE *out);
+// Initialize set from data written by visited_save, e.g. a memory-mapped file. Returns false if the data
+// is malformed, in which case the set is left uninitialized.
+bool visited_load(VisitedSet *set, const void *data, size_t size);
+
+#endif